@@ -0,0 +1,85 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <pow.h>
+#include <random.h>
+#include <test/util/setup_common.h>
+#include <txdb.h>
+#include <validation.h>
+#include <versionbits.h>
+
+//! Number of headers in the block index of the benchmarks
+static constexpr int BENCH_BLOCK_INDEX_SIZE{100000};
+
+/** Write a chain of headers with valid proof of work to the block tree database. */
+static void WriteHeaders(CBlockTreeDB& blocktree, int num_headers)
+{
+    const Consensus::Params& consensus = Params().GetConsensus();
+    std::vector<uint256> hashes(num_headers);
+    std::vector<CBlockIndex> entries(num_headers);
+    std::vector<const CBlockIndex*> blockinfo;
+    for (int i = 0; i < num_headers; ++i) {
+        CBlockHeader header;
+        header.nVersion = VERSIONBITS_TOP_BITS;
+        header.hashPrevBlock = i > 0 ? hashes[i - 1] : uint256();
+        header.nTime = Params().GenesisBlock().nTime + i;
+        header.nBits = UintToArith256(consensus.powLimit).GetCompact();
+        while (!CheckProofOfWork(header.GetHash(), header.nBits, consensus)) {
+            ++header.nNonce;
+        }
+        hashes[i] = header.GetHash();
+        entries[i] = CBlockIndex(header);
+        entries[i].phashBlock = &hashes[i];
+        entries[i].pprev = i > 0 ? &entries[i - 1] : nullptr;
+        entries[i].nHeight = i;
+        entries[i].RaiseValidity(BLOCK_VALID_TREE);
+        blockinfo.push_back(&entries[i]);
+    }
+    assert(blocktree.WriteBatchSync({}, 0, blockinfo));
+}
+
+static void LoadBlockIndex(benchmark::Bench& bench)
+{
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+    CBlockTreeDB blocktree(1 << 20, true);
+    WriteHeaders(blocktree, BENCH_BLOCK_INDEX_SIZE);
+
+    LOCK(cs_main);
+    CBlockIndex* const best_header = pindexBestHeader;
+    bench.run([&] {
+        BlockManager blockman;
+        std::set<CBlockIndex*, CBlockIndexWorkComparator> candidates;
+        assert(blockman.LoadBlockIndex(Params().GetConsensus(), blocktree, candidates));
+        assert(blockman.m_block_index.size() == BENCH_BLOCK_INDEX_SIZE);
+        pindexBestHeader = best_header;
+    });
+}
+
+static void BlockIndexGetAncestor(benchmark::Bench& bench)
+{
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+    CBlockTreeDB blocktree(1 << 20, true);
+    WriteHeaders(blocktree, BENCH_BLOCK_INDEX_SIZE);
+
+    LOCK(cs_main);
+    CBlockIndex* const best_header = pindexBestHeader;
+    BlockManager blockman;
+    std::set<CBlockIndex*, CBlockIndexWorkComparator> candidates;
+    assert(blockman.LoadBlockIndex(Params().GetConsensus(), blocktree, candidates));
+    const CBlockIndex* tip = pindexBestHeader;
+    assert(tip->nHeight == BENCH_BLOCK_INDEX_SIZE - 1);
+    pindexBestHeader = best_header;
+
+    FastRandomContext rng(true);
+    bench.minEpochIterations(10000).run([&] {
+        const CBlockIndex* pindex = tip->GetAncestor(rng.randrange(BENCH_BLOCK_INDEX_SIZE));
+        pindex = pindex->GetAncestor(rng.randrange(pindex->nHeight + 1));
+        ankerl::nanobench::doNotOptimizeAway(pindex);
+    });
+}
+
+BENCHMARK(LoadBlockIndex);
+BENCHMARK(BlockIndexGetAncestor);
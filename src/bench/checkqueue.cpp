@@ -4,18 +4,26 @@
 
 #include <bench/bench.h>
 #include <checkqueue.h>
+#include <crypto/sha256.h>
 #include <key.h>
 #include <prevector.h>
 #include <pubkey.h>
 #include <random.h>
+#include <script/sigcache.h>
+#include <tinyformat.h>
+#include <uint256.h>
 #include <util/system.h>
 
+#include <algorithm>
+#include <array>
+#include <deque>
 #include <vector>
 
 static const size_t BATCHES = 101;
 static const size_t BATCH_SIZE = 30;
 static const int PREVECTOR_SIZE = 28;
 static const unsigned int QUEUE_BATCH_SIZE = 128;
+static const size_t SCHNORR_JOBS = 2000;
 
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
@@ -69,3 +77,128 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::Bench& bench)
     ECC_Stop();
 }
 BENCHMARK(CCheckQueueSpeedPrevectorJob);
+
+// This Benchmark measures how the CheckQueue scales with the number of threads
+// (including the master), using small checks so that the overhead of
+// distributing them over the threads dominates.
+static void CCheckQueueScaling(benchmark::Bench& bench)
+{
+    struct HashJob {
+        uint256 data;
+        bool operator()()
+        {
+            uint256 out;
+            CSHA256().Write(data.begin(), data.size()).Finalize(out.begin());
+            return out != data;
+        }
+        void swap(HashJob& x) { std::swap(data, x.data); }
+    };
+
+    FastRandomContext insecure_rand(true);
+    std::vector<std::vector<HashJob>> vBatches(BATCHES * 10);
+    for (auto& vChecks : vBatches) {
+        vChecks.resize(BATCH_SIZE);
+        for (auto& check : vChecks) check.data = insecure_rand.rand256();
+    }
+
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        CCheckQueue<HashJob> queue{QUEUE_BATCH_SIZE};
+        queue.StartWorkerThreads(threads - 1);
+        bench.minEpochIterations(10).batch(BATCH_SIZE * vBatches.size()).unit("check").run(strprintf("CCheckQueueScaling %d threads", threads), [&] {
+            CCheckQueueControl<HashJob> control(&queue);
+            for (auto vChecks : vBatches) {
+                control.Add(vChecks);
+            }
+            bool ret = control.Wait();
+            assert(ret);
+        });
+        queue.StopWorkerThreads();
+    }
+}
+BENCHMARK(CCheckQueueScaling);
+
+// This Benchmark tests the CheckQueue with jobs that each verify one Schnorr
+// signature, either by themselves or by adding it to a batch of QUEUE_BATCH_SIZE
+// jobs that is verified by the worker running the last job of the batch, as
+// done for the signatures of a block.
+static void CheckQueueSchnorrJobs(benchmark::Bench& bench, bool use_batch)
+{
+    // We shouldn't ever be running with the checkqueue on a single core machine.
+    if (GetNumCores() <= 1) return;
+
+    const ECCVerifyHandle verify_handle;
+    ECC_Start();
+
+    struct SchnorrJob {
+        std::vector<unsigned char> pubkey;
+        uint256 msg;
+        std::array<unsigned char, 64> sig;
+        BatchSchnorrVerifier* batch{nullptr};
+        bool operator()()
+        {
+            const XOnlyPubKey xonly{pubkey};
+            if (batch) {
+                batch->Add(sig, xonly, msg);
+                return batch->FinishCheck();
+            }
+            return xonly.VerifySchnorr(msg, sig);
+        }
+        void swap(SchnorrJob& x)
+        {
+            std::swap(pubkey, x.pubkey);
+            std::swap(msg, x.msg);
+            std::swap(sig, x.sig);
+            std::swap(batch, x.batch);
+        }
+    };
+    CCheckQueue<SchnorrJob> queue {QUEUE_BATCH_SIZE};
+    queue.StartWorkerThreads(GetNumCores() - 1);
+
+    FastRandomContext insecure_rand(true);
+    std::vector<SchnorrJob> jobs(SCHNORR_JOBS);
+    for (auto& job : jobs) {
+        CKey key;
+        const uint256 secret = insecure_rand.rand256();
+        key.Set(secret.begin(), secret.end(), true);
+        const CPubKey pubkey = key.GetPubKey();
+        job.pubkey.assign(pubkey.begin() + 1, pubkey.end());
+        job.msg = insecure_rand.rand256();
+        bool ret = key.SignSchnorr(job.msg, job.sig);
+        assert(ret);
+    }
+
+    bench.minEpochIterations(10).batch(SCHNORR_JOBS).unit("job").run([&] {
+        std::deque<BatchSchnorrVerifier> batches;
+        CCheckQueueControl<SchnorrJob> control(&queue);
+        bool ret{true};
+        for (size_t i = 0; i < jobs.size(); i += QUEUE_BATCH_SIZE) {
+            std::vector<SchnorrJob> vChecks(jobs.begin() + i, jobs.begin() + std::min(jobs.size(), i + QUEUE_BATCH_SIZE));
+            if (use_batch) {
+                BatchSchnorrVerifier& batch = batches.emplace_back();
+                for (SchnorrJob& job : vChecks) {
+                    batch.AddCheck();
+                    job.batch = &batch;
+                }
+            }
+            control.Add(vChecks);
+            if (use_batch) ret &= batches.back().FinishCheck();
+        }
+        ret &= control.Wait();
+        assert(ret);
+    });
+    queue.StopWorkerThreads();
+    ECC_Stop();
+}
+
+static void CCheckQueueSpeedSchnorrJob(benchmark::Bench& bench)
+{
+    CheckQueueSchnorrJobs(bench, /* use_batch= */ false);
+}
+
+static void CCheckQueueSpeedSchnorrBatchJob(benchmark::Bench& bench)
+{
+    CheckQueueSchnorrJobs(bench, /* use_batch= */ true);
+}
+
+BENCHMARK(CCheckQueueSpeedSchnorrJob);
+BENCHMARK(CCheckQueueSpeedSchnorrBatchJob);
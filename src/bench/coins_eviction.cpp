@@ -0,0 +1,88 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <random.h>
+#include <test/util/setup_common.h>
+#include <txdb.h>
+
+#include <algorithm>
+#include <vector>
+
+static constexpr size_t COINS_PER_BLOCK = 2000;
+static constexpr size_t BLOCKS_PER_RUN = 10;
+static constexpr size_t WARMUP_BLOCKS = 200;
+//! Spends come from the coins created in this many recent blocks...
+static constexpr size_t HOT_BLOCKS = 20;
+//! ...except for one in this many, which spends any unspent coin.
+static constexpr uint64_t COLD_SPEND_RATIO = 10;
+static constexpr size_t CACHE_BUDGET_BYTES = 8 << 20;
+
+// Connect blocks that each create and spend COINS_PER_BLOCK coins, mostly
+// recent ones as during IBD, with a cache that regularly exceeds its budget.
+// Either the whole cache is flushed and cleared, or the changes are written
+// and the oldest coins evicted, as FlushStateToDisk does.
+static void ConnectBlocksUnderCachePressure(benchmark::Bench& bench, bool evict)
+{
+    const auto testing_setup = MakeNoLogFileContext<const BasicTestingSetup>();
+    CCoinsViewDB db("coins_eviction_bench", 8 << 20, /* fMemory */ true, /* fWipe */ false);
+    CCoinsViewCache cache(&db);
+    FastRandomContext rng(true);
+
+    // Unspent outpoints, roughly in order of creation.
+    std::vector<COutPoint> unspent;
+    uint32_t height = 0;
+
+    const auto connect_block = [&] {
+        ++height;
+        for (size_t i = 0; i < COINS_PER_BLOCK && !unspent.empty(); ++i) {
+            const size_t hot = std::min(unspent.size(), HOT_BLOCKS * COINS_PER_BLOCK);
+            const size_t index = rng.randrange(COLD_SPEND_RATIO) == 0 ? rng.randrange(unspent.size()) : unspent.size() - 1 - rng.randrange(hot);
+            const bool spent = cache.SpendCoin(unspent[index]);
+            assert(spent);
+            unspent[index] = unspent.back();
+            unspent.pop_back();
+        }
+        const uint256 txid = rng.rand256();
+        for (uint32_t n = 0; n < COINS_PER_BLOCK; ++n) {
+            unspent.emplace_back(txid, n);
+            cache.AddCoin(unspent.back(), Coin(CTxOut(COIN, CScript() << OP_TRUE), height, false), false);
+        }
+        cache.SetBestBlock(rng.rand256());
+
+        if (cache.DynamicMemoryUsage() > CACHE_BUDGET_BYTES) {
+            if (evict) {
+                cache.Sync();
+                cache.Evict(CACHE_BUDGET_BYTES / 2);
+            } else {
+                cache.Flush();
+            }
+        }
+    };
+
+    // Grow the UTXO set well beyond the cache budget before measuring.
+    for (size_t block = 0; block < WARMUP_BLOCKS; ++block) {
+        connect_block();
+    }
+
+    bench.batch(BLOCKS_PER_RUN * COINS_PER_BLOCK).unit("coin").run([&] {
+        for (size_t block = 0; block < BLOCKS_PER_RUN; ++block) {
+            connect_block();
+        }
+    });
+}
+
+static void CoinsCacheFlushAll(benchmark::Bench& bench)
+{
+    ConnectBlocksUnderCachePressure(bench, /* evict */ false);
+}
+
+static void CoinsCacheEvictOldest(benchmark::Bench& bench)
+{
+    ConnectBlocksUnderCachePressure(bench, /* evict */ true);
+}
+
+BENCHMARK(CoinsCacheFlushAll);
+BENCHMARK(CoinsCacheEvictOldest);
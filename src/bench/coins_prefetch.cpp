@@ -0,0 +1,128 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <test/util/setup_common.h>
+#include <txdb.h>
+#include <validation.h>
+
+#include <vector>
+
+static constexpr size_t NUM_DB_TXS = 5000;
+static constexpr size_t OUTPUTS_PER_DB_TX = 4;
+static constexpr size_t NUM_BLOCK_TXS = 500;
+static constexpr size_t INPUTS_PER_BLOCK_TX = 4;
+
+// Fill an in-memory chainstate database with coins, and build a block that
+// spends a random subset of them.
+static void SetupPrefetchData(CCoinsViewDB& db, CBlock& block)
+{
+    FastRandomContext rng(true);
+    std::vector<COutPoint> outpoints;
+    {
+        CCoinsViewCache cache(&db);
+        for (size_t i = 0; i < NUM_DB_TXS; ++i) {
+            const uint256 txid = rng.rand256();
+            for (size_t n = 0; n < OUTPUTS_PER_DB_TX; ++n) {
+                CTxOut out(rng.randrange(50 * COIN), CScript() << OP_DUP << OP_HASH160 << rng.randbytes(20) << OP_EQUALVERIFY << OP_CHECKSIG);
+                outpoints.emplace_back(txid, n);
+                cache.AddCoin(outpoints.back(), Coin(std::move(out), 1, false), false);
+            }
+        }
+        cache.SetBestBlock(rng.rand256());
+        cache.Flush();
+    }
+    Shuffle(outpoints.begin(), outpoints.end(), rng);
+
+    block.vtx.clear();
+    auto outpoint_it = outpoints.begin();
+    for (size_t i = 0; i < NUM_BLOCK_TXS; ++i) {
+        CMutableTransaction mtx;
+        for (size_t n = 0; n < INPUTS_PER_BLOCK_TX; ++n) {
+            mtx.vin.emplace_back(*outpoint_it++);
+        }
+        mtx.vout.emplace_back(COIN, CScript() << OP_TRUE);
+        block.vtx.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+}
+
+// Fetch every input of a block through a cold coins cache, as ConnectBlock
+// does, either with or without warming the cache in parallel first.
+static void FetchBlockInputs(benchmark::Bench& bench, int prefetch_threads)
+{
+    const auto testing_setup = MakeNoLogFileContext<const BasicTestingSetup>();
+    CCoinsViewDB db("coins_prefetch_bench", 8 << 20, /* fMemory */ true, /* fWipe */ false);
+    CBlock block;
+    SetupPrefetchData(db, block);
+
+    StartCoinsPrefetchWorkerThreads(prefetch_threads);
+    bench.batch(NUM_BLOCK_TXS * INPUTS_PER_BLOCK_TX).unit("input").run([&] {
+        CCoinsViewCache cache(&db);
+        PrefetchBlockInputs(block, cache, db);
+        for (const auto& tx : block.vtx) {
+            for (const CTxIn& txin : tx->vin) {
+                const Coin& coin = cache.AccessCoin(txin.prevout);
+                assert(!coin.IsSpent());
+            }
+        }
+    });
+    StopCoinsPrefetchWorkerThreads();
+}
+
+static void CoinsFetchBlockInputs(benchmark::Bench& bench)
+{
+    FetchBlockInputs(bench, /* prefetch_threads */ 0);
+}
+
+static void CoinsPrefetchBlockInputs(benchmark::Bench& bench)
+{
+    FetchBlockInputs(bench, DEFAULT_COINS_PREFETCH_THREADS);
+}
+
+// Look the inputs of a block up directly in the database, one by one or in a
+// single batch.
+static void LookupBlockInputs(benchmark::Bench& bench, bool batch)
+{
+    const auto testing_setup = MakeNoLogFileContext<const BasicTestingSetup>();
+    CCoinsViewDB db("coins_prefetch_bench", 8 << 20, /* fMemory */ true, /* fWipe */ false);
+    CBlock block;
+    SetupPrefetchData(db, block);
+
+    std::vector<COutPoint> outpoints;
+    for (const auto& tx : block.vtx) {
+        for (const CTxIn& txin : tx->vin) {
+            outpoints.push_back(txin.prevout);
+        }
+    }
+    std::vector<Coin> coins(outpoints.size());
+    bench.batch(outpoints.size()).unit("input").run([&] {
+        size_t found = 0;
+        if (batch) {
+            found = db.GetCoins(outpoints, coins);
+        } else {
+            for (size_t i = 0; i < outpoints.size(); ++i) {
+                if (db.GetCoin(outpoints[i], coins[i])) ++found;
+            }
+        }
+        assert(found == outpoints.size());
+    });
+}
+
+static void CoinsDBGetCoin(benchmark::Bench& bench)
+{
+    LookupBlockInputs(bench, /* batch */ false);
+}
+
+static void CoinsDBGetCoins(benchmark::Bench& bench)
+{
+    LookupBlockInputs(bench, /* batch */ true);
+}
+
+BENCHMARK(CoinsFetchBlockInputs);
+BENCHMARK(CoinsPrefetchBlockInputs);
+BENCHMARK(CoinsDBGetCoin);
+BENCHMARK(CoinsDBGetCoins);
@@ -39,5 +39,54 @@ static void MatchGCSFilter(benchmark::Bench& bench)
     });
 }
 
+static void DecodeGCSFilter(benchmark::Bench& bench)
+{
+    GCSFilter::ElementSet elements;
+    for (int i = 0; i < 10000; ++i) {
+        GCSFilter::Element element(32);
+        element[0] = static_cast<unsigned char>(i);
+        element[1] = static_cast<unsigned char>(i >> 8);
+        elements.insert(std::move(element));
+    }
+    GCSFilter filter({0, 0, 20, 1 << 20}, elements);
+
+    bench.batch(elements.size()).unit("elem").run([&] {
+        GCSFilter decoded(filter.GetParams(), filter.GetEncoded());
+    });
+}
+
+/** Screen a chain segment of block-sized filters for a wallet-sized set of scripts, as a rescan does. */
+static void MatchAnyGCSFilterRange(benchmark::Bench& bench)
+{
+    std::vector<GCSFilter> filters;
+    for (int block = 0; block < 100; ++block) {
+        GCSFilter::ElementSet elements;
+        for (int i = 0; i < 2000; ++i) {
+            GCSFilter::Element element(32);
+            element[0] = static_cast<unsigned char>(i);
+            element[1] = static_cast<unsigned char>(i >> 8);
+            element[2] = static_cast<unsigned char>(block);
+            elements.insert(std::move(element));
+        }
+        filters.emplace_back(GCSFilter::Params{static_cast<uint64_t>(block), 0, BASIC_FILTER_P, BASIC_FILTER_M}, elements);
+    }
+
+    GCSFilter::ElementSet queries;
+    for (int i = 0; i < 1000; ++i) {
+        GCSFilter::Element element(32, 0xff);
+        element[0] = static_cast<unsigned char>(i);
+        element[1] = static_cast<unsigned char>(i >> 8);
+        queries.insert(std::move(element));
+    }
+
+    bench.batch(filters.size()).unit("filter").run([&] {
+        for (const GCSFilter& filter : filters) {
+            filter.MatchAny(queries);
+        }
+    });
+}
+
 BENCHMARK(ConstructGCSFilter);
+BENCHMARK(DecodeGCSFilter);
 BENCHMARK(MatchGCSFilter);
+BENCHMARK(MatchAnyGCSFilterRange);
@@ -4,15 +4,20 @@
 
 #include <bench/bench.h>
 #include <key.h>
+#include <pubkey.h>
+#include <random.h>
 #if defined(HAVE_CONSENSUS_LIB)
 #include <script/bitcoinconsensus.h>
 #endif
 #include <script/script.h>
+#include <script/sigcache.h>
 #include <script/standard.h>
 #include <streams.h>
 #include <test/util/transaction_utils.h>
+#include <uint256.h>
 
 #include <array>
+#include <vector>
 
 // Microbenchmark for verification of a basic P2WPKH script. Can be easily
 // modified to measure performance of other types of scripts.
@@ -96,5 +101,64 @@ static void VerifyNestedIfScript(benchmark::Bench& bench)
     });
 }
 
+// Number of Schnorr signatures, roughly those of a block full of key path spends.
+static constexpr size_t SCHNORR_SIGS{2000};
+
+struct SchnorrSignatures {
+    std::vector<XOnlyPubKey> pubkeys;
+    std::vector<uint256> msgs;
+    std::vector<std::array<unsigned char, 64>> sigs;
+
+    explicit SchnorrSignatures(size_t count)
+    {
+        FastRandomContext rng(true);
+        for (size_t i = 0; i < count; ++i) {
+            CKey key;
+            const uint256 secret = rng.rand256();
+            key.Set(secret.begin(), secret.end(), true);
+            const CPubKey pubkey = key.GetPubKey();
+            pubkeys.emplace_back(Span<const unsigned char>(pubkey.begin() + 1, pubkey.end()));
+            msgs.push_back(rng.rand256());
+            sigs.emplace_back();
+            bool ret = key.SignSchnorr(msgs.back(), sigs.back());
+            assert(ret);
+        }
+    }
+};
+
+// Microbenchmarks for verification of BIP340 Schnorr signatures, one by one
+// and all at once like the signatures of a block when connecting it.
+static void VerifySchnorrBench(benchmark::Bench& bench)
+{
+    const ECCVerifyHandle verify_handle;
+    ECC_Start();
+    const SchnorrSignatures data{SCHNORR_SIGS};
+    bench.batch(SCHNORR_SIGS).unit("sig").run([&] {
+        for (size_t i = 0; i < SCHNORR_SIGS; ++i) {
+            bool ret = data.pubkeys[i].VerifySchnorr(data.msgs[i], data.sigs[i]);
+            assert(ret);
+        }
+    });
+    ECC_Stop();
+}
+
+static void VerifySchnorrBatchBench(benchmark::Bench& bench)
+{
+    const ECCVerifyHandle verify_handle;
+    ECC_Start();
+    const SchnorrSignatures data{SCHNORR_SIGS};
+    BatchSchnorrVerifier batch;
+    bench.batch(SCHNORR_SIGS).unit("sig").run([&] {
+        for (size_t i = 0; i < SCHNORR_SIGS; ++i) {
+            batch.Add(data.sigs[i], data.pubkeys[i], data.msgs[i]);
+        }
+        bool ret = batch.Verify();
+        assert(ret);
+    });
+    ECC_Stop();
+}
+
 BENCHMARK(VerifyScriptBench);
 BENCHMARK(VerifyNestedIfScript);
+BENCHMARK(VerifySchnorrBench);
+BENCHMARK(VerifySchnorrBatchBench);
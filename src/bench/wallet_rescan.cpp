@@ -0,0 +1,104 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <consensus/merkle.h>
+#include <crypto/common.h>
+#include <index/blockfilterindex.h>
+#include <interfaces/chain.h>
+#include <key_io.h>
+#include <node/context.h>
+#include <pow.h>
+#include <test/util/mining.h>
+#include <test/util/setup_common.h>
+#include <test/util/wallet.h>
+#include <util/time.h>
+#include <validation.h>
+#include <wallet/wallet.h>
+
+/** Mine a block whose coinbase pays to the script and to num_outputs - 1 other scripts. */
+static void MineBlockWithOutputs(const NodeContext& node, const CScript& coinbase_script, int num_outputs)
+{
+    auto block = PrepareBlock(node, coinbase_script);
+
+    CMutableTransaction coinbase{*block->vtx[0]};
+    const CAmount value{coinbase.vout[0].nValue / num_outputs};
+    coinbase.vout[0].nValue = value;
+    const int height{WITH_LOCK(cs_main, return ::ChainActive().Height() + 1)};
+    for (int i = 1; i < num_outputs; ++i) {
+        std::vector<unsigned char> program(20);
+        WriteLE32(program.data(), height);
+        WriteLE32(program.data() + 4, i);
+        coinbase.vout.emplace_back(value, CScript() << OP_0 << program);
+    }
+    block->vtx[0] = MakeTransactionRef(std::move(coinbase));
+    block->hashMerkleRoot = BlockMerkleRoot(*block);
+
+    while (!CheckProofOfWork(block->GetHash(), block->nBits, Params().GetConsensus())) {
+        ++block->nNonce;
+    }
+    bool processed{Assert(node.chainman)->ProcessNewBlock(Params(), block, true, nullptr)};
+    assert(processed);
+}
+
+/**
+ * Rescan a synthetic chain of blocks with many outputs, one in fifty of which
+ * pays to a wallet with a few hundred scripts, either reading every block or
+ * only those whose block filter matches.
+ */
+static void WalletRescan(benchmark::Bench& bench, bool use_block_filters)
+{
+    const auto test_setup = MakeNoLogFileContext<const TestingSetup>(CBaseChainParams::REGTEST, {"-keypool=100"});
+
+    if (use_block_filters) {
+        InitBlockFilterIndex(BlockFilterType::BASIC, 1 << 20, /* f_memory */ true);
+        GetBlockFilterIndex(BlockFilterType::BASIC)->Start();
+    }
+
+    CWallet wallet{test_setup->m_node.chain.get(), "", CreateMockWalletDatabase()};
+    {
+        bool first_run;
+        if (wallet.LoadWallet(first_run) != DBErrors::LOAD_OK) assert(false);
+        wallet.AddWalletFlags(WALLET_FLAG_DESCRIPTORS);
+        LOCK(wallet.cs_wallet);
+        wallet.SetupDescriptorScriptPubKeyMans();
+    }
+
+    const CScript script_mine{GetScriptForDestination(DecodeDestination(getnewaddress(wallet)))};
+    const CScript script_other{GetScriptForDestination(DecodeDestination(ADDRESS_BCRT1_UNSPENDABLE))};
+    for (int i = 0; i < 200; ++i) {
+        MineBlockWithOutputs(test_setup->m_node, i % 50 == 0 ? script_mine : script_other, 2000);
+    }
+    {
+        LOCK2(wallet.cs_wallet, cs_main);
+        wallet.SetLastBlockProcessed(::ChainActive().Height(), ::ChainActive().Tip()->GetBlockHash());
+    }
+
+    if (use_block_filters) {
+        while (!GetBlockFilterIndex(BlockFilterType::BASIC)->BlockUntilSyncedToCurrentChain()) {
+            UninterruptibleSleep(std::chrono::milliseconds{10});
+        }
+    }
+
+    const uint256 genesis_hash{WITH_LOCK(cs_main, return ::ChainActive().Genesis()->GetBlockHash())};
+    bench.run([&] {
+        WalletRescanReserver reserver(wallet);
+        reserver.reserve();
+        const CWallet::ScanResult result = wallet.ScanForWalletTransactions(genesis_hash, 0, {} /* max_height */, reserver, false /* update */);
+        assert(result.status == CWallet::ScanResult::SUCCESS);
+        assert(result.last_scanned_height == 200);
+    });
+    assert(wallet.mapWallet.size() == 4);
+
+    if (use_block_filters) {
+        GetBlockFilterIndex(BlockFilterType::BASIC)->Stop();
+        DestroyBlockFilterIndex(BlockFilterType::BASIC);
+    }
+}
+
+static void WalletRescanAllBlocks(benchmark::Bench& bench) { WalletRescan(bench, /* use_block_filters */ false); }
+static void WalletRescanBlockFilters(benchmark::Bench& bench) { WalletRescan(bench, /* use_block_filters */ true); }
+
+BENCHMARK(WalletRescanAllBlocks);
+BENCHMARK(WalletRescanBlockFilters);
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <limits>
 #include <mutex>
 #include <sstream>
 #include <set>
@@ -55,6 +56,41 @@ static uint64_t MapIntoRange(uint64_t x, uint64_t n)
 #endif
 }
 
+// Sort values that are uniformly distributed in the range [0, f). A counting sort by
+// position in the range leaves about one value per bucket, which an insertion sort
+// then puts in order, so this takes linear time on average.
+static void SortUniformValues(std::vector<uint64_t>& values, uint64_t f)
+{
+    const size_t n = values.size();
+    if (n < 64) {
+        std::sort(values.begin(), values.end());
+        return;
+    }
+
+    // Scale values to [0, 2^64) and map them into n buckets without dividing.
+    const uint64_t scale = f ? std::numeric_limits<uint64_t>::max() / f : 1;
+    std::vector<uint32_t> bucket_ends(n, 0);
+    for (uint64_t value : values) {
+        ++bucket_ends[MapIntoRange(value * scale, n)];
+    }
+    for (size_t i = 1; i < n; ++i) {
+        bucket_ends[i] += bucket_ends[i - 1];
+    }
+    std::vector<uint64_t> sorted(n);
+    for (uint64_t value : values) {
+        sorted[--bucket_ends[MapIntoRange(value * scale, n)]] = value;
+    }
+    for (size_t i = 1; i < n; ++i) {
+        const uint64_t value = sorted[i];
+        size_t j = i;
+        for (; j > 0 && sorted[j - 1] > value; --j) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = value;
+    }
+    values.swap(sorted);
+}
+
 uint64_t GCSFilter::HashToRange(const Element& element) const
 {
     uint64_t hash = CSipHasher(m_params.m_siphash_k0, m_params.m_siphash_k1)
@@ -70,7 +106,7 @@ std::vector<uint64_t> GCSFilter::BuildHashedSet(const ElementSet& elements) cons
     for (const Element& element : elements) {
         hashed_elements.push_back(HashToRange(element));
     }
-    std::sort(hashed_elements.begin(), hashed_elements.end());
+    SortUniformValues(hashed_elements, m_F);
     return hashed_elements;
 }
 
@@ -78,7 +114,7 @@ GCSFilter::GCSFilter(const Params& params)
     : m_params(params), m_N(0), m_F(0), m_encoded{0}
 {}
 
-GCSFilter::GCSFilter(const Params& params, std::vector<unsigned char> encoded_filter)
+GCSFilter::GCSFilter(const Params& params, std::vector<unsigned char> encoded_filter, bool skip_decode_check)
     : m_params(params), m_encoded(std::move(encoded_filter))
 {
     VectorReader stream(GCS_SER_TYPE, GCS_SER_VERSION, m_encoded, 0);
@@ -90,13 +126,15 @@ GCSFilter::GCSFilter(const Params& params, std::vector<unsigned char> encoded_fi
     }
     m_F = static_cast<uint64_t>(m_N) * static_cast<uint64_t>(m_params.m_M);
 
+    if (skip_decode_check) return;
+
     // Verify that the encoded filter contains exactly N elements. If it has too much or too little
     // data, a std::ios_base::failure exception will be raised.
-    BitStreamReader<VectorReader> bitreader(stream);
+    GolombRiceReader reader(Span<const unsigned char>{m_encoded}.subspan(m_encoded.size() - stream.size()));
     for (uint64_t i = 0; i < m_N; ++i) {
-        GolombRiceDecode(bitreader, m_params.m_P);
+        reader.Decode(m_params.m_P);
     }
-    if (!stream.empty()) {
+    if (reader.RemainingBytes() != 0) {
         throw std::ios_base::failure("encoded_filter contains excess data");
     }
 }
@@ -139,12 +177,12 @@ bool GCSFilter::MatchInternal(const uint64_t* element_hashes, size_t size) const
     uint64_t N = ReadCompactSize(stream);
     assert(N == m_N);
 
-    BitStreamReader<VectorReader> bitreader(stream);
+    GolombRiceReader reader(Span<const unsigned char>{m_encoded}.subspan(m_encoded.size() - stream.size()));
 
     uint64_t value = 0;
     size_t hashes_index = 0;
     for (uint32_t i = 0; i < m_N; ++i) {
-        uint64_t delta = GolombRiceDecode(bitreader, m_params.m_P);
+        uint64_t delta = reader.Decode(m_params.m_P);
         value += delta;
 
         while (true) {
@@ -250,14 +288,14 @@ static GCSFilter::ElementSet BasicFilterElements(const CBlock& block,
 }
 
 BlockFilter::BlockFilter(BlockFilterType filter_type, const uint256& block_hash,
-                         std::vector<unsigned char> filter)
+                         std::vector<unsigned char> filter, bool skip_decode_check)
     : m_filter_type(filter_type), m_block_hash(block_hash)
 {
     GCSFilter::Params params;
     if (!BuildParams(params)) {
         throw std::invalid_argument("unknown filter_type");
     }
-    m_filter = GCSFilter(params, std::move(filter));
+    m_filter = GCSFilter(params, std::move(filter), skip_decode_check);
 }
 
 BlockFilter::BlockFilter(BlockFilterType filter_type, const CBlock& block, const CBlockUndo& block_undo)
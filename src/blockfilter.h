@@ -58,8 +58,12 @@ public:
     /** Constructs an empty filter. */
     explicit GCSFilter(const Params& params = Params());
 
-    /** Reconstructs an already-created filter from an encoding. */
-    GCSFilter(const Params& params, std::vector<unsigned char> encoded_filter);
+    /**
+     * Reconstructs an already-created filter from an encoding. Unless skip_decode_check is set,
+     * the whole encoding is decoded to check that it holds exactly N elements; callers that
+     * already know the encoding is intact (e.g. by its hash) can skip that.
+     */
+    GCSFilter(const Params& params, std::vector<unsigned char> encoded_filter, bool skip_decode_check = false);
 
     /** Builds a new filter from the params and set of elements. */
     GCSFilter(const Params& params, const ElementSet& elements);
@@ -122,7 +126,7 @@ public:
 
     //! Reconstruct a BlockFilter from parts.
     BlockFilter(BlockFilterType filter_type, const uint256& block_hash,
-                std::vector<unsigned char> filter);
+                std::vector<unsigned char> filter, bool skip_decode_check = false);
 
     //! Construct a new BlockFilter of the specified type from a block.
     BlockFilter(BlockFilterType filter_type, const CBlock& block, const CBlockUndo& block_undo);
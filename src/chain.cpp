@@ -5,6 +5,27 @@
 
 #include <chain.h>
 
+CBlockIndex* BlockIndexArena::Allocate()
+{
+    const size_t pos = m_size++;
+    if (pos / CHUNK_SIZE == m_chunks.size()) {
+        m_chunks.emplace_back(new CBlockIndex[CHUNK_SIZE]);
+    }
+    return &m_chunks[pos / CHUNK_SIZE][pos % CHUNK_SIZE];
+}
+
+void BlockIndexArena::clear()
+{
+    m_chunks.clear();
+    m_size = 0;
+}
+
+void BlockIndexArena::swap(BlockIndexArena& other)
+{
+    m_chunks.swap(other.m_chunks);
+    std::swap(m_size, other.m_size);
+}
+
 /**
  * CChain implementation
  */
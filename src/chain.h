@@ -13,6 +13,7 @@
 #include <tinyformat.h>
 #include <uint256.h>
 
+#include <memory>
 #include <vector>
 
 /**
@@ -388,6 +389,30 @@ public:
     }
 };
 
+/**
+ * Storage for the entries of a block index. Entries are allocated in large
+ * chunks rather than one by one, so that entries allocated one after the other
+ * are next to each other in memory. They keep their address until the arena is
+ * cleared or destroyed.
+ */
+class BlockIndexArena
+{
+private:
+    //! Number of entries per chunk
+    static constexpr size_t CHUNK_SIZE{4096};
+
+    std::vector<std::unique_ptr<CBlockIndex[]>> m_chunks;
+    size_t m_size{0};
+
+public:
+    /** Return a new default-constructed entry. */
+    CBlockIndex* Allocate();
+
+    size_t size() const { return m_size; }
+    void clear();
+    void swap(BlockIndexArena& other);
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
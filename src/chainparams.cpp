@@ -446,6 +446,11 @@ public:
                 210,
                 {uint256S("0x9c5ed99ef98544b34f8920b6d1802f72ac28ae6e2bd2bd4c316ff10c230df3f2"), 210},
             },
+            {
+                // The chain of feature_assumeutxo.py
+                299,
+                {uint256S("0x89fb9c5845e83fe7c9aab67e0f41df9b6d73ea0f3dc770ed02b56a17a2b7131c"), 303},
+            },
         };
 
         chainTxData = ChainTxData{
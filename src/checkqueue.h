@@ -10,6 +10,10 @@
 #include <util/threadnames.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
 #include <vector>
 
 template <typename T>
@@ -24,12 +28,24 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker (including the master) has its own local queue, each with
+  * its own lock. Added verifications are spread over the workers' queues;
+  * a worker takes batches from the back of its own queue, and when that
+  * runs dry it steals half of another worker's queue from the front. This
+  * avoids all workers contending on a single lock for every batch.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! A worker's local queue of elements to be processed.
+    struct WorkerQueue {
+        Mutex m_mutex;
+        std::deque<T> m_checks GUARDED_BY(m_mutex);
+    };
+
+    //! Mutex used to sleep and wake up workers and the master
     Mutex m_mutex;
 
     //! Worker threads block on this when out of work
@@ -38,93 +54,110 @@ private:
     //! Master thread blocks on this when out of work
     std::condition_variable m_master_cv;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue GUARDED_BY(m_mutex);
+    //! The local queues: index 0 belongs to the master, index n + 1 to worker thread n.
+    //! Only resized in StartWorkerThreads, while no thread uses them.
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle GUARDED_BY(m_mutex){0};
+    //! The local queue the next batch of added elements goes to.
+    std::atomic<size_t> m_next_queue{0};
 
-    //! The total number of workers (including the master).
-    int nTotal GUARDED_BY(m_mutex){0};
-
-    //! The temporary evaluation result.
-    bool fAllOk GUARDED_BY(m_mutex){true};
+    //! The number of elements in all local queues. Only changed while holding
+    //! the lock of the queue the elements are added to or taken from.
+    std::atomic<unsigned int> m_queued{0};
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo GUARDED_BY(m_mutex){0};
+    std::atomic<unsigned int> m_todo{0};
+
+    //! The temporary evaluation result.
+    std::atomic<bool> m_all_ok{true};
 
     //! The maximum number of elements to be processed in one batch
     const unsigned int nBatchSize;
 
     std::vector<std::thread> m_worker_threads;
-    bool m_request_stop GUARDED_BY(m_mutex){false};
+    std::atomic<bool> m_request_stop{false};
+
+    /**
+     * Move a batch of elements to vChecks: from the back of our own queue if
+     * it is not empty, otherwise from the front of another worker's queue.
+     * Returns false if all queues are empty.
+     */
+    bool TakeBatch(size_t index, std::vector<T>& vChecks)
+    {
+        {
+            WorkerQueue& own = *m_queues[index];
+            LOCK(own.m_mutex);
+            if (!own.m_checks.empty()) {
+                // Leave part of our queue for others to steal, so all workers
+                // finish approximately simultaneously.
+                const size_t n = std::max<size_t>(1, std::min<size_t>(nBatchSize, own.m_checks.size() / 2));
+                for (size_t i = 0; i < n; ++i) {
+                    vChecks.emplace_back();
+                    vChecks.back().swap(own.m_checks.back());
+                    own.m_checks.pop_back();
+                }
+                m_queued -= n;
+                return true;
+            }
+        }
+        for (size_t i = 1; i < m_queues.size() && m_queued > 0; ++i) {
+            WorkerQueue& victim = *m_queues[(index + i) % m_queues.size()];
+            LOCK(victim.m_mutex);
+            if (victim.m_checks.empty()) continue;
+            const size_t n = std::max<size_t>(1, std::min<size_t>(nBatchSize, victim.m_checks.size() / 2));
+            for (size_t j = 0; j < n; ++j) {
+                vChecks.emplace_back();
+                vChecks.back().swap(victim.m_checks.front());
+                victim.m_checks.pop_front();
+            }
+            m_queued -= n;
+            return true;
+        }
+        return false;
+    }
 
     /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster)
+    bool Loop(size_t index, bool fMaster)
     {
-        std::condition_variable& cond = fMaster ? m_master_cv : m_worker_cv;
         std::vector<T> vChecks;
-        vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
+        vChecks.reserve(std::max(1U, nBatchSize));
         do {
-            {
+            if (m_request_stop) {
+                return false;
+            }
+            if (!TakeBatch(index, vChecks)) {
                 WAIT_LOCK(m_mutex, lock);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        m_master_cv.notify_one();
+                if (fMaster) {
+                    while (m_todo > 0 && m_queued == 0 && !m_request_stop) {
+                        m_master_cv.wait(lock);
+                    }
+                    if (m_todo == 0) {
+                        // return the current status, and reset it for new work later
+                        return m_all_ok.exchange(true);
+                    }
                 } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty() && !m_request_stop) {
-                    if (fMaster && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        fAllOk = true;
-                        // return the current status
-                        return fRet;
+                    while (m_queued == 0 && !m_request_stop) {
+                        m_worker_cv.wait(lock);
                     }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
                 }
-                if (m_request_stop) {
-                    return false;
-                }
-
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the m_mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
             }
-            // execute work
+            // execute work, unless another check already failed
+            const unsigned int nNow = vChecks.size();
+            bool fOk = m_all_ok;
             for (T& check : vChecks)
                 if (fOk)
                     fOk = check();
+            if (!fOk) m_all_ok = false;
             vChecks.clear();
+            if (m_todo.fetch_sub(nNow) == nNow) {
+                // We processed the last element; inform the master it can exit and return the result
+                WITH_LOCK(m_mutex, m_master_cv.notify_one());
+            }
         } while (true);
     }
 
@@ -136,22 +169,22 @@ public:
     explicit CCheckQueue(unsigned int nBatchSizeIn)
         : nBatchSize(nBatchSizeIn)
     {
+        m_queues.emplace_back(std::make_unique<WorkerQueue>());
     }
 
     //! Create a pool of new worker threads.
-    void StartWorkerThreads(const int threads_num)
+    void StartWorkerThreads(const int threads_num, const std::string& thread_name = "scriptch")
     {
-        {
-            LOCK(m_mutex);
-            nIdle = 0;
-            nTotal = 0;
-            fAllOk = true;
-        }
         assert(m_worker_threads.empty());
+        m_all_ok = true;
+        m_queues.resize(1);
+        for (int n = 0; n < threads_num; ++n) {
+            m_queues.emplace_back(std::make_unique<WorkerQueue>());
+        }
         for (int n = 0; n < threads_num; ++n) {
-            m_worker_threads.emplace_back([this, n]() {
-                util::ThreadRename(strprintf("scriptch.%i", n));
-                Loop(false /* worker thread */);
+            m_worker_threads.emplace_back([this, n, thread_name]() {
+                util::ThreadRename(strprintf("%s.%i", thread_name, n));
+                Loop(n + 1, false /* worker thread */);
             });
         }
     }
@@ -159,21 +192,30 @@ public:
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
-        return Loop(true /* master thread */);
+        return Loop(0, true /* master thread */);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        LOCK(m_mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+        if (vChecks.empty()) return;
+        m_todo += vChecks.size();
+        // Hand the batch to the next worker in turn; the master only gets
+        // work up front if there are no workers, and steals it otherwise.
+        const size_t workers = m_queues.size() - 1;
+        WorkerQueue& queue = *m_queues[workers == 0 ? 0 : 1 + m_next_queue++ % workers];
+        {
+            LOCK(queue.m_mutex);
+            for (T& check : vChecks) {
+                queue.m_checks.emplace_back();
+                check.swap(queue.m_checks.back());
+            }
+            m_queued += vChecks.size();
         }
-        nTodo += vChecks.size();
+        LOCK(m_mutex);
         if (vChecks.size() == 1)
             m_worker_cv.notify_one();
-        else if (vChecks.size() > 1)
+        else
             m_worker_cv.notify_all();
     }
 
@@ -186,7 +228,7 @@ public:
             t.join();
         }
         m_worker_threads.clear();
-        WITH_LOCK(m_mutex, m_request_stop = false);
+        m_request_stop = false;
     }
 
     ~CCheckQueue()
@@ -9,11 +9,167 @@
 #include <random.h>
 #include <version.h>
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+
+CompactCoin& CompactCoin::operator=(const CompactCoin& other)
+{
+    if (this == &other) return *this;
+    Clear();
+    m_value = other.m_value;
+    m_height = other.m_height;
+    m_coinbase = other.m_coinbase;
+    m_type = other.m_type;
+    m_raw_size = other.m_raw_size;
+    if (m_type == ScriptType::EXPANDED) {
+        // Copies are not referenced yet; keep them compact.
+        Set(*other.m_script.expanded);
+    } else if (m_type == ScriptType::HEAP) {
+        m_script.indirect.size = other.m_script.indirect.size;
+        m_script.indirect.data = new unsigned char[m_script.indirect.size];
+        memcpy(m_script.indirect.data, other.m_script.indirect.data, m_script.indirect.size);
+    } else {
+        memcpy(m_script.direct, other.m_script.direct, sizeof(m_script.direct));
+    }
+    return *this;
+}
+
+CompactCoin& CompactCoin::operator=(CompactCoin&& other) noexcept
+{
+    if (this == &other) return *this;
+    Clear();
+    m_value = other.m_value;
+    m_height = other.m_height;
+    m_coinbase = other.m_coinbase;
+    m_type = other.m_type;
+    m_raw_size = other.m_raw_size;
+    m_script = other.m_script;
+    // The heap buffer or expanded Coin, if any, now belongs to this.
+    other.m_type = ScriptType::RAW;
+    other.Clear();
+    return *this;
+}
+
+void CompactCoin::Clear()
+{
+    if (m_type == ScriptType::HEAP) delete[] m_script.indirect.data;
+    if (m_type == ScriptType::EXPANDED) delete m_script.expanded;
+    m_value = -1;
+    m_height = 0;
+    m_coinbase = false;
+    m_type = ScriptType::RAW;
+    m_raw_size = 0;
+}
+
+void CompactCoin::Set(const Coin& coin)
+{
+    Clear();
+    m_value = coin.out.nValue;
+    m_height = coin.nHeight;
+    m_coinbase = coin.fCoinBase;
+
+    const CScript& script = coin.out.scriptPubKey;
+    const size_t size = script.size();
+    auto keep = [&](ScriptType type, size_t offset, size_t length) {
+        m_type = type;
+        memcpy(m_script.direct, script.data() + offset, length);
+    };
+    if (size == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20 &&
+        script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG) {
+        keep(ScriptType::P2PKH, 3, 20);
+    } else if (size == 23 && script[0] == OP_HASH160 && script[1] == 20 && script[22] == OP_EQUAL) {
+        keep(ScriptType::P2SH, 2, 20);
+    } else if (size == 22 && script[0] == OP_0 && script[1] == 20) {
+        keep(ScriptType::P2WPKH, 2, 20);
+    } else if (size == 34 && script[0] == OP_0 && script[1] == 32) {
+        keep(ScriptType::P2WSH, 2, 32);
+    } else if (size == 34 && script[0] == OP_1 && script[1] == 32) {
+        keep(ScriptType::P2TR, 2, 32);
+    } else if (size == 35 && script[0] == 33 && (script[1] == 0x02 || script[1] == 0x03) && script[34] == OP_CHECKSIG) {
+        keep(script[1] == 0x02 ? ScriptType::P2PK_EVEN : ScriptType::P2PK_ODD, 2, 32);
+    } else if (size <= sizeof(m_script.direct)) {
+        keep(ScriptType::RAW, 0, size);
+        m_raw_size = size;
+    } else {
+        m_type = ScriptType::HEAP;
+        m_script.indirect.size = size;
+        m_script.indirect.data = new unsigned char[size];
+        memcpy(m_script.indirect.data, script.data(), size);
+    }
+}
+
+Coin CompactCoin::Expand() const
+{
+    Coin coin;
+    coin.out.nValue = m_value;
+    coin.nHeight = m_height;
+    coin.fCoinBase = m_coinbase;
+
+    // Rebuild the script as prefix, the stored bytes, then suffix.
+    auto expand = [&](std::initializer_list<unsigned char> prefix, size_t length, std::initializer_list<unsigned char> suffix) {
+        CScript& script = coin.out.scriptPubKey;
+        script.resize(prefix.size() + length + suffix.size());
+        unsigned char* out = script.data();
+        out = std::copy(prefix.begin(), prefix.end(), out);
+        out = std::copy(m_script.direct, m_script.direct + length, out);
+        std::copy(suffix.begin(), suffix.end(), out);
+    };
+    switch (m_type) {
+    case ScriptType::RAW: expand({}, m_raw_size, {}); break;
+    case ScriptType::HEAP:
+        coin.out.scriptPubKey.assign(m_script.indirect.data, m_script.indirect.data + m_script.indirect.size);
+        break;
+    case ScriptType::P2PKH: expand({OP_DUP, OP_HASH160, 20}, 20, {OP_EQUALVERIFY, OP_CHECKSIG}); break;
+    case ScriptType::P2SH: expand({OP_HASH160, 20}, 20, {OP_EQUAL}); break;
+    case ScriptType::P2WPKH: expand({OP_0, 20}, 20, {}); break;
+    case ScriptType::P2WSH: expand({OP_0, 32}, 32, {}); break;
+    case ScriptType::P2TR: expand({OP_1, 32}, 32, {}); break;
+    case ScriptType::P2PK_EVEN: expand({33, 0x02}, 32, {OP_CHECKSIG}); break;
+    case ScriptType::P2PK_ODD: expand({33, 0x03}, 32, {OP_CHECKSIG}); break;
+    case ScriptType::EXPANDED: coin.out.scriptPubKey = m_script.expanded->out.scriptPubKey; break;
+    } // no default case, so the compiler can warn about missing cases
+    return coin;
+}
+
+const Coin& CompactCoin::ExpandInPlace()
+{
+    assert(!IsSpent());
+    if (m_type != ScriptType::EXPANDED) {
+        Coin* coin = new Coin(Expand());
+        if (m_type == ScriptType::HEAP) delete[] m_script.indirect.data;
+        m_type = ScriptType::EXPANDED;
+        m_script.expanded = coin;
+    }
+    return *m_script.expanded;
+}
+
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return nullptr; }
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsView::Cursors(size_t count) const
+{
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    cursors.emplace_back(Cursor());
+    return cursors;
+}
+
+size_t CCoinsView::GetCoins(Span<const COutPoint> outpoints, Span<Coin> coins) const
+{
+    assert(outpoints.size() == coins.size());
+    size_t found = 0;
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        if (GetCoin(outpoints[i], coins[i]) && !coins[i].IsSpent()) {
+            ++found;
+        } else {
+            coins[i].Clear();
+        }
+    }
+    return found;
+}
 
 bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
 {
@@ -29,9 +185,12 @@ std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetH
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
 bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewBacked::Cursors(size_t count) const { return base->Cursors(count); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn),
+    cacheCoins{0, SaltedOutpointHasher{}, CCoinsMap::key_equal{}, &m_cache_coins_memory_resource},
+    cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
@@ -57,12 +216,49 @@ CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const
 bool CCoinsViewCache::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     CCoinsMap::const_iterator it = FetchCoin(outpoint);
     if (it != cacheCoins.end()) {
-        coin = it->second.coin;
+        coin = it->second.coin.Expand();
         return !coin.IsSpent();
     }
     return false;
 }
 
+size_t CCoinsViewCache::GetCoins(Span<const COutPoint> outpoints, Span<Coin> coins) const
+{
+    assert(outpoints.size() == coins.size());
+    size_t found = 0;
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        CCoinsMap::const_iterator it = cacheCoins.find(outpoints[i]);
+        if (it == cacheCoins.end()) {
+            missing.push_back(i);
+        } else if (it->second.coin.IsSpent()) {
+            coins[i].Clear();
+        } else {
+            coins[i] = it->second.coin.Expand();
+            ++found;
+        }
+    }
+    if (missing.empty()) return found;
+
+    // Resolve everything that is not cached with a single call to the base,
+    // and cache the results as FetchCoin would.
+    std::vector<COutPoint> missing_outpoints;
+    missing_outpoints.reserve(missing.size());
+    for (const size_t i : missing) {
+        missing_outpoints.push_back(outpoints[i]);
+    }
+    std::vector<Coin> missing_coins(missing.size());
+    base->GetCoins(missing_outpoints, missing_coins);
+    for (size_t j = 0; j < missing.size(); ++j) {
+        coins[missing[j]] = missing_coins[j];
+        if (missing_coins[j].IsSpent()) continue;
+        ++found;
+        auto inserted = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(missing_outpoints[j]), std::forward_as_tuple(std::move(missing_coins[j])));
+        if (inserted.second) cachedCoinsUsage += inserted.first->second.coin.DynamicMemoryUsage();
+    }
+    return found;
+}
+
 void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possible_overwrite) {
     assert(!coin.IsSpent());
     if (coin.out.scriptPubKey.IsUnspendable()) return;
@@ -92,17 +288,28 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
         // DIRTY, then it can be marked FRESH.
         fresh = !(it->second.flags & CCoinsCacheEntry::DIRTY);
     }
-    it->second.coin = std::move(coin);
+    it->second.coin.Set(coin);
     it->second.flags |= CCoinsCacheEntry::DIRTY | (fresh ? CCoinsCacheEntry::FRESH : 0);
     cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
 }
 
 void CCoinsViewCache::EmplaceCoinInternalDANGER(COutPoint&& outpoint, Coin&& coin) {
-    cachedCoinsUsage += coin.DynamicMemoryUsage();
-    cacheCoins.emplace(
+    auto inserted = cacheCoins.emplace(
         std::piecewise_construct,
         std::forward_as_tuple(std::move(outpoint)),
         std::forward_as_tuple(std::move(coin), CCoinsCacheEntry::DIRTY));
+    if (inserted.second) cachedCoinsUsage += inserted.first->second.coin.DynamicMemoryUsage();
+}
+
+bool CCoinsViewCache::PrefetchCoin(const COutPoint& outpoint, Coin&& coin) {
+    if (coin.IsSpent()) return false;
+    CCoinsMap::iterator it;
+    bool inserted;
+    std::tie(it, inserted) = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (inserted) {
+        cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    }
+    return inserted;
 }
 
 void AddCoins(CCoinsViewCache& cache, const CTransaction &tx, int nHeight, bool check_for_overwrite) {
@@ -121,7 +328,7 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
     if (it == cacheCoins.end()) return false;
     cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
     if (moveout) {
-        *moveout = std::move(it->second.coin);
+        *moveout = it->second.coin.Expand();
     }
     if (it->second.flags & CCoinsCacheEntry::FRESH) {
         cacheCoins.erase(it);
@@ -135,12 +342,14 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
 static const Coin coinEmpty;
 
 const Coin& CCoinsViewCache::AccessCoin(const COutPoint &outpoint) const {
-    CCoinsMap::const_iterator it = FetchCoin(outpoint);
-    if (it == cacheCoins.end()) {
+    CCoinsMap::iterator it = FetchCoin(outpoint);
+    if (it == cacheCoins.end() || it->second.coin.IsSpent()) {
         return coinEmpty;
-    } else {
-        return it->second.coin;
     }
+    cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+    const Coin& coin = it->second.coin.ExpandInPlace();
+    cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    return coin;
 }
 
 bool CCoinsViewCache::HaveCoin(const COutPoint &outpoint) const {
@@ -222,10 +431,73 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
+    ReallocateCache();
     cachedCoinsUsage = 0;
     return fOk;
 }
 
+bool CCoinsViewCache::Sync()
+{
+    // The base may consume the map it is given, so hand it a copy of the
+    // modified entries only.
+    CCoinsMapMemoryResource resource{};
+    CCoinsMap dirty{0, SaltedOutpointHasher{}, CCoinsMap::key_equal{}, &resource};
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) {
+            ++it;
+        } else if (it->second.coin.IsSpent()) {
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            dirty.emplace(it->first, std::move(it->second));
+            it = cacheCoins.erase(it);
+        } else {
+            dirty.emplace(it->first, it->second);
+            it->second.flags = 0;
+            ++it;
+        }
+    }
+    return base->BatchWrite(dirty, hashBlock);
+}
+
+size_t CCoinsViewCache::Evict(size_t target_usage)
+{
+    const size_t usage = DynamicMemoryUsage();
+    if (usage <= target_usage || cacheCoins.empty()) return 0;
+
+    // Nodes and buckets are attributed evenly to all entries.
+    const size_t entry_overhead = (usage - cachedCoinsUsage) / cacheCoins.size();
+
+    // Find the lowest height whose entries, together with everything newer
+    // and everything modified, still fit in target_usage.
+    size_t keep_usage = 0;
+    std::map<uint32_t, size_t> usage_by_height;
+    for (const auto& entry : cacheCoins) {
+        const size_t entry_usage = entry_overhead + entry.second.coin.DynamicMemoryUsage();
+        if (entry.second.flags & CCoinsCacheEntry::DIRTY) {
+            keep_usage += entry_usage;
+        } else {
+            usage_by_height[entry.second.coin.Height()] += entry_usage;
+        }
+    }
+    uint32_t min_height = std::numeric_limits<uint32_t>::max();
+    for (auto it = usage_by_height.rbegin(); it != usage_by_height.rend(); ++it) {
+        if (keep_usage + it->second > target_usage) break;
+        keep_usage += it->second;
+        min_height = it->first;
+    }
+
+    size_t evicted = 0;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY) && it->second.coin.Height() < min_height) {
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            it = cacheCoins.erase(it);
+            ++evicted;
+        } else {
+            ++it;
+        }
+    }
+    return evicted;
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -256,7 +528,9 @@ void CCoinsViewCache::ReallocateCache()
     // Cache should be empty when we're calling this.
     assert(cacheCoins.size() == 0);
     cacheCoins.~CCoinsMap();
-    ::new (&cacheCoins) CCoinsMap();
+    m_cache_coins_memory_resource.~CCoinsMapMemoryResource();
+    ::new (&m_cache_coins_memory_resource) CCoinsMapMemoryResource{};
+    ::new (&cacheCoins) CCoinsMap{0, SaltedOutpointHasher{}, CCoinsMap::key_equal{}, &m_cache_coins_memory_resource};
 }
 
 static const size_t MIN_TRANSACTION_OUTPUT_WEIGHT = WITNESS_SCALE_FACTOR * ::GetSerializeSize(CTxOut(), PROTOCOL_VERSION);
@@ -273,18 +547,32 @@ const Coin& AccessByTxid(const CCoinsViewCache& view, const uint256& txid)
     return coinEmpty;
 }
 
+void CCoinsViewErrorCatcher::HandleReadError(const std::runtime_error& e) const
+{
+    for (auto f : m_err_callbacks) {
+        f();
+    }
+    LogPrintf("Error reading from database: %s\n", e.what());
+    // Starting the shutdown sequence and returning false to the caller would be
+    // interpreted as 'entry not found' (as opposed to unable to read data), and
+    // could lead to invalid interpretation. Just exit immediately, as we can't
+    // continue anyway, and all writes should be atomic.
+    std::abort();
+}
+
 bool CCoinsViewErrorCatcher::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     try {
         return CCoinsViewBacked::GetCoin(outpoint, coin);
     } catch(const std::runtime_error& e) {
-        for (auto f : m_err_callbacks) {
-            f();
-        }
-        LogPrintf("Error reading from database: %s\n", e.what());
-        // Starting the shutdown sequence and returning false to the caller would be
-        // interpreted as 'entry not found' (as opposed to unable to read data), and
-        // could lead to invalid interpretation. Just exit immediately, as we can't
-        // continue anyway, and all writes should be atomic.
-        std::abort();
+        HandleReadError(e);
+    }
+}
+
+size_t CCoinsViewErrorCatcher::GetCoins(Span<const COutPoint> outpoints, Span<Coin> coins) const
+{
+    try {
+        return base->GetCoins(outpoints, coins);
+    } catch (const std::runtime_error& e) {
+        HandleReadError(e);
     }
 }
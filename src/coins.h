@@ -11,6 +11,8 @@
 #include <memusage.h>
 #include <primitives/transaction.h>
 #include <serialize.h>
+#include <span.h>
+#include <support/allocators/pool.h>
 #include <uint256.h>
 #include <util/hasher.h>
 
@@ -18,6 +20,8 @@
 #include <stdint.h>
 
 #include <functional>
+#include <memory>
+#include <stdexcept>
 #include <unordered_map>
 
 class ChainstateManager;
@@ -84,6 +88,89 @@ public:
     }
 };
 
+/**
+ * A Coin in the form the coins cache keeps it in.
+ *
+ * A CScript stores at most 28 bytes inline, so every P2WSH, P2TR or P2PK
+ * output held as a Coin costs a separate heap allocation. Here, scripts of
+ * those templates and of P2PKH, P2SH and P2WPKH are reduced to a tag and the
+ * hash or key they commit to, and other scripts of up to 32 bytes are kept
+ * verbatim in the same space, so only longer nonstandard scripts still go to
+ * the heap. The Coin is only rebuilt when it is accessed. Coins that callers
+ * hold a reference to (see CCoinsViewCache::AccessCoin) are kept expanded.
+ */
+class CompactCoin
+{
+public:
+    CompactCoin() : m_height(0), m_coinbase(false) {}
+    explicit CompactCoin(const Coin& coin) : CompactCoin() { Set(coin); }
+    CompactCoin(const CompactCoin& other) : CompactCoin() { *this = other; }
+    CompactCoin(CompactCoin&& other) noexcept : CompactCoin() { *this = std::move(other); }
+    CompactCoin& operator=(const CompactCoin& other);
+    CompactCoin& operator=(CompactCoin&& other) noexcept;
+    ~CompactCoin() { Clear(); }
+
+    //! Replace the contents by those of coin.
+    void Set(const Coin& coin);
+
+    //! Rebuild the Coin.
+    Coin Expand() const;
+
+    //! Replace the compact form by the expanded Coin and return it. The Coin
+    //! stays in place until this is cleared or assigned to. Must not be spent.
+    const Coin& ExpandInPlace();
+
+    void Clear();
+
+    bool IsSpent() const { return m_value == -1; }
+
+    bool IsCoinBase() const { return m_coinbase; }
+
+    uint32_t Height() const { return m_height; }
+
+    //! Serialized like the Coin it holds.
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        Expand().Serialize(s);
+    }
+
+    size_t DynamicMemoryUsage() const {
+        if (m_type == ScriptType::EXPANDED) {
+            return memusage::MallocUsage(sizeof(Coin)) + m_script.expanded->DynamicMemoryUsage();
+        }
+        return m_type == ScriptType::HEAP ? memusage::MallocUsage(m_script.indirect.size) : 0;
+    }
+
+private:
+    enum class ScriptType : uint8_t {
+        RAW, //!< m_raw_size bytes of script in m_script.direct
+        HEAP, //!< the script in m_script.indirect
+        P2PKH,
+        P2SH,
+        P2WPKH,
+        P2WSH,
+        P2TR,
+        P2PK_EVEN, //!< to a compressed public key, starting with 0x02
+        P2PK_ODD, //!< to a compressed public key, starting with 0x03
+        EXPANDED, //!< the whole Coin in m_script.expanded
+    };
+
+    CAmount m_value{-1};
+    uint32_t m_height : 31;
+    uint32_t m_coinbase : 1;
+    ScriptType m_type{ScriptType::RAW};
+    uint8_t m_raw_size{0};
+    //! The hash or key the script commits to, or the script itself
+    union {
+        unsigned char direct[32];
+        struct {
+            unsigned char* data;
+            uint32_t size;
+        } indirect;
+        Coin* expanded;
+    } m_script{};
+};
+
 /**
  * A Coin in one level of the coins database caching hierarchy.
  *
@@ -101,7 +188,7 @@ public:
  */
 struct CCoinsCacheEntry
 {
-    Coin coin; // The actual cached data.
+    CompactCoin coin; // The actual cached data.
     unsigned char flags;
 
     enum Flags {
@@ -126,11 +213,30 @@ struct CCoinsCacheEntry
     };
 
     CCoinsCacheEntry() : flags(0) {}
-    explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
-    CCoinsCacheEntry(Coin&& coin_, unsigned char flag) : coin(std::move(coin_)), flags(flag) {}
+    explicit CCoinsCacheEntry(const Coin& coin_) : coin(coin_), flags(0) {}
+    CCoinsCacheEntry(const Coin& coin_, unsigned char flag) : coin(coin_), flags(flag) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The coins cache map. Nodes are carved out of large chunks owned by a
+ * PoolResource instead of being allocated one by one on the heap, which
+ * removes the per-entry malloc overhead and keeps entries close together.
+ *
+ * PoolAllocator's MAX_BLOCK_SIZE_BYTES parameter here uses sizeof the data, and adds the size
+ * of 4 pointers. We do not know the exact node size used in the std::unordered_node implementation
+ * because it is implementation defined. Most implementations have an overhead of 1 or 2 pointers,
+ * so nodes can be connected in a linked list, and in some cases the hash value is stored as well.
+ * Using an additional sizeof(void*)*4 for MAX_BLOCK_SIZE_BYTES should thus be sufficient so that
+ * all implementations can allocate the nodes from the PoolAllocator.
+ */
+using CCoinsMap = std::unordered_map<COutPoint,
+                                     CCoinsCacheEntry,
+                                     SaltedOutpointHasher,
+                                     std::equal_to<COutPoint>,
+                                     PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                                                   sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4>>;
+
+using CCoinsMapMemoryResource = CCoinsMap::allocator_type::ResourceType;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -162,6 +268,14 @@ public:
      */
     virtual bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
 
+    /** Retrieve the Coins for several outpoints at once. coins must have the
+     *  same size as outpoints; each entry is set to the unspent coin for the
+     *  corresponding outpoint, or cleared if there is none.
+     *  Returns the number of unspent coins found.
+     *  The default implementation calls GetCoin for every outpoint.
+     */
+    virtual size_t GetCoins(Span<const COutPoint> outpoints, Span<Coin> coins) const;
+
     //! Just check whether a given outpoint is unspent.
     virtual bool HaveCoin(const COutPoint &outpoint) const;
 
@@ -181,6 +295,12 @@ public:
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
 
+    //! Get at most count cursors that together iterate over the whole state,
+    //! so it can be scanned on several threads. Each cursor covers a disjoint
+    //! range of txids, in the order of the cursors, and all of them see the
+    //! same state. The default implementation returns the single Cursor().
+    virtual std::vector<std::unique_ptr<CCoinsViewCursor>> Cursors(size_t count) const;
+
     //! As we use CCoinsViews polymorphically, have a virtual destructor
     virtual ~CCoinsView() {}
 
@@ -204,6 +324,7 @@ public:
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    std::vector<std::unique_ptr<CCoinsViewCursor>> Cursors(size_t count) const override;
     size_t EstimateSize() const override;
 };
 
@@ -217,6 +338,7 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
+    mutable CCoinsMapMemoryResource m_cache_coins_memory_resource{};
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -232,6 +354,7 @@ public:
 
     // Standard CCoinsView methods
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    size_t GetCoins(Span<const COutPoint> outpoints, Span<Coin> coins) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
@@ -239,6 +362,9 @@ public:
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
     }
+    std::vector<std::unique_ptr<CCoinsViewCursor>> Cursors(size_t count) const override {
+        throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
+    }
 
     /**
      * Check if we have the given utxo already loaded in this cache.
@@ -251,6 +377,9 @@ public:
      * Return a reference to Coin in the cache, or coinEmpty if not found. This is
      * more efficient than GetCoin.
      *
+     * The cached entry is expanded from its compact form to back the reference,
+     * and stays expanded until it is spent or written to the parent view.
+     *
      * Generally, do not hold the reference returned for more than a short scope.
      * While the current implementation allows for modifications to the contents
      * of the cache while holding the reference, this behavior should not be relied
@@ -274,6 +403,18 @@ public:
      */
     void EmplaceCoinInternalDANGER(COutPoint&& outpoint, Coin&& coin);
 
+    /**
+     * Insert a coin that the caller read from the backing view, exactly as if
+     * it had been fetched by a cache miss (i.e. not DIRTY). This allows the
+     * cache to be warmed by lookups done outside of it, e.g. in parallel.
+     *
+     * Does nothing if an entry for the outpoint is already cached, so that
+     * modifications held by this cache are never replaced by base data.
+     *
+     * @returns whether the coin was inserted
+     */
+    bool PrefetchCoin(const COutPoint& outpoint, Coin&& coin);
+
     /**
      * Spend a coin. Pass moveto in order to get the deleted data.
      * If no unspent output exists for the passed outpoint, this call
@@ -288,6 +429,23 @@ public:
      */
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base, but keep the
+     * unspent entries cached (and no longer dirty). Spent entries are dropped.
+     * If false is returned, the state of this cache (and its backing view) will be undefined.
+     */
+    bool Sync();
+
+    /**
+     * Drop entries that are not modified, those with the lowest coin height
+     * first, until the memory usage of the cache is at most target_usage
+     * bytes. The memory of the dropped entries is kept by the pool and reused
+     * for new entries. Modified entries are never dropped, so call Sync()
+     * first to make everything evictable.
+     * Returns the number of entries that were dropped.
+     */
+    size_t Evict(size_t target_usage);
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
@@ -305,7 +463,8 @@ public:
 
     //! Force a reallocation of the cache map. This is required when downsizing
     //! the cache because the map's allocator may be hanging onto a lot of
-    //! memory despite having called .clear().
+    //! memory despite having called .clear(). The pooled node memory is only
+    //! released by this call, so Flush() uses it as well.
     //!
     //! See: https://stackoverflow.com/questions/42114044/how-to-release-unordered-map-memory
     void ReallocateCache();
@@ -349,11 +508,14 @@ public:
     }
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    size_t GetCoins(Span<const COutPoint> outpoints, Span<Coin> coins) const override;
 
 private:
     /** A list of callbacks to execute upon leveldb read error. */
     std::vector<std::function<void()>> m_err_callbacks;
 
+    [[noreturn]] void HandleReadError(const std::runtime_error& e) const;
+
 };
 
 #endif // BITCOIN_COINS_H
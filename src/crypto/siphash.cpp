@@ -4,6 +4,8 @@
 
 #include <crypto/siphash.h>
 
+#include <crypto/common.h>
+
 #define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
 
 #define SIPROUND do { \
@@ -51,6 +53,18 @@ CSipHasher& CSipHasher::Write(const unsigned char* data, size_t size)
     uint64_t t = tmp;
     uint8_t c = count;
 
+    // Process whole words at once while the input is aligned with them.
+    if ((c & 7) == 0) {
+        for (; size >= 8; data += 8, size -= 8) {
+            const uint64_t m = ReadLE64(data);
+            v3 ^= m;
+            SIPROUND;
+            SIPROUND;
+            v0 ^= m;
+            c += 8;
+        }
+    }
+
     while (size--) {
         t |= ((uint64_t)(*(data++))) << (8 * (c % 8));
         c++;
@@ -6,6 +6,9 @@
 
 #include <memory>
 #include <random.h>
+#include <sync.h>
+#include <util/memory.h>
+#include <util/threadnames.h>
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -13,6 +16,11 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <optional>
+#include <thread>
 
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -72,7 +80,7 @@ public:
     }
 };
 
-static void SetMaxOpenFiles(leveldb::Options *options) {
+static void SetMaxOpenFiles(leveldb::Options *options, int requested_open_files) {
     // On most platforms the default setting of max_open_files (which is 1000)
     // is optimal. On Windows using a large file count is OK because the handles
     // do not interfere with select() loops. On 64-bit Unix hosts this value is
@@ -93,15 +101,25 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
         options->max_open_files = 64;
     }
 #endif
+    if (requested_open_files > 0) {
+        options->max_open_files = requested_open_files;
+    }
     LogPrint(BCLog::LEVELDB, "LevelDB using max_open_files=%d (default=%d)\n",
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(size_t nCacheSize, const DBOptions& db_options)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+    // up to two write buffers may be held in memory simultaneously
+    if (db_options.bulk_load) {
+        options.block_cache = leveldb::NewLRUCache(nCacheSize / 4);
+        options.write_buffer_size = nCacheSize * 3 / 8;
+    } else {
+        options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
+        options.write_buffer_size = nCacheSize / 4;
+    }
+    options.max_file_size = db_options.max_file_size;
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
     options.compression = leveldb::kNoCompression;
     options.info_log = new CBitcoinLevelDBLogger();
@@ -110,39 +128,520 @@ static leveldb::Options GetOptions(size_t nCacheSize)
         // on corruption in later versions.
         options.paranoid_checks = true;
     }
-    SetMaxOpenFiles(&options);
+    SetMaxOpenFiles(&options, db_options.max_open_files);
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+namespace {
+
+//! Subdirectory of a database directory that holds the keys of one partition.
+fs::path PartitionPath(const fs::path& path, uint8_t prefix)
+{
+    return path / strprintf("partition_%02x", prefix);
+}
+
+std::vector<fs::path> ListPartitionDirs(const fs::path& path)
+{
+    std::vector<fs::path> dirs;
+    if (!fs::is_directory(path)) return dirs;
+    for (fs::directory_iterator it(path); it != fs::directory_iterator(); ++it) {
+        if (fs::is_directory(it->path()) && it->path().filename().string().rfind("partition_", 0) == 0) {
+            dirs.push_back(it->path());
+        }
+    }
+    return dirs;
+}
+
+/** One LevelDB database together with the options it was opened with. */
+class LevelDBInstance
+{
+public:
+    leveldb::Options options;
+    leveldb::DB* pdb{nullptr};
+
+    LevelDBInstance(const fs::path& path, size_t cache_size, const DBOptions& db_options, leveldb::Env* env, bool memory)
+    {
+        options = GetOptions(cache_size, db_options);
+        options.create_if_missing = true;
+        if (env) options.env = env;
+        if (!memory) TryCreateDirectories(path);
+        leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
+        dbwrapper_private::HandleError(status);
+    }
+
+    ~LevelDBInstance()
+    {
+        delete pdb;
+        delete options.filter_policy;
+        delete options.info_log;
+        delete options.block_cache;
+    }
+
+    size_t DynamicMemoryUsage() const
+    {
+        std::string memory;
+        if (!pdb->GetProperty("leveldb.approximate-memory-usage", &memory)) {
+            LogPrint(BCLog::LEVELDB, "Failed to get approximate-memory-usage property\n");
+            return 0;
+        }
+        return stoul(memory);
+    }
+};
+
+/**
+ * Environment that runs the background work (compactions) of one database on
+ * a thread of its own, rather than on the single thread LevelDB shares between
+ * all databases, so that databases and partitions compact in parallel.
+ */
+class CompactionEnv final : public leveldb::EnvWrapper
+{
+private:
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::pair<void (*)(void*), void*>> m_queue GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::thread m_thread;
+
+    void ThreadMain(std::string thread_name)
+    {
+        util::ThreadRename(std::move(thread_name));
+        while (true) {
+            std::pair<void (*)(void*), void*> work;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                while (!m_stop && m_queue.empty()) m_cond.wait(lock);
+                if (m_queue.empty()) return;
+                work = m_queue.front();
+                m_queue.pop_front();
+            }
+            work.first(work.second);
+        }
+    }
+
+public:
+    CompactionEnv(leveldb::Env* base, std::string thread_name)
+        : leveldb::EnvWrapper(base),
+          m_thread(&CompactionEnv::ThreadMain, this, std::move(thread_name)) {}
+
+    ~CompactionEnv()
+    {
+        WITH_LOCK(m_mutex, m_stop = true);
+        m_cond.notify_one();
+        m_thread.join();
+    }
+
+    void Schedule(void (*function)(void*), void* arg) override
+    {
+        WITH_LOCK(m_mutex, m_queue.emplace_back(function, arg));
+        m_cond.notify_one();
+    }
+};
+
+/** All keys in a single LevelDB database. */
+class LevelDBBackend final : public DBBackend
+{
+private:
+    //! custom environment this database is using (nullptr in case of default environment)
+    std::unique_ptr<leveldb::Env> m_env;
+    std::unique_ptr<CompactionEnv> m_compaction_env;
+    LevelDBInstance m_db;
+
+public:
+    LevelDBBackend(const fs::path& path, size_t cache_size, bool memory, const DBOptions& db_options, const std::string& name)
+        : m_env{memory ? leveldb::NewMemEnv(leveldb::Env::Default()) : nullptr},
+          m_compaction_env{db_options.compaction_thread ? MakeUnique<CompactionEnv>(memory ? m_env.get() : leveldb::Env::Default(), "dbcompact." + name) : nullptr},
+          m_db{path, cache_size, db_options, m_compaction_env ? m_compaction_env.get() : m_env.get(), memory}
+    {
+        if (!memory && !ListPartitionDirs(path).empty()) {
+            throw dbwrapper_error(strprintf("Database %s was written with -dbbackend=partitioned", path.string()));
+        }
+    }
+
+    leveldb::Status Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) override
+    {
+        return m_db.pdb->Get(options, key, value);
+    }
+
+    void MultiGet(const leveldb::ReadOptions& options, const std::vector<leveldb::Slice>& keys,
+                  std::vector<std::string>& values, std::vector<leveldb::Status>& statuses) override
+    {
+        leveldb::ReadOptions snapshot_options = options;
+        snapshot_options.snapshot = m_db.pdb->GetSnapshot();
+        values.resize(keys.size());
+        statuses.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            statuses[i] = m_db.pdb->Get(snapshot_options, keys[i], &values[i]);
+        }
+        m_db.pdb->ReleaseSnapshot(snapshot_options.snapshot);
+    }
+
+    leveldb::Status Write(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch) override
+    {
+        return m_db.pdb->Write(options, batch);
+    }
+
+    std::vector<std::unique_ptr<leveldb::Iterator>> NewIterators(const leveldb::ReadOptions& options, size_t count) override
+    {
+        leveldb::ReadOptions snapshot_options = options;
+        snapshot_options.snapshot = m_db.pdb->GetSnapshot();
+        std::vector<std::unique_ptr<leveldb::Iterator>> iterators;
+        for (size_t i = 0; i < count; ++i) {
+            iterators.emplace_back(m_db.pdb->NewIterator(snapshot_options));
+        }
+        // The iterators keep reading the state as of the snapshot after it is released.
+        m_db.pdb->ReleaseSnapshot(snapshot_options.snapshot);
+        return iterators;
+    }
+
+    uint64_t ApproximateSize(const leveldb::Slice& begin, const leveldb::Slice& end) override
+    {
+        uint64_t size = 0;
+        leveldb::Range range(begin, end);
+        m_db.pdb->GetApproximateSizes(&range, 1, &size);
+        return size;
+    }
+
+    void CompactRange(const leveldb::Slice* begin, const leveldb::Slice* end) override
+    {
+        m_db.pdb->CompactRange(begin, end);
+    }
+
+    size_t DynamicMemoryUsage() override { return m_db.DynamicMemoryUsage(); }
+};
+
+/** Iterator over the union of several databases that hold disjoint sets of keys. */
+class MergingIterator final : public leveldb::Iterator
+{
+private:
+    std::vector<std::unique_ptr<leveldb::Iterator>> m_children;
+    leveldb::Iterator* m_current{nullptr};
+    bool m_forward{true};
+
+    void FindSmallest()
+    {
+        m_current = nullptr;
+        for (const auto& child : m_children) {
+            if (child->Valid() && (!m_current || child->key().compare(m_current->key()) < 0)) m_current = child.get();
+        }
+    }
+
+    void FindLargest()
+    {
+        m_current = nullptr;
+        for (const auto& child : m_children) {
+            if (child->Valid() && (!m_current || child->key().compare(m_current->key()) > 0)) m_current = child.get();
+        }
+    }
+
+public:
+    explicit MergingIterator(std::vector<std::unique_ptr<leveldb::Iterator>> children) : m_children(std::move(children)) {}
+
+    bool Valid() const override { return m_current != nullptr; }
+
+    void SeekToFirst() override
+    {
+        for (const auto& child : m_children) child->SeekToFirst();
+        m_forward = true;
+        FindSmallest();
+    }
+
+    void SeekToLast() override
+    {
+        for (const auto& child : m_children) child->SeekToLast();
+        m_forward = false;
+        FindLargest();
+    }
+
+    void Seek(const leveldb::Slice& target) override
+    {
+        for (const auto& child : m_children) child->Seek(target);
+        m_forward = true;
+        FindSmallest();
+    }
+
+    void Next() override
+    {
+        assert(Valid());
+        if (!m_forward) {
+            // Keys are unique across children, so seeking to the current key
+            // moves the other children to the first key after it.
+            const std::string key = m_current->key().ToString();
+            for (const auto& child : m_children) {
+                if (child.get() != m_current) child->Seek(key);
+            }
+            m_forward = true;
+        }
+        m_current->Next();
+        FindSmallest();
+    }
+
+    void Prev() override
+    {
+        assert(Valid());
+        if (m_forward) {
+            const std::string key = m_current->key().ToString();
+            for (const auto& child : m_children) {
+                if (child.get() == m_current) continue;
+                child->Seek(key);
+                if (child->Valid()) {
+                    child->Prev();
+                } else {
+                    child->SeekToLast();
+                }
+            }
+            m_forward = false;
+        }
+        m_current->Prev();
+        FindLargest();
+    }
+
+    leveldb::Slice key() const override { return m_current->key(); }
+    leveldb::Slice value() const override { return m_current->value(); }
+
+    leveldb::Status status() const override
+    {
+        for (const auto& child : m_children) {
+            if (!child->status().ok()) return child->status();
+        }
+        return leveldb::Status::OK();
+    }
+};
+
+/**
+ * Keeps every partition in a LevelDB database of its own, in a subdirectory
+ * of the database directory, and all other keys in the database directory
+ * itself. Partitions get their own share of the cache and their own
+ * compaction thread.
+ */
+class PartitionedBackend final : public DBBackend
+{
+private:
+    std::unique_ptr<leveldb::Env> m_mem_env;
+    std::vector<std::unique_ptr<CompactionEnv>> m_compaction_envs;
+    //! m_dbs[0] holds the keys that are in no partition
+    std::vector<std::unique_ptr<LevelDBInstance>> m_dbs;
+    //! index into m_dbs for every first byte of a key
+    std::array<uint8_t, 256> m_partition_of{};
+
+    //! Serializes writes and taking snapshots, so that snapshots of different databases match.
+    Mutex m_mutex;
+    //! database last written to without sync
+    std::optional<size_t> m_unsynced GUARDED_BY(m_mutex);
+
+    size_t PartitionOf(const leveldb::Slice& key) const
+    {
+        return key.empty() ? 0 : m_partition_of[static_cast<uint8_t>(key[0])];
+    }
+
+    /** Splits a batch into runs of consecutive operations on the same database. */
+    class BatchSplitter final : public leveldb::WriteBatch::Handler
+    {
+    private:
+        const PartitionedBackend& m_backend;
+
+        leveldb::WriteBatch& Run(const leveldb::Slice& key)
+        {
+            const size_t partition = m_backend.PartitionOf(key);
+            if (runs.empty() || runs.back().first != partition) runs.emplace_back(partition, leveldb::WriteBatch{});
+            return runs.back().second;
+        }
+
+    public:
+        std::vector<std::pair<size_t, leveldb::WriteBatch>> runs;
+
+        explicit BatchSplitter(const PartitionedBackend& backend) : m_backend(backend) {}
+        void Put(const leveldb::Slice& key, const leveldb::Slice& value) override { Run(key).Put(key, value); }
+        void Delete(const leveldb::Slice& key) override { Run(key).Delete(key); }
+    };
+
+    std::vector<const leveldb::Snapshot*> GetSnapshots()
+    {
+        LOCK(m_mutex);
+        std::vector<const leveldb::Snapshot*> snapshots;
+        for (const auto& db : m_dbs) snapshots.push_back(db->pdb->GetSnapshot());
+        return snapshots;
+    }
+
+    void ReleaseSnapshots(const std::vector<const leveldb::Snapshot*>& snapshots)
+    {
+        for (size_t i = 0; i < m_dbs.size(); ++i) m_dbs[i]->pdb->ReleaseSnapshot(snapshots[i]);
+    }
+
+public:
+    PartitionedBackend(const fs::path& path, size_t cache_size, bool memory, const DBOptions& db_options, const std::string& name)
+        : m_mem_env{memory ? leveldb::NewMemEnv(leveldb::Env::Default()) : nullptr}
+    {
+        const std::vector<DBPartition>& partitions = db_options.partitions;
+        leveldb::Env* base_env = memory ? m_mem_env.get() : leveldb::Env::Default();
+        leveldb::Env* default_env = m_mem_env.get();
+        if (db_options.compaction_thread) {
+            m_compaction_envs.push_back(MakeUnique<CompactionEnv>(base_env, "dbcompact." + name));
+            default_env = m_compaction_envs.back().get();
+        }
+        double default_share = 1.0;
+        for (const DBPartition& partition : partitions) default_share -= partition.cache_share;
+        m_dbs.push_back(MakeUnique<LevelDBInstance>(path, cache_size * std::max(default_share, 0.0), db_options, default_env, memory));
+
+        // Keys of a partition in the main database were written with another
+        // backend or partitioning, and would not be found.
+        std::unique_ptr<leveldb::Iterator> it(m_dbs[0]->pdb->NewIterator(leveldb::ReadOptions()));
+        for (const DBPartition& partition : partitions) {
+            const char prefix = partition.prefix;
+            it->Seek(leveldb::Slice(&prefix, 1));
+            if (it->Valid() && it->key()[0] == prefix) {
+                throw dbwrapper_error(strprintf("Database %s holds keys of partition %02x written with another -dbbackend", path.string(), partition.prefix));
+            }
+        }
+        it.reset();
+        for (const fs::path& dir : memory ? std::vector<fs::path>{} : ListPartitionDirs(path)) {
+            if (std::none_of(partitions.begin(), partitions.end(), [&](const DBPartition& partition) { return PartitionPath(path, partition.prefix) == dir; })) {
+                throw dbwrapper_error(strprintf("Database %s holds unknown partition %s", path.string(), dir.filename().string()));
+            }
+        }
+
+        for (const DBPartition& partition : partitions) {
+            assert(m_partition_of[partition.prefix] == 0);
+            m_compaction_envs.push_back(MakeUnique<CompactionEnv>(base_env, strprintf("dbcompact.%s.%02x", name, partition.prefix)));
+            m_dbs.push_back(MakeUnique<LevelDBInstance>(PartitionPath(path, partition.prefix), cache_size * partition.cache_share,
+                                                        db_options, m_compaction_envs.back().get(), memory));
+            m_partition_of[partition.prefix] = m_dbs.size() - 1;
+        }
+    }
+
+    leveldb::Status Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) override
+    {
+        return m_dbs[PartitionOf(key)]->pdb->Get(options, key, value);
+    }
+
+    void MultiGet(const leveldb::ReadOptions& options, const std::vector<leveldb::Slice>& keys,
+                  std::vector<std::string>& values, std::vector<leveldb::Status>& statuses) override
+    {
+        const std::vector<const leveldb::Snapshot*> snapshots = GetSnapshots();
+        leveldb::ReadOptions snapshot_options = options;
+        values.resize(keys.size());
+        statuses.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            const size_t partition = PartitionOf(keys[i]);
+            snapshot_options.snapshot = snapshots[partition];
+            statuses[i] = m_dbs[partition]->pdb->Get(snapshot_options, keys[i], &values[i]);
+        }
+        ReleaseSnapshots(snapshots);
+    }
+
+    leveldb::Status Write(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch) override
+    {
+        if (m_dbs.size() == 1) return m_dbs[0]->pdb->Write(options, batch);
+
+        BatchSplitter splitter(*this);
+        leveldb::Status status = batch->Iterate(&splitter);
+        if (!status.ok()) return status;
+
+        LOCK(m_mutex);
+        for (auto& [partition, run] : splitter.runs) {
+            if (m_unsynced && *m_unsynced != partition) {
+                // Databases sync independently. Make the earlier writes durable
+                // before writing to another database, so that a crash can not
+                // keep a later write while losing an earlier one.
+                leveldb::WriteOptions sync_options;
+                sync_options.sync = true;
+                leveldb::WriteBatch empty;
+                status = m_dbs[*m_unsynced]->pdb->Write(sync_options, &empty);
+                if (!status.ok()) return status;
+                m_unsynced.reset();
+            }
+            status = m_dbs[partition]->pdb->Write(options, &run);
+            if (!status.ok()) return status;
+            if (!options.sync) m_unsynced = partition;
+        }
+        return status;
+    }
+
+    std::vector<std::unique_ptr<leveldb::Iterator>> NewIterators(const leveldb::ReadOptions& options, size_t count) override
+    {
+        const std::vector<const leveldb::Snapshot*> snapshots = GetSnapshots();
+        leveldb::ReadOptions snapshot_options = options;
+        std::vector<std::unique_ptr<leveldb::Iterator>> iterators;
+        for (size_t i = 0; i < count; ++i) {
+            std::vector<std::unique_ptr<leveldb::Iterator>> children;
+            for (size_t partition = 0; partition < m_dbs.size(); ++partition) {
+                snapshot_options.snapshot = snapshots[partition];
+                children.emplace_back(m_dbs[partition]->pdb->NewIterator(snapshot_options));
+            }
+            if (children.size() == 1) {
+                iterators.push_back(std::move(children.front()));
+            } else {
+                iterators.push_back(MakeUnique<MergingIterator>(std::move(children)));
+            }
+        }
+        ReleaseSnapshots(snapshots);
+        return iterators;
+    }
+
+    uint64_t ApproximateSize(const leveldb::Slice& begin, const leveldb::Slice& end) override
+    {
+        uint64_t total = 0;
+        leveldb::Range range(begin, end);
+        for (const auto& db : m_dbs) {
+            uint64_t size = 0;
+            db->pdb->GetApproximateSizes(&range, 1, &size);
+            total += size;
+        }
+        return total;
+    }
+
+    void CompactRange(const leveldb::Slice* begin, const leveldb::Slice* end) override
+    {
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < m_dbs.size(); ++i) {
+            threads.emplace_back([this, i, begin, end] { m_dbs[i]->pdb->CompactRange(begin, end); });
+        }
+        m_dbs[0]->pdb->CompactRange(begin, end);
+        for (std::thread& thread : threads) thread.join();
+    }
+
+    size_t DynamicMemoryUsage() override
+    {
+        size_t usage = 0;
+        for (const auto& db : m_dbs) usage += db->DynamicMemoryUsage();
+        return usage;
+    }
+};
+
+} // namespace
+
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const DBOptions& db_options)
     : m_name{path.stem().string()}
 {
-    penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
-    options.create_if_missing = true;
-    if (fMemory) {
-        penv = leveldb::NewMemEnv(leveldb::Env::Default());
-        options.env = penv;
-    } else {
+    if (!fMemory) {
         if (fWipe) {
             LogPrintf("Wiping LevelDB in %s\n", path.string());
-            leveldb::Status result = leveldb::DestroyDB(path.string(), options);
+            for (const fs::path& dir : ListPartitionDirs(path)) {
+                dbwrapper_private::HandleError(leveldb::DestroyDB(dir.string(), leveldb::Options()));
+                fs::remove(dir);
+            }
+            leveldb::Status result = leveldb::DestroyDB(path.string(), leveldb::Options());
             dbwrapper_private::HandleError(result);
         }
         TryCreateDirectories(path);
         LogPrintf("Opening LevelDB in %s\n", path.string());
     }
-    leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
-    dbwrapper_private::HandleError(status);
+    const std::string backend = gArgs.GetArg("-dbbackend", DEFAULT_DB_BACKEND);
+    if (backend == "leveldb") {
+        m_backend = MakeUnique<LevelDBBackend>(path, nCacheSize, fMemory, db_options, m_name);
+    } else if (backend == "partitioned") {
+        m_backend = MakeUnique<PartitionedBackend>(path, nCacheSize, fMemory, db_options, m_name);
+    } else {
+        throw dbwrapper_error(strprintf("Unknown -dbbackend '%s'", backend));
+    }
     LogPrintf("Opened LevelDB successfully\n");
 
     if (gArgs.GetBoolArg("-forcecompactdb", false)) {
         LogPrintf("Starting database compaction of %s\n", path.string());
-        pdb->CompactRange(nullptr, nullptr);
+        m_backend->CompactRange(nullptr, nullptr);
         LogPrintf("Finished database compaction of %s\n", path.string());
     }
 
@@ -166,19 +665,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
 }
 
-CDBWrapper::~CDBWrapper()
-{
-    delete pdb;
-    pdb = nullptr;
-    delete options.filter_policy;
-    options.filter_policy = nullptr;
-    delete options.info_log;
-    options.info_log = nullptr;
-    delete options.block_cache;
-    options.block_cache = nullptr;
-    delete penv;
-    options.env = nullptr;
-}
+CDBWrapper::~CDBWrapper() = default;
 
 bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
@@ -187,7 +674,7 @@ bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
     if (log_memory) {
         mem_before = DynamicMemoryUsage() / 1024.0 / 1024;
     }
-    leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
+    leveldb::Status status = m_backend->Write(fSync ? syncoptions : writeoptions, &batch.batch);
     dbwrapper_private::HandleError(status);
     if (log_memory) {
         double mem_after = DynamicMemoryUsage() / 1024.0 / 1024;
@@ -198,12 +685,7 @@ bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 }
 
 size_t CDBWrapper::DynamicMemoryUsage() const {
-    std::string memory;
-    if (!pdb->GetProperty("leveldb.approximate-memory-usage", &memory)) {
-        LogPrint(BCLog::LEVELDB, "Failed to get approximate-memory-usage property\n");
-        return 0;
-    }
-    return stoul(memory);
+    return m_backend->DynamicMemoryUsage();
 }
 
 // Prefixed with null character to avoid collisions with other keys
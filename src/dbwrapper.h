@@ -16,9 +16,18 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
+//! -dbbackend default
+static const char* const DEFAULT_DB_BACKEND = "leveldb";
+//! Default target size of the table files LevelDB writes (bytes)
+static const size_t DEFAULT_DB_MAX_FILE_SIZE = 2 << 20;
+
 class dbwrapper_error : public std::runtime_error
 {
 public:
@@ -43,6 +52,61 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
 };
 
+/**
+ * Keys whose serialization starts with a given byte, which the partitioned
+ * backend keeps in a LevelDB database of their own. The LevelDB backend keeps
+ * all keys in one database and ignores partitions.
+ */
+struct DBPartition {
+    //! first byte of the keys in this partition
+    uint8_t prefix;
+    //! share of the wrapper's cache size given to this partition
+    double cache_share;
+};
+
+/** LevelDB tuning of one database, given to the CDBWrapper constructor. */
+struct DBOptions {
+    //! Key prefixes the partitioned backend keeps, and tunes, separately.
+    //! Writes spanning several partitions are not atomic: a crash may leave
+    //! any prefix of such a batch applied.
+    std::vector<DBPartition> partitions{};
+    //! target size of the table files written by compactions
+    size_t max_file_size{DEFAULT_DB_MAX_FILE_SIZE};
+    //! maximum number of table files kept open (0 = platform default)
+    int max_open_files{0};
+    //! Run compactions on a thread of this database's own, rather than on the
+    //! single thread LevelDB shares between all databases.
+    bool compaction_thread{false};
+    //! Give the write buffer most of the cache, for fewer level-0 files and
+    //! compactions while many writes are loaded.
+    bool bulk_load{false};
+};
+
+/** Key-value store that a CDBWrapper keeps its data in. */
+class DBBackend
+{
+public:
+    virtual ~DBBackend() {}
+
+    virtual leveldb::Status Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) = 0;
+
+    /** Look up several keys against one state of the store. */
+    virtual void MultiGet(const leveldb::ReadOptions& options, const std::vector<leveldb::Slice>& keys,
+                          std::vector<std::string>& values, std::vector<leveldb::Status>& statuses) = 0;
+
+    virtual leveldb::Status Write(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch) = 0;
+
+    /** Create count iterators that all see the same state of the store. */
+    virtual std::vector<std::unique_ptr<leveldb::Iterator>> NewIterators(const leveldb::ReadOptions& options, size_t count) = 0;
+
+    virtual uint64_t ApproximateSize(const leveldb::Slice& begin, const leveldb::Slice& end) = 0;
+
+    /** Compact the keys in [begin, end]; nullptr stands for the start or end of the store. */
+    virtual void CompactRange(const leveldb::Slice* begin, const leveldb::Slice* end) = 0;
+
+    virtual size_t DynamicMemoryUsage() = 0;
+};
+
 /** Batch of changes queued to be written to a CDBWrapper */
 class CDBBatch
 {
@@ -177,12 +241,6 @@ class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
 private:
-    //! custom environment this database is using (may be nullptr in case of default environment)
-    leveldb::Env* penv;
-
-    //! database options used
-    leveldb::Options options;
-
     //! options used when reading from the database
     leveldb::ReadOptions readoptions;
 
@@ -195,8 +253,8 @@ private:
     //! options used when sync writing to the database
     leveldb::WriteOptions syncoptions;
 
-    //! the database itself
-    leveldb::DB* pdb;
+    //! the store the data is kept in, selected with -dbbackend
+    std::unique_ptr<DBBackend> m_backend;
 
     //! the name of this database
     std::string m_name;
@@ -220,8 +278,10 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] db_options  Tuning of the database.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false,
+               const DBOptions& db_options = {});
     ~CDBWrapper();
 
     CDBWrapper(const CDBWrapper&) = delete;
@@ -236,7 +296,7 @@ public:
         leveldb::Slice slKey((const char*)ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status = m_backend->Get(readoptions, slKey, &strValue);
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -270,7 +330,7 @@ public:
         leveldb::Slice slKey((const char*)ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status = m_backend->Get(readoptions, slKey, &strValue);
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -280,6 +340,51 @@ public:
         return true;
     }
 
+    /**
+     * Read several keys against one state of the database. found[i] is set if
+     * keys[i] exists and its value could be deserialized into values[i].
+     * Returns the number of keys found.
+     */
+    template <typename K, typename V>
+    size_t ReadMany(const std::vector<K>& keys, std::vector<V>& values, std::vector<bool>& found) const
+    {
+        std::vector<std::string> strKeys;
+        strKeys.reserve(keys.size());
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        for (const K& key : keys) {
+            ssKey << key;
+            strKeys.push_back(ssKey.str());
+            ssKey.clear();
+        }
+        const std::vector<leveldb::Slice> slKeys(strKeys.begin(), strKeys.end());
+
+        std::vector<std::string> strValues;
+        std::vector<leveldb::Status> statuses;
+        m_backend->MultiGet(readoptions, slKeys, strValues, statuses);
+
+        values.resize(keys.size());
+        found.assign(keys.size(), false);
+        size_t count = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (!statuses[i].ok()) {
+                if (statuses[i].IsNotFound()) continue;
+                LogPrintf("LevelDB read failure: %s\n", statuses[i].ToString());
+                dbwrapper_private::HandleError(statuses[i]);
+            }
+            try {
+                CDataStream ssValue(MakeUCharSpan(strValues[i]), SER_DISK, CLIENT_VERSION);
+                ssValue.Xor(obfuscate_key);
+                ssValue >> values[i];
+            } catch (const std::exception&) {
+                continue;
+            }
+            found[i] = true;
+            ++count;
+        }
+        return count;
+    }
+
     template <typename K>
     bool Erase(const K& key, bool fSync = false)
     {
@@ -295,7 +400,20 @@ public:
 
     CDBIterator *NewIterator()
     {
-        return new CDBIterator(*this, pdb->NewIterator(iteroptions));
+        return new CDBIterator(*this, m_backend->NewIterators(iteroptions, 1).front().release());
+    }
+
+    /**
+     * Create count iterators that all see the same state of the database, so
+     * that they can walk different parts of it concurrently.
+     */
+    std::vector<std::unique_ptr<CDBIterator>> NewIterators(size_t count)
+    {
+        std::vector<std::unique_ptr<CDBIterator>> iterators;
+        for (auto& piter : m_backend->NewIterators(iteroptions, count)) {
+            iterators.emplace_back(new CDBIterator(*this, piter.release()));
+        }
+        return iterators;
     }
 
     /**
@@ -313,10 +431,7 @@ public:
         ssKey2 << key_end;
         leveldb::Slice slKey1((const char*)ssKey1.data(), ssKey1.size());
         leveldb::Slice slKey2((const char*)ssKey2.data(), ssKey2.size());
-        uint64_t size = 0;
-        leveldb::Range range(slKey1, slKey2);
-        pdb->GetApproximateSizes(&range, 1, &size);
-        return size;
+        return m_backend->ApproximateSize(slKey1, slKey2);
     }
 
     /**
@@ -332,7 +447,7 @@ public:
         ssKey2 << key_end;
         leveldb::Slice slKey1((const char*)ssKey1.data(), ssKey1.size());
         leveldb::Slice slKey2((const char*)ssKey2.data(), ssKey2.size());
-        pdb->CompactRange(&slKey1, &slKey2);
+        m_backend->CompactRange(&slKey1, &slKey2);
     }
 };
 
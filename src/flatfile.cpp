@@ -3,13 +3,28 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <list>
 #include <stdexcept>
 
+#include <clientversion.h>
 #include <flatfile.h>
 #include <logging.h>
+#include <streams.h>
+#include <sync.h>
 #include <tinyformat.h>
+#include <util/lzcompress.h>
 #include <util/system.h>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 FlatFileSeq::FlatFileSeq(fs::path dir, const char* prefix, size_t chunk_size) :
     m_dir(std::move(dir)),
     m_prefix(prefix),
@@ -30,6 +45,116 @@ fs::path FlatFileSeq::FileName(const FlatFilePos& pos) const
     return m_dir / strprintf("%s%05u.dat", m_prefix, pos.nFile);
 }
 
+fs::path FlatFileSeq::CompressedFileName(const FlatFilePos& pos) const
+{
+    return m_dir / strprintf("%s%05u.dat.cmp", m_prefix, pos.nFile);
+}
+
+bool FlatFileSeq::Exists(const FlatFilePos& pos) const
+{
+    return fs::exists(FileName(pos)) || fs::exists(CompressedFileName(pos));
+}
+
+bool FlatFileSeq::IsCompressed(const FlatFilePos& pos) const
+{
+    return !fs::exists(FileName(pos)) && fs::exists(CompressedFileName(pos));
+}
+
+namespace {
+//! Magic bytes at the start of a compressed flat file
+constexpr char COMPRESSED_MAGIC[4] = {'f', 'l', 'z', '\x01'};
+//! Size of the magic bytes, chunk size and uncompressed size at the start of a compressed flat file
+constexpr uint64_t COMPRESSED_HEADER_SIZE{16};
+
+/**
+ * Reads a compressed flat file. The header is followed by a table with the offset of every
+ * chunk in the chunk data, plus the offset of the end of the last chunk, and then by the chunk
+ * data. Each chunk is compressed with LZCompress(), or stored as is if that does not make it
+ * smaller, in which case it is exactly as long as the uncompressed chunk.
+ */
+class CompressedFileReader
+{
+private:
+    CAutoFile m_file;
+    uint32_t m_chunk_size{0};
+    uint64_t m_size{0};
+    //! The last chunk read, kept for a following read that starts in it
+    uint64_t m_cached_chunk{std::numeric_limits<uint64_t>::max()};
+    std::vector<uint8_t> m_cached;
+
+public:
+    explicit CompressedFileReader(const fs::path& path) : m_file{fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION}
+    {
+        if (m_file.IsNull()) return;
+        try {
+            char magic[sizeof(COMPRESSED_MAGIC)];
+            m_file.read(magic, sizeof(magic));
+            m_file >> m_chunk_size >> m_size;
+            if (memcmp(magic, COMPRESSED_MAGIC, sizeof(magic)) != 0 || m_chunk_size == 0) {
+                m_file.fclose();
+            }
+        } catch (const std::ios_base::failure&) {
+            m_file.fclose();
+        }
+    }
+
+    bool IsNull() const { return m_file.IsNull(); }
+
+    //! Size of the uncompressed contents
+    uint64_t size() const { return m_size; }
+
+    //! Read out.size() bytes of the uncompressed contents, starting at pos.
+    bool Read(uint64_t pos, Span<uint8_t> out)
+    {
+        if (m_file.IsNull() || pos > m_size || out.size() > m_size - pos) return false;
+        if (out.empty()) return true;
+        const uint64_t num_chunks{(m_size + m_chunk_size - 1) / m_chunk_size};
+        const uint64_t data_start{COMPRESSED_HEADER_SIZE + (num_chunks + 1) * 8};
+        const uint64_t first{pos / m_chunk_size};
+        const uint64_t last{(pos + out.size() - 1) / m_chunk_size};
+        const uint64_t cached_chunk{m_cached_chunk};
+        m_cached_chunk = std::numeric_limits<uint64_t>::max();
+        try {
+            std::vector<uint64_t> offsets(last - first + 2);
+            if (fseek(m_file.Get(), COMPRESSED_HEADER_SIZE + first * 8, SEEK_SET)) return false;
+            for (uint64_t& offset : offsets) {
+                m_file >> offset;
+            }
+            std::vector<uint8_t> stored;
+            std::vector<uint8_t> chunk;
+            for (uint64_t n = first; n <= last; ++n) {
+                const uint64_t chunk_start{n * m_chunk_size};
+                const uint64_t chunk_size{std::min<uint64_t>(m_chunk_size, m_size - chunk_start)};
+                if (n == cached_chunk) {
+                    chunk.swap(m_cached);
+                } else {
+                    const uint64_t begin{offsets[n - first]};
+                    const uint64_t end{offsets[n - first + 1]};
+                    if (end < begin || end - begin > chunk_size) return false;
+                    stored.resize(end - begin);
+                    if (fseek(m_file.Get(), data_start + begin, SEEK_SET)) return false;
+                    m_file.read((char*)stored.data(), stored.size());
+                    if (stored.size() == chunk_size) {
+                        chunk.swap(stored);
+                    } else {
+                        chunk.resize(chunk_size);
+                        if (!LZDecompress(stored, chunk)) return false;
+                    }
+                }
+                const uint64_t copy_start{std::max(pos, chunk_start)};
+                const uint64_t copy_end{std::min(pos + out.size(), chunk_start + chunk_size)};
+                std::copy(chunk.begin() + (copy_start - chunk_start), chunk.begin() + (copy_end - chunk_start), out.begin() + (copy_start - pos));
+            }
+            m_cached_chunk = last;
+            m_cached.swap(chunk);
+        } catch (const std::ios_base::failure&) {
+            return false;
+        }
+        return true;
+    }
+};
+} // namespace
+
 FILE* FlatFileSeq::Open(const FlatFilePos& pos, bool read_only)
 {
     if (pos.IsNull()) {
@@ -38,6 +163,9 @@ FILE* FlatFileSeq::Open(const FlatFilePos& pos, bool read_only)
     fs::path path = FileName(pos);
     fs::create_directories(path.parent_path());
     FILE* file = fsbridge::fopen(path, read_only ? "rb": "rb+");
+    if (!file && fs::exists(CompressedFileName(pos))) {
+        return OpenCompressed(pos, read_only);
+    }
     if (!file && !read_only)
         file = fsbridge::fopen(path, "wb+");
     if (!file) {
@@ -52,6 +180,37 @@ FILE* FlatFileSeq::Open(const FlatFilePos& pos, bool read_only)
     return file;
 }
 
+FILE* FlatFileSeq::OpenCompressed(const FlatFilePos& pos, bool read_only) const
+{
+    const fs::path path = CompressedFileName(pos);
+    if (!read_only) {
+        LogPrintf("Unable to open compressed file %s for writing\n", path.string());
+        return nullptr;
+    }
+    CompressedFileReader reader{path};
+    FILE* file = reader.IsNull() ? nullptr : std::tmpfile();
+    if (!file) {
+        LogPrintf("Unable to open file %s\n", path.string());
+        return nullptr;
+    }
+    LogPrint(BCLog::VALIDATION, "Decompressing %s to a temporary file\n", path.string());
+    std::vector<uint8_t> buf;
+    for (uint64_t start = 0; start < reader.size(); start += buf.size()) {
+        buf.resize(std::min<uint64_t>(COMPRESSED_FLAT_FILE_CHUNK_SIZE, reader.size() - start));
+        if (!reader.Read(start, buf) || fwrite(buf.data(), 1, buf.size(), file) != buf.size()) {
+            LogPrintf("Unable to decompress %s\n", path.string());
+            fclose(file);
+            return nullptr;
+        }
+    }
+    if (fseek(file, pos.nPos, SEEK_SET)) {
+        LogPrintf("Unable to seek to position %u of %s\n", pos.nPos, path.string());
+        fclose(file);
+        return nullptr;
+    }
+    return file;
+}
+
 size_t FlatFileSeq::Allocate(const FlatFilePos& pos, size_t add_size, bool& out_of_space)
 {
     out_of_space = false;
@@ -80,6 +239,9 @@ size_t FlatFileSeq::Allocate(const FlatFilePos& pos, size_t add_size, bool& out_
 
 bool FlatFileSeq::Flush(const FlatFilePos& pos, bool finalize)
 {
+    // Compressed files were finalized and committed when they were written.
+    if (IsCompressed(pos)) return true;
+
     FILE* file = Open(FlatFilePos(pos.nFile, 0)); // Avoid fseek to nPos
     if (!file) {
         return error("%s: failed to open file %d", __func__, pos.nFile);
@@ -97,3 +259,194 @@ bool FlatFileSeq::Flush(const FlatFilePos& pos, bool finalize)
     fclose(file);
     return true;
 }
+
+MappedFlatFile::~MappedFlatFile()
+{
+#ifndef WIN32
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+}
+
+std::shared_ptr<const MappedFlatFile> MapFlatFile(const fs::path& path)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        LogPrint(BCLog::VALIDATION, "Unable to map %s\n", path.string());
+        return nullptr;
+    }
+    return std::make_shared<const MappedFlatFile>(static_cast<const uint8_t*>(data), st.st_size);
+#else
+    return nullptr;
+#endif
+}
+
+namespace {
+/** Whether the file at path is at least size bytes long. */
+bool FileCovers(const fs::path& path, size_t size)
+{
+#ifndef WIN32
+    struct stat st;
+    return stat(path.string().c_str(), &st) == 0 && st.st_size >= 0 && size_t(st.st_size) >= size;
+#else
+    return false;
+#endif
+}
+
+/** Process-wide cache of flat file mappings, most recently used first. */
+class FlatFileMapCache
+{
+private:
+    Mutex m_mutex;
+    std::list<std::pair<std::string, std::shared_ptr<const MappedFlatFile>>> m_maps GUARDED_BY(m_mutex);
+
+public:
+    std::shared_ptr<const MappedFlatFile> Get(const fs::path& path, size_t needed_size)
+    {
+        // Mapping whole block files takes a lot of address space, so only do it on 64-bit systems.
+        if (sizeof(void*) < 8) return nullptr;
+
+        const std::string key = path.string();
+        LOCK(m_mutex);
+        for (auto it = m_maps.begin(); it != m_maps.end(); ++it) {
+            if (it->first != key) continue;
+            if (it->second->size() >= needed_size) {
+                // Touching pages of a mapping past the end of its file raises
+                // SIGBUS, so make sure the file was not truncated since.
+                if (!FileCovers(path, needed_size)) {
+                    LogPrint(BCLog::VALIDATION, "%s shrank below its mapping\n", key);
+                    m_maps.erase(it);
+                    return nullptr;
+                }
+                m_maps.splice(m_maps.begin(), m_maps, it);
+                return it->second;
+            }
+            // The file has grown since it was mapped.
+            m_maps.erase(it);
+            break;
+        }
+        auto mapping = MapFlatFile(path);
+        if (!mapping || mapping->size() < needed_size) return nullptr;
+        m_maps.emplace_front(key, mapping);
+        if (m_maps.size() > MAX_MAPPED_FLAT_FILES) m_maps.pop_back();
+        return mapping;
+    }
+
+    void Erase(const fs::path& path)
+    {
+        const std::string key = path.string();
+        LOCK(m_mutex);
+        m_maps.remove_if([&](const auto& entry) { return entry.first == key; });
+    }
+};
+
+FlatFileMapCache g_flat_file_maps;
+} // namespace
+
+std::shared_ptr<const MappedFlatFile> FlatFileSeq::Map(const FlatFilePos& pos, size_t size) const
+{
+    if (pos.IsNull()) {
+        return nullptr;
+    }
+    return g_flat_file_maps.Get(FileName(pos), size_t{pos.nPos} + size);
+}
+
+void FlatFileSeq::Unmap(const FlatFilePos& pos) const
+{
+    g_flat_file_maps.Erase(FileName(pos));
+}
+
+bool FlatFileSeq::Compress(const FlatFilePos& pos, size_t size, const std::function<bool()>& interrupt) const
+{
+    const fs::path compressed_path = CompressedFileName(pos);
+    const fs::path temp_path = compressed_path.string() + ".tmp";
+    CAutoFile in{fsbridge::fopen(FileName(pos), "rb"), SER_DISK, CLIENT_VERSION};
+    if (in.IsNull()) {
+        return error("%s: failed to open file %d", __func__, pos.nFile);
+    }
+    CAutoFile out{fsbridge::fopen(temp_path, "wb"), SER_DISK, CLIENT_VERSION};
+    if (out.IsNull()) {
+        return error("%s: failed to create %s", __func__, temp_path.string());
+    }
+
+    const uint64_t num_chunks{(size + COMPRESSED_FLAT_FILE_CHUNK_SIZE - 1) / COMPRESSED_FLAT_FILE_CHUNK_SIZE};
+    std::vector<uint64_t> offsets{0};
+    try {
+        out.write(COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+        out << COMPRESSED_FLAT_FILE_CHUNK_SIZE << uint64_t{size};
+        // The offset table is written once the chunks are.
+        for (uint64_t n = 0; n <= num_chunks; ++n) {
+            out << uint64_t{0};
+        }
+        std::vector<uint8_t> chunk;
+        std::vector<uint8_t> check;
+        for (uint64_t n = 0; n < num_chunks; ++n) {
+            if (interrupt && interrupt()) {
+                out.fclose();
+                fs::remove(temp_path);
+                return false;
+            }
+            chunk.resize(std::min<uint64_t>(COMPRESSED_FLAT_FILE_CHUNK_SIZE, size - n * COMPRESSED_FLAT_FILE_CHUNK_SIZE));
+            in.read((char*)chunk.data(), chunk.size());
+            const std::vector<uint8_t> compressed{LZCompress(chunk)};
+            check.resize(chunk.size());
+            if (compressed.size() < chunk.size() && LZDecompress(compressed, check) && check == chunk) {
+                out.write((const char*)compressed.data(), compressed.size());
+                offsets.push_back(offsets.back() + compressed.size());
+            } else {
+                out.write((const char*)chunk.data(), chunk.size());
+                offsets.push_back(offsets.back() + chunk.size());
+            }
+        }
+        if (fseek(out.Get(), COMPRESSED_HEADER_SIZE, SEEK_SET)) {
+            throw std::ios_base::failure("seek to the offset table failed");
+        }
+        for (uint64_t offset : offsets) {
+            out << offset;
+        }
+        if (!FileCommit(out.Get())) {
+            throw std::ios_base::failure("commit failed");
+        }
+    } catch (const std::ios_base::failure& e) {
+        out.fclose();
+        fs::remove(temp_path);
+        return error("%s: failed to compress file %d: %s", __func__, pos.nFile, e.what());
+    }
+    out.fclose();
+    if (!RenameOver(temp_path, compressed_path)) {
+        fs::remove(temp_path);
+        return error("%s: failed to rename %s", __func__, temp_path.string());
+    }
+    DirectoryCommit(m_dir);
+    return true;
+}
+
+bool FlatFileSeq::ReadCompressed(const FlatFilePos& pos, Span<uint8_t> out) const
+{
+    if (pos.IsNull()) {
+        return false;
+    }
+    CompressedFileReader reader{CompressedFileName(pos)};
+    return reader.Read(pos.nPos, out);
+}
+
+bool FlatFileSeq::ReadCompressed(const FlatFilePos& pos, Span<uint8_t> header, const std::function<std::optional<size_t>(Span<const uint8_t>)>& get_body_size, std::vector<uint8_t>& body) const
+{
+    if (pos.IsNull()) {
+        return false;
+    }
+    CompressedFileReader reader{CompressedFileName(pos)};
+    if (!reader.Read(pos.nPos, header)) return false;
+    const std::optional<size_t> body_size{get_body_size(header)};
+    if (!body_size) return false;
+    body.resize(*body_size);
+    return reader.Read(uint64_t{pos.nPos} + header.size(), body);
+}
@@ -6,10 +6,20 @@
 #ifndef BITCOIN_FLATFILE_H
 #define BITCOIN_FLATFILE_H
 
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include <fs.h>
 #include <serialize.h>
+#include <span.h>
+
+/** Maximum number of flat files kept memory-mapped at the same time. */
+static constexpr size_t MAX_MAPPED_FLAT_FILES{8};
+/** Number of bytes of a flat file compressed together by FlatFileSeq::Compress(). */
+static constexpr uint32_t COMPRESSED_FLAT_FILE_CHUNK_SIZE{256 * 1024};
 
 struct FlatFilePos
 {
@@ -39,6 +49,56 @@ struct FlatFilePos
     std::string ToString() const;
 };
 
+/**
+ * A read-only memory mapping of a whole flat file. The mapping stays valid for as long as a
+ * reference to it is held, even if the file is evicted from the map cache or deleted.
+ */
+class MappedFlatFile
+{
+private:
+    const uint8_t* const m_data;
+    const size_t m_size;
+
+public:
+    MappedFlatFile(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+    ~MappedFlatFile();
+
+    MappedFlatFile(const MappedFlatFile&) = delete;
+    MappedFlatFile& operator=(const MappedFlatFile&) = delete;
+
+    Span<const uint8_t> data() const { return {m_data, m_size}; }
+    size_t size() const { return m_size; }
+};
+
+/** Map a whole file read-only. Returns null if the file is empty or cannot be mapped, e.g. on Windows. */
+std::shared_ptr<const MappedFlatFile> MapFlatFile(const fs::path& path);
+
+/**
+ * A range of bytes read from a flat file. It either points straight into a memory-mapped file
+ * (keeping the mapping alive) or owns a copy of the bytes when the file could not be mapped.
+ */
+class FlatFileData
+{
+private:
+    std::shared_ptr<const MappedFlatFile> m_mapping;
+    std::vector<uint8_t> m_copy;
+    Span<const uint8_t> m_span;
+
+public:
+    FlatFileData() = default;
+    FlatFileData(std::shared_ptr<const MappedFlatFile> mapping, Span<const uint8_t> span) :
+        m_mapping(std::move(mapping)), m_span(span) {}
+    explicit FlatFileData(std::vector<uint8_t> copy) : m_copy(std::move(copy)), m_span(m_copy) {}
+
+    FlatFileData(FlatFileData&&) = default;
+    FlatFileData& operator=(FlatFileData&&) = default;
+    FlatFileData(const FlatFileData&) = delete;
+    FlatFileData& operator=(const FlatFileData&) = delete;
+
+    Span<const uint8_t> span() const { return m_span; }
+    bool IsMapped() const { return m_mapping != nullptr; }
+};
+
 /**
  * FlatFileSeq represents a sequence of numbered files storing raw data. This class facilitates
  * access to and efficient management of these files.
@@ -50,6 +110,9 @@ private:
     const char* const m_prefix;
     const size_t m_chunk_size;
 
+    /** Open a read-only handle to the decompressed contents of a compressed file. */
+    FILE* OpenCompressed(const FlatFilePos& pos, bool read_only) const;
+
 public:
     /**
      * Constructor
@@ -63,7 +126,22 @@ public:
     /** Get the name of the file at the given position. */
     fs::path FileName(const FlatFilePos& pos) const;
 
-    /** Open a handle to the file at the given position. */
+    /** Get the name of the compressed version of the file at the given position. */
+    fs::path CompressedFileName(const FlatFilePos& pos) const;
+
+    /** Whether the file at the given position exists, compressed or not. */
+    bool Exists(const FlatFilePos& pos) const;
+
+    /** Whether the file at the given position has been replaced by its compressed version. */
+    bool IsCompressed(const FlatFilePos& pos) const;
+
+    /**
+     * Open a handle to the file at the given position.
+     *
+     * Once a file has been replaced by its compressed version, it can only be opened read-only,
+     * and the handle is to a temporary file holding the decompressed contents. That suits
+     * reading through a whole file; use ReadCompressed() to read a few bytes of it.
+     */
     FILE* Open(const FlatFilePos& pos, bool read_only = false);
 
     /**
@@ -79,12 +157,58 @@ public:
 
     /**
      * Commit a file to disk, and optionally truncate off extra pre-allocated bytes if final.
+     * Compressed files are already final, so flushing them succeeds without doing anything.
      *
      * @param[in] pos The first unwritten position in the file to be flushed.
      * @param[in] finalize True if no more data will be written to this file.
      * @return true on success, false on failure.
      */
     bool Flush(const FlatFilePos& pos, bool finalize = false);
+
+    /**
+     * Get a read-only memory mapping of the file at the given position that covers at least
+     * size bytes after it. Mappings are shared through a small process-wide LRU cache and are
+     * remapped when the file has grown past the end of the cached mapping.
+     *
+     * @return The mapping, or nullptr if the file cannot be mapped (e.g. it is too short, or
+     *         memory mapping is not supported on this platform). Callers should then fall back
+     *         to reading through Open().
+     */
+    std::shared_ptr<const MappedFlatFile> Map(const FlatFilePos& pos, size_t size) const;
+
+    /** Drop the cached mapping of the file at the given position, e.g. before it is deleted. */
+    void Unmap(const FlatFilePos& pos) const;
+
+    /**
+     * Write a compressed version of the first size bytes of the file at the given position, next
+     * to it. The file is compressed in chunks, each of which can be decompressed on its own, and
+     * every chunk is checked to decompress to the original bytes before it is written. Reads keep
+     * using the original file until the caller removes it.
+     *
+     * @param[in] interrupt If set, called before each chunk; compression is abandoned once it returns true.
+     * @return true on success, false on failure or when interrupted.
+     */
+    bool Compress(const FlatFilePos& pos, size_t size, const std::function<bool()>& interrupt = nullptr) const;
+
+    /**
+     * Read out.size() bytes at the given position of a compressed file. Positions refer to the
+     * uncompressed contents, so they stay valid when a file is compressed. Only the chunks
+     * covering the range are read and decompressed.
+     *
+     * @return true on success, false if the file is missing or corrupt, or too short.
+     */
+    bool ReadCompressed(const FlatFilePos& pos, Span<uint8_t> out) const;
+
+    /**
+     * Read a record at the given position of a compressed file: header.size() bytes, followed by
+     * a body of the size get_body_size derives from the header, or std::nullopt to reject it. The
+     * file is opened once, and a chunk holding both the end of the header and the start of the
+     * body is decompressed once.
+     *
+     * @return true on success, false if the file is missing or corrupt, too short, or the header
+     *         is rejected.
+     */
+    bool ReadCompressed(const FlatFilePos& pos, Span<uint8_t> header, const std::function<std::optional<size_t>(Span<const uint8_t>)>& get_body_size, std::vector<uint8_t>& body) const;
 };
 
 #endif // BITCOIN_FLATFILE_H
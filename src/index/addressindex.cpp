@@ -0,0 +1,258 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <compressor.h>
+#include <crypto/sha256.h>
+#include <index/addressindex.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <optional>
+
+/* The index database has an entry for every output, under a key made of the SHA256 hash of its
+ * scriptPubKey, the height of the block it was created in and its outpoint. An output that is
+ * spent has a second entry under the same key with a different type, which follows the entry of
+ * the output, so the outputs paying to a script and their spends are found in one range scan
+ * ordered by height.
+ *
+ * Keys have the type [DB_ADDRESS, uint256, uint32 (BE), uint256, VARINT(uint32), type].
+ * Values of outputs are [VARINT(compressed amount), CDiskTxPos], and values of spends are
+ * [uint256, VARINT(uint32), VARINT(uint32)]: the spending txid, input index and height.
+ */
+constexpr char DB_ADDRESS = 'a';
+constexpr char DB_ADDRESS_OUTPUT = 'o';
+constexpr char DB_ADDRESS_SPEND = 's';
+
+std::unique_ptr<AddressIndex> g_address_index;
+
+namespace {
+
+struct DBAddressKey {
+    uint256 script_hash;
+    uint32_t height;
+    COutPoint outpoint;
+    char type;
+
+    DBAddressKey() : height(0), type(0) {}
+    DBAddressKey(const uint256& script_hash_in, uint32_t height_in, const COutPoint& outpoint_in, char type_in) :
+        script_hash(script_hash_in), height(height_in), outpoint(outpoint_in), type(type_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_ADDRESS);
+        s << script_hash;
+        ser_writedata32be(s, height);
+        s << outpoint.hash << VARINT(outpoint.n);
+        ser_writedata8(s, type);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_ADDRESS) {
+            throw std::ios_base::failure("Invalid format for addressindex DB key");
+        }
+        s >> script_hash;
+        height = ser_readdata32be(s);
+        s >> outpoint.hash >> VARINT(outpoint.n);
+        type = ser_readdata8(s);
+    }
+};
+
+struct DBOutputVal {
+    CAmount amount;
+    CDiskTxPos tx_pos;
+
+    SERIALIZE_METHODS(DBOutputVal, obj) { READWRITE(Using<AmountCompression>(obj.amount), obj.tx_pos); }
+};
+
+struct DBSpendVal {
+    COutPoint spent_by;
+    uint32_t height;
+
+    SERIALIZE_METHODS(DBSpendVal, obj) { READWRITE(obj.spent_by.hash, VARINT(obj.spent_by.n), VARINT(obj.height)); }
+};
+
+uint256 ScriptHash(const CScript& script)
+{
+    uint256 hash;
+    CSHA256().Write(script.data(), script.size()).Finalize(hash.begin());
+    return hash;
+}
+
+} // namespace
+
+/** Access to the addressindex database (indexes/addressindex/) */
+class AddressIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+AddressIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe)
+{}
+
+struct AddressIndex::BlockEntries : public BaseIndex::BlockData {
+    std::vector<std::pair<DBAddressKey, DBOutputVal>> outputs;
+    std::vector<std::pair<DBAddressKey, DBSpendVal>> spends;
+};
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<AddressIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+AddressIndex::~AddressIndex() {}
+
+bool AddressIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData>& data) const
+{
+    auto entries = MakeUnique<BlockEntries>();
+
+    // Exclude genesis block transaction because outputs are not spendable.
+    if (pindex->nHeight > 0) {
+        CBlockUndo block_undo;
+        if (!UndoReadFromDisk(block_undo, pindex)) {
+            return false;
+        }
+
+        CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+        for (size_t i = 0; i < block.vtx.size(); ++i) {
+            const CTransaction& tx = *block.vtx[i];
+            for (uint32_t j = 0; j < tx.vout.size(); ++j) {
+                // Unspendable outputs are never added to the UTXO set.
+                if (tx.vout[j].scriptPubKey.IsUnspendable()) continue;
+
+                entries->outputs.emplace_back(
+                    DBAddressKey{ScriptHash(tx.vout[j].scriptPubKey), (uint32_t)pindex->nHeight, COutPoint{tx.GetHash(), j}, DB_ADDRESS_OUTPUT},
+                    DBOutputVal{tx.vout[j].nValue, pos});
+            }
+
+            pos.nTxOffset += ::GetSerializeSize(tx, CLIENT_VERSION);
+
+            // The coinbase transaction has no undo data since it spends nothing.
+            if (tx.IsCoinBase()) continue;
+            const CTxUndo& tx_undo = block_undo.vtxundo.at(i - 1);
+            for (uint32_t j = 0; j < tx_undo.vprevout.size(); ++j) {
+                const Coin& coin = tx_undo.vprevout[j];
+                entries->spends.emplace_back(
+                    DBAddressKey{ScriptHash(coin.out.scriptPubKey), coin.nHeight, tx.vin[j].prevout, DB_ADDRESS_SPEND},
+                    DBSpendVal{COutPoint{tx.GetHash(), j}, (uint32_t)pindex->nHeight});
+            }
+        }
+    }
+
+    data = std::move(entries);
+    return true;
+}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex, const BlockData* data, CDBBatch& batch)
+{
+    const BlockEntries& entries = static_cast<const BlockEntries&>(*data);
+    for (const auto& output : entries.outputs) {
+        batch.Write(output.first, output.second);
+    }
+    for (const auto& spend : entries.spends) {
+        batch.Write(spend.first, spend.second);
+    }
+    return true;
+}
+
+bool AddressIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // Erase the outputs the disconnected blocks created, and the spends of the outputs they spent.
+    CDBBatch batch(*m_db);
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk",
+                         __func__, pindex->GetBlockHash().ToString());
+        }
+        std::unique_ptr<BlockData> data;
+        if (!PrepareBlock(block, pindex, data)) {
+            return false;
+        }
+        const BlockEntries& entries = static_cast<const BlockEntries&>(*data);
+        for (const auto& output : entries.outputs) {
+            batch.Erase(output.first);
+        }
+        for (const auto& spend : entries.spends) {
+            batch.Erase(spend.first);
+        }
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& AddressIndex::GetDB() const { return *m_db; }
+
+bool AddressIndex::FindOutputs(const CScript& script, int start_height, const std::function<bool(const AddressOutput&)>& fn) const
+{
+    const uint256 script_hash{ScriptHash(script)};
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBAddressKey{script_hash, (uint32_t)std::max(start_height, 0), COutPoint{uint256{}, 0}, 0});
+
+    // An output is handed to fn once it is known whether its next entry is its spend.
+    std::optional<AddressOutput> output;
+    for (; db_it->Valid(); db_it->Next()) {
+        DBAddressKey key;
+        if (!db_it->GetKey(key) || key.script_hash != script_hash) break;
+
+        if (key.type == DB_ADDRESS_OUTPUT) {
+            if (output && !fn(*output)) return true;
+            DBOutputVal value;
+            if (!db_it->GetValue(value)) {
+                return error("%s: Cannot read output %s in %s", __func__, key.outpoint.ToString(), GetName());
+            }
+            output = AddressOutput{};
+            output->outpoint = key.outpoint;
+            output->height = key.height;
+            output->amount = value.amount;
+            output->tx_pos = value.tx_pos;
+        } else if (key.type == DB_ADDRESS_SPEND) {
+            DBSpendVal value;
+            if (!output || output->outpoint != key.outpoint || !db_it->GetValue(value)) {
+                return error("%s: Cannot read spend of output %s in %s", __func__, key.outpoint.ToString(), GetName());
+            }
+            output->spent_by = value.spent_by;
+            output->spent_height = value.height;
+        } else {
+            return error("%s: Unexpected entry type %d in %s", __func__, key.type, GetName());
+        }
+    }
+    if (output) fn(*output);
+    return true;
+}
+
+bool AddressIndex::ReadTx(const AddressOutput& output, CTransactionRef& tx) const
+{
+    // Read through the raw block, which also works once its block file is compressed.
+    FlatFileData block_data;
+    if (!ReadRawBlockFromDisk(block_data, output.tx_pos, Params().MessageStart())) {
+        return error("%s: ReadRawBlockFromDisk failed", __func__);
+    }
+    CBlockHeader header;
+    try {
+        const Span<const uint8_t> data{block_data.span()};
+        SpanReader{SER_DISK, CLIENT_VERSION, data} >> header;
+        const size_t tx_start{::GetSerializeSize(header, CLIENT_VERSION) + output.tx_pos.nTxOffset};
+        if (tx_start > data.size()) {
+            return error("%s: transaction offset past the end of the block", __func__);
+        }
+        SpanReader{SER_DISK, CLIENT_VERSION, data.subspan(tx_start)} >> tx;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    if (tx->GetHash() != output.outpoint.hash) {
+        return error("%s: txid mismatch", __func__);
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_ADDRESSINDEX_H
+#define BITCOIN_INDEX_ADDRESSINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+#include <index/disktxpos.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+
+#include <functional>
+
+/** An output paying to a script, and the input spending it if it is spent. */
+struct AddressOutput {
+    COutPoint outpoint;
+    //! Height of the block the output was created in
+    int height{0};
+    CAmount amount{0};
+    //! Location of the transaction creating the output
+    CDiskTxPos tx_pos;
+
+    //! The input spending the output: the spending transaction and the index of the input in it
+    COutPoint spent_by;
+    //! Height of the block the output was spent in, or -1 if it is unspent
+    int spent_height{-1};
+
+    bool IsSpent() const { return spent_height >= 0; }
+};
+
+/**
+ * AddressIndex is used to look up the outputs paying to a script, and the
+ * inputs spending them. The index is written to a LevelDB database, where the
+ * outputs are keyed by the hash of their scriptPubKey and ordered by height.
+ */
+class AddressIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+    /// The outputs a block creates and spends, see PrepareBlock.
+    struct BlockEntries;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData>& data) const override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, const BlockData* data, CDBBatch& batch) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~AddressIndex() override;
+
+    /// Call fn for each output paying to the script created at or above start_height, in order of
+    /// height, until it returns false. Returns false if the index could not be read.
+    bool FindOutputs(const CScript& script, int start_height, const std::function<bool(const AddressOutput&)>& fn) const;
+
+    /// Read the transaction that created an output.
+    bool ReadTx(const AddressOutput& output, CTransactionRef& tx) const;
+};
+
+/// The global address index. May be null.
+extern std::unique_ptr<AddressIndex> g_address_index;
+
+#endif // BITCOIN_INDEX_ADDRESSINDEX_H
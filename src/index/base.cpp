@@ -8,14 +8,20 @@
 #include <shutdown.h>
 #include <tinyformat.h>
 #include <util/system.h>
+#include <util/threadnames.h>
 #include <util/translation.h>
 #include <validation.h>
 #include <warnings.h>
 
+#include <condition_variable>
+#include <deque>
+
 constexpr char DB_BEST_BLOCK = 'B';
 
 constexpr int64_t SYNC_LOG_INTERVAL = 30; // seconds
 constexpr int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30; // seconds
+constexpr int SYNC_READ_AHEAD_PER_THREAD = 4; // blocks
+constexpr size_t SYNC_BATCH_SIZE = 16 << 20; // bytes of pending index entries
 
 template <typename... Args>
 static void FatalError(const char* fmt, const Args&... args)
@@ -45,6 +51,119 @@ void BaseIndex::DB::WriteBestBlock(CDBBatch& batch, const CBlockLocator& locator
     batch.Write(DB_BEST_BLOCK, locator);
 }
 
+static int GetIndexSyncThreads()
+{
+    int threads = gArgs.GetArg("-indexsyncthreads", DEFAULT_INDEX_SYNC_THREADS);
+    if (threads <= 0) threads = GetNumCores();
+    return std::max(1, std::min(threads, MAX_INDEX_SYNC_THREADS));
+}
+
+/**
+ * Reads the blocks the sync thread is about to index from disk and prepares
+ * them with PrepareBlock, on several threads. Blocks are added and taken in
+ * the order they are written to the index.
+ */
+class BaseIndex::ReadAhead
+{
+public:
+    struct Entry {
+        const CBlockIndex* pindex;
+        CBlock block;
+        std::unique_ptr<BlockData> data;
+        bool read{false};
+        bool prepared{false};
+    };
+
+private:
+    struct Slot {
+        Entry entry;
+        bool loading{false};
+        bool done{false};
+    };
+
+    const BaseIndex& m_index;
+    mutable Mutex m_mutex;
+    std::condition_variable m_cv;
+    //! Elements are only removed from the front once done, so references to the others stay valid
+    std::deque<Slot> m_slots GUARDED_BY(m_mutex);
+    bool m_request_stop GUARDED_BY(m_mutex){false};
+    std::vector<std::thread> m_threads;
+
+    void Loop()
+    {
+        const Consensus::Params& consensus_params = Params().GetConsensus();
+        WAIT_LOCK(m_mutex, lock);
+        while (!m_request_stop) {
+            auto it = std::find_if(m_slots.begin(), m_slots.end(), [](const Slot& slot) { return !slot.loading && !slot.done; });
+            if (it == m_slots.end()) {
+                m_cv.wait(lock);
+                continue;
+            }
+            Slot& slot = *it;
+            slot.loading = true;
+            {
+                REVERSE_LOCK(lock);
+                Entry& entry = slot.entry;
+                entry.read = ReadBlockFromDisk(entry.block, entry.pindex, consensus_params);
+                try {
+                    entry.prepared = entry.read && m_index.PrepareBlock(entry.block, entry.pindex, entry.data);
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Failed to prepare block %s: %s\n", __func__, entry.pindex->GetBlockHash().ToString(), e.what());
+                }
+            }
+            slot.loading = false;
+            slot.done = true;
+            m_cv.notify_all();
+        }
+    }
+
+public:
+    ReadAhead(const BaseIndex& index, int threads) : m_index(index)
+    {
+        for (int n = 0; n < threads; ++n) {
+            m_threads.emplace_back([this, n] {
+                util::ThreadRename(strprintf("%s.%i", m_index.GetName(), n));
+                Loop();
+            });
+        }
+    }
+
+    ~ReadAhead()
+    {
+        WITH_LOCK(m_mutex, m_request_stop = true);
+        m_cv.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    size_t Size() const
+    {
+        return WITH_LOCK(m_mutex, return m_slots.size());
+    }
+
+    /// Queue a block to be read and prepared after the ones already queued.
+    void Add(const CBlockIndex* pindex)
+    {
+        LOCK(m_mutex);
+        m_slots.emplace_back();
+        m_slots.back().entry.pindex = pindex;
+        m_cv.notify_all();
+    }
+
+    /// Take the first queued block, waiting until it is read and prepared.
+    Entry Take()
+    {
+        WAIT_LOCK(m_mutex, lock);
+        assert(!m_slots.empty());
+        const Slot& slot = m_slots.front();
+        m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return slot.done; });
+        Entry entry{std::move(m_slots.front().entry)};
+        m_slots.pop_front();
+        return entry;
+    }
+};
+
 BaseIndex::~BaseIndex()
 {
     Interrupt();
@@ -125,7 +244,12 @@ void BaseIndex::ThreadSync()
 {
     const CBlockIndex* pindex = m_best_block_index.load();
     if (!m_synced) {
-        auto& consensus_params = Params().GetConsensus();
+        const int threads = GetIndexSyncThreads();
+        ReadAhead read_ahead(*this, threads);
+        // The last block queued in the read-ahead, which runs ahead of pindex, the last block written.
+        const CBlockIndex* pindex_queued = pindex;
+        // Entries of the blocks written since the last commit.
+        CDBBatch batch(GetDB());
 
         int64_t last_log_time = 0;
         int64_t last_locator_write_time = 0;
@@ -135,28 +259,54 @@ void BaseIndex::ThreadSync()
                 // No need to handle errors in Commit. If it fails, the error will be already be
                 // logged. The best way to recover is to continue, as index cannot be corrupted by
                 // a missed commit to disk for an advanced index state.
-                Commit();
+                Commit(batch);
                 return;
             }
 
             {
                 LOCK(cs_main);
-                const CBlockIndex* pindex_next = NextSyncBlock(pindex);
-                if (!pindex_next) {
-                    m_best_block_index = pindex;
-                    m_synced = true;
-                    // No need to handle errors in Commit. See rationale above.
-                    Commit();
-                    break;
+                while (read_ahead.Size() < (size_t)(threads * SYNC_READ_AHEAD_PER_THREAD)) {
+                    const CBlockIndex* pindex_next = NextSyncBlock(pindex_queued);
+                    if (!pindex_next || pindex_next->pprev != pindex_queued) break;
+                    read_ahead.Add(pindex_next);
+                    pindex_queued = pindex_next;
                 }
-                if (pindex_next->pprev != pindex && !Rewind(pindex, pindex_next->pprev)) {
-                    FatalError("%s: Failed to rewind index %s to a previous chain tip",
-                               __func__, GetName());
-                    return;
+                if (read_ahead.Size() == 0) {
+                    const CBlockIndex* pindex_next = NextSyncBlock(pindex);
+                    // The written entries must not get lost once the locator moves past them, so a
+                    // failed commit is fatal from here on.
+                    m_best_block_index = pindex;
+                    if (!Commit(batch)) {
+                        FatalError("%s: Failed to commit latest %s state", __func__, GetName());
+                        return;
+                    }
+                    if (!pindex_next) {
+                        m_synced = true;
+                        break;
+                    }
+                    if (!Rewind(pindex, pindex_next->pprev)) {
+                        FatalError("%s: Failed to rewind index %s to a previous chain tip",
+                                   __func__, GetName());
+                        return;
+                    }
+                    pindex = pindex_queued = pindex_next->pprev;
+                    continue;
                 }
-                pindex = pindex_next;
             }
 
+            ReadAhead::Entry entry{read_ahead.Take()};
+            if (!entry.read) {
+                FatalError("%s: Failed to read block %s from disk",
+                           __func__, entry.pindex->GetBlockHash().ToString());
+                return;
+            }
+            if (!entry.prepared || !WriteBlock(entry.block, entry.pindex, entry.data.get(), batch)) {
+                FatalError("%s: Failed to write block %s to index database",
+                           __func__, entry.pindex->GetBlockHash().ToString());
+                return;
+            }
+            pindex = entry.pindex;
+
             int64_t current_time = GetTime();
             if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
                 LogPrintf("Syncing %s with block chain from height %d\n",
@@ -164,23 +314,14 @@ void BaseIndex::ThreadSync()
                 last_log_time = current_time;
             }
 
-            if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
+            if (batch.SizeEstimate() > SYNC_BATCH_SIZE ||
+                last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
                 m_best_block_index = pindex;
                 last_locator_write_time = current_time;
-                // No need to handle errors in Commit. See rationale above.
-                Commit();
-            }
-
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
-                FatalError("%s: Failed to read block %s from disk",
-                           __func__, pindex->GetBlockHash().ToString());
-                return;
-            }
-            if (!WriteBlock(block, pindex)) {
-                FatalError("%s: Failed to write block %s to index database",
-                           __func__, pindex->GetBlockHash().ToString());
-                return;
+                if (!Commit(batch)) {
+                    FatalError("%s: Failed to commit latest %s state", __func__, GetName());
+                    return;
+                }
             }
         }
     }
@@ -195,7 +336,14 @@ void BaseIndex::ThreadSync()
 bool BaseIndex::Commit()
 {
     CDBBatch batch(GetDB());
-    if (!CommitInternal(batch) || !GetDB().WriteBatch(batch)) {
+    return Commit(batch);
+}
+
+bool BaseIndex::Commit(CDBBatch& batch)
+{
+    const bool success = CommitInternal(batch) && GetDB().WriteBatch(batch);
+    batch.Clear();
+    if (!success) {
         return error("%s: Failed to commit latest %s state", __func__, GetName());
     }
     return true;
@@ -261,7 +409,10 @@ void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const
         }
     }
 
-    if (WriteBlock(*block, pindex)) {
+    std::unique_ptr<BlockData> data;
+    CDBBatch batch(GetDB());
+    if (PrepareBlock(*block, pindex, data) && WriteBlock(*block, pindex, data.get(), batch) &&
+        GetDB().WriteBatch(batch)) {
         m_best_block_index = pindex;
     } else {
         FatalError("%s: Failed to write block %s to index",
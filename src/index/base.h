@@ -13,6 +13,11 @@
 
 class CBlockIndex;
 
+/** Maximum number of threads reading and preparing blocks while an index syncs */
+static const int MAX_INDEX_SYNC_THREADS = 16;
+/** -indexsyncthreads default (number of threads reading and preparing blocks while an index syncs, 0 = auto) */
+static const int DEFAULT_INDEX_SYNC_THREADS = 0;
+
 struct IndexSummary {
     std::string name;
     bool synced{false};
@@ -23,6 +28,10 @@ struct IndexSummary {
  * Base class for indices of blockchain data. This implements
  * CValidationInterface and ensures blocks are indexed sequentially according
  * to their position in the active chain.
+ *
+ * While the index catches up with the chain, blocks are read and prepared
+ * (see PrepareBlock) on several threads ahead of being written, and the
+ * entries of many blocks are written in one batch together with the locator.
  */
 class BaseIndex : public CValidationInterface
 {
@@ -47,7 +56,14 @@ protected:
         void WriteBestBlock(CDBBatch& batch, const CBlockLocator& locator);
     };
 
+    /// Data an index derives from a single block, see PrepareBlock.
+    struct BlockData {
+        virtual ~BlockData() {}
+    };
+
 private:
+    class ReadAhead;
+
     /// Whether the index is in sync with the main chain. The flag is flipped
     /// from false to true once, after which point this starts processing
     /// ValidationInterface notifications to stay in sync.
@@ -76,6 +92,9 @@ private:
     /// getting corrupted.
     bool Commit();
 
+    /// Write the entries in the batch together with the current index state, and clear the batch.
+    bool Commit(CDBBatch& batch);
+
 protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex) override;
 
@@ -84,8 +103,15 @@ protected:
     /// Initialize internal state from the database and block index.
     virtual bool Init();
 
-    /// Write update index entries for a newly connected block.
-    virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
+    /// Derive the data of a block that WriteBlock needs, such as the positions of its transactions
+    /// or its filter. While the index syncs, this is called for many blocks at once on several
+    /// threads, ahead of WriteBlock, so it must not depend on the index state or earlier blocks.
+    virtual bool PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData>& data) const { return true; }
+
+    /// Add the index entries for a newly connected block to the batch, given the data PrepareBlock
+    /// derived from it. The entries of the preceding blocks may still be in the batch rather than
+    /// in the database.
+    virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, const BlockData* data, CDBBatch& batch) { return true; }
 
     /// Virtual method called internally by Commit that can be overridden to atomically
     /// commit more index state.
@@ -97,6 +123,9 @@ protected:
 
     virtual DB& GetDB() const = 0;
 
+    /// The last block in the chain that the index is in sync with.
+    const CBlockIndex* CurrentIndex() const { return m_best_block_index.load(); }
+
     /// Get the name of the index for display in logs.
     virtual const char* GetName() const = 0;
 
@@ -5,6 +5,7 @@
 #include <map>
 
 #include <dbwrapper.h>
+#include <hash.h>
 #include <index/blockfilterindex.h>
 #include <util/system.h>
 #include <validation.h>
@@ -141,7 +142,7 @@ bool BlockFilterIndex::CommitInternal(CDBBatch& batch)
     return BaseIndex::CommitInternal(batch);
 }
 
-bool BlockFilterIndex::ReadFilterFromDisk(const FlatFilePos& pos, BlockFilter& filter) const
+bool BlockFilterIndex::ReadFilterFromDisk(const FlatFilePos& pos, const uint256& hash, BlockFilter& filter) const
 {
     CAutoFile filein(m_filter_fileseq->Open(pos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull()) {
@@ -152,7 +153,12 @@ bool BlockFilterIndex::ReadFilterFromDisk(const FlatFilePos& pos, BlockFilter& f
     std::vector<unsigned char> encoded_filter;
     try {
         filein >> block_hash >> encoded_filter;
-        filter = BlockFilter(GetFilterType(), block_hash, std::move(encoded_filter));
+        // The hash in the index vouches for the encoding, which is cheaper to check than
+        // decoding the whole filter.
+        if (Hash(encoded_filter) != hash) {
+            return error("%s: Checksum mismatch in filter decode", __func__);
+        }
+        filter = BlockFilter(GetFilterType(), block_hash, std::move(encoded_filter), /* skip_decode_check */ true);
     }
     catch (const std::exception& e) {
         return error("%s: Failed to deserialize block filter from disk: %s", __func__, e.what());
@@ -207,31 +213,48 @@ size_t BlockFilterIndex::WriteFilterToDisk(FlatFilePos& pos, const BlockFilter&
     return data_size;
 }
 
-bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+struct BlockFilterIndex::BlockFilterData : public BaseIndex::BlockData {
+    BlockFilter filter;
+};
+
+bool BlockFilterIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData>& data) const
 {
     CBlockUndo block_undo;
-    uint256 prev_header;
+    if (pindex->nHeight > 0 && !UndoReadFromDisk(block_undo, pindex)) {
+        return false;
+    }
 
-    if (pindex->nHeight > 0) {
-        if (!UndoReadFromDisk(block_undo, pindex)) {
-            return false;
-        }
+    auto filter_data = MakeUnique<BlockFilterData>();
+    filter_data->filter = BlockFilter(m_filter_type, block, block_undo);
+    data = std::move(filter_data);
+    return true;
+}
 
-        std::pair<uint256, DBVal> read_out;
-        if (!m_db->Read(DBHeightKey(pindex->nHeight - 1), read_out)) {
-            return false;
-        }
+bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex, const BlockData* data, CDBBatch& batch)
+{
+    uint256 prev_header;
 
+    if (pindex->nHeight > 0) {
         uint256 expected_block_hash = pindex->pprev->GetBlockHash();
-        if (read_out.first != expected_block_hash) {
-            return error("%s: previous block header belongs to unexpected block %s; expected %s",
-                         __func__, read_out.first.ToString(), expected_block_hash.ToString());
+        if (m_last_header.first == expected_block_hash) {
+            // The entry of the previous block may still be in the batch.
+            prev_header = m_last_header.second;
+        } else {
+            std::pair<uint256, DBVal> read_out;
+            if (!m_db->Read(DBHeightKey(pindex->nHeight - 1), read_out)) {
+                return false;
+            }
+
+            if (read_out.first != expected_block_hash) {
+                return error("%s: previous block header belongs to unexpected block %s; expected %s",
+                             __func__, read_out.first.ToString(), expected_block_hash.ToString());
+            }
+
+            prev_header = read_out.second.header;
         }
-
-        prev_header = read_out.second.header;
     }
 
-    BlockFilter filter(m_filter_type, block, block_undo);
+    const BlockFilter& filter = static_cast<const BlockFilterData&>(*data).filter;
 
     size_t bytes_written = WriteFilterToDisk(m_next_filter_pos, filter);
     if (bytes_written == 0) return false;
@@ -242,11 +265,10 @@ bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex
     value.second.header = filter.ComputeHeader(prev_header);
     value.second.pos = m_next_filter_pos;
 
-    if (!m_db->Write(DBHeightKey(pindex->nHeight), value)) {
-        return false;
-    }
+    batch.Write(DBHeightKey(pindex->nHeight), value);
 
     m_next_filter_pos.nPos += bytes_written;
+    m_last_header = {value.first, value.second.header};
     return true;
 }
 
@@ -379,7 +401,7 @@ bool BlockFilterIndex::LookupFilter(const CBlockIndex* block_index, BlockFilter&
         return false;
     }
 
-    return ReadFilterFromDisk(entry.pos, filter_out);
+    return ReadFilterFromDisk(entry.pos, entry.hash, filter_out);
 }
 
 bool BlockFilterIndex::LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out)
@@ -423,7 +445,7 @@ bool BlockFilterIndex::LookupFilterRange(int start_height, const CBlockIndex* st
     filters_out.resize(entries.size());
     auto filter_pos_it = filters_out.begin();
     for (const auto& entry : entries) {
-        if (!ReadFilterFromDisk(entry.pos, *filter_pos_it)) {
+        if (!ReadFilterFromDisk(entry.pos, entry.hash, *filter_pos_it)) {
             return false;
         }
         ++filter_pos_it;
@@ -449,6 +471,28 @@ bool BlockFilterIndex::LookupFilterHashRange(int start_height, const CBlockIndex
     return true;
 }
 
+bool BlockFilterIndex::MatchAnyRange(int start_height, const CBlockIndex* stop_index,
+                                     const GCSFilter::ElementSet& elements, std::vector<int>& heights_out) const
+{
+    std::vector<DBVal> entries;
+    if (!LookupRange(*m_db, m_name, start_height, stop_index, entries)) {
+        return false;
+    }
+
+    heights_out.clear();
+    BlockFilter filter;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (!ReadFilterFromDisk(entries[i].pos, entries[i].hash, filter)) {
+            return false;
+        }
+        if (filter.GetFilter().MatchAny(elements)) {
+            heights_out.push_back(start_height + static_cast<int>(i));
+        }
+    }
+
+    return true;
+}
+
 BlockFilterIndex* GetBlockFilterIndex(BlockFilterType filter_type)
 {
     auto it = g_filter_indexes.find(filter_type);
@@ -31,7 +31,10 @@ private:
     FlatFilePos m_next_filter_pos;
     std::unique_ptr<FlatFileSeq> m_filter_fileseq;
 
-    bool ReadFilterFromDisk(const FlatFilePos& pos, BlockFilter& filter) const;
+    /** Block hash and filter header of the last block written, whose entry may not be in the database yet. */
+    std::pair<uint256, uint256> m_last_header;
+
+    bool ReadFilterFromDisk(const FlatFilePos& pos, const uint256& hash, BlockFilter& filter) const;
     size_t WriteFilterToDisk(FlatFilePos& pos, const BlockFilter& filter);
 
     Mutex m_cs_headers_cache;
@@ -39,11 +42,16 @@ private:
     std::unordered_map<uint256, uint256, FilterHeaderHasher> m_headers_cache GUARDED_BY(m_cs_headers_cache);
 
 protected:
+    /** The filter of a block, see PrepareBlock. */
+    struct BlockFilterData;
+
     bool Init() override;
 
     bool CommitInternal(CDBBatch& batch) override;
 
-    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+    bool PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData>& data) const override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, const BlockData* data, CDBBatch& batch) override;
 
     bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
 
@@ -71,6 +79,14 @@ public:
     /** Get a range of filter hashes between two heights on a chain. */
     bool LookupFilterHashRange(int start_height, const CBlockIndex* stop_index,
                                std::vector<uint256>& hashes_out) const;
+
+    /**
+     * Match a set of elements against a range of filters between two heights on a chain, one
+     * filter at a time. The heights of the blocks whose filters may contain any of the elements
+     * are returned in ascending order in heights_out.
+     */
+    bool MatchAnyRange(int start_height, const CBlockIndex* stop_index,
+                       const GCSFilter::ElementSet& elements, std::vector<int>& heights_out) const;
 };
 
 /**
@@ -0,0 +1,368 @@
+// Copyright (c) 2020-2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <coins.h>
+#include <index/coinstatsindex.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* The index database stores the UTXO set statistics as of each block. Those belonging to blocks on
+ * the active chain are indexed by height, and those belonging to blocks that have been reorganized
+ * out of the active chain are indexed by block hash, like in the block filter index.
+ *
+ * The MuHash3072 state of the UTXO set as of the best block of the index is stored under the
+ * DB_MUHASH key, so the index can continue from there after a restart.
+ *
+ * Keys for the height index have the type [DB_BLOCK_HEIGHT, uint32 (BE)].
+ * Keys for the hash index have the type [DB_BLOCK_HASH, uint256].
+ */
+constexpr char DB_BLOCK_HASH = 's';
+constexpr char DB_BLOCK_HEIGHT = 't';
+constexpr char DB_MUHASH = 'M';
+
+namespace {
+
+struct DBVal {
+    uint256 muhash;
+    uint64_t transaction_output_count;
+    uint64_t bogo_size;
+    CAmount total_amount;
+
+    SERIALIZE_METHODS(DBVal, obj) { READWRITE(obj.muhash, obj.transaction_output_count, obj.bogo_size, obj.total_amount); }
+};
+
+struct DBHeightKey {
+    int height;
+
+    explicit DBHeightKey(int height_in) : height(height_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_BLOCK_HEIGHT);
+        ser_writedata32be(s, height);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_BLOCK_HEIGHT) {
+            throw std::ios_base::failure("Invalid format for coinstatsindex DB height key");
+        }
+        height = ser_readdata32be(s);
+    }
+};
+
+struct DBHashKey {
+    uint256 block_hash;
+
+    explicit DBHashKey(const uint256& hash_in) : block_hash(hash_in) {}
+
+    SERIALIZE_METHODS(DBHashKey, obj) {
+        char prefix = DB_BLOCK_HASH;
+        READWRITE(prefix);
+        if (prefix != DB_BLOCK_HASH) {
+            throw std::ios_base::failure("Invalid format for coinstatsindex DB hash key");
+        }
+
+        READWRITE(obj.block_hash);
+    }
+};
+
+}; // namespace
+
+std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+CoinStatsIndex::CoinStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+{
+    fs::path path = GetDataDir() / "indexes" / "coinstats";
+    fs::create_directories(path);
+
+    m_name = "coinstatsindex";
+    m_db = MakeUnique<BaseIndex::DB>(path / "db", n_cache_size, f_memory, f_wipe);
+}
+
+struct CoinStatsIndex::BlockStats : public BaseIndex::BlockData {
+    //! MuHash of the outputs the block adds, divided by those it spends
+    MuHash3072 muhash;
+    int64_t transaction_output_count{0};
+    int64_t bogo_size{0};
+    CAmount total_amount{0};
+};
+
+bool CoinStatsIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData>& data) const
+{
+    auto stats = MakeUnique<BlockStats>();
+
+    // The outputs of the genesis block are not part of the UTXO set.
+    if (pindex->nHeight > 0) {
+        CBlockUndo block_undo;
+        if (!UndoReadFromDisk(block_undo, pindex)) {
+            return false;
+        }
+
+        // The coinbase outputs of these blocks are overwritten by later ones,
+        // so only those later outputs end up in the UTXO set.
+        const bool skip_coinbase = IsBIP30Unspendable(*pindex);
+
+        for (size_t i = 0; i < block.vtx.size(); ++i) {
+            const CTransaction& tx = *block.vtx[i];
+            if (!(skip_coinbase && tx.IsCoinBase())) {
+                for (uint32_t j = 0; j < tx.vout.size(); ++j) {
+                    // Unspendable outputs are never added to the UTXO set.
+                    if (tx.vout[j].scriptPubKey.IsUnspendable()) continue;
+
+                    const Coin coin{tx.vout[j], pindex->nHeight, tx.IsCoinBase()};
+                    stats->muhash.Insert(MakeUCharSpan(TxOutSer(COutPoint(tx.GetHash(), j), coin)));
+                    ++stats->transaction_output_count;
+                    stats->total_amount += coin.out.nValue;
+                    stats->bogo_size += GetBogoSize(coin.out.scriptPubKey);
+                }
+            }
+
+            // The coinbase transaction has no undo data since it spends nothing.
+            if (tx.IsCoinBase()) continue;
+            const CTxUndo& tx_undo = block_undo.vtxundo.at(i - 1);
+            for (size_t j = 0; j < tx_undo.vprevout.size(); ++j) {
+                const Coin& coin = tx_undo.vprevout[j];
+                stats->muhash.Remove(MakeUCharSpan(TxOutSer(tx.vin[j].prevout, coin)));
+                --stats->transaction_output_count;
+                stats->total_amount -= coin.out.nValue;
+                stats->bogo_size -= GetBogoSize(coin.out.scriptPubKey);
+            }
+        }
+    }
+
+    data = std::move(stats);
+    return true;
+}
+
+bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex, const BlockData* data, CDBBatch& batch)
+{
+    if (pindex->nHeight > 0) {
+        uint256 expected_block_hash = pindex->pprev->GetBlockHash();
+        // The entry of the previous block may still be in the batch.
+        if (m_last_block_hash != expected_block_hash) {
+            std::pair<uint256, DBVal> read_out;
+            if (!m_db->Read(DBHeightKey(pindex->nHeight - 1), read_out)) {
+                return false;
+            }
+
+            if (read_out.first != expected_block_hash) {
+                return error("%s: previous block header belongs to unexpected block %s; expected %s",
+                             __func__, read_out.first.ToString(), expected_block_hash.ToString());
+            }
+        }
+    }
+
+    const BlockStats& stats = static_cast<const BlockStats&>(*data);
+    m_muhash *= stats.muhash;
+    m_transaction_output_count += stats.transaction_output_count;
+    m_bogo_size += stats.bogo_size;
+    m_total_amount += stats.total_amount;
+
+    std::pair<uint256, DBVal> value;
+    value.first = pindex->GetBlockHash();
+    m_muhash.Finalize(value.second.muhash);
+    value.second.transaction_output_count = m_transaction_output_count;
+    value.second.bogo_size = m_bogo_size;
+    value.second.total_amount = m_total_amount;
+
+    batch.Write(DBHeightKey(pindex->nHeight), value);
+    m_last_block_hash = value.first;
+    return true;
+}
+
+static bool CopyHeightIndexToHashIndex(CDBIterator& db_it, CDBBatch& batch,
+                                       const std::string& index_name,
+                                       int start_height, int stop_height)
+{
+    DBHeightKey key(start_height);
+    db_it.Seek(key);
+
+    for (int height = start_height; height <= stop_height; ++height) {
+        if (!db_it.GetKey(key) || key.height != height) {
+            return error("%s: unexpected key in %s: expected (%c, %d)",
+                         __func__, index_name, DB_BLOCK_HEIGHT, height);
+        }
+
+        std::pair<uint256, DBVal> value;
+        if (!db_it.GetValue(value)) {
+            return error("%s: unable to read value in %s at key (%c, %d)",
+                         __func__, index_name, DB_BLOCK_HEIGHT, height);
+        }
+
+        batch.Write(DBHashKey(value.first), std::move(value.second));
+
+        db_it.Next();
+    }
+    return true;
+}
+
+bool CoinStatsIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    CDBBatch batch(*m_db);
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+
+    // During a reorg, we need to copy the statistics of all blocks that are getting disconnected
+    // from the height index to the hash index so we can still find them when the height index
+    // entries are overwritten.
+    if (!CopyHeightIndexToHashIndex(*db_it, batch, m_name, new_tip->nHeight, current_tip->nHeight)) {
+        return false;
+    }
+
+    if (!m_db->WriteBatch(batch)) return false;
+
+    // Undo the disconnected blocks, most recent first. The resulting MuHash
+    // state gets written in Commit by the call to BaseIndex::Rewind.
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk",
+                         __func__, pindex->GetBlockHash().ToString());
+        }
+        if (!ReverseBlock(block, pindex)) {
+            return false;
+        }
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+static bool LookUpOne(const CDBWrapper& db, const CBlockIndex* block_index, DBVal& result)
+{
+    // First check if the result is stored under the height index and the value there matches the
+    // block hash. This should be the case if the block is on the active chain.
+    std::pair<uint256, DBVal> read_out;
+    if (!db.Read(DBHeightKey(block_index->nHeight), read_out)) {
+        return false;
+    }
+    if (read_out.first == block_index->GetBlockHash()) {
+        result = std::move(read_out.second);
+        return true;
+    }
+
+    // If value at the height index corresponds to an different block, the result will be stored in
+    // the hash index.
+    return db.Read(DBHashKey(block_index->GetBlockHash()), result);
+}
+
+bool CoinStatsIndex::LookUpStats(const CBlockIndex* block_index, CCoinsStats& coins_stats) const
+{
+    DBVal entry;
+    if (!LookUpOne(*m_db, block_index, entry)) {
+        return false;
+    }
+
+    coins_stats.hashSerialized = entry.muhash;
+    coins_stats.nTransactionOutputs = entry.transaction_output_count;
+    coins_stats.nBogoSize = entry.bogo_size;
+    coins_stats.nTotalAmount = entry.total_amount;
+    return true;
+}
+
+bool CoinStatsIndex::Init()
+{
+    if (!m_db->Read(DB_MUHASH, m_muhash)) {
+        // Check that the cause of the read failure is that the key does not exist. Any other errors
+        // indicate database corruption or a disk failure, and starting the index would cause
+        // further corruption.
+        if (m_db->Exists(DB_MUHASH)) {
+            return error("%s: Cannot read current %s state; index may be corrupted",
+                         __func__, GetName());
+        }
+    }
+
+    if (!BaseIndex::Init()) return false;
+
+    // Continue the running totals from the best block of the index.
+    const CBlockIndex* pindex = CurrentIndex();
+    if (pindex) {
+        DBVal entry;
+        if (!LookUpOne(*m_db, pindex, entry)) {
+            return error("%s: Cannot read current %s state; index may be corrupted",
+                         __func__, GetName());
+        }
+
+        uint256 muhash;
+        m_muhash.Finalize(muhash);
+        if (entry.muhash != muhash) {
+            return error("%s: Cannot read current %s state; MuHash does not match block %s",
+                         __func__, GetName(), pindex->GetBlockHash().ToString());
+        }
+
+        m_transaction_output_count = entry.transaction_output_count;
+        m_bogo_size = entry.bogo_size;
+        m_total_amount = entry.total_amount;
+    }
+
+    return true;
+}
+
+bool CoinStatsIndex::CommitInternal(CDBBatch& batch)
+{
+    // The MuHash state and the best block locator are written atomically, so
+    // they always describe the same block.
+    batch.Write(DB_MUHASH, m_muhash);
+    return BaseIndex::CommitInternal(batch);
+}
+
+bool CoinStatsIndex::ReverseBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The genesis block is never disconnected.
+    assert(pindex->nHeight > 0);
+
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return false;
+    }
+
+    const bool skip_coinbase = IsBIP30Unspendable(*pindex);
+
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+        if (!(skip_coinbase && tx.IsCoinBase())) {
+            for (uint32_t j = 0; j < tx.vout.size(); ++j) {
+                if (tx.vout[j].scriptPubKey.IsUnspendable()) continue;
+
+                const Coin coin{tx.vout[j], pindex->nHeight, tx.IsCoinBase()};
+                m_muhash.Remove(MakeUCharSpan(TxOutSer(COutPoint(tx.GetHash(), j), coin)));
+                --m_transaction_output_count;
+                m_total_amount -= coin.out.nValue;
+                m_bogo_size -= GetBogoSize(coin.out.scriptPubKey);
+            }
+        }
+
+        if (tx.IsCoinBase()) continue;
+        const CTxUndo& tx_undo = block_undo.vtxundo.at(i - 1);
+        for (size_t j = 0; j < tx_undo.vprevout.size(); ++j) {
+            const Coin& coin = tx_undo.vprevout[j];
+            m_muhash.Insert(MakeUCharSpan(TxOutSer(tx.vin[j].prevout, coin)));
+            ++m_transaction_output_count;
+            m_total_amount += coin.out.nValue;
+            m_bogo_size += GetBogoSize(coin.out.scriptPubKey);
+        }
+    }
+
+    // Check that the statistics are back to those of the previous block.
+    DBVal read_out;
+    if (!LookUpOne(*m_db, pindex->pprev, read_out)) {
+        return false;
+    }
+
+    uint256 muhash;
+    m_muhash.Finalize(muhash);
+    if (read_out.muhash != muhash || read_out.transaction_output_count != m_transaction_output_count ||
+        read_out.bogo_size != m_bogo_size || read_out.total_amount != m_total_amount) {
+        return error("%s: statistics after reverting block %s do not match those of block %s",
+                     __func__, pindex->GetBlockHash().ToString(), pindex->pprev->GetBlockHash().ToString());
+    }
+
+    return true;
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2020-2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_COINSTATSINDEX_H
+#define BITCOIN_INDEX_COINSTATSINDEX_H
+
+#include <chain.h>
+#include <crypto/muhash.h>
+#include <index/base.h>
+#include <node/coinstats.h>
+
+/**
+ * CoinStatsIndex maintains statistics on the UTXO set, and a MuHash of it, for
+ * every block. The statistics are updated incrementally from each connected
+ * block and its undo data, so gettxoutsetinfo can look them up instead of
+ * walking the whole chainstate.
+ */
+class CoinStatsIndex final : public BaseIndex
+{
+private:
+    std::string m_name;
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+    MuHash3072 m_muhash;
+    uint64_t m_transaction_output_count{0};
+    uint64_t m_bogo_size{0};
+    CAmount m_total_amount{0};
+
+    /// Hash of the last block written, whose entry may not be in the database yet.
+    uint256 m_last_block_hash;
+
+    /// Undo the changes a block made to the statistics, when it is disconnected.
+    bool ReverseBlock(const CBlock& block, const CBlockIndex* pindex);
+
+protected:
+    /// The changes a block makes to the statistics, see PrepareBlock.
+    struct BlockStats;
+
+    bool Init() override;
+
+    bool CommitInternal(CDBBatch& batch) override;
+
+    bool PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData>& data) const override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, const BlockData* data, CDBBatch& batch) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "coinstatsindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit CoinStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Look up the statistics of the UTXO set as of the given block.
+    /// Only the MuHash (in hashSerialized), nTransactionOutputs, nBogoSize and
+    /// nTotalAmount of coins_stats are set.
+    bool LookUpStats(const CBlockIndex* block_index, CCoinsStats& coins_stats) const;
+};
+
+/// The global UTXO set statistics index. May be null.
+extern std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+#endif // BITCOIN_INDEX_COINSTATSINDEX_H
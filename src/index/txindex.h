@@ -19,6 +19,9 @@ class TxIndex final : public BaseIndex
 protected:
     class DB;
 
+    /// The positions of the transactions of a block, see PrepareBlock.
+    struct BlockTxs;
+
 private:
     const std::unique_ptr<DB> m_db;
 
@@ -26,7 +29,9 @@ protected:
     /// Override base class init to migrate from old database.
     bool Init() override;
 
-    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+    bool PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData>& data) const override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, const BlockData* data, CDBBatch& batch) override;
 
     BaseIndex::DB& GetDB() const override;
 
@@ -0,0 +1,126 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <index/txospenderindex.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* The index database has an entry for every output spent in the active chain.
+ *
+ * Keys have the type [DB_TXOSPENDER, uint256, VARINT(uint32)]: the outpoint.
+ * Values have the type [uint256, VARINT(uint32), VARINT(uint32), uint256]: the
+ * spending txid, input index, height and block hash.
+ */
+constexpr char DB_TXOSPENDER = 's';
+
+std::unique_ptr<TxoSpenderIndex> g_txospender_index;
+
+namespace {
+
+struct DBOutPointKey {
+    COutPoint outpoint;
+
+    explicit DBOutPointKey(const COutPoint& outpoint_in) : outpoint(outpoint_in) {}
+
+    SERIALIZE_METHODS(DBOutPointKey, obj) {
+        char prefix = DB_TXOSPENDER;
+        READWRITE(prefix);
+        if (prefix != DB_TXOSPENDER) {
+            throw std::ios_base::failure("Invalid format for txospenderindex DB key");
+        }
+
+        READWRITE(obj.outpoint.hash, VARINT(obj.outpoint.n));
+    }
+};
+
+struct DBVal {
+    COutPoint input;
+    uint32_t height;
+    uint256 block_hash;
+
+    SERIALIZE_METHODS(DBVal, obj) { READWRITE(obj.input.hash, VARINT(obj.input.n), VARINT(obj.height), obj.block_hash); }
+};
+
+} // namespace
+
+/** Access to the txospenderindex database (indexes/txospenderindex/) */
+class TxoSpenderIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+TxoSpenderIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "txospenderindex", n_cache_size, f_memory, f_wipe)
+{}
+
+struct TxoSpenderIndex::BlockSpends : public BaseIndex::BlockData {
+    std::vector<std::pair<DBOutPointKey, DBVal>> spends;
+};
+
+TxoSpenderIndex::TxoSpenderIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<TxoSpenderIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+TxoSpenderIndex::~TxoSpenderIndex() {}
+
+bool TxoSpenderIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData>& data) const
+{
+    auto spends = MakeUnique<BlockSpends>();
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase()) continue;
+        for (uint32_t i = 0; i < tx->vin.size(); ++i) {
+            spends->spends.emplace_back(DBOutPointKey{tx->vin[i].prevout}, DBVal{COutPoint{tx->GetHash(), i}, (uint32_t)pindex->nHeight, pindex->GetBlockHash()});
+        }
+    }
+    data = std::move(spends);
+    return true;
+}
+
+bool TxoSpenderIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex, const BlockData* data, CDBBatch& batch)
+{
+    for (const auto& spend : static_cast<const BlockSpends&>(*data).spends) {
+        batch.Write(spend.first, spend.second);
+    }
+    return true;
+}
+
+bool TxoSpenderIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // Erase the spends of the disconnected blocks.
+    CDBBatch batch(*m_db);
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk",
+                         __func__, pindex->GetBlockHash().ToString());
+        }
+        for (const auto& tx : block.vtx) {
+            if (tx->IsCoinBase()) continue;
+            for (const CTxIn& txin : tx->vin) {
+                batch.Erase(DBOutPointKey{txin.prevout});
+            }
+        }
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& TxoSpenderIndex::GetDB() const { return *m_db; }
+
+bool TxoSpenderIndex::FindSpender(const COutPoint& outpoint, TxoSpender& spender) const
+{
+    DBVal value;
+    if (!m_db->Read(DBOutPointKey{outpoint}, value)) {
+        return false;
+    }
+    spender.input = value.input;
+    spender.height = value.height;
+    spender.block_hash = value.block_hash;
+    return true;
+}
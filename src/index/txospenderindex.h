@@ -0,0 +1,64 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_TXOSPENDERINDEX_H
+#define BITCOIN_INDEX_TXOSPENDERINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+#include <primitives/transaction.h>
+
+/** The input spending an output, as found in the spent output index. */
+struct TxoSpender {
+    //! The spending transaction and the index of the input in it
+    COutPoint input;
+    //! Height of the block the output was spent in
+    int height{0};
+    //! Hash of the block the output was spent in
+    uint256 block_hash;
+};
+
+/**
+ * TxoSpenderIndex is used to look up the input spending an output in the
+ * active chain. The index is written to a LevelDB database and records the
+ * spending transaction, input and block height by outpoint.
+ */
+class TxoSpenderIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+    /// The outputs a block spends, see PrepareBlock.
+    struct BlockSpends;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<BlockData>& data) const override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, const BlockData* data, CDBBatch& batch) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "txospenderindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit TxoSpenderIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~TxoSpenderIndex() override;
+
+    /// Look up the input spending an output. Returns false if the output is not spent in the
+    /// chain the index is synced to.
+    bool FindSpender(const COutPoint& outpoint, TxoSpender& spender) const;
+};
+
+/// The global spent output index. May be null.
+extern std::unique_ptr<TxoSpenderIndex> g_txospender_index;
+
+#endif // BITCOIN_INDEX_TXOSPENDERINDEX_H
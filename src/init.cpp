@@ -17,12 +17,16 @@
 #include <chainparams.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <dbwrapper.h>
 #include <fs.h>
 #include <hash.h>
 #include <httprpc.h>
 #include <httpserver.h>
+#include <index/addressindex.h>
 #include <index/blockfilterindex.h>
+#include <index/coinstatsindex.h>
 #include <index/txindex.h>
+#include <index/txospenderindex.h>
 #include <interfaces/chain.h>
 #include <interfaces/node.h>
 #include <key.h>
@@ -32,6 +36,7 @@
 #include <net_permissions.h>
 #include <net_processing.h>
 #include <netbase.h>
+#include <node/coinstats.h>
 #include <node/context.h>
 #include <node/ui_interface.h>
 #include <policy/feerate.h>
@@ -171,6 +176,15 @@ void Interrupt(NodeContext& node)
         g_txindex->Interrupt();
     }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Interrupt(); });
+    if (g_coin_stats_index) {
+        g_coin_stats_index->Interrupt();
+    }
+    if (g_address_index) {
+        g_address_index->Interrupt();
+    }
+    if (g_txospender_index) {
+        g_txospender_index->Interrupt();
+    }
 }
 
 void Shutdown(NodeContext& node)
@@ -222,6 +236,9 @@ void Shutdown(NodeContext& node)
     if (node.scheduler) node.scheduler->stop();
     if (g_load_block.joinable()) g_load_block.join();
     StopScriptCheckWorkerThreads();
+    StopCoinsPrefetchWorkerThreads();
+    StopBlockReadAheadThread();
+    StopBlockFileCompressionThread();
 
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
@@ -239,6 +256,7 @@ void Shutdown(NodeContext& node)
     // FlushStateToDisk generates a ChainStateFlushed callback, which we should avoid missing
     if (node.chainman) {
         LOCK(cs_main);
+        node.chainman->ResetAssumedValidBlockIndex();
         for (CChainState* chainstate : node.chainman->GetAll()) {
             if (chainstate->CanFlushToDisk()) {
                 chainstate->ForceFlushStateToDisk();
@@ -257,6 +275,18 @@ void Shutdown(NodeContext& node)
     }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
     DestroyAllBlockFilterIndexes();
+    if (g_coin_stats_index) {
+        g_coin_stats_index->Stop();
+        g_coin_stats_index.reset();
+    }
+    if (g_address_index) {
+        g_address_index->Stop();
+        g_address_index.reset();
+    }
+    if (g_txospender_index) {
+        g_txospender_index->Stop();
+        g_txospender_index.reset();
+    }
 
     // Any future callbacks will be dropped. This should absolutely be safe - if
     // missing a callback results in an unrecoverable situation, unclean shutdown
@@ -272,6 +302,9 @@ void Shutdown(NodeContext& node)
                 chainstate->ResetCoinsViews();
             }
         }
+        if (pblocktree && node.args->GetBoolArg("-blockindeximage", DEFAULT_BLOCK_INDEX_IMAGE)) {
+            node.chainman->m_blockman.WriteBlockIndexImage(*pblocktree);
+        }
         pblocktree.reset();
     }
     for (const auto& client : node.chain_clients) {
@@ -386,6 +419,7 @@ void SetupServerArgs(NodeContext& node)
     argsman.AddArg("-alertnotify=<cmd>", "Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
     argsman.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex(), signetChainParams->GetConsensus().defaultAssumeValid.GetHex()), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-blockindeximage", strprintf("Write an image of the block index at shutdown and load it instead of the block index database at the next start (default: %u)", DEFAULT_BLOCK_INDEX_IMAGE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-blocksdir=<dir>", "Specify directory to hold blocks subdirectory for *.dat files (default: <datadir>)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-fastprune", "Use smaller block files and lower minimum prune height for testing purposes", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
 #if HAVE_SYSTEM
@@ -393,9 +427,15 @@ void SetupServerArgs(NodeContext& node)
 #endif
     argsman.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-blocksonly", strprintf("Whether to reject transactions from network peers. Automatic broadcast and rebroadcast of any transactions from inbound peers is disabled, unless the peer has the 'forcerelay' permission. RPC transactions are not affected. (default: %u)", DEFAULT_BLOCKSONLY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-compressblocks", strprintf("Compress block files in the background once no more blocks are written to them. Blocks are decompressed when they are read, which is slower (default: %u)", DEFAULT_COMPRESS_BLOCKS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-conf=<file>", strprintf("Specify path to read-only configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-datadir=<dir>", "Specify data directory", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-dbbackend=<name>", strprintf("Storage backend of the databases: leveldb keeps each database in one LevelDB database, partitioned keeps the chainstate coins in a separately cached and compacted one. A database must be read with the backend it was written with (default: %s)", DEFAULT_DB_BACKEND), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-dbbulkload", strprintf("When the chainstate and block index are built from scratch, give their LevelDB write buffers most of the database cache, and compact the chainstate once the initial block download is over (default: %u)", DEFAULT_DB_BULK_LOAD), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-dbbackgroundflush", strprintf("Write the chainstate to disk in a background thread while validation continues (default: %u)", DEFAULT_DB_BACKGROUND_FLUSH), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-coinsprefetchthreads=<n>", strprintf("Set the number of threads used to load block inputs from the chainstate database before connecting a block (0 to %d, 0 = disable, default: %d)", MAX_COINS_PREFETCH_THREADS, DEFAULT_COINS_PREFETCH_THREADS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-blockreadahead=<n>", strprintf("Set the number of blocks read from disk and checked in the background before they are connected (0 to %d, 0 = disable, default: %d)", MAX_BLOCK_READ_AHEAD, DEFAULT_BLOCK_READ_AHEAD), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
@@ -414,6 +454,9 @@ void SetupServerArgs(NodeContext& node)
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks. When in pruning mode or if blocks on disk might be corrupted, use full -reindex instead.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-indexsyncthreads=<n>", strprintf("Set the number of threads reading and preparing blocks while an index catches up with the chain (0 to %d, 0 = auto, default: %d)", MAX_INDEX_SYNC_THREADS, DEFAULT_INDEX_SYNC_THREADS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-reindexthreads=<n>", strprintf("Set the number of threads scanning block files during -reindex (0 to %d, 0 = auto, default: %d)", MAX_REINDEX_THREADS, DEFAULT_REINDEX_THREADS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-utxoscanthreads=<n>", strprintf("Set the number of threads scanning the UTXO set in gettxoutsetinfo and scantxoutset (0 to %d, 0 = auto, default: %d)", MAX_UTXO_SCAN_THREADS, DEFAULT_UTXO_SCAN_THREADS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-settings=<file>", strprintf("Specify path to dynamic settings data file. Can be disabled with -nosettings. File is written at runtime and not meant to be edited by users (use %s instead for custom settings). Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME, BITCOIN_SETTINGS_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #if HAVE_SYSTEM
     argsman.AddArg("-startupnotify=<cmd>", "Execute command on startup.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -428,6 +471,9 @@ void SetupServerArgs(NodeContext& node)
                  strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
                  " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled.",
                  ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-coinstatsindex", strprintf("Maintain coinstats index used by the gettxoutsetinfo RPC (default: %u)", DEFAULT_COINSTATSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-addressindex", strprintf("Maintain an index of outputs and their spends by scriptPubKey, used by the getaddressoutputs rpc call and the /rest/addressoutputs endpoint (default: %u)", DEFAULT_ADDRESSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-txospenderindex", strprintf("Maintain an index of the inputs spending outputs of the chain, used by the gettxspendingprevout rpc call (default: %u)", DEFAULT_TXOSPENDERINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 
     argsman.AddArg("-addnode=<ip>", "Add a node to connect to and attempt to keep the connection open (see the `addnode` RPC command help for more info). This option can be specified multiple times to add multiple nodes.", ArgsManager::ALLOW_ANY | ArgsManager::NETWORK_ONLY, OptionsCategory::CONNECTION);
     argsman.AddArg("-asmap=<file>", strprintf("Specify asn mapping used for bucketing of the peers (default: %s). Relative paths will be prefixed by the net-specific datadir location.", DEFAULT_ASMAP_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
@@ -700,21 +746,13 @@ static void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImp
 
     // -reindex
     if (fReindex) {
-        int nFile = 0;
-        while (true) {
-            FlatFilePos pos(nFile, 0);
-            if (!fs::exists(GetBlockPosFilename(pos)))
-                break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            ::ChainstateActive().LoadExternalBlockFile(chainparams, file, &pos);
-            if (ShutdownRequested()) {
-                LogPrintf("Shutdown requested. Exit %s\n", __func__);
-                return;
-            }
-            nFile++;
+        int reindex_threads = args.GetArg("-reindexthreads", DEFAULT_REINDEX_THREADS);
+        if (reindex_threads <= 0) reindex_threads = GetNumCores();
+        reindex_threads = std::min(reindex_threads, MAX_REINDEX_THREADS);
+        LogPrintf("Scanning block files with %d threads\n", reindex_threads);
+        if (!::ChainstateActive().ReindexBlockFiles(chainparams, reindex_threads)) {
+            LogPrintf("Shutdown requested. Exit %s\n", __func__);
+            return;
         }
         pblocktree->WriteReindexing(false);
         fReindex = false;
@@ -751,6 +789,10 @@ static void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImp
             return;
         }
     }
+    // The background chainstate may have reached the snapshot base in a previous run.
+    if (!WITH_LOCK(::cs_main, return chainman.MaybeCompleteSnapshotValidation())) {
+        return;
+    }
 
     if (args.GetBoolArg("-stopafterblockimport", DEFAULT_STOPAFTERBLOCKIMPORT)) {
         LogPrintf("Stopping after block import\n");
@@ -1009,6 +1051,11 @@ bool AppInitParameterInteraction(const ArgsManager& args)
         return InitError(strprintf(_("Specified blocks directory \"%s\" does not exist."), args.GetArg("-blocksdir", "")));
     }
 
+    const std::string db_backend = args.GetArg("-dbbackend", DEFAULT_DB_BACKEND);
+    if (db_backend != "leveldb" && db_backend != "partitioned") {
+        return InitError(strprintf(_("Unknown -dbbackend value %s."), db_backend));
+    }
+
     // parse and validate enabled filter types
     std::string blockfilterindex_value = args.GetArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
     if (blockfilterindex_value == "" || blockfilterindex_value == "1") {
@@ -1033,10 +1080,12 @@ bool AppInitParameterInteraction(const ArgsManager& args)
         nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
     }
 
-    // if using block pruning, then disallow txindex
+    // if using block pruning, then disallow txindex and addressindex
     if (args.GetArg("-prune", 0)) {
         if (args.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (args.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
+            return InitError(_("Prune mode is incompatible with -addressindex."));
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1348,6 +1397,16 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
         StartScriptCheckWorkerThreads(script_threads);
     }
 
+    int prefetch_threads = args.GetArg("-coinsprefetchthreads", DEFAULT_COINS_PREFETCH_THREADS);
+    prefetch_threads = std::max(0, std::min(prefetch_threads, MAX_COINS_PREFETCH_THREADS));
+    LogPrintf("Coins prefetch uses %d threads\n", prefetch_threads);
+    StartCoinsPrefetchWorkerThreads(prefetch_threads);
+
+    int read_ahead = args.GetArg("-blockreadahead", DEFAULT_BLOCK_READ_AHEAD);
+    read_ahead = std::max(0, std::min(read_ahead, MAX_BLOCK_READ_AHEAD));
+    LogPrintf("Reading %d blocks ahead of connecting them\n", read_ahead);
+    StartBlockReadAheadThread(read_ahead);
+
     assert(!node.scheduler);
     node.scheduler = MakeUnique<CScheduler>();
 
@@ -1550,6 +1609,10 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
     nTotalCache -= nBlockTreeDBCache;
     int64_t nTxIndexCache = std::min(nTotalCache / 8, args.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
     nTotalCache -= nTxIndexCache;
+    int64_t address_index_cache = std::min(nTotalCache / 8, args.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ? max_address_index_cache << 20 : 0);
+    nTotalCache -= address_index_cache;
+    int64_t txospender_index_cache = std::min(nTotalCache / 8, args.GetBoolArg("-txospenderindex", DEFAULT_TXOSPENDERINDEX) ? max_txospender_index_cache << 20 : 0);
+    nTotalCache -= txospender_index_cache;
     int64_t filter_index_cache = 0;
     if (!g_enabled_filter_types.empty()) {
         size_t n_indexes = g_enabled_filter_types.size();
@@ -1567,6 +1630,12 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
     if (args.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         LogPrintf("* Using %.1f MiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
     }
+    if (args.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        LogPrintf("* Using %.1f MiB for address index database\n", address_index_cache * (1.0 / 1024 / 1024));
+    }
+    if (args.GetBoolArg("-txospenderindex", DEFAULT_TXOSPENDERINDEX)) {
+        LogPrintf("* Using %.1f MiB for spent output index database\n", txospender_index_cache * (1.0 / 1024 / 1024));
+    }
     for (BlockFilterType filter_type : g_enabled_filter_types) {
         LogPrintf("* Using %.1f MiB for %s block filter index database\n",
                   filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
@@ -1589,6 +1658,19 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
             try {
                 LOCK(cs_main);
                 chainman.InitializeChainstate(*Assert(node.mempool));
+                // Resume a chainstate loaded from a UTXO snapshot (see loadtxoutset).
+                if (!chainman.DetectSnapshotChainstate(*Assert(node.mempool), /* drop */ fReset || fReindexChainState)) {
+                    return InitError(_("Found more than one UTXO snapshot chainstate in the data directory."));
+                }
+                if (chainman.IsSnapshotActive()) {
+                    bool have_index = fPruneMode || !g_enabled_filter_types.empty();
+                    for (const char* index_arg : {"-txindex", "-coinstatsindex", "-addressindex", "-txospenderindex"}) {
+                        have_index |= args.GetBoolArg(index_arg, false);
+                    }
+                    if (have_index) {
+                        return InitError(_("A UTXO snapshot chainstate is in use, which is incompatible with -prune and the indexes. Use -reindex-chainstate to drop it."));
+                    }
+                }
                 chainman.m_total_coinstip_cache = nCoinCacheUsage;
                 chainman.m_total_coinsdb_cache = nCoinDBCache;
 
@@ -1691,6 +1773,16 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
                 if (failed_chainstate_init) {
                     break; // out of the chainstate activation do-while
                 }
+
+                if (chainman.IsSnapshotActive()) {
+                    // A snapshot chainstate can't be rebuilt from the blocks on disk.
+                    if (!chainman.ActiveTip()) {
+                        strLoadError = _("Error loading the UTXO snapshot chainstate");
+                        break;
+                    }
+                    chainman.InitBackgroundValidation();
+                    chainman.MaybeRebalanceCaches();
+                }
             } catch (const std::exception& e) {
                 LogPrintf("%s\n", e.what());
                 strLoadError = _("Error opening block database");
@@ -1808,6 +1900,21 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
         GetBlockFilterIndex(filter_type)->Start();
     }
 
+    if (args.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        g_coin_stats_index = MakeUnique<CoinStatsIndex>(/* cache size */ 0, false, fReindex);
+        g_coin_stats_index->Start();
+    }
+
+    if (args.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        g_address_index = MakeUnique<AddressIndex>(address_index_cache, false, fReindex);
+        g_address_index->Start();
+    }
+
+    if (args.GetBoolArg("-txospenderindex", DEFAULT_TXOSPENDERINDEX)) {
+        g_txospender_index = MakeUnique<TxoSpenderIndex>(txospender_index_cache, false, fReindex);
+        g_txospender_index->Start();
+    }
+
     // ********************************************************* Step 9: load wallet
     for (const auto& client : node.chain_clients) {
         if (!client->load()) {
@@ -1879,6 +1986,10 @@ bool AppInitMain(const util::Ref& context, NodeContext& node, interfaces::BlockA
         ThreadImport(chainman, vImportFiles, args);
     });
 
+    if (args.GetBoolArg("-compressblocks", DEFAULT_COMPRESS_BLOCKS)) {
+        StartBlockFileCompressionThread();
+    }
+
     // Wait for genesis block to be processed
     {
         WAIT_LOCK(g_genesis_wait_mutex, lock);
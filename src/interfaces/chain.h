@@ -5,6 +5,7 @@
 #ifndef BITCOIN_INTERFACES_CHAIN_H
 #define BITCOIN_INTERFACES_CHAIN_H
 
+#include <blockfilter.h>           // For BlockFilterType and GCSFilter::ElementSet
 #include <optional.h>               // For Optional and nullopt
 #include <primitives/transaction.h> // For CTransactionRef
 #include <util/settings.h>          // For util::SettingsValue
@@ -156,6 +157,18 @@ public:
     //! the height range from min_height to max_height, inclusive.
     virtual bool hasBlocks(const uint256& block_hash, int min_height = 0, Optional<int> max_height = {}) = 0;
 
+    //! Return whether the block filter index of the given type is enabled.
+    virtual bool hasBlockFilterIndex(BlockFilterType filter_type) = 0;
+
+    //! Match a set of elements against the block filters of the active chain,
+    //! from start_block up to max_height inclusive, in one batch. Returns false
+    //! if start_block is not in the active chain or the filter index does not
+    //! cover the range yet. Otherwise sets blocks_out to the hashes of the
+    //! blocks checked, in order, each paired with whether its filter may
+    //! contain any of the elements.
+    virtual bool matchBlockFilters(BlockFilterType filter_type, const uint256& start_block, int max_height,
+        const GCSFilter::ElementSet& elements, std::vector<std::pair<uint256, bool>>& blocks_out) = 0;
+
     //! Check if transaction is RBF opt in.
     virtual RBFTransactionState isRBFOptIn(const CTransaction& tx) = 0;
 
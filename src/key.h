@@ -128,6 +128,13 @@ public:
      */
     bool SignCompact(const uint256& hash, std::vector<unsigned char>& vchSig) const;
 
+    /**
+     * Create a BIP340 Schnorr signature (64 bytes) for the x-only public key
+     * corresponding to this key. sig must be exactly 64 bytes. aux is the
+     * optional auxiliary randomness used to derive the nonce.
+     */
+    bool SignSchnorr(const uint256& hash, Span<unsigned char> sig, const uint256* aux = nullptr) const;
+
     //! Derive BIP32 child key.
     bool Derive(CKey& keyChild, ChainCode &ccChild, unsigned int nChild, const ChainCode& cc) const;
 
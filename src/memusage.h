@@ -7,6 +7,7 @@
 
 #include <indirectmap.h>
 #include <prevector.h>
+#include <support/allocators/pool.h>
 
 #include <stdlib.h>
 
@@ -167,6 +168,37 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+template <class Key, class T, class Hash, class Pred, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const std::unordered_map<Key,
+                                                           T,
+                                                           Hash,
+                                                           Pred,
+                                                           PoolAllocator<std::pair<const Key, T>,
+                                                                         MAX_BLOCK_SIZE_BYTES,
+                                                                         ALIGN_BYTES>>& m)
+{
+    auto* pool_resource = m.get_allocator().resource();
+
+    // The allocated chunks are stored in a std::list. Size per node should
+    // therefore be 3 pointers: next, previous, and a pointer to the chunk.
+    size_t estimated_list_node_size = MallocUsage(sizeof(void*) * 3);
+    size_t usage_resource = estimated_list_node_size * pool_resource->NumAllocatedChunks();
+    // Chunks double in size until they reach the maximum chunk size.
+    size_t usage_chunks = 0;
+    for (size_t i = 0; i < pool_resource->NumAllocatedChunks(); ++i) {
+        const size_t chunk_size_bytes = pool_resource->ChunkSizeBytes(i);
+        if (chunk_size_bytes == pool_resource->ChunkSizeBytes()) {
+            usage_chunks += MallocUsage(chunk_size_bytes) * (pool_resource->NumAllocatedChunks() - i);
+            break;
+        }
+        usage_chunks += MallocUsage(chunk_size_bytes);
+    }
+    // Memory that is not handed out to the map is reused before the resource
+    // grows, so it is available to the map and not counted.
+    usage_chunks -= pool_resource->UnusedBytes();
+    return usage_resource + usage_chunks + MallocUsage(sizeof(void*) * m.bucket_count());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
@@ -431,6 +431,11 @@ private:
      */
     void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /** Add the not-in-flight blocks the chainstate validating a snapshot in the background needs
+     *  next to vBlocks, until it has at most count entries.
+     */
+    void FindHistoricalBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight GUARDED_BY(cs_main);
 
     /** When our tip was last updated. */
@@ -870,6 +875,48 @@ void PeerManagerImpl::FindNextBlocksToDownload(NodeId nodeid, unsigned int count
     }
 }
 
+void PeerManagerImpl::FindHistoricalBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks)
+{
+    if (vBlocks.size() >= count)
+        return;
+
+    const CChainState* background = m_chainman.BackgroundValidationChainstate();
+    if (!background || !background->m_validation_target)
+        return;
+    const CBlockIndex* target = background->m_validation_target;
+
+    CNodeState *state = State(nodeid);
+    assert(state != nullptr);
+    if (state->pindexBestKnownBlock == nullptr || state->pindexBestKnownBlock->GetAncestor(target->nHeight) != target) {
+        // This peer may not have the blocks leading to the snapshot base.
+        return;
+    }
+
+    // Fetch the ancestors of the snapshot base that follow the background tip, within the download window.
+    const CBlockIndex* pindexFork = LastCommonAncestor(background->m_chain.Tip(), target);
+    const int nWindowEnd = std::min<int>(pindexFork->nHeight + BLOCK_DOWNLOAD_WINDOW, target->nHeight);
+    std::vector<const CBlockIndex*> vToFetch(nWindowEnd - pindexFork->nHeight);
+    const CBlockIndex* pindexWalk = target->GetAncestor(nWindowEnd);
+    for (auto it = vToFetch.rbegin(); it != vToFetch.rend(); ++it) {
+        *it = pindexWalk;
+        pindexWalk = pindexWalk->pprev;
+    }
+
+    const Consensus::Params& consensusParams = m_chainparams.GetConsensus();
+    for (const CBlockIndex* pindex : vToFetch) {
+        if (!State(nodeid)->fHaveWitness && IsWitnessEnabled(pindex->pprev, consensusParams)) {
+            // We wouldn't download this block or its descendants from this peer.
+            return;
+        }
+        if (pindex->nStatus & BLOCK_HAVE_DATA || mapBlocksInFlight.count(pindex->GetBlockHash()))
+            continue;
+        vBlocks.push_back(pindex);
+        if (vBlocks.size() == count) {
+            return;
+        }
+    }
+}
+
 } // namespace
 
 void PeerManagerImpl::PushNodeVersion(CNode& pnode, int64_t nTime)
@@ -1613,11 +1660,11 @@ void static ProcessGetBlockData(CNode& pfrom, Peer& peer, const CChainParams& ch
         } else if (inv.IsMsgWitnessBlk()) {
             // Fast-path: in this case it is possible to serve the block directly from disk,
             // as the network format matches the format on disk
-            std::vector<uint8_t> block_data;
+            FlatFileData block_data;
             if (!ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart())) {
                 assert(!"cannot load block from disk");
             }
-            connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data)));
+            connman.PushMessage(&pfrom, msgMaker.Make(NetMsgType::BLOCK, block_data.span()));
             // Don't set pblock as we've sent the block
         } else {
             // Send block from disk
@@ -4662,6 +4709,7 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
             FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller);
+            FindHistoricalBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload);
             for (const CBlockIndex *pindex : vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(*pto);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
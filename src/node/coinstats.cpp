@@ -8,21 +8,36 @@
 #include <coins.h>
 #include <crypto/muhash.h>
 #include <hash.h>
+#include <index/coinstatsindex.h>
 #include <serialize.h>
 #include <uint256.h>
 #include <util/system.h>
+#include <util/threadnames.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <exception>
 #include <map>
+#include <thread>
+#include <type_traits>
 
-static uint64_t GetBogoSize(const CScript& scriptPubKey)
+uint64_t GetBogoSize(const CScript& script_pub_key)
 {
     return 32 /* txid */ +
            4 /* vout index */ +
            4 /* height + coinbase */ +
            8 /* amount */ +
            2 /* scriptPubKey len */ +
-           scriptPubKey.size() /* scriptPubKey */;
+           script_pub_key.size() /* scriptPubKey */;
+}
+
+CDataStream TxOutSer(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint;
+    ss << static_cast<uint32_t>(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+    return ss;
 }
 
 static void ApplyHash(CCoinsStats& stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs, std::map<uint32_t, Coin>::const_iterator it)
@@ -46,13 +61,7 @@ static void ApplyHash(CCoinsStats& stats, std::nullptr_t, const uint256& hash, c
 static void ApplyHash(CCoinsStats& stats, MuHash3072& muhash, const uint256& hash, const std::map<uint32_t, Coin>& outputs, std::map<uint32_t, Coin>::const_iterator it)
 {
     COutPoint outpoint = COutPoint(hash, it->first);
-    Coin coin = it->second;
-
-    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
-    ss << outpoint;
-    ss << static_cast<uint32_t>(coin.nHeight * 2 + coin.fCoinBase);
-    ss << coin.out;
-    muhash.Insert(MakeUCharSpan(ss));
+    muhash.Insert(MakeUCharSpan(TxOutSer(outpoint, it->second)));
 }
 
 //! Warning: be very careful when changing this! assumeutxo and UTXO snapshot
@@ -81,29 +90,22 @@ static void ApplyStats(CCoinsStats& stats, T& hash_obj, const uint256& hash, con
     }
 }
 
-//! Calculate statistics about the unspent transaction output set
-template <typename T>
-static bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, T hash_obj, const std::function<void()>& interruption_point)
+void ApplyHashSerialized(CCoinsStats& stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
 {
-    stats = CCoinsStats();
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-    assert(pcursor);
-
-    stats.hashBlock = pcursor->GetBestBlock();
-    {
-        LOCK(cs_main);
-        stats.nHeight = g_chainman.m_blockman.LookupBlockIndex(stats.hashBlock)->nHeight;
-    }
-
-    PrepareHash(hash_obj, stats);
+    ApplyStats(stats, ss, hash, outputs);
+}
 
+//! Add the coins of cursor to stats and hash_obj
+template <typename T>
+static bool ScanCoins(CCoinsViewCursor& cursor, CCoinsStats& stats, T& hash_obj, const std::function<void()>& interruption_point)
+{
     uint256 prevkey;
     std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
+    while (cursor.Valid()) {
         interruption_point();
         COutPoint key;
         Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+        if (cursor.GetKey(key) && cursor.GetValue(coin)) {
             if (!outputs.empty() && key.hash != prevkey) {
                 ApplyStats(stats, hash_obj, prevkey, outputs);
                 outputs.clear();
@@ -114,11 +116,120 @@ static bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, T hash_obj, const
         } else {
             return error("%s: unable to read value", __func__);
         }
-        pcursor->Next();
+        cursor.Next();
     }
     if (!outputs.empty()) {
         ApplyStats(stats, hash_obj, prevkey, outputs);
     }
+    return true;
+}
+
+// The MuHash of a set is the product of the MuHashes of its shards
+static void CombineHash(MuHash3072& muhash, const MuHash3072& shard_muhash)
+{
+    muhash *= shard_muhash;
+}
+static void CombineHash(std::nullptr_t, std::nullptr_t) {}
+
+int GetUTXOScanThreads()
+{
+    int threads = gArgs.GetArg("-utxoscanthreads", DEFAULT_UTXO_SCAN_THREADS);
+    if (threads <= 0) threads = GetNumCores();
+    return std::max(1, std::min(threads, MAX_UTXO_SCAN_THREADS));
+}
+
+void ScanCursors(const std::vector<std::unique_ptr<CCoinsViewCursor>>& cursors, const std::function<void(size_t, CCoinsViewCursor&)>& fn)
+{
+    if (cursors.size() == 1) {
+        fn(0, *cursors[0]);
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(cursors.size());
+    std::vector<std::thread> threads;
+    for (size_t n = 0; n < cursors.size(); ++n) {
+        threads.emplace_back([&, n] {
+            util::ThreadRename(strprintf("utxoscan.%i", n));
+            try {
+                fn(n, *cursors[n]);
+            } catch (...) {
+                errors[n] = std::current_exception();
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+//! Calculate statistics about the unspent transaction output set
+template <typename T>
+static bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, T hash_obj, const std::function<void()>& interruption_point, const CBlockIndex* pindex)
+{
+    const bool index_requested{stats.index_requested};
+    stats = CCoinsStats();
+    stats.index_requested = index_requested;
+
+    // Use the index when it supports the hash type. The stats of a specific
+    // block can only be provided by the index.
+    constexpr bool index_supported{!std::is_same<T, CHashWriter>::value};
+    if (pindex || (index_supported && index_requested && g_coin_stats_index)) {
+        if (!index_supported || !g_coin_stats_index) return false;
+        const CBlockIndex* block_index{pindex};
+        if (!block_index) {
+            LOCK(cs_main);
+            block_index = g_chainman.m_blockman.LookupBlockIndex(view->GetBestBlock());
+            if (!block_index) return false;
+        }
+        stats.hashBlock = block_index->GetBlockHash();
+        stats.nHeight = block_index->nHeight;
+        stats.index_used = true;
+        if (g_coin_stats_index->LookUpStats(block_index, stats)) return true;
+        // A specific block can only be served by the index. For the current
+        // best block, fall back to scanning if the index has not caught up yet.
+        if (pindex) return false;
+        stats = CCoinsStats();
+        stats.index_requested = index_requested;
+    }
+
+    // The legacy hash commits to the whole serialized set in order, so only
+    // the other hash types can be computed over several shards at once.
+    constexpr bool serial_hash{std::is_same<T, CHashWriter>::value};
+    const std::vector<std::unique_ptr<CCoinsViewCursor>> cursors{view->Cursors(serial_hash ? 1 : GetUTXOScanThreads())};
+    assert(!cursors.empty() && cursors[0]);
+
+    stats.hashBlock = cursors[0]->GetBestBlock();
+    {
+        LOCK(cs_main);
+        const CBlockIndex* block_index{g_chainman.m_blockman.LookupBlockIndex(stats.hashBlock)};
+        if (!block_index) return false;
+        stats.nHeight = block_index->nHeight;
+    }
+
+    PrepareHash(hash_obj, stats);
+
+    if constexpr (serial_hash) {
+        if (!ScanCoins(*cursors[0], stats, hash_obj, interruption_point)) return false;
+    } else {
+        std::vector<CCoinsStats> shard_stats(cursors.size());
+        std::vector<T> shard_hash_objs(cursors.size());
+        std::vector<char> shard_ok(cursors.size(), false);
+        ScanCursors(cursors, [&](size_t n, CCoinsViewCursor& cursor) {
+            shard_ok[n] = ScanCoins(cursor, shard_stats[n], shard_hash_objs[n], interruption_point);
+        });
+        for (size_t n = 0; n < cursors.size(); ++n) {
+            if (!shard_ok[n]) return false;
+            CombineHash(hash_obj, shard_hash_objs[n]);
+            stats.nTransactions += shard_stats[n].nTransactions;
+            stats.nTransactionOutputs += shard_stats[n].nTransactionOutputs;
+            stats.nBogoSize += shard_stats[n].nBogoSize;
+            stats.nTotalAmount += shard_stats[n].nTotalAmount;
+            stats.coins_count += shard_stats[n].coins_count;
+        }
+    }
 
     FinalizeHash(hash_obj, stats);
 
@@ -126,19 +237,19 @@ static bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, T hash_obj, const
     return true;
 }
 
-bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, CoinStatsHashType hash_type, const std::function<void()>& interruption_point)
+bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, CoinStatsHashType hash_type, const std::function<void()>& interruption_point, const CBlockIndex* pindex)
 {
     switch (hash_type) {
     case(CoinStatsHashType::HASH_SERIALIZED): {
         CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-        return GetUTXOStats(view, stats, ss, interruption_point);
+        return GetUTXOStats(view, stats, ss, interruption_point, pindex);
     }
     case(CoinStatsHashType::MUHASH): {
         MuHash3072 muhash;
-        return GetUTXOStats(view, stats, muhash, interruption_point);
+        return GetUTXOStats(view, stats, muhash, interruption_point, pindex);
     }
     case(CoinStatsHashType::NONE): {
-        return GetUTXOStats(view, stats, nullptr, interruption_point);
+        return GetUTXOStats(view, stats, nullptr, interruption_point, pindex);
     }
     } // no default case, so the compiler can warn about missing cases
     assert(false);
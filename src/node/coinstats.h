@@ -7,12 +7,27 @@
 #define BITCOIN_NODE_COINSTATS_H
 
 #include <amount.h>
+#include <streams.h>
 #include <uint256.h>
 
 #include <cstdint>
 #include <functional>
+#include <map>
+#include <memory>
+#include <vector>
 
+class CBlockIndex;
+class CHashWriter;
 class CCoinsView;
+class CCoinsViewCursor;
+class COutPoint;
+class CScript;
+struct Coin;
+
+/** Maximum number of threads a scan of the UTXO set is split over */
+static const int MAX_UTXO_SCAN_THREADS = 16;
+/** -utxoscanthreads default (number of threads scanning the UTXO set, 0 = auto) */
+static const int DEFAULT_UTXO_SCAN_THREADS = 0;
 
 enum class CoinStatsHashType {
     HASH_SERIALIZED,
@@ -33,9 +48,36 @@ struct CCoinsStats
 
     //! The number of coins contained.
     uint64_t coins_count{0};
+
+    //! Whether the coinstatsindex may be used to answer the request.
+    bool index_requested{true};
+    //! Whether the statistics were looked up in the coinstatsindex, in which
+    //! case nTransactions and nDiskSize are not set.
+    bool index_used{false};
 };
 
-//! Calculate statistics about the unspent transaction output set
-bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, const CoinStatsHashType hash_type, const std::function<void()>& interruption_point = {});
+//! Calculate statistics about the unspent transaction output set.
+//! If pindex is set, or the coinstatsindex is enabled and requested for a hash
+//! type it supports, the statistics are looked up in the index instead of
+//! walking the whole set. pindex defaults to the best block of view.
+bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, const CoinStatsHashType hash_type, const std::function<void()>& interruption_point = {}, const CBlockIndex* pindex = nullptr);
+
+//! Number of threads to split a scan of the UTXO set over, set by -utxoscanthreads.
+int GetUTXOScanThreads();
+
+//! Call fn with the index and the cursor for each of cursors, each on its own
+//! thread, and wait for all of them to finish. If fn throws, the first
+//! exception is rethrown once all threads have stopped.
+void ScanCursors(const std::vector<std::unique_ptr<CCoinsViewCursor>>& cursors, const std::function<void(size_t, CCoinsViewCursor&)>& fn);
+
+//! Add the unspent outputs of transaction hash to stats and to the legacy
+//! serialized hash ss, the same way GetUTXOStats does for HASH_SERIALIZED.
+//! The outputs of each transaction must be added in txid order.
+void ApplyHashSerialized(CCoinsStats& stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs);
+
+uint64_t GetBogoSize(const CScript& script_pub_key);
+
+//! Serialize a coin the way it is committed to in the MuHash of the UTXO set.
+CDataStream TxOutSer(const COutPoint& outpoint, const Coin& coin);
 
 #endif // BITCOIN_NODE_COINSTATS_H
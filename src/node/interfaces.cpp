@@ -7,6 +7,7 @@
 #include <boost/signals2/signal.hpp>
 #include <chain.h>
 #include <chainparams.h>
+#include <index/blockfilterindex.h>
 #include <init.h>
 #include <interfaces/chain.h>
 #include <interfaces/handler.h>
@@ -520,6 +521,39 @@ public:
         }
         return false;
     }
+    bool hasBlockFilterIndex(BlockFilterType filter_type) override
+    {
+        return GetBlockFilterIndex(filter_type) != nullptr;
+    }
+    bool matchBlockFilters(BlockFilterType filter_type, const uint256& start_block, int max_height,
+        const GCSFilter::ElementSet& elements, std::vector<std::pair<uint256, bool>>& blocks_out) override
+    {
+        const BlockFilterIndex* block_filter_index{GetBlockFilterIndex(filter_type)};
+        if (!block_filter_index) return false;
+
+        const CBlockIndex* start_index;
+        const CBlockIndex* stop_index;
+        {
+            LOCK(cs_main);
+            const CChain& active = Assert(m_node.chainman)->ActiveChain();
+            start_index = g_chainman.m_blockman.LookupBlockIndex(start_block);
+            if (!start_index || !active.Contains(start_index)) return false;
+            stop_index = active[std::max(start_index->nHeight, std::min(max_height, active.Height()))];
+        }
+
+        // Match outside of cs_main, the filters are read from disk.
+        std::vector<int> heights;
+        if (!block_filter_index->MatchAnyRange(start_index->nHeight, stop_index, elements, heights)) return false;
+
+        blocks_out.assign(stop_index->nHeight - start_index->nHeight + 1, {uint256(), false});
+        for (const CBlockIndex* block = stop_index; block != start_index->pprev; block = block->pprev) {
+            blocks_out[block->nHeight - start_index->nHeight].first = block->GetBlockHash();
+        }
+        for (int height : heights) {
+            blocks_out[height - start_index->nHeight].second = true;
+        }
+        return true;
+    }
     RBFTransactionState isRBFOptIn(const CTransaction& tx) override
     {
         if (!m_node.mempool) return IsRBFOptInEmptyMempool(tx);
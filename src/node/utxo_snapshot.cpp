@@ -0,0 +1,83 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/utxo_snapshot.h>
+
+#include <util/threadnames.h>
+
+//! Number of transactions handed to the hashing thread at once
+static constexpr size_t HASH_BATCH_SIZE{1000};
+//! Number of batches that may wait for the hashing thread before Add() blocks
+static constexpr size_t MAX_QUEUED_HASH_BATCHES{16};
+
+SnapshotHasher::SnapshotHasher(const uint256& base_blockhash)
+{
+    m_stats.hashBlock = base_blockhash;
+    m_hash_writer << base_blockhash;
+    m_batch.reserve(HASH_BATCH_SIZE);
+    m_thread = std::thread([this] {
+        util::ThreadRename("snapshothash");
+        ThreadHash();
+    });
+}
+
+SnapshotHasher::~SnapshotHasher()
+{
+    if (!m_thread.joinable()) return;
+    {
+        LOCK(m_mutex);
+        m_queue.clear();
+        m_stop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+void SnapshotHasher::Add(const uint256& txid, Outputs&& outputs)
+{
+    m_batch.emplace_back(txid, std::move(outputs));
+    if (m_batch.size() < HASH_BATCH_SIZE) return;
+    {
+        WAIT_LOCK(m_mutex, lock);
+        m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_queue.size() < MAX_QUEUED_HASH_BATCHES; });
+        m_queue.push_back(std::move(m_batch));
+    }
+    m_cond.notify_all();
+    m_batch = Batch{};
+    m_batch.reserve(HASH_BATCH_SIZE);
+}
+
+CCoinsStats SnapshotHasher::Finalize()
+{
+    {
+        LOCK(m_mutex);
+        if (!m_batch.empty()) m_queue.push_back(std::move(m_batch));
+        m_stop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+    m_stats.hashSerialized = m_hash_writer.GetHash();
+    return m_stats;
+}
+
+void SnapshotHasher::ThreadHash()
+{
+    while (true) {
+        Batch batch;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || !m_queue.empty(); });
+            // Queued batches are still hashed when stopping, unless the
+            // destructor discarded them.
+            if (m_queue.empty()) return;
+            batch = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        m_cond.notify_all();
+        for (const auto& tx : batch) {
+            ApplyHashSerialized(m_stats, m_hash_writer, tx.first, tx.second);
+            m_stats.coins_count += tx.second.size();
+        }
+    }
+}
@@ -6,8 +6,31 @@
 #ifndef BITCOIN_NODE_UTXO_SNAPSHOT_H
 #define BITCOIN_NODE_UTXO_SNAPSHOT_H
 
-#include <uint256.h>
+#include <coins.h>
+#include <hash.h>
+#include <node/coinstats.h>
 #include <serialize.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <uint256.h>
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <ios>
+#include <map>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! Magic bytes at the start of a UTXO snapshot.
+static constexpr char SNAPSHOT_MAGIC_BYTES[5] = {'u', 't', 'x', 'o', '\xff'};
+
+//! Version of the UTXO snapshot format. Version 2 groups the coins by txid:
+//! each transaction is written as its txid and the CompactSize number of its
+//! unspent outputs, followed by the CompactSize output index and the
+//! serialized Coin of each output, in increasing txid and output index order.
+static constexpr uint16_t SNAPSHOT_VERSION{2};
 
 //! Metadata describing a serialized version of a UTXO set from which an
 //! assumeutxo CChainState can be constructed.
@@ -35,7 +58,66 @@ public:
             m_coins_count(coins_count),
             m_nchaintx(nchaintx) { }
 
-    SERIALIZE_METHODS(SnapshotMetadata, obj) { READWRITE(obj.m_base_blockhash, obj.m_coins_count, obj.m_nchaintx); }
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s.write(SNAPSHOT_MAGIC_BYTES, sizeof(SNAPSHOT_MAGIC_BYTES));
+        s << SNAPSHOT_VERSION << m_base_blockhash << m_coins_count << m_nchaintx;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char magic[sizeof(SNAPSHOT_MAGIC_BYTES)];
+        s.read(magic, sizeof(magic));
+        if (std::memcmp(magic, SNAPSHOT_MAGIC_BYTES, sizeof(magic)) != 0) {
+            throw std::ios_base::failure("Invalid UTXO snapshot magic bytes");
+        }
+        uint16_t version;
+        s >> version;
+        if (version != SNAPSHOT_VERSION) {
+            throw std::ios_base::failure(strprintf("Unsupported UTXO snapshot version %d", version));
+        }
+        s >> m_base_blockhash >> m_coins_count >> m_nchaintx;
+    }
+};
+
+/**
+ * Computes the serialized hash of a UTXO set, which assumeutxo parameters
+ * commit to, while its snapshot is written or loaded. The hash is computed on
+ * a separate thread, so that it overlaps with the disk and database accesses
+ * of the caller instead of requiring a second pass over the coins.
+ */
+class SnapshotHasher
+{
+public:
+    using Outputs = std::map<uint32_t, Coin>;
+
+    explicit SnapshotHasher(const uint256& base_blockhash);
+    ~SnapshotHasher();
+
+    //! Add the unspent outputs of a transaction. Transactions must be added in
+    //! increasing txid order, like the UTXO set database iterates over them.
+    void Add(const uint256& txid, Outputs&& outputs);
+
+    //! Wait until all added transactions are hashed and return the statistics
+    //! of the UTXO set, including its hash in hashSerialized.
+    CCoinsStats Finalize();
+
+private:
+    using Batch = std::vector<std::pair<uint256, Outputs>>;
+
+    //! Hash the batches of m_queue until Finalize() or destruction.
+    void ThreadHash();
+
+    Batch m_batch;
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Batch> m_queue GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+    CHashWriter m_hash_writer{SER_GETHASH, PROTOCOL_VERSION};
+    CCoinsStats m_stats;
+    std::thread m_thread;
 };
 
 #endif // BITCOIN_NODE_UTXO_SNAPSHOT_H
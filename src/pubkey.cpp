@@ -13,6 +13,10 @@ namespace
 {
 /* Global secp256k1_context object used for verification. */
 secp256k1_context* secp256k1_context_verify = nullptr;
+
+/* Size of the scratch space used for Schnorr batch verification. Batches that
+ * need more room are split up by libsecp256k1. */
+constexpr size_t SCHNORR_BATCH_SCRATCH_SIZE{4 << 20};
 } // namespace
 
 /** This function is taken from the libsecp256k1 distribution and implements
@@ -181,6 +185,26 @@ bool XOnlyPubKey::VerifySchnorr(const uint256& msg, Span<const unsigned char> si
     return secp256k1_schnorrsig_verify(secp256k1_context_verify, sigbytes.data(), msg.begin(), &pubkey);
 }
 
+bool XOnlyPubKey::VerifySchnorrBatch(Span<const XOnlyPubKey> pubkeys, Span<const uint256> msgs, Span<const std::array<unsigned char, 64>> sigs)
+{
+    assert(pubkeys.size() == msgs.size() && pubkeys.size() == sigs.size());
+    if (pubkeys.empty()) return true;
+    std::vector<secp256k1_xonly_pubkey> parsed(pubkeys.size());
+    std::vector<const secp256k1_xonly_pubkey*> pubkey_ptrs(pubkeys.size());
+    std::vector<const unsigned char*> msg_ptrs(pubkeys.size());
+    std::vector<const unsigned char*> sig_ptrs(pubkeys.size());
+    for (size_t i = 0; i < pubkeys.size(); ++i) {
+        if (!secp256k1_xonly_pubkey_parse(secp256k1_context_verify, &parsed[i], pubkeys[i].data())) return false;
+        pubkey_ptrs[i] = &parsed[i];
+        msg_ptrs[i] = msgs[i].begin();
+        sig_ptrs[i] = sigs[i].data();
+    }
+    secp256k1_scratch_space* scratch = secp256k1_scratch_space_create(secp256k1_context_verify, SCHNORR_BATCH_SCRATCH_SIZE);
+    const int ret = secp256k1_schnorrsig_verify_batch(secp256k1_context_verify, scratch, sig_ptrs.data(), msg_ptrs.data(), pubkey_ptrs.data(), pubkeys.size());
+    secp256k1_scratch_space_destroy(secp256k1_context_verify, scratch);
+    return ret;
+}
+
 bool XOnlyPubKey::CheckPayToContract(const XOnlyPubKey& base, const uint256& hash, bool parity) const
 {
     secp256k1_xonly_pubkey base_point;
@@ -12,6 +12,7 @@
 #include <span.h>
 #include <uint256.h>
 
+#include <array>
 #include <stdexcept>
 #include <vector>
 
@@ -230,6 +231,14 @@ public:
      * sigbytes must be exactly 64 bytes.
      */
     bool VerifySchnorr(const uint256& msg, Span<const unsigned char> sigbytes) const;
+
+    /** Verify a batch of Schnorr signatures at once.
+     *
+     * The i'th signature is checked against the i'th public key and message; all
+     * three spans must have the same size. Returns false if any signature is
+     * invalid, without telling which one.
+     */
+    static bool VerifySchnorrBatch(Span<const XOnlyPubKey> pubkeys, Span<const uint256> msgs, Span<const std::array<unsigned char, 64>> sigs);
     bool CheckPayToContract(const XOnlyPubKey& base, const uint256& hash, bool parity) const;
 
     const unsigned char& operator[](int pos) const { return *(m_keydata.begin() + pos); }
@@ -7,7 +7,9 @@
 #include <chainparams.h>
 #include <core_io.h>
 #include <httpserver.h>
+#include <index/addressindex.h>
 #include <index/txindex.h>
+#include <key_io.h>
 #include <node/context.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
@@ -243,8 +245,11 @@ static bool rest_block(HTTPRequest* req,
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
     CBlock block;
+    FlatFileData block_data;
     CBlockIndex* pblockindex = nullptr;
     CBlockIndex* tip = nullptr;
+    // Binary and hex replies in the on-disk serialization can be served from the block file as is
+    const bool raw = rf != RetFormat::JSON && RPCSerializationFlags() == 0;
     {
         LOCK(cs_main);
         tip = ::ChainActive().Tip();
@@ -256,24 +261,38 @@ static bool rest_block(HTTPRequest* req,
         if (IsBlockPruned(pblockindex))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        if (raw) {
+            if (!ReadRawBlockFromDisk(block_data, pblockindex, Params().MessageStart()))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        } else if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        }
     }
 
     switch (rf) {
     case RetFormat::BINARY: {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string binaryBlock = ssBlock.str();
+        std::string binaryBlock;
+        if (raw) {
+            binaryBlock.assign(block_data.span().begin(), block_data.span().end());
+        } else {
+            CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+            ssBlock << block;
+            binaryBlock = ssBlock.str();
+        }
         req->WriteHeader("Content-Type", "application/octet-stream");
         req->WriteReply(HTTP_OK, binaryBlock);
         return true;
     }
 
     case RetFormat::HEX: {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock) + "\n";
+        std::string strHex;
+        if (raw) {
+            strHex = HexStr(block_data.span()) + "\n";
+        } else {
+            CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+            ssBlock << block;
+            strHex = HexStr(ssBlock) + "\n";
+        }
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
@@ -535,11 +554,12 @@ static bool rest_getutxos(const util::Ref& context, HTTPRequest* req, const std:
     bitmap.resize((vOutPoints.size() + 7) / 8);
     {
         auto process_utxos = [&vOutPoints, &outs, &hits](const CCoinsView& view, const CTxMemPool& mempool) {
-            for (const COutPoint& vOutPoint : vOutPoints) {
-                Coin coin;
-                bool hit = !mempool.isSpent(vOutPoint) && view.GetCoin(vOutPoint, coin);
+            std::vector<Coin> coins(vOutPoints.size());
+            view.GetCoins(vOutPoints, coins);
+            for (size_t i = 0; i < vOutPoints.size(); ++i) {
+                bool hit = !mempool.isSpent(vOutPoints[i]) && !coins[i].IsSpent();
                 hits.push_back(hit);
-                if (hit) outs.emplace_back(std::move(coin));
+                if (hit) outs.emplace_back(std::move(coins[i]));
             }
         };
 
@@ -667,6 +687,49 @@ static bool rest_blockhash_by_height(const util::Ref& context, HTTPRequest* req,
     }
 }
 
+static bool rest_addressoutputs(const util::Ref& context, HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/addressoutputs/<skip>/<count>/<address>.<ext>.");
+
+    int32_t skip, count;
+    if (!ParseInt32(path[0], &skip) || skip < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid skip: " + SanitizeString(path[0]));
+    if (!ParseInt32(path[1], &count) || count < 1 || count > 1000)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Output count out of range: " + SanitizeString(path[1]));
+
+    const CTxDestination dest = DecodeDestination(path[2]);
+    if (!IsValidDestination(dest))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + SanitizeString(path[2]));
+
+    if (!g_address_index)
+        return RESTERR(req, HTTP_NOT_FOUND, "Address index not enabled (-addressindex)");
+    if (!g_address_index->BlockUntilSyncedToCurrentChain())
+        return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "Address index is still syncing");
+
+    switch (rf) {
+    case RetFormat::JSON: {
+        UniValue result;
+        if (!AddressOutputsToJSON(*g_address_index, {GetScriptForDestination(dest)}, /* include_spent */ true, /* start_height */ 0, skip, count, /* totals */ false, /* verbose */ false, result))
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Unable to read the address index");
+        std::string strJSON = result.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(const util::Ref& context, HTTPRequest* req, const std::string& strReq);
@@ -680,6 +743,7 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/addressoutputs/", rest_addressoutputs},
 };
 
 void StartREST(const util::Ref& context)
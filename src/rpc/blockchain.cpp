@@ -13,7 +13,12 @@
 #include <consensus/validation.h>
 #include <core_io.h>
 #include <hash.h>
+#include <index/addressindex.h>
 #include <index/blockfilterindex.h>
+#include <index/coinstatsindex.h>
+#include <index/txindex.h>
+#include <index/txospenderindex.h>
+#include <key_io.h>
 #include <node/coinstats.h>
 #include <node/context.h>
 #include <node/utxo_snapshot.h>
@@ -45,6 +50,7 @@
 #include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <optional>
 
 struct CUpdatedBlock
 {
@@ -860,6 +866,20 @@ static CBlock GetBlockChecked(const CBlockIndex* pblockindex)
     return block;
 }
 
+static FlatFileData GetRawBlockChecked(const CBlockIndex* pblockindex)
+{
+    FlatFileData block_data;
+    if (IsBlockPruned(pblockindex)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+    }
+
+    if (!ReadRawBlockFromDisk(block_data, pblockindex, Params().MessageStart())) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+    }
+
+    return block_data;
+}
+
 static CBlockUndo GetUndoChecked(const CBlockIndex* pblockindex)
 {
     CBlockUndo blockUndo;
@@ -942,8 +962,11 @@ static RPCHelpMan getblock()
     }
 
     CBlock block;
+    FlatFileData block_data;
     const CBlockIndex* pblockindex;
     const CBlockIndex* tip;
+    // Hex output in the on-disk serialization can be served from the block file as is
+    const bool raw = verbosity <= 0 && RPCSerializationFlags() == 0;
     {
         LOCK(cs_main);
         pblockindex = g_chainman.m_blockman.LookupBlockIndex(hash);
@@ -953,7 +976,15 @@ static RPCHelpMan getblock()
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
         }
 
-        block = GetBlockChecked(pblockindex);
+        if (raw) {
+            block_data = GetRawBlockChecked(pblockindex);
+        } else {
+            block = GetBlockChecked(pblockindex);
+        }
+    }
+
+    if (raw) {
+        return HexStr(block_data.span());
     }
 
     if (verbosity <= 0)
@@ -1039,46 +1070,107 @@ CoinStatsHashType ParseHashType(const std::string& hash_type_input)
     }
 }
 
+static CBlockIndex* ParseHashOrHeight(const UniValue& param) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (param.isNum()) {
+        const int height = param.get_int();
+        const int current_tip = ::ChainActive().Height();
+        if (height < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
+        }
+        if (height > current_tip) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
+        }
+
+        return ::ChainActive()[height];
+    } else {
+        const uint256 hash(ParseHashV(param, "hash_or_height"));
+        CBlockIndex* pindex = g_chainman.m_blockman.LookupBlockIndex(hash);
+        if (!pindex) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        if (!::ChainActive().Contains(pindex)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
+        }
+        return pindex;
+    }
+}
+
 static RPCHelpMan gettxoutsetinfo()
 {
     return RPCHelpMan{"gettxoutsetinfo",
                 "\nReturns statistics about the unspent transaction output set.\n"
-                "Note this call may take some time.\n",
+                "Note this call may take some time if you are not using coinstatsindex.\n",
                 {
                     {"hash_type", RPCArg::Type::STR, /* default */ "hash_serialized_2", "Which UTXO set hash should be calculated. Options: 'hash_serialized_2' (the legacy algorithm), 'muhash', 'none'."},
+                    {"hash_or_height", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The block hash or height of the target height (only available with coinstatsindex).", "", {"", "string or numeric"}},
+                    {"use_index", RPCArg::Type::BOOL, /* default */ "true", "Use coinstatsindex, if available."},
                 },
                 RPCResult{
                     RPCResult::Type::OBJ, "", "",
                     {
-                        {RPCResult::Type::NUM, "height", "The current block height (index)"},
-                        {RPCResult::Type::STR_HEX, "bestblock", "The hash of the block at the tip of the chain"},
-                        {RPCResult::Type::NUM, "transactions", "The number of transactions with unspent outputs"},
+                        {RPCResult::Type::NUM, "height", "The block height (index) of the returned statistics"},
+                        {RPCResult::Type::STR_HEX, "bestblock", "The hash of the block at which these statistics are calculated"},
+                        {RPCResult::Type::NUM, "transactions", /* optional */ true, "The number of transactions with unspent outputs (not available when coinstatsindex is used)"},
                         {RPCResult::Type::NUM, "txouts", "The number of unspent transaction outputs"},
                         {RPCResult::Type::NUM, "bogosize", "A meaningless metric for UTXO set size"},
                         {RPCResult::Type::STR_HEX, "hash_serialized_2", /* optional */ true, "The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)"},
                         {RPCResult::Type::STR_HEX, "muhash", /* optional */ true, "The serialized hash (only present if 'muhash' hash_type is chosen)"},
-                        {RPCResult::Type::NUM, "disk_size", "The estimated size of the chainstate on disk"},
+                        {RPCResult::Type::NUM, "disk_size", /* optional */ true, "The estimated size of the chainstate on disk (not available when coinstatsindex is used)"},
                         {RPCResult::Type::STR_AMOUNT, "total_amount", "The total amount"},
                     }},
                 RPCExamples{
-                    HelpExampleCli("gettxoutsetinfo", "")
-            + HelpExampleRpc("gettxoutsetinfo", "")
+                    HelpExampleCli("gettxoutsetinfo", "") +
+                    HelpExampleCli("gettxoutsetinfo", R"("none")") +
+                    HelpExampleCli("gettxoutsetinfo", R"("none" 1000)") +
+                    HelpExampleCli("gettxoutsetinfo", R"("none" '"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09"')") +
+                    HelpExampleRpc("gettxoutsetinfo", "") +
+                    HelpExampleRpc("gettxoutsetinfo", R"("none")") +
+                    HelpExampleRpc("gettxoutsetinfo", R"("none", 1000)") +
+                    HelpExampleRpc("gettxoutsetinfo", R"("none", "00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09")")
                 },
         [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
 {
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
+    stats.index_requested = request.params[2].isNull() || request.params[2].get_bool();
     ::ChainstateActive().ForceFlushStateToDisk();
 
     const CoinStatsHashType hash_type{request.params[0].isNull() ? CoinStatsHashType::HASH_SERIALIZED : ParseHashType(request.params[0].get_str())};
 
     CCoinsView* coins_view = WITH_LOCK(cs_main, return &ChainstateActive().CoinsDB());
     NodeContext& node = EnsureNodeContext(request.context);
-    if (GetUTXOStats(coins_view, stats, hash_type, node.rpc_interruption_point)) {
+
+    const CBlockIndex* pindex{nullptr};
+    if (!request.params[1].isNull()) {
+        if (!g_coin_stats_index) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Querying specific block heights requires coinstatsindex");
+        }
+        if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "hash_serialized_2 hash type cannot be queried for a specific block");
+        }
+        pindex = WITH_LOCK(cs_main, return ParseHashOrHeight(request.params[1]));
+    }
+
+    const bool use_index{g_coin_stats_index && (pindex || (stats.index_requested && hash_type != CoinStatsHashType::HASH_SERIALIZED))};
+    if (use_index && !g_coin_stats_index->BlockUntilSyncedToCurrentChain()) {
+        const IndexSummary summary{g_coin_stats_index->GetSummary()};
+        if (!pindex) {
+            // The statistics of the current tip can still be calculated by scanning the UTXO set.
+            stats.index_requested = false;
+        } else if (pindex->nHeight > summary.best_block_height) {
+            // The statistics of a block the index has already synced past can be returned anyway.
+            throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Unable to get data because coinstatsindex is still syncing. Current height: %d", summary.best_block_height));
+        }
+    }
+
+    if (GetUTXOStats(coins_view, stats, hash_type, node.rpc_interruption_point, pindex)) {
         ret.pushKV("height", (int64_t)stats.nHeight);
         ret.pushKV("bestblock", stats.hashBlock.GetHex());
-        ret.pushKV("transactions", (int64_t)stats.nTransactions);
+        if (!stats.index_used) {
+            ret.pushKV("transactions", (int64_t)stats.nTransactions);
+        }
         ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
         ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
         if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
@@ -1087,7 +1179,9 @@ static RPCHelpMan gettxoutsetinfo()
         if (hash_type == CoinStatsHashType::MUHASH) {
               ret.pushKV("muhash", stats.hashSerialized.GetHex());
         }
-        ret.pushKV("disk_size", stats.nDiskSize);
+        if (!stats.index_used) {
+            ret.pushKV("disk_size", stats.nDiskSize);
+        }
         ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
     } else {
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
@@ -1178,6 +1272,108 @@ static RPCHelpMan gettxout()
     };
 }
 
+static RPCHelpMan gettxspendingprevout()
+{
+    return RPCHelpMan{"gettxspendingprevout",
+                "\nReturns the transactions spending the given outputs, from the mempool and, with -txospenderindex, the active chain.\n",
+                {
+                    {"outputs", RPCArg::Type::ARR, RPCArg::Optional::NO, "The transaction outputs that we want to check",
+                        {
+                            {"", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED, "",
+                                {
+                                    {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The transaction id"},
+                                    {"vout", RPCArg::Type::NUM, RPCArg::Optional::NO, "The output number"},
+                                },
+                            },
+                        },
+                    },
+                },
+                RPCResult{
+                    RPCResult::Type::ARR, "", "",
+                    {
+                        {RPCResult::Type::OBJ, "", "",
+                        {
+                            {RPCResult::Type::STR_HEX, "txid", "the transaction id of the checked output"},
+                            {RPCResult::Type::NUM, "vout", "the vout value of the checked output"},
+                            {RPCResult::Type::STR_HEX, "spendingtxid", /* optional */ true, "the transaction id of the spending transaction, if the output is spent"},
+                            {RPCResult::Type::NUM, "vin", /* optional */ true, "the index of the input spending the output, if the output is spent"},
+                            {RPCResult::Type::STR_HEX, "blockhash", /* optional */ true, "the hash of the block the output was spent in, if the spend is confirmed"},
+                            {RPCResult::Type::NUM, "height", /* optional */ true, "the height of the block the output was spent in, if the spend is confirmed"},
+                        }},
+                    }
+                },
+                RPCExamples{
+                    HelpExampleCli("gettxspendingprevout", "\"[{\\\"txid\\\":\\\"a08e6907dbbd3d809776dbfc5d82e371b764ed838b5655e72f463568df1aadf0\\\",\\\"vout\\\":3}]\"")
+            + HelpExampleRpc("gettxspendingprevout", "\"[{\\\"txid\\\":\\\"a08e6907dbbd3d809776dbfc5d82e371b764ed838b5655e72f463568df1aadf0\\\",\\\"vout\\\":3}]\"")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    RPCTypeCheck(request.params, {UniValue::VARR});
+    const UniValue& output_params = request.params[0];
+    if (output_params.empty()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, outputs are missing");
+    }
+
+    std::vector<COutPoint> prevouts;
+    prevouts.reserve(output_params.size());
+    for (unsigned int idx = 0; idx < output_params.size(); idx++) {
+        const UniValue& o = output_params[idx].get_obj();
+
+        RPCTypeCheckObj(o,
+                        {
+                            {"txid", UniValueType(UniValue::VSTR)},
+                            {"vout", UniValueType(UniValue::VNUM)},
+                        }, /*fAllowNull=*/false, /*fStrict=*/true);
+
+        const uint256 txid(ParseHashO(o, "txid"));
+        const int nOutput = find_value(o, "vout").get_int();
+        if (nOutput < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, vout cannot be negative");
+        }
+
+        prevouts.emplace_back(txid, nOutput);
+    }
+
+    if (g_txospender_index && !g_txospender_index->BlockUntilSyncedToCurrentChain()) {
+        const IndexSummary summary{g_txospender_index->GetSummary()};
+        throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Unable to get data because txospenderindex is still syncing. Current height: %d", summary.best_block_height));
+    }
+
+    const CTxMemPool& mempool = EnsureMemPool(request.context);
+    UniValue result{UniValue::VARR};
+    for (const COutPoint& prevout : prevouts) {
+        UniValue o(UniValue::VOBJ);
+        o.pushKV("txid", prevout.hash.GetHex());
+        o.pushKV("vout", (uint64_t)prevout.n);
+
+        bool in_mempool{false};
+        {
+            // The spending transaction is owned by the mempool, so it may only
+            // be accessed while mempool.cs is held.
+            LOCK(mempool.cs);
+            if (const CTransaction* spending_tx = mempool.GetConflictTx(prevout)) {
+                const auto it = std::find_if(spending_tx->vin.begin(), spending_tx->vin.end(), [&](const CTxIn& txin) { return txin.prevout == prevout; });
+                o.pushKV("spendingtxid", spending_tx->GetHash().GetHex());
+                o.pushKV("vin", (uint64_t)(it - spending_tx->vin.begin()));
+                in_mempool = true;
+            }
+        }
+        TxoSpender spender;
+        if (!in_mempool && g_txospender_index && g_txospender_index->FindSpender(prevout, spender)) {
+            o.pushKV("spendingtxid", spender.input.hash.GetHex());
+            o.pushKV("vin", (uint64_t)spender.input.n);
+            o.pushKV("blockhash", spender.block_hash.GetHex());
+            o.pushKV("height", spender.height);
+        }
+
+        result.push_back(o);
+    }
+
+    return result;
+},
+    };
+}
+
 static RPCHelpMan verifychain()
 {
     return RPCHelpMan{"verifychain",
@@ -1851,29 +2047,7 @@ static RPCHelpMan getblockstats()
 {
     LOCK(cs_main);
 
-    CBlockIndex* pindex;
-    if (request.params[0].isNum()) {
-        const int height = request.params[0].get_int();
-        const int current_tip = ::ChainActive().Height();
-        if (height < 0) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
-        }
-        if (height > current_tip) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
-        }
-
-        pindex = ::ChainActive()[height];
-    } else {
-        const uint256 hash(ParseHashV(request.params[0], "hash_or_height"));
-        pindex = g_chainman.m_blockman.LookupBlockIndex(hash);
-        if (!pindex) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-        }
-        if (!::ChainActive().Contains(pindex)) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
-        }
-    }
-
+    CBlockIndex* pindex = ParseHashOrHeight(request.params[0]);
     CHECK_NONFATAL(pindex != nullptr);
 
     std::set<std::string> stats;
@@ -2076,11 +2250,13 @@ static RPCHelpMan savemempool()
 }
 
 namespace {
-//! Search for a given set of pubkey scripts
-bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results, std::function<void()>& interruption_point)
+//! Search for a given set of pubkey scripts. Several cursors may be searched
+//! concurrently: each adds the part of the txid space it has covered to
+//! scanned, from which the overall scan_progress is derived.
+bool FindScriptPubKey(std::atomic<int>& scan_progress, std::atomic<uint32_t>& scanned, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results, std::function<void()>& interruption_point)
 {
-    scan_progress = 0;
     count = 0;
+    std::optional<uint32_t> last_high;
     while (cursor->Valid()) {
         COutPoint key;
         Coin coin;
@@ -2092,17 +2268,19 @@ bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>&
                 return false;
             }
         }
-        if (count % 256 == 0) {
+        if (count % 256 == 1) {
             // update progress reference every 256 item
             uint32_t high = 0x100 * *key.hash.begin() + *(key.hash.begin() + 1);
-            scan_progress = (int)(high * 100.0 / 65536.0 + 0.5);
+            if (last_high) {
+                scan_progress = (int)((scanned += high - *last_high) * 100.0 / 65536.0 + 0.5);
+            }
+            last_high = high;
         }
         if (needles.count(coin.out.scriptPubKey)) {
             out_results.emplace(key, coin);
         }
         cursor->Next();
     }
-    scan_progress = 100;
     return true;
 }
 } // namespace
@@ -2244,18 +2422,31 @@ static RPCHelpMan scantxoutset()
         g_should_abort_scan = false;
         g_scan_progress = 0;
         int64_t count = 0;
-        std::unique_ptr<CCoinsViewCursor> pcursor;
+        std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
         CBlockIndex* tip;
         {
             LOCK(cs_main);
             ::ChainstateActive().ForceFlushStateToDisk();
-            pcursor = std::unique_ptr<CCoinsViewCursor>(::ChainstateActive().CoinsDB().Cursor());
-            CHECK_NONFATAL(pcursor);
+            cursors = ::ChainstateActive().CoinsDB().Cursors(GetUTXOScanThreads());
+            CHECK_NONFATAL(!cursors.empty() && cursors[0]);
             tip = ::ChainActive().Tip();
             CHECK_NONFATAL(tip);
         }
         NodeContext& node = EnsureNodeContext(request.context);
-        bool res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count, pcursor.get(), needles, coins, node.rpc_interruption_point);
+        std::atomic<uint32_t> scanned{0};
+        std::vector<int64_t> shard_counts(cursors.size());
+        std::vector<std::map<COutPoint, Coin>> shard_coins(cursors.size());
+        std::vector<char> shard_res(cursors.size(), false);
+        ScanCursors(cursors, [&](size_t n, CCoinsViewCursor& cursor) {
+            shard_res[n] = FindScriptPubKey(g_scan_progress, scanned, g_should_abort_scan, shard_counts[n], &cursor, needles, shard_coins[n], node.rpc_interruption_point);
+        });
+        bool res = true;
+        for (size_t n = 0; n < cursors.size(); ++n) {
+            res &= shard_res[n];
+            count += shard_counts[n];
+            coins.insert(shard_coins[n].begin(), shard_coins[n].end());
+        }
+        if (res) g_scan_progress = 100;
         result.pushKV("success", res);
         result.pushKV("txouts", count);
         result.pushKV("height", tip->nHeight);
@@ -2288,6 +2479,147 @@ static RPCHelpMan scantxoutset()
     };
 }
 
+bool AddressOutputsToJSON(const AddressIndex& index, const std::vector<CScript>& scripts, bool include_spent, int start_height, size_t skip, size_t count, bool totals, bool verbose, UniValue& result)
+{
+    UniValue outputs(UniValue::VARR);
+    size_t txouts = 0;
+    CAmount total_received = 0;
+    CAmount balance = 0;
+    bool read_tx = true;
+    for (const CScript& script : scripts) {
+        bool found = index.FindOutputs(script, start_height, [&](const AddressOutput& output) {
+            if (totals) {
+                total_received += output.amount;
+                if (!output.IsSpent()) balance += output.amount;
+            }
+            if (output.IsSpent() && !include_spent) return true;
+            if (txouts++ < skip) return true;
+            // Without totals, the rest of the outputs need not be read.
+            if (outputs.size() >= count) return totals;
+
+            UniValue entry(UniValue::VOBJ);
+            entry.pushKV("txid", output.outpoint.hash.GetHex());
+            entry.pushKV("vout", (int)output.outpoint.n);
+            entry.pushKV("scriptPubKey", HexStr(script));
+            entry.pushKV("height", output.height);
+            entry.pushKV("amount", ValueFromAmount(output.amount));
+            if (output.IsSpent()) {
+                UniValue spent(UniValue::VOBJ);
+                spent.pushKV("txid", output.spent_by.hash.GetHex());
+                spent.pushKV("vin", (int)output.spent_by.n);
+                spent.pushKV("height", output.spent_height);
+                entry.pushKV("spent", spent);
+            }
+            if (verbose) {
+                CTransactionRef tx;
+                if (!index.ReadTx(output, tx)) return read_tx = false;
+                entry.pushKV("hex", EncodeHexTx(*tx, RPCSerializationFlags()));
+            }
+            outputs.push_back(entry);
+            return true;
+        });
+        if (!found || !read_tx) return false;
+        if (!totals && outputs.size() >= count) break;
+    }
+
+    result = UniValue(UniValue::VOBJ);
+    result.pushKV("height", index.GetSummary().best_block_height);
+    if (totals) {
+        result.pushKV("txouts", (uint64_t)txouts);
+        result.pushKV("total_received", ValueFromAmount(total_received));
+        result.pushKV("balance", ValueFromAmount(balance));
+    }
+    result.pushKV("outputs", outputs);
+    return true;
+}
+
+static RPCHelpMan getaddressoutputs()
+{
+    return RPCHelpMan{"getaddressoutputs",
+                "\nReturns the outputs paying to an address or output descriptor, and the inputs spending them.\n"
+                "Requires -addressindex. Outputs are ordered by scriptPubKey and then by height. Ranged descriptors\n"
+                "are expanded over their first 1000 indexes. To page through a long history, pass the height of the\n"
+                "last output listed as start_height and the number of outputs listed at that height as skip.\n",
+                {
+                    {"address_or_descriptor", RPCArg::Type::STR, RPCArg::Optional::NO, "An address or an output descriptor"},
+                    {"include_spent", RPCArg::Type::BOOL, /* default */ "true", "Whether to list the spent outputs as well"},
+                    {"skip", RPCArg::Type::NUM, /* default */ "0", "The number of outputs to skip"},
+                    {"count", RPCArg::Type::NUM, /* default */ "1000", "The maximum number of outputs to list"},
+                    {"verbose", RPCArg::Type::BOOL, /* default */ "false", "Whether to include the serialized transaction creating each output"},
+                    {"start_height", RPCArg::Type::NUM, /* default */ "0", "The height to start listing outputs from"},
+                    {"totals", RPCArg::Type::BOOL, /* default */ "false", "Whether to count and total all matching outputs, which reads the whole history of the scripts"},
+                },
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::NUM, "height", "The height of the block the index is synced to"},
+                        {RPCResult::Type::NUM, "txouts", /* optional */ true, "The number of matching outputs from start_height, across all pages, if totals is true"},
+                        {RPCResult::Type::STR_AMOUNT, "total_received", /* optional */ true, "The total amount of the outputs from start_height paying to the scripts in " + CURRENCY_UNIT + ", if totals is true"},
+                        {RPCResult::Type::STR_AMOUNT, "balance", /* optional */ true, "The total amount of the unspent outputs from start_height paying to the scripts in " + CURRENCY_UNIT + ", if totals is true"},
+                        {RPCResult::Type::ARR, "outputs", "",
+                            {
+                                {RPCResult::Type::OBJ, "", "",
+                                    {
+                                        {RPCResult::Type::STR_HEX, "txid", "The transaction id"},
+                                        {RPCResult::Type::NUM, "vout", "The vout value"},
+                                        {RPCResult::Type::STR_HEX, "scriptPubKey", "The script key"},
+                                        {RPCResult::Type::NUM, "height", "Height of the block the output was created in"},
+                                        {RPCResult::Type::STR_AMOUNT, "amount", "The amount in " + CURRENCY_UNIT + " of the output"},
+                                        {RPCResult::Type::OBJ, "spent", /* optional */ true, "The input spending the output, if it is spent",
+                                            {
+                                                {RPCResult::Type::STR_HEX, "txid", "The spending transaction id"},
+                                                {RPCResult::Type::NUM, "vin", "The index of the input in the spending transaction"},
+                                                {RPCResult::Type::NUM, "height", "Height of the block the output was spent in"},
+                                            }},
+                                        {RPCResult::Type::STR_HEX, "hex", /* optional */ true, "The serialized transaction creating the output, if verbose is true"},
+                                    }},
+                            }},
+                    }},
+                RPCExamples{
+                    HelpExampleCli("getaddressoutputs", "\"" + EXAMPLE_ADDRESS[0] + "\"")
+                  + HelpExampleCli("getaddressoutputs", "\"" + EXAMPLE_ADDRESS[0] + "\" false 0 100")
+                  + HelpExampleCli("getaddressoutputs", "\"" + EXAMPLE_ADDRESS[0] + "\" true 0 1000 false 0 true")
+                  + HelpExampleRpc("getaddressoutputs", "\"" + EXAMPLE_ADDRESS[0] + "\"")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    if (!g_address_index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled (-addressindex)");
+    }
+
+    std::vector<CScript> scripts;
+    const CTxDestination dest = DecodeDestination(request.params[0].get_str());
+    if (IsValidDestination(dest)) {
+        scripts.push_back(GetScriptForDestination(dest));
+    } else {
+        FlatSigningProvider provider;
+        scripts = EvalDescriptorStringOrObject(request.params[0], provider);
+    }
+
+    const bool include_spent = request.params[1].isNull() || request.params[1].get_bool();
+    const int skip = request.params[2].isNull() ? 0 : request.params[2].get_int();
+    const int count = request.params[3].isNull() ? 1000 : request.params[3].get_int();
+    const bool verbose = !request.params[4].isNull() && request.params[4].get_bool();
+    const int start_height = request.params[5].isNull() ? 0 : request.params[5].get_int();
+    const bool totals = !request.params[6].isNull() && request.params[6].get_bool();
+    if (skip < 0 || count < 0 || start_height < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "skip, count and start_height must not be negative");
+    }
+
+    if (!g_address_index->BlockUntilSyncedToCurrentChain()) {
+        const IndexSummary summary{g_address_index->GetSummary()};
+        throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Unable to get data because addressindex is still syncing. Current height: %d", summary.best_block_height));
+    }
+
+    UniValue result;
+    if (!AddressOutputsToJSON(*g_address_index, scripts, include_spent, start_height, skip, count, totals, verbose, result)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the address index");
+    }
+    return result;
+},
+    };
+}
+
 static RPCHelpMan getblockfilter()
 {
     return RPCHelpMan{"getblockfilter",
@@ -2389,6 +2721,7 @@ static RPCHelpMan dumptxoutset()
                     {RPCResult::Type::NUM, "coins_written", "the number of coins written in the snapshot"},
                     {RPCResult::Type::STR_HEX, "base_hash", "the hash of the base of the snapshot"},
                     {RPCResult::Type::NUM, "base_height", "the height of the base of the snapshot"},
+                    {RPCResult::Type::STR_HEX, "txoutset_hash", "the serialized hash of the UTXO set, as committed to by assumeutxo (hash_serialized_2 of gettxoutsetinfo)"},
                     {RPCResult::Type::STR, "path", "the absolute path that the snapshot was written to"},
                 }
         },
@@ -2424,14 +2757,12 @@ static RPCHelpMan dumptxoutset()
 UniValue CreateUTXOSnapshot(NodeContext& node, CChainState& chainstate, CAutoFile& afile)
 {
     std::unique_ptr<CCoinsViewCursor> pcursor;
-    CCoinsStats stats;
     CBlockIndex* tip;
 
     {
         // We need to lock cs_main to ensure that the coinsdb isn't written to
-        // between (i) flushing coins cache to disk (coinsdb), (ii) getting stats
-        // based upon the coinsdb, and (iii) constructing a cursor to the
-        // coinsdb for use below this block.
+        // between (i) flushing coins cache to disk (coinsdb) and (ii)
+        // constructing a cursor to the coinsdb for use below this block.
         //
         // Cursors returned by leveldb iterate over snapshots, so the contents
         // of the pcursor will not be affected by simultaneous writes during
@@ -2444,19 +2775,32 @@ UniValue CreateUTXOSnapshot(NodeContext& node, CChainState& chainstate, CAutoFil
 
         chainstate.ForceFlushStateToDisk();
 
-        if (!GetUTXOStats(&chainstate.CoinsDB(), stats, CoinStatsHashType::NONE, node.rpc_interruption_point)) {
-            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
-        }
-
         pcursor = std::unique_ptr<CCoinsViewCursor>(chainstate.CoinsDB().Cursor());
-        tip = g_chainman.m_blockman.LookupBlockIndex(stats.hashBlock);
+        tip = g_chainman.m_blockman.LookupBlockIndex(pcursor->GetBestBlock());
         CHECK_NONFATAL(tip);
     }
 
-    SnapshotMetadata metadata{tip->GetBlockHash(), stats.coins_count, tip->nChainTx};
+    // The number of coins is only known once they are all written, so the
+    // metadata is written again at the end.
+    SnapshotMetadata metadata{tip->GetBlockHash(), 0, tip->nChainTx};
 
     afile << metadata;
 
+    SnapshotHasher hasher{tip->GetBlockHash()};
+    uint256 txid;
+    SnapshotHasher::Outputs outputs;
+    auto write_outputs = [&] {
+        afile << txid;
+        WriteCompactSize(afile, outputs.size());
+        for (const auto& output : outputs) {
+            WriteCompactSize(afile, output.first);
+            afile << output.second;
+        }
+        metadata.m_coins_count += outputs.size();
+        hasher.Add(txid, std::move(outputs));
+        outputs.clear();
+    };
+
     COutPoint key;
     Coin coin;
     unsigned int iter{0};
@@ -2465,23 +2809,135 @@ UniValue CreateUTXOSnapshot(NodeContext& node, CChainState& chainstate, CAutoFil
         if (iter % 5000 == 0) node.rpc_interruption_point();
         ++iter;
         if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            afile << key;
-            afile << coin;
+            if (!outputs.empty() && key.hash != txid) write_outputs();
+            txid = key.hash;
+            outputs.emplace(key.n, std::move(coin));
         }
 
         pcursor->Next();
     }
+    if (!outputs.empty()) write_outputs();
+
+    const CCoinsStats stats{hasher.Finalize()};
+    CHECK_NONFATAL(stats.coins_count == metadata.m_coins_count);
 
+    if (fseek(afile.Get(), 0, SEEK_SET) != 0) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to write the snapshot metadata");
+    }
+    afile << metadata;
     afile.fclose();
 
     UniValue result(UniValue::VOBJ);
-    result.pushKV("coins_written", stats.coins_count);
+    result.pushKV("coins_written", metadata.m_coins_count);
     result.pushKV("base_hash", tip->GetBlockHash().ToString());
     result.pushKV("base_height", tip->nHeight);
+    result.pushKV("txoutset_hash", stats.hashSerialized.GetHex());
 
     return result;
 }
 
+static RPCHelpMan loadtxoutset()
+{
+    return RPCHelpMan{
+        "loadtxoutset",
+        "\nLoad a serialized UTXO set written by dumptxoutset and make it the active chainstate.\n"
+        "The node then serves the chain from the base of the snapshot, while the blocks leading up\n"
+        "to it are downloaded and validated in the background. The snapshot must match the\n"
+        "assumeutxo chain parameters, its base block header must be known, and the active chain\n"
+        "must lead up to it. The snapshot chainstate is resumed after a restart, and replaces\n"
+        "the validated chainstate once the background validation has completed.\n",
+        {
+            {"path",
+                RPCArg::Type::STR,
+                RPCArg::Optional::NO,
+                /* default_val */ "",
+                "path to the snapshot file. If relative, will be prefixed by datadir."},
+        },
+        RPCResult{
+            RPCResult::Type::OBJ, "", "",
+                {
+                    {RPCResult::Type::NUM, "coins_loaded", "the number of coins loaded from the snapshot"},
+                    {RPCResult::Type::STR_HEX, "tip_hash", "the hash of the base of the snapshot"},
+                    {RPCResult::Type::NUM, "base_height", "the height of the base of the snapshot"},
+                    {RPCResult::Type::STR, "path", "the absolute path that the snapshot was loaded from"},
+                }
+        },
+        RPCExamples{
+            HelpExampleCli("loadtxoutset", "utxo.dat")
+        },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    ChainstateManager& chainman = EnsureChainman(request.context);
+    const fs::path path = fsbridge::AbsPathJoin(GetDataDir(), request.params[0].get_str());
+
+    if (fPruneMode) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Snapshots cannot be loaded in prune mode");
+    }
+    bool have_index = g_txindex || g_coin_stats_index || g_address_index || g_txospender_index;
+    ForEachBlockFilterIndex([&](BlockFilterIndex&) { have_index = true; });
+    if (have_index) {
+        // The indexes would have to follow the snapshot chainstate without its history.
+        throw JSONRPCError(RPC_MISC_ERROR, "Snapshots cannot be loaded with indexes enabled");
+    }
+
+    FILE* file{fsbridge::fopen(path, "rb")};
+    CAutoFile afile{file, SER_DISK, CLIENT_VERSION};
+    if (afile.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Couldn't open file " + path.string() + " for reading");
+    }
+
+    SnapshotMetadata metadata;
+    try {
+        afile >> metadata;
+    } catch (const std::ios_base::failure& e) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("Unable to parse snapshot metadata: %s", e.what()));
+    }
+
+    int base_height;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* base = chainman.m_blockman.LookupBlockIndex(metadata.m_base_blockhash);
+        if (!base) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
+                "The base block header " + metadata.m_base_blockhash.ToString() + " of the snapshot is not known");
+        }
+        if (base->nStatus & BLOCK_FAILED_MASK) {
+            throw JSONRPCError(RPC_MISC_ERROR, "The base block of the snapshot is invalid");
+        }
+        if (chainman.ActiveHeight() >= base->nHeight) {
+            throw JSONRPCError(RPC_MISC_ERROR, "The active chain is not behind the base block of the snapshot");
+        }
+        if (chainman.ActiveTip() && base->GetAncestor(chainman.ActiveHeight()) != chainman.ActiveTip()) {
+            throw JSONRPCError(RPC_MISC_ERROR, "The active chain does not lead up to the base block of the snapshot");
+        }
+        base_height = base->nHeight;
+    }
+
+    if (!chainman.ActivateSnapshot(afile, metadata, /* in_memory */ false)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to load UTXO snapshot " + path.string() + ", see debug.log");
+    }
+
+    // Connect the blocks we already have, both on top of the snapshot and in the background.
+    for (CChainState* chainstate : chainman.GetAll()) {
+        BlockValidationState state;
+        if (!chainstate->ActivateBestChain(state, Params())) {
+            throw JSONRPCError(RPC_DATABASE_ERROR, state.ToString());
+        }
+    }
+    if (!WITH_LOCK(cs_main, return chainman.MaybeCompleteSnapshotValidation())) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The snapshot does not match the validated chain, see debug.log");
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("coins_loaded", metadata.m_coins_count);
+    result.pushKV("tip_hash", metadata.m_base_blockhash.ToString());
+    result.pushKV("base_height", base_height);
+    result.pushKV("path", path.string());
+    return result;
+},
+    };
+}
+
 void RegisterBlockchainRPCCommands(CRPCTable &t)
 {
 // clang-format off
@@ -2505,12 +2961,14 @@ static const CRPCCommand commands[] =
     { "blockchain",         &getrawmempool,                      },
     { "blockchain",         &gettxout,                           },
     { "blockchain",         &gettxoutsetinfo,                    },
+    { "blockchain",         &gettxspendingprevout,               },
     { "blockchain",         &pruneblockchain,                    },
     { "blockchain",         &savemempool,                        },
     { "blockchain",         &verifychain,                        },
 
     { "blockchain",         &preciousblock,                      },
     { "blockchain",         &scantxoutset,                       },
+    { "blockchain",         &getaddressoutputs,                  },
     { "blockchain",         &getblockfilter,                     },
 
     /* Not shown in help */
@@ -2521,6 +2979,7 @@ static const CRPCCommand commands[] =
     { "hidden",              &waitforblockheight,                },
     { "hidden",              &syncwithvalidationinterfacequeue,  },
     { "hidden",              &dumptxoutset,                      },
+    { "hidden",              &loadtxoutset,                      },
 };
 // clang-format on
     for (const auto& c : commands) {
@@ -14,10 +14,12 @@
 
 extern RecursiveMutex cs_main;
 
+class AddressIndex;
 class CBlock;
 class CBlockIndex;
 class CBlockPolicyEstimator;
 class CChainState;
+class CScript;
 class CTxMemPool;
 class ChainstateManager;
 class UniValue;
@@ -54,6 +56,14 @@ UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex
 /** Used by getblockstats to get feerates at different percentiles by weight  */
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight);
 
+/**
+ * Outputs paying to the scripts, found in the address index, to JSON. Of the outputs created at or
+ * above start_height, ordered by script and then height, the first skip are left out and at most
+ * count are listed. Only with totals are the remaining outputs read, to count and total all of them.
+ * Returns false if the index could not be read.
+ */
+bool AddressOutputsToJSON(const AddressIndex& index, const std::vector<CScript>& scripts, bool include_spent, int start_height, size_t skip, size_t count, bool totals, bool verbose, UniValue& result);
+
 NodeContext& EnsureNodeContext(const util::Ref& context);
 CTxMemPool& EnsureMemPool(const util::Ref& context);
 ChainstateManager& EnsureChainman(const util::Ref& context);
@@ -144,6 +144,15 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "verifychain", 1, "nblocks" },
     { "getblockstats", 0, "hash_or_height" },
     { "getblockstats", 1, "stats" },
+    { "gettxoutsetinfo", 1, "hash_or_height" },
+    { "gettxoutsetinfo", 2, "use_index" },
+    { "getaddressoutputs", 1, "include_spent" },
+    { "getaddressoutputs", 2, "skip" },
+    { "getaddressoutputs", 3, "count" },
+    { "getaddressoutputs", 4, "verbose" },
+    { "getaddressoutputs", 5, "start_height" },
+    { "getaddressoutputs", 6, "totals" },
+    { "gettxspendingprevout", 0, "outputs" },
     { "pruneblockchain", 0, "height" },
     { "keypoolrefill", 0, "newsize" },
     { "getrawmempool", 0, "verbose" },
@@ -120,7 +120,41 @@ bool CachingTransactionSignatureChecker::VerifySchnorrSignature(Span<const unsig
     uint256 entry;
     signatureCache.ComputeEntrySchnorr(entry, sighash, sig, pubkey);
     if (signatureCache.Get(entry, !store)) return true;
+    if (m_batch) {
+        // The result is only known once the whole batch is verified, so
+        // deferred signatures are never stored in the cache.
+        m_batch->Add(sig, pubkey, sighash);
+        return true;
+    }
     if (!TransactionSignatureChecker::VerifySchnorrSignature(sig, pubkey, sighash)) return false;
     if (store) signatureCache.Set(entry);
     return true;
 }
+
+void BatchSchnorrVerifier::Add(Span<const unsigned char> sig, const XOnlyPubKey& pubkey, const uint256& sighash)
+{
+    assert(sig.size() == 64);
+    LOCK(m_mutex);
+    m_pubkeys.push_back(pubkey);
+    m_sighashes.push_back(sighash);
+    m_sigs.emplace_back();
+    std::copy(sig.begin(), sig.end(), m_sigs.back().begin());
+}
+
+bool BatchSchnorrVerifier::Verify()
+{
+    std::vector<XOnlyPubKey> pubkeys;
+    std::vector<uint256> sighashes;
+    std::vector<std::array<unsigned char, 64>> sigs;
+    {
+        LOCK(m_mutex);
+        pubkeys.swap(m_pubkeys);
+        sighashes.swap(m_sighashes);
+        sigs.swap(m_sigs);
+    }
+    if (XOnlyPubKey::VerifySchnorrBatch(pubkeys, sighashes, sigs)) return true;
+    for (size_t i = 0; i < pubkeys.size(); ++i) {
+        if (!pubkeys[i].VerifySchnorr(sighashes[i], sigs[i])) return false;
+    }
+    return true;
+}
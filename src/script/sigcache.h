@@ -6,10 +6,15 @@
 #ifndef BITCOIN_SCRIPT_SIGCACHE_H
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
+#include <pubkey.h>
 #include <script/interpreter.h>
 #include <span.h>
+#include <sync.h>
+#include <uint256.h>
 #include <util/hasher.h>
 
+#include <array>
+#include <atomic>
 #include <vector>
 
 // DoS prevention: limit cache size to 32MB (over 1000000 entries on 64-bit
@@ -21,13 +26,66 @@ static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
 class CPubKey;
 
+/**
+ * Collects Schnorr signatures so that they can be verified together in a
+ * single batch, which is considerably faster than verifying them one by one.
+ * Signatures can be added from several script checking threads at once.
+ *
+ * A batch can also track the script checks that add signatures to it: every
+ * check registered with AddCheck() calls FinishCheck() once it has run, and
+ * the owner calls FinishCheck() once it registers no more checks. Whichever
+ * call comes last verifies the batch, so that batches are verified by the
+ * script checking threads instead of all at the end by the owner.
+ */
+class BatchSchnorrVerifier
+{
+private:
+    Mutex m_mutex;
+    std::vector<XOnlyPubKey> m_pubkeys GUARDED_BY(m_mutex);
+    std::vector<uint256> m_sighashes GUARDED_BY(m_mutex);
+    std::vector<std::array<unsigned char, 64>> m_sigs GUARDED_BY(m_mutex);
+    //! Registered checks that have not finished, plus one until the owner finishes registering.
+    std::atomic<unsigned int> m_pending{1};
+    //! Number of checks registered so far
+    unsigned int m_checks{0};
+
+public:
+    /** Add a signature to the batch. sig must be exactly 64 bytes. */
+    void Add(Span<const unsigned char> sig, const XOnlyPubKey& pubkey, const uint256& sighash);
+
+    /**
+     * Verify all signatures added since the last call, and clear the batch.
+     * If the batch does not verify, the signatures are checked individually
+     * before giving up, so a false result always means one of them is invalid.
+     */
+    bool Verify();
+
+    /** Register a script check that may add signatures. Not thread-safe, only the owner registers checks. */
+    void AddCheck()
+    {
+        ++m_checks;
+        ++m_pending;
+    }
+
+    /** Number of checks registered so far. */
+    unsigned int CheckCount() const { return m_checks; }
+
+    /**
+     * Mark a registered check, or the registration of checks, as finished. The
+     * last call verifies the batch and returns its result; other calls return true.
+     */
+    bool FinishCheck() { return --m_pending > 0 || Verify(); }
+};
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
     bool store;
+    //! If set, Schnorr signatures that miss the cache are deferred to this batch instead of being verified.
+    BatchSchnorrVerifier* m_batch;
 
 public:
-    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, bool storeIn, PrecomputedTransactionData& txdataIn) : TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn), store(storeIn) {}
+    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, bool storeIn, PrecomputedTransactionData& txdataIn, BatchSchnorrVerifier* batch = nullptr) : TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn), store(storeIn), m_batch(batch) {}
 
     bool VerifyECDSASignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const override;
     bool VerifySchnorrSignature(Span<const unsigned char> sig, const XOnlyPubKey& pubkey, const uint256& sighash) const override;
@@ -104,6 +104,37 @@ SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_schnorrsig_verify(
     const secp256k1_xonly_pubkey *pubkey
 ) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(4);
 
+/** Verify a batch of Schnorr signatures at once.
+ *
+ *  Checks a random linear combination of the verification equations of all
+ *  signatures with a single multi-scalar multiplication, which is faster
+ *  than verifying them one by one. The randomizers are derived from a hash of
+ *  all inputs. If the batch fails, at least one of the signatures is invalid,
+ *  but this function does not tell which one.
+ *
+ *  Returns: 1: all signatures are correct (or n_sigs is 0)
+ *           0: at least one signature is incorrect
+ *  Args:    ctx: a secp256k1 context object, initialized for verification.
+ *       scratch: scratch space used for the multi-scalar multiplication. If
+ *                NULL, or too small to be useful, the points are multiplied one
+ *                by one, which is not faster than individual verification.
+ *  In:    sig64: array of pointers to the 64-byte signatures to verify (can
+ *                only be NULL if n_sigs is 0)
+ *         msg32: array of pointers to the 32-byte messages being verified
+ *                (can only be NULL if n_sigs is 0)
+ *        pubkey: array of pointers to the x-only public keys to verify with
+ *                (can only be NULL if n_sigs is 0)
+ *        n_sigs: number of signatures in the batch
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_schnorrsig_verify_batch(
+    const secp256k1_context* ctx,
+    secp256k1_scratch_space *scratch,
+    const unsigned char *const *sig64,
+    const unsigned char *const *msg32,
+    const secp256k1_xonly_pubkey *const *pubkey,
+    size_t n_sigs
+) SECP256K1_ARG_NONNULL(1);
+
 #ifdef __cplusplus
 }
 #endif
@@ -236,4 +236,134 @@ int secp256k1_schnorrsig_verify(const secp256k1_context* ctx, const unsigned cha
            secp256k1_fe_equal_var(&rx, &r.x);
 }
 
+/* Initializes SHA256 as the tagged hash with tag "BIP0340/batch". */
+static void secp256k1_schnorrsig_sha256_tagged_batch(secp256k1_sha256 *sha) {
+    static const unsigned char tag[13] = "BIP0340/batch";
+    secp256k1_sha256_initialize_tagged(sha, tag, sizeof(tag));
+}
+
+typedef struct {
+    const secp256k1_context *ctx;
+    const unsigned char *const *sig64;
+    const unsigned char *const *msg32;
+    const secp256k1_xonly_pubkey *const *pubkey;
+    unsigned char seed[32];
+} secp256k1_schnorrsig_verify_batch_ecmult_data;
+
+/* Computes the randomizer a_i for the i-th signature of a batch. The first
+ * randomizer is 1; the others are derived from the seed, which commits to all
+ * signatures, messages and public keys of the batch. */
+static void secp256k1_schnorrsig_batch_randomizer(secp256k1_scalar *a, const unsigned char *seed32, size_t i) {
+    secp256k1_sha256 sha;
+    unsigned char buf[32];
+    unsigned char idx[8];
+    int j;
+
+    if (i == 0) {
+        secp256k1_scalar_set_int(a, 1);
+        return;
+    }
+    for (j = 0; j < 8; j++) {
+        idx[j] = (unsigned char)((uint64_t)i >> (8 * j));
+    }
+    secp256k1_sha256_initialize(&sha);
+    secp256k1_sha256_write(&sha, seed32, 32);
+    secp256k1_sha256_write(&sha, idx, sizeof(idx));
+    secp256k1_sha256_finalize(&sha, buf);
+    secp256k1_scalar_set_b32(a, buf, NULL);
+}
+
+/* Provides the points R_i (even idx) and P_i (odd idx) with the scalars a_i
+ * and a_i*e_i of the batch equation to secp256k1_ecmult_multi_var. */
+static int secp256k1_schnorrsig_verify_batch_ecmult_callback(secp256k1_scalar *sc, secp256k1_ge *pt, size_t idx, void *data) {
+    secp256k1_schnorrsig_verify_batch_ecmult_data *ecmult_data = (secp256k1_schnorrsig_verify_batch_ecmult_data *) data;
+    size_t i = idx / 2;
+
+    secp256k1_schnorrsig_batch_randomizer(sc, ecmult_data->seed, i);
+    if (idx % 2 == 0) {
+        secp256k1_fe rx;
+        if (!secp256k1_fe_set_b32(&rx, &ecmult_data->sig64[i][0])) {
+            return 0;
+        }
+        return secp256k1_ge_set_xo_var(pt, &rx, 0);
+    } else {
+        secp256k1_scalar e;
+        unsigned char buf[32];
+        if (!secp256k1_xonly_pubkey_load(ecmult_data->ctx, pt, ecmult_data->pubkey[i])) {
+            return 0;
+        }
+        secp256k1_fe_get_b32(buf, &pt->x);
+        secp256k1_schnorrsig_challenge(&e, &ecmult_data->sig64[i][0], ecmult_data->msg32[i], buf);
+        secp256k1_scalar_mul(sc, sc, &e);
+        return 1;
+    }
+}
+
+int secp256k1_schnorrsig_verify_batch(const secp256k1_context* ctx, secp256k1_scratch_space *scratch, const unsigned char *const *sig64, const unsigned char *const *msg32, const secp256k1_xonly_pubkey *const *pubkey, size_t n_sigs) {
+    secp256k1_schnorrsig_verify_batch_ecmult_data ecmult_data;
+    secp256k1_sha256 sha;
+    secp256k1_scalar s;
+    secp256k1_scalar a;
+    secp256k1_scalar sum_s;
+    secp256k1_gej rj;
+    size_t i;
+    int overflow;
+
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(secp256k1_ecmult_context_is_built(&ctx->ecmult_ctx));
+    ARG_CHECK(n_sigs == 0 || sig64 != NULL);
+    ARG_CHECK(n_sigs == 0 || msg32 != NULL);
+    ARG_CHECK(n_sigs == 0 || pubkey != NULL);
+    /* Each signature contributes two points to the multi-multiplication. */
+    ARG_CHECK(n_sigs <= SIZE_MAX / 2);
+
+    if (n_sigs == 0) {
+        return 1;
+    }
+
+    /* Seed the randomizers with everything that is being verified, so that
+     * they cannot be predicted by whoever created the signatures. */
+    secp256k1_schnorrsig_sha256_tagged_batch(&sha);
+    for (i = 0; i < n_sigs; i++) {
+        unsigned char buf[32];
+        secp256k1_ge pk;
+        ARG_CHECK(sig64[i] != NULL);
+        ARG_CHECK(msg32[i] != NULL);
+        ARG_CHECK(pubkey[i] != NULL);
+        if (!secp256k1_xonly_pubkey_load(ctx, &pk, pubkey[i])) {
+            return 0;
+        }
+        secp256k1_fe_get_b32(buf, &pk.x);
+        secp256k1_sha256_write(&sha, sig64[i], 64);
+        secp256k1_sha256_write(&sha, msg32[i], 32);
+        secp256k1_sha256_write(&sha, buf, 32);
+    }
+    secp256k1_sha256_finalize(&sha, ecmult_data.seed);
+
+    /* Compute -sum(a_i*s_i), the scalar of the generator. */
+    secp256k1_scalar_clear(&sum_s);
+    for (i = 0; i < n_sigs; i++) {
+        secp256k1_scalar_set_b32(&s, &sig64[i][32], &overflow);
+        if (overflow) {
+            return 0;
+        }
+        secp256k1_schnorrsig_batch_randomizer(&a, ecmult_data.seed, i);
+        secp256k1_scalar_mul(&s, &s, &a);
+        secp256k1_scalar_add(&sum_s, &sum_s, &s);
+    }
+    secp256k1_scalar_negate(&sum_s, &sum_s);
+
+    ecmult_data.ctx = ctx;
+    ecmult_data.sig64 = sig64;
+    ecmult_data.msg32 = msg32;
+    ecmult_data.pubkey = pubkey;
+
+    /* All signatures are valid (with overwhelming probability) iff
+     * -sum(a_i*s_i)*G + sum(a_i*R_i) + sum(a_i*e_i*P_i) is the point at infinity. */
+    if (!secp256k1_ecmult_multi_var(&ctx->error_callback, &ctx->ecmult_ctx, scratch, &rj, &sum_s, secp256k1_schnorrsig_verify_batch_ecmult_callback, (void *) &ecmult_data, 2 * n_sigs)) {
+        return 0;
+    }
+    return secp256k1_gej_is_infinity(&rj);
+}
+
 #endif
@@ -692,12 +692,15 @@ void test_schnorrsig_sign(void) {
 
 #define N_SIGS 3
 /* Creates N_SIGS valid signatures and verifies them with verify and
- * verify_batch (TODO). Then flips some bits and checks that verification now
+ * verify_batch. Then flips some bits and checks that verification now
  * fails. */
-void test_schnorrsig_sign_verify(void) {
+void test_schnorrsig_sign_verify(secp256k1_scratch_space *scratch) {
     unsigned char sk[32];
     unsigned char msg[N_SIGS][32];
     unsigned char sig[N_SIGS][64];
+    const unsigned char *sig_arr[N_SIGS];
+    const unsigned char *msg_arr[N_SIGS];
+    const secp256k1_xonly_pubkey *pk_arr[N_SIGS];
     size_t i;
     secp256k1_keypair keypair;
     secp256k1_xonly_pubkey pk;
@@ -711,30 +714,41 @@ void test_schnorrsig_sign_verify(void) {
         secp256k1_testrand256(msg[i]);
         CHECK(secp256k1_schnorrsig_sign(ctx, sig[i], msg[i], &keypair, NULL, NULL));
         CHECK(secp256k1_schnorrsig_verify(ctx, sig[i], msg[i], &pk));
+        sig_arr[i] = sig[i];
+        msg_arr[i] = msg[i];
+        pk_arr[i] = &pk;
     }
+    CHECK(secp256k1_schnorrsig_verify_batch(ctx, scratch, sig_arr, msg_arr, pk_arr, N_SIGS));
+    CHECK(secp256k1_schnorrsig_verify_batch(ctx, NULL, sig_arr, msg_arr, pk_arr, N_SIGS));
+    CHECK(secp256k1_schnorrsig_verify_batch(ctx, scratch, sig_arr, msg_arr, pk_arr, 1));
+    CHECK(secp256k1_schnorrsig_verify_batch(ctx, scratch, NULL, NULL, NULL, 0));
 
     {
         /* Flip a few bits in the signature and in the message and check that
-         * verify and verify_batch (TODO) fail */
+         * verify and verify_batch fail */
         size_t sig_idx = secp256k1_testrand_int(N_SIGS);
         size_t byte_idx = secp256k1_testrand_int(32);
         unsigned char xorbyte = secp256k1_testrand_int(254)+1;
         sig[sig_idx][byte_idx] ^= xorbyte;
         CHECK(!secp256k1_schnorrsig_verify(ctx, sig[sig_idx], msg[sig_idx], &pk));
+        CHECK(!secp256k1_schnorrsig_verify_batch(ctx, scratch, sig_arr, msg_arr, pk_arr, N_SIGS));
         sig[sig_idx][byte_idx] ^= xorbyte;
 
         byte_idx = secp256k1_testrand_int(32);
         sig[sig_idx][32+byte_idx] ^= xorbyte;
         CHECK(!secp256k1_schnorrsig_verify(ctx, sig[sig_idx], msg[sig_idx], &pk));
+        CHECK(!secp256k1_schnorrsig_verify_batch(ctx, scratch, sig_arr, msg_arr, pk_arr, N_SIGS));
         sig[sig_idx][32+byte_idx] ^= xorbyte;
 
         byte_idx = secp256k1_testrand_int(32);
         msg[sig_idx][byte_idx] ^= xorbyte;
         CHECK(!secp256k1_schnorrsig_verify(ctx, sig[sig_idx], msg[sig_idx], &pk));
+        CHECK(!secp256k1_schnorrsig_verify_batch(ctx, scratch, sig_arr, msg_arr, pk_arr, N_SIGS));
         msg[sig_idx][byte_idx] ^= xorbyte;
 
         /* Check that above bitflips have been reversed correctly */
         CHECK(secp256k1_schnorrsig_verify(ctx, sig[sig_idx], msg[sig_idx], &pk));
+        CHECK(secp256k1_schnorrsig_verify_batch(ctx, scratch, sig_arr, msg_arr, pk_arr, N_SIGS));
     }
 
     /* Test overflowing s */
@@ -742,6 +756,7 @@ void test_schnorrsig_sign_verify(void) {
     CHECK(secp256k1_schnorrsig_verify(ctx, sig[0], msg[0], &pk));
     memset(&sig[0][32], 0xFF, 32);
     CHECK(!secp256k1_schnorrsig_verify(ctx, sig[0], msg[0], &pk));
+    CHECK(!secp256k1_schnorrsig_verify_batch(ctx, scratch, sig_arr, msg_arr, pk_arr, N_SIGS));
 
     /* Test negative s */
     CHECK(secp256k1_schnorrsig_sign(ctx, sig[0], msg[0], &keypair, NULL, NULL));
@@ -750,6 +765,7 @@ void test_schnorrsig_sign_verify(void) {
     secp256k1_scalar_negate(&s, &s);
     secp256k1_scalar_get_b32(&sig[0][32], &s);
     CHECK(!secp256k1_schnorrsig_verify(ctx, sig[0], msg[0], &pk));
+    CHECK(!secp256k1_schnorrsig_verify_batch(ctx, scratch, sig_arr, msg_arr, pk_arr, N_SIGS));
 }
 #undef N_SIGS
 
@@ -791,6 +807,7 @@ void test_schnorrsig_taproot(void) {
 
 void run_schnorrsig_tests(void) {
     int i;
+    secp256k1_scratch_space *scratch = secp256k1_scratch_space_create(ctx, 1024 * 1024);
     run_nonce_function_bip340_tests();
 
     test_schnorrsig_api();
@@ -798,9 +815,10 @@ void run_schnorrsig_tests(void) {
     test_schnorrsig_bip_vectors();
     for (i = 0; i < count; i++) {
         test_schnorrsig_sign();
-        test_schnorrsig_sign_verify();
+        test_schnorrsig_sign_verify(scratch);
     }
     test_schnorrsig_taproot();
+    secp256k1_scratch_space_destroy(ctx, scratch);
 }
 
 #endif
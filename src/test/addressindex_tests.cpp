@@ -0,0 +1,118 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <index/addressindex.h>
+#include <script/standard.h>
+#include <test/util/setup_common.h>
+#include <test/util/transaction_utils.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+static std::vector<AddressOutput> FindOutputs(const AddressIndex& index, const CScript& script)
+{
+    std::vector<AddressOutput> outputs;
+    BOOST_REQUIRE(index.FindOutputs(script, /* start_height */ 0, [&](const AddressOutput& output) {
+        outputs.push_back(output);
+        return true;
+    }));
+    return outputs;
+}
+
+BOOST_FIXTURE_TEST_CASE(addressindex_initial_sync, TestChain100Setup)
+{
+    AddressIndex address_index(1 << 20, true);
+
+    const CScript coinbase_script_pub_key = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // Outputs should not be found in the index before it is started.
+    BOOST_CHECK(FindOutputs(address_index, coinbase_script_pub_key).empty());
+
+    // BlockUntilSyncedToCurrentChain should return false before addressindex is started.
+    BOOST_CHECK(!address_index.BlockUntilSyncedToCurrentChain());
+
+    address_index.Start();
+
+    // Allow the address index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!address_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+
+    // Check that the index has all coinbase outputs of the chain, in order of height.
+    std::vector<AddressOutput> outputs = FindOutputs(address_index, coinbase_script_pub_key);
+    BOOST_REQUIRE_EQUAL(outputs.size(), m_coinbase_txns.size());
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        BOOST_CHECK(outputs[i].outpoint == COutPoint(m_coinbase_txns[i]->GetHash(), 0));
+        BOOST_CHECK_EQUAL(outputs[i].height, int(i + 1));
+        BOOST_CHECK_EQUAL(outputs[i].amount, m_coinbase_txns[i]->vout[0].nValue);
+        BOOST_CHECK(!outputs[i].IsSpent());
+
+        CTransactionRef tx;
+        BOOST_CHECK(address_index.ReadTx(outputs[i], tx));
+        BOOST_CHECK_EQUAL(tx->GetHash(), m_coinbase_txns[i]->GetHash());
+    }
+
+    // fn can stop the lookup early.
+    size_t found = 0;
+    BOOST_CHECK(address_index.FindOutputs(coinbase_script_pub_key, /* start_height */ 0, [&](const AddressOutput&) { return ++found < 3; }));
+    BOOST_CHECK_EQUAL(found, 3U);
+
+    // The lookup can start at a height.
+    std::vector<AddressOutput> from_height;
+    BOOST_CHECK(address_index.FindOutputs(coinbase_script_pub_key, /* start_height */ 50, [&](const AddressOutput& output) {
+        from_height.push_back(output);
+        return true;
+    }));
+    BOOST_REQUIRE_EQUAL(from_height.size(), outputs.size() - 49);
+    BOOST_CHECK(from_height[0].outpoint == outputs[49].outpoint);
+    BOOST_CHECK_EQUAL(from_height[0].height, 50);
+
+    // Check that a block spending an output updates the index.
+    const CScript p2wpkh = GetScriptForDestination(WitnessV0KeyHash(coinbaseKey.GetPubKey()));
+    const CMutableTransaction spend = BuildP2PKSpendingTransaction(coinbaseKey, COutPoint{m_coinbase_txns[0]->GetHash(), 0}, p2wpkh, 11 * CENT);
+    const CScript p2pkh = GetScriptForDestination(PKHash(coinbaseKey.GetPubKey()));
+    CreateAndProcessBlock({spend}, p2pkh);
+    BOOST_CHECK(address_index.BlockUntilSyncedToCurrentChain());
+
+    outputs = FindOutputs(address_index, coinbase_script_pub_key);
+    BOOST_REQUIRE(outputs[0].IsSpent());
+    BOOST_CHECK_EQUAL(outputs[0].spent_by.hash, CTransaction(spend).GetHash());
+    BOOST_CHECK_EQUAL(outputs[0].spent_by.n, 0U);
+    BOOST_CHECK_EQUAL(outputs[0].spent_height, 101);
+    BOOST_CHECK(!outputs[1].IsSpent());
+    BOOST_CHECK_EQUAL(FindOutputs(address_index, p2wpkh).size(), 1U);
+    BOOST_CHECK_EQUAL(FindOutputs(address_index, p2pkh).size(), 1U);
+
+    // Replace the spending block by an empty one. The index rewinds the stale
+    // block when the competing block is connected.
+    CBlockIndex* stale_block_index = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    {
+        BlockValidationState state;
+        BOOST_CHECK(::ChainstateActive().InvalidateBlock(state, Params(), stale_block_index));
+    }
+    const CBlock block = CreateAndProcessBlock({}, p2pkh);
+    BOOST_CHECK(address_index.BlockUntilSyncedToCurrentChain());
+
+    BOOST_CHECK(!FindOutputs(address_index, coinbase_script_pub_key)[0].IsSpent());
+    BOOST_CHECK(FindOutputs(address_index, p2wpkh).empty());
+    outputs = FindOutputs(address_index, p2pkh);
+    BOOST_REQUIRE_EQUAL(outputs.size(), 1U);
+    BOOST_CHECK_EQUAL(outputs[0].outpoint.hash, block.vtx[0]->GetHash());
+    BOOST_CHECK_EQUAL(outputs[0].height, 101);
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    address_index.Stop();
+
+    // Let scheduler events finish running to avoid accessing any memory related to the index after it is destructed
+    SyncWithValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -262,6 +262,19 @@ BOOST_FIXTURE_TEST_CASE(blockfilter_index_initial_sync, BuildChainTestingSetup)
     filters.clear();
     filter_hashes.clear();
 
+    // Test matching a range of filters. Only the blocks of chain A, which is active, pay to its
+    // coinbase script.
+    std::vector<int> heights;
+    GCSFilter::ElementSet elements_A{{coinbase_script_pub_key_A.begin(), coinbase_script_pub_key_A.end()}};
+    GCSFilter::ElementSet elements_B{{coinbase_script_pub_key_B.begin(), coinbase_script_pub_key_B.end()}};
+    BOOST_CHECK(filter_index.MatchAnyRange(0, tip, elements_A, heights));
+    BOOST_CHECK((heights == std::vector<int>{tip->nHeight - 3, tip->nHeight - 2, tip->nHeight - 1, tip->nHeight}));
+    BOOST_CHECK(filter_index.MatchAnyRange(tip->nHeight - 1, tip, elements_A, heights));
+    BOOST_CHECK((heights == std::vector<int>{tip->nHeight - 1, tip->nHeight}));
+    BOOST_CHECK(filter_index.MatchAnyRange(0, tip, elements_B, heights));
+    BOOST_CHECK(heights.empty());
+    BOOST_CHECK(!filter_index.MatchAnyRange(tip->nHeight + 1, tip, elements_A, heights));
+
     filter_index.Interrupt();
     filter_index.Stop();
 }
@@ -10,6 +10,7 @@
 #include <serialize.h>
 #include <streams.h>
 #include <univalue.h>
+#include <util/golombrice.h>
 #include <util/strencodings.h>
 
 #include <boost/test/unit_test.hpp>
@@ -39,6 +40,65 @@ BOOST_AUTO_TEST_CASE(gcsfilter_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(golombrice_reader_test)
+{
+    for (uint8_t P : {0, 1, 7, 19, 20, 32, 63}) {
+        // Include quotients longer than a 64 bit word.
+        std::vector<uint64_t> values;
+        for (uint64_t q : {0, 1, 2, 63, 64, 65, 130}) {
+            values.push_back((q << P) + (P == 0 ? 0 : InsecureRandBits(P)));
+        }
+        for (int i = 0; i < 100; ++i) {
+            values.push_back((InsecureRandRange(8) << P) + (P == 0 ? 0 : InsecureRandBits(P)));
+        }
+
+        std::vector<unsigned char> encoded;
+        {
+            CVectorWriter stream(SER_NETWORK, 0, encoded, 0);
+            BitStreamWriter<CVectorWriter> bitwriter(stream);
+            for (uint64_t value : values) {
+                GolombRiceEncode(bitwriter, P, value);
+            }
+        }
+
+        GolombRiceReader reader(encoded);
+        for (uint64_t value : values) {
+            BOOST_CHECK_EQUAL(reader.Decode(P), value);
+        }
+        BOOST_CHECK_EQUAL(reader.RemainingBytes(), 0U);
+
+        // The last value ends in the last byte, so reading it fails without that byte.
+        GolombRiceReader truncated(Span<const unsigned char>{encoded}.first(encoded.size() - 1));
+        BOOST_CHECK_THROW(for (size_t i = 0; i < values.size(); ++i) truncated.Decode(P), std::ios_base::failure);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_decode_check)
+{
+    GCSFilter::ElementSet elements;
+    for (int i = 0; i < 100; ++i) {
+        GCSFilter::Element element(32);
+        element[0] = i;
+        elements.insert(std::move(element));
+    }
+    const GCSFilter filter({0, 0, 10, 1 << 10}, elements);
+
+    // Extra or missing data is caught when decoding the filter, unless the check is skipped.
+    std::vector<unsigned char> excess = filter.GetEncoded();
+    excess.push_back(0);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), excess), std::ios_base::failure);
+    BOOST_CHECK_EQUAL(GCSFilter(filter.GetParams(), excess, /* skip_decode_check */ true).GetN(), 100U);
+
+    std::vector<unsigned char> truncated = filter.GetEncoded();
+    truncated.resize(truncated.size() / 2);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), truncated), std::ios_base::failure);
+
+    const GCSFilter decoded(filter.GetParams(), filter.GetEncoded());
+    for (const auto& element : elements) {
+        BOOST_CHECK(decoded.Match(element));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(gcsfilter_default_constructor)
 {
     GCSFilter filter;
@@ -5,14 +5,20 @@
 #include <attributes.h>
 #include <clientversion.h>
 #include <coins.h>
+#include <key.h>
 #include <script/standard.h>
 #include <streams.h>
+#include <test/util/logging.h>
 #include <test/util/setup_common.h>
 #include <txdb.h>
 #include <uint256.h>
 #include <undo.h>
 #include <util/strencodings.h>
+#include <validation.h>
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
 #include <map>
 #include <vector>
 
@@ -59,7 +65,7 @@ public:
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
                 // Same optimization used in CCoinsViewDB is to only write dirty entries.
-                map_[it->first] = it->second.coin;
+                map_[it->first] = it->second.coin.Expand();
                 if (it->second.coin.IsSpent() && InsecureRandRange(3) == 0) {
                     // Randomly delete empty entries on write.
                     map_.erase(it->first);
@@ -273,6 +279,198 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     SimulationTest(&db_base, true);
 }
 
+// Check that coins handed to the background writer stay visible through the
+// database view, and that the database ends up in the same state as with a
+// synchronous write.
+static void CheckDBFlush(bool background)
+{
+    CCoinsViewDB db{"test", /*nCacheSize*/ 1 << 23, /*fMemory*/ true, /*fWipe*/ false, /*db_options*/ {}, background};
+    CCoinsViewCache cache{&db};
+
+    std::vector<COutPoint> outpoints;
+    for (uint32_t i = 0; i < 100; ++i) {
+        outpoints.emplace_back(InsecureRand256(), i);
+        Coin coin;
+        coin.out.nValue = i + 1;
+        coin.nHeight = 1;
+        cache.AddCoin(outpoints.back(), std::move(coin), /*possible_overwrite*/ false);
+    }
+    const uint256 block1 = InsecureRand256();
+    cache.SetBestBlock(block1);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(db.GetBestBlock() == block1);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    for (const COutPoint& outpoint : outpoints) {
+        Coin coin;
+        BOOST_CHECK(db.GetCoin(outpoint, coin));
+        BOOST_CHECK_EQUAL(coin.out.nValue, outpoint.n + 1);
+    }
+
+    // Spend every other coin; the next flush has to wait for the first one.
+    for (size_t i = 0; i < outpoints.size(); i += 2) {
+        BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+    }
+    const uint256 block2 = InsecureRand256();
+    cache.SetBestBlock(block2);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(db.GetBestBlock() == block2);
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        BOOST_CHECK_EQUAL(db.HaveCoin(outpoints[i]), i % 2 == 1);
+    }
+    std::atomic<bool> written{false};
+    db.AfterPendingWrite([&] { written = true; });
+
+    BOOST_CHECK(db.WaitForPendingWrite());
+    BOOST_CHECK(written);
+    BOOST_CHECK_EQUAL(db.PendingWriteUsage(), 0U);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    std::unique_ptr<CCoinsViewCursor> cursor{db.Cursor()};
+    BOOST_CHECK(cursor->GetBestBlock() == block2);
+    size_t count = 0;
+    for (; cursor->Valid(); cursor->Next()) {
+        COutPoint key;
+        BOOST_CHECK(cursor->GetKey(key));
+        BOOST_CHECK_EQUAL(key.n % 2, 1U);
+        ++count;
+    }
+    BOOST_CHECK_EQUAL(count, outpoints.size() / 2);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_db_flush)
+{
+    CheckDBFlush(/*background*/ false);
+    CheckDBFlush(/*background*/ true);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_get_coins)
+{
+    CCoinsViewDB db{"test", /*nCacheSize*/ 1 << 23, /*fMemory*/ true, /*fWipe*/ false};
+    std::vector<COutPoint> outpoints;
+    {
+        CCoinsViewCache cache{&db};
+        for (uint32_t i = 0; i < 200; ++i) {
+            outpoints.emplace_back(InsecureRand256(), i);
+            Coin coin;
+            coin.out.nValue = i + 1;
+            coin.nHeight = i;
+            cache.AddCoin(outpoints.back(), std::move(coin), /*possible_overwrite*/ false);
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+
+    // Query present and absent outpoints, including duplicates, through a
+    // cache that already knows about some of them.
+    CCoinsViewCacheTest cache{&db};
+    BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+    cache.AccessCoin(outpoints[1]);
+    std::vector<COutPoint> query;
+    for (size_t i = 0; i < outpoints.size(); i += 2) {
+        query.push_back(outpoints[i]);
+        query.emplace_back(InsecureRand256(), i);
+    }
+    query.push_back(outpoints[1]);
+    query.push_back(outpoints[2]);
+
+    std::vector<Coin> coins(query.size());
+    const size_t found = cache.GetCoins(query, coins);
+    cache.SelfTest();
+    size_t expected_found = 0;
+    for (size_t i = 0; i < query.size(); ++i) {
+        Coin coin;
+        const bool have = cache.GetCoin(query[i], coin);
+        BOOST_CHECK_EQUAL(!coins[i].IsSpent(), have);
+        if (have) {
+            BOOST_CHECK(coins[i] == coin);
+            BOOST_CHECK(cache.HaveCoinInCache(query[i]));
+            ++expected_found;
+        }
+    }
+    BOOST_CHECK_EQUAL(found, expected_found);
+    BOOST_CHECK_EQUAL(found, outpoints.size() / 2 - 1 + 2);
+
+    // The database answers the same on its own.
+    std::vector<Coin> db_coins(query.size());
+    BOOST_CHECK_EQUAL(db.GetCoins(query, db_coins), found + 1);
+    BOOST_CHECK(!db_coins[0].IsSpent());
+    for (size_t i = 1; i < query.size(); ++i) {
+        BOOST_CHECK(db_coins[i] == coins[i]);
+    }
+
+}
+
+static std::vector<COutPoint> ReadCursor(CCoinsViewCursor& cursor)
+{
+    std::vector<COutPoint> outpoints;
+    for (; cursor.Valid(); cursor.Next()) {
+        COutPoint outpoint;
+        Coin coin;
+        BOOST_CHECK(cursor.GetKey(outpoint));
+        BOOST_CHECK(cursor.GetValue(coin));
+        outpoints.push_back(outpoint);
+    }
+    return outpoints;
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_db_cursors)
+{
+    CCoinsViewDB db{"test", /*nCacheSize*/ 1 << 23, /*fMemory*/ true, /*fWipe*/ false};
+    {
+        CCoinsViewCache cache{&db};
+        for (uint32_t i = 0; i < 300; ++i) {
+            const uint256 txid = InsecureRand256();
+            for (uint32_t n = 0; n <= i % 3; ++n) {
+                Coin coin;
+                coin.out.nValue = i + 1;
+                coin.nHeight = i;
+                cache.AddCoin(COutPoint{txid, n}, std::move(coin), /*possible_overwrite*/ false);
+            }
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+
+    for (const size_t count : {1, 2, 7, 256, 1000}) {
+        const std::vector<COutPoint> expected = ReadCursor(*std::unique_ptr<CCoinsViewCursor>{db.Cursor()});
+        std::vector<std::unique_ptr<CCoinsViewCursor>> cursors = db.Cursors(count);
+        BOOST_CHECK_EQUAL(cursors.size(), std::min<size_t>(count, 256));
+
+        // The cursors don't see coins written after they were created.
+        {
+            CCoinsViewCache cache{&db};
+            Coin coin;
+            coin.out.nValue = 1;
+            cache.AddCoin(COutPoint{InsecureRand256(), 0}, std::move(coin), /*possible_overwrite*/ false);
+            cache.SetBestBlock(InsecureRand256());
+            BOOST_CHECK(cache.Flush());
+        }
+
+        // Together, the shards walk all coins in order.
+        std::vector<COutPoint> outpoints;
+        for (auto& cursor : cursors) {
+            BOOST_CHECK(cursor->GetBestBlock() == cursors[0]->GetBestBlock());
+            const std::vector<COutPoint> shard = ReadCursor(*cursor);
+            outpoints.insert(outpoints.end(), shard.begin(), shard.end());
+        }
+        BOOST_CHECK(outpoints == expected);
+    }
+}
+
+// A bulk load is remembered in the database, so that it is compacted even if
+// the initial block download finishes in a later session.
+BOOST_AUTO_TEST_CASE(ccoins_db_bulk_load_resume)
+{
+    const fs::path path = GetDataDir() / "bulk_load";
+    DBOptions bulk_options;
+    bulk_options.bulk_load = true;
+    { CCoinsViewDB db{path, /*nCacheSize*/ 1 << 20, /*fMemory*/ false, /*fWipe*/ false, bulk_options}; }
+
+    CCoinsViewDB db{path, /*nCacheSize*/ 1 << 20, /*fMemory*/ false, /*fWipe*/ false};
+    ASSERT_DEBUG_LOG("Compacting");
+    LOCK(cs_main);
+    db.FinishBulkLoad();
+}
+
 // Store of all necessary tx and undo data for next test
 typedef std::map<COutPoint, std::tuple<CTransaction,CTxUndo,Coin>> UtxoData;
 UtxoData utxoData;
@@ -496,6 +694,91 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
     g_mock_deterministic_tests = false;
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_compact_coin)
+{
+    CKey key;
+    key.MakeNewKey(/* fCompressed */ true);
+    const CPubKey pubkey = key.GetPubKey();
+    CKey uncompressed_key;
+    uncompressed_key.MakeNewKey(/* fCompressed */ false);
+    const std::vector<std::pair<CScript, bool>> scripts{
+        // Scripts stored without a heap allocation
+        {GetScriptForDestination(PKHash(pubkey)), true},
+        {GetScriptForDestination(ScriptHash(CScript() << OP_TRUE)), true},
+        {GetScriptForDestination(WitnessV0KeyHash(pubkey)), true},
+        {GetScriptForDestination(WitnessV0ScriptHash(CScript() << OP_TRUE)), true},
+        {CScript() << OP_1 << ToByteVector(InsecureRand256()), true},
+        {GetScriptForRawPubKey(pubkey), true},
+        {CScript(), true},
+        {CScript() << OP_TRUE, true},
+        {CScript() << OP_2 << std::vector<unsigned char>(30, 0x01), true},
+        // Scripts that are too long to be stored inline
+        {CScript() << OP_2 << ToByteVector(InsecureRand256()), false},
+        {CScript() << OP_0 << ToByteVector(InsecureRand256()) << OP_DROP, false},
+        {GetScriptForRawPubKey(uncompressed_key.GetPubKey()), false},
+        {GetScriptForMultisig(1, {pubkey, pubkey}), false},
+    };
+    for (const auto& script : scripts) {
+        const Coin coin{CTxOut{CAmount(InsecureRandRange(MAX_MONEY)), script.first}, int(InsecureRandRange(1 << 30)), InsecureRandBool()};
+        CompactCoin compact{coin};
+        BOOST_CHECK(!compact.IsSpent());
+        BOOST_CHECK_EQUAL(compact.Height(), coin.nHeight);
+        BOOST_CHECK_EQUAL(compact.IsCoinBase(), coin.IsCoinBase());
+        BOOST_CHECK_EQUAL(compact.DynamicMemoryUsage() == 0, script.second);
+        BOOST_CHECK(compact.Expand() == coin);
+
+        // It serializes like the Coin it holds.
+        CDataStream ss_compact{SER_DISK, CLIENT_VERSION};
+        CDataStream ss_coin{SER_DISK, CLIENT_VERSION};
+        ss_compact << compact;
+        ss_coin << coin;
+        BOOST_CHECK(ss_compact.str() == ss_coin.str());
+
+        const CompactCoin copy{compact};
+        BOOST_CHECK(copy.Expand() == coin);
+        CompactCoin moved{std::move(compact)};
+        BOOST_CHECK(moved.Expand() == coin);
+        compact = moved;
+        BOOST_CHECK(compact.Expand() == coin);
+
+        // Expanding in place keeps the Coin at a stable address; copies of it are compact again.
+        const Coin& expanded = compact.ExpandInPlace();
+        BOOST_CHECK(expanded == coin);
+        BOOST_CHECK_EQUAL(&compact.ExpandInPlace(), &expanded);
+        BOOST_CHECK_EQUAL(compact.DynamicMemoryUsage(), memusage::MallocUsage(sizeof(Coin)) + coin.DynamicMemoryUsage());
+        BOOST_CHECK(compact.Expand() == coin);
+        const CompactCoin recompacted{compact};
+        BOOST_CHECK_EQUAL(recompacted.DynamicMemoryUsage() == 0, script.second);
+        BOOST_CHECK(recompacted.Expand() == coin);
+
+        compact.Clear();
+        BOOST_CHECK(compact.IsSpent());
+        BOOST_CHECK(compact.Expand().IsSpent());
+        BOOST_CHECK_EQUAL(compact.DynamicMemoryUsage(), 0U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_access_coin_reference)
+{
+    CCoinsView base;
+    CCoinsViewCache cache{&base};
+    const COutPoint outpoint{InsecureRand256(), 0};
+    const Coin coin{CTxOut{1000, GetScriptForDestination(WitnessV0ScriptHash(CScript() << OP_TRUE))}, 1, false};
+    cache.AddCoin(outpoint, Coin{coin}, /* possible_overwrite */ false);
+    const size_t compact_usage = cache.DynamicMemoryUsage();
+
+    // Accessing the coin expands its entry, which is accounted for and then referenced.
+    const Coin& accessed = cache.AccessCoin(outpoint);
+    BOOST_CHECK(accessed == coin);
+    BOOST_CHECK_EQUAL(&cache.AccessCoin(outpoint), &accessed);
+    BOOST_CHECK_EQUAL(AccessByTxid(cache, outpoint.hash).out.nValue, coin.out.nValue);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), compact_usage + memusage::MallocUsage(sizeof(Coin)) + coin.DynamicMemoryUsage());
+
+    BOOST_CHECK(cache.SpendCoin(outpoint));
+    BOOST_CHECK(cache.AccessCoin(outpoint).IsSpent());
+    BOOST_CHECK(AccessByTxid(cache, outpoint.hash).IsSpent());
+}
+
 BOOST_AUTO_TEST_CASE(ccoins_serialization)
 {
     // Good example
@@ -582,9 +865,9 @@ static size_t InsertCoinsMapEntry(CCoinsMap& map, CAmount value, char flags)
         return 0;
     }
     assert(flags != NO_ENTRY);
-    CCoinsCacheEntry entry;
-    entry.flags = flags;
-    SetCoinsValue(value, entry.coin);
+    Coin coin;
+    SetCoinsValue(value, coin);
+    CCoinsCacheEntry entry{coin, static_cast<unsigned char>(flags)};
     auto inserted = map.emplace(OUTPOINT, std::move(entry));
     assert(inserted.second);
     return inserted.first->second.coin.DynamicMemoryUsage();
@@ -600,7 +883,7 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
         if (it->second.coin.IsSpent()) {
             value = SPENT;
         } else {
-            value = it->second.coin.out.nValue;
+            value = it->second.coin.Expand().out.nValue;
         }
         flags = it->second.flags;
         assert(flags != NO_ENTRY);
@@ -609,7 +892,8 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map{0, CCoinsMap::hasher{}, CCoinsMap::key_equal{}, &resource};
     InsertCoinsMapEntry(map, value, flags);
     BOOST_CHECK(view.BatchWrite(map, {}));
 }
@@ -679,6 +963,37 @@ BOOST_AUTO_TEST_CASE(ccoins_access)
     CheckAccessCoin(VALUE1, VALUE2, VALUE2, DIRTY|FRESH, DIRTY|FRESH);
 }
 
+static void CheckPrefetchCoin(CAmount cache_value, CAmount prefetch_value, CAmount expected_value, char cache_flags, char expected_flags)
+{
+    SingleEntryCacheTest test(ABSENT, cache_value, cache_flags);
+    Coin coin;
+    SetCoinsValue(prefetch_value, coin);
+    test.cache.PrefetchCoin(OUTPOINT, std::move(coin));
+    test.cache.SelfTest();
+
+    CAmount result_value;
+    char result_flags;
+    GetCoinsMapEntry(test.cache.map(), result_value, result_flags);
+    BOOST_CHECK_EQUAL(result_value, expected_value);
+    BOOST_CHECK_EQUAL(result_flags, expected_flags);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_prefetch)
+{
+    /* Check PrefetchCoin behavior, inserting a coin looked up from the base
+     * view, and checking that an existing cache entry is never replaced.
+     *
+     *                 Cache   Prefetch Result  Cache        Result
+     *                 Value   Value    Value   Flags        Flags
+     */
+    CheckPrefetchCoin(ABSENT, SPENT , ABSENT, NO_ENTRY   , NO_ENTRY   );
+    CheckPrefetchCoin(ABSENT, VALUE1, VALUE1, NO_ENTRY   , 0          );
+    for (const char flags : FLAGS) {
+        CheckPrefetchCoin(SPENT , VALUE1, SPENT , flags, flags);
+        CheckPrefetchCoin(VALUE2, VALUE1, VALUE2, flags, flags);
+    }
+}
+
 static void CheckSpendCoins(CAmount base_value, CAmount cache_value, CAmount expected_value, char cache_flags, char expected_flags)
 {
     SingleEntryCacheTest test(base_value, cache_value, cache_flags);
@@ -692,6 +1007,121 @@ static void CheckSpendCoins(CAmount base_value, CAmount cache_value, CAmount exp
     BOOST_CHECK_EQUAL(result_flags, expected_flags);
 };
 
+BOOST_AUTO_TEST_CASE(ccoins_sync_evict)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache{&base};
+
+    // Ten heights with a thousand coins each.
+    std::vector<COutPoint> outpoints;
+    for (uint32_t height = 1; height <= 10; ++height) {
+        const uint256 txid = InsecureRand256();
+        for (uint32_t n = 0; n < 1000; ++n) {
+            Coin coin;
+            coin.out.nValue = InsecureRand32();
+            coin.out.scriptPubKey.assign(InsecureRandBits(6), 0);
+            coin.nHeight = height;
+            outpoints.emplace_back(txid, n);
+            cache.AddCoin(outpoints.back(), std::move(coin), /*possible_overwrite*/ false);
+        }
+    }
+    cache.SetBestBlock(InsecureRand256());
+
+    // Nothing can be evicted before the changes are written.
+    BOOST_CHECK_EQUAL(cache.Evict(0), 0U);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), outpoints.size());
+
+    // Spent entries are dropped by Sync, the others stay cached and clean.
+    for (size_t i = 0; i < outpoints.size(); i += 10) {
+        BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+    }
+    BOOST_CHECK(cache.Sync());
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), outpoints.size() - outpoints.size() / 10);
+    for (const auto& entry : cache.map()) {
+        BOOST_CHECK_EQUAL(entry.second.flags, 0);
+    }
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        Coin coin;
+        BOOST_CHECK_EQUAL(base.GetCoin(outpoints[i], coin) && !coin.IsSpent(), i % 10 != 0);
+    }
+
+    // Evicting keeps the most recent coins and releases memory.
+    const size_t usage = cache.DynamicMemoryUsage();
+    const size_t evicted = cache.Evict(usage / 2);
+    cache.SelfTest();
+    BOOST_CHECK(evicted > 0);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize() + evicted, outpoints.size() - outpoints.size() / 10);
+    BOOST_CHECK(cache.DynamicMemoryUsage() < usage);
+    uint32_t min_cached_height = std::numeric_limits<uint32_t>::max();
+    for (const auto& entry : cache.map()) {
+        min_cached_height = std::min<uint32_t>(min_cached_height, entry.second.coin.Height());
+    }
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        const uint32_t height = i / 1000 + 1;
+        if (height < min_cached_height) BOOST_CHECK(!cache.HaveCoinInCache(outpoints[i]));
+        if (i % 10 != 0 && height >= min_cached_height) BOOST_CHECK(cache.HaveCoinInCache(outpoints[i]));
+    }
+
+    // Evicted coins are still available from the base.
+    BOOST_CHECK(cache.HaveCoin(outpoints[1]));
+    BOOST_CHECK(!cache.HaveCoin(outpoints[0]));
+}
+
+// Randomly modify a two level cache stack, syncing and evicting the lower
+// cache instead of flushing it, and check that the coins stay the same.
+BOOST_AUTO_TEST_CASE(ccoins_sync_evict_simulation)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache{&base};
+    std::map<COutPoint, Coin> result;
+
+    std::vector<COutPoint> outpoints;
+    for (unsigned int i = 0; i < NUM_SIMULATION_ITERATIONS / 40; ++i) {
+        outpoints.emplace_back(InsecureRand256(), InsecureRandBits(2));
+    }
+
+    bool evicted_an_entry = false;
+    for (unsigned int i = 0; i < NUM_SIMULATION_ITERATIONS / 4; ++i) {
+        CCoinsViewCacheTest top{&cache};
+        for (unsigned int j = 0; j < 10; ++j) {
+            const COutPoint& outpoint = outpoints[InsecureRandRange(outpoints.size())];
+            Coin& coin = result[outpoint];
+            BOOST_CHECK(top.AccessCoin(outpoint) == coin);
+            if (coin.IsSpent() || InsecureRandRange(4) == 0) {
+                Coin newcoin;
+                newcoin.out.nValue = InsecureRand32();
+                newcoin.out.scriptPubKey.assign(InsecureRandBits(6), 0);
+                newcoin.nHeight = InsecureRandRange(100);
+                coin = newcoin;
+                top.AddCoin(outpoint, std::move(newcoin), /*possible_overwrite*/ true);
+            } else {
+                BOOST_CHECK(top.SpendCoin(outpoint));
+                coin.Clear();
+            }
+        }
+        top.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(top.Flush());
+
+        if (InsecureRandRange(10) == 0) {
+            BOOST_CHECK(cache.Sync());
+            for (const auto& entry : cache.map()) {
+                BOOST_CHECK_EQUAL(entry.second.flags, 0);
+            }
+            const size_t size = cache.GetCacheSize();
+            const size_t evicted = cache.Evict(InsecureRandRange(cache.DynamicMemoryUsage() + 1));
+            BOOST_CHECK_EQUAL(cache.GetCacheSize() + evicted, size);
+            evicted_an_entry |= evicted > 0;
+        }
+        cache.SelfTest();
+    }
+
+    for (const auto& entry : result) {
+        BOOST_CHECK(cache.AccessCoin(entry.first) == entry.second);
+    }
+    BOOST_CHECK(evicted_an_entry);
+}
+
 BOOST_AUTO_TEST_CASE(ccoins_spend)
 {
     /* Check SpendCoin behavior, requesting a coin from a cache view layered on
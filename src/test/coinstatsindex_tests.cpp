@@ -0,0 +1,138 @@
+// Copyright (c) 2020-2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <index/coinstatsindex.h>
+#include <script/interpreter.h>
+#include <script/standard.h>
+#include <test/util/setup_common.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(coinstatsindex_tests)
+
+static void CheckStatsAgainstCoinsDB(const CoinStatsIndex& coin_stats_index)
+{
+    ::ChainstateActive().ForceFlushStateToDisk();
+
+    LOCK(cs_main);
+    CCoinsStats expected;
+    expected.index_requested = false;
+    BOOST_REQUIRE(GetUTXOStats(&::ChainstateActive().CoinsDB(), expected, CoinStatsHashType::MUHASH, [] {}));
+
+    CCoinsStats indexed;
+    BOOST_REQUIRE(coin_stats_index.LookUpStats(::ChainActive().Tip(), indexed));
+    BOOST_CHECK_EQUAL(indexed.hashSerialized, expected.hashSerialized);
+    BOOST_CHECK_EQUAL(indexed.nTransactionOutputs, expected.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(indexed.nBogoSize, expected.nBogoSize);
+    BOOST_CHECK_EQUAL(indexed.nTotalAmount, expected.nTotalAmount);
+}
+
+BOOST_FIXTURE_TEST_CASE(coinstatsindex_initial_sync, TestChain100Setup)
+{
+    CoinStatsIndex coin_stats_index{1 << 20, true};
+
+    CCoinsStats coin_stats;
+    const CBlockIndex* block_index = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+
+    // CoinStatsIndex should not be found before it is started.
+    BOOST_CHECK(!coin_stats_index.LookUpStats(block_index, coin_stats));
+
+    // BlockUntilSyncedToCurrentChain should return false before CoinStatsIndex
+    // is started.
+    BOOST_CHECK(!coin_stats_index.BlockUntilSyncedToCurrentChain());
+
+    coin_stats_index.Start();
+
+    // Allow the CoinStatsIndex to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!coin_stats_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+
+    // The genesis block output is unspendable, so the set starts out empty.
+    const CBlockIndex* genesis_block_index = WITH_LOCK(cs_main, return ::ChainActive().Genesis());
+    BOOST_CHECK(coin_stats_index.LookUpStats(genesis_block_index, coin_stats));
+    BOOST_CHECK_EQUAL(coin_stats.nTransactionOutputs, 0U);
+    BOOST_CHECK_EQUAL(coin_stats.nTotalAmount, 0);
+
+    // The statistics of the chain the index caught up with match a full scan.
+    CheckStatsAgainstCoinsDB(coin_stats_index);
+
+    // Check that a block spending outputs updates the index.
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint{m_coinbase_txns[0]->GetHash(), 0};
+    spend.vout.resize(2);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = GetScriptForDestination(PKHash(coinbaseKey.GetPubKey()));
+    spend.vout[1].nValue = 22 * CENT;
+    spend.vout[1].scriptPubKey = GetScriptForDestination(WitnessV0KeyHash(coinbaseKey.GetPubKey()));
+    {
+        const CScript script_pub_key = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+        std::vector<unsigned char> vchSig;
+        const uint256 hash = SignatureHash(script_pub_key, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        spend.vin[0].scriptSig << vchSig;
+    }
+    const CScript coinbase_script_pub_key = GetScriptForDestination(PKHash(coinbaseKey.GetPubKey()));
+    const CBlock spend_block = CreateAndProcessBlock({spend}, coinbase_script_pub_key);
+    BOOST_CHECK(coin_stats_index.BlockUntilSyncedToCurrentChain());
+    CheckStatsAgainstCoinsDB(coin_stats_index);
+
+    // Replace the spending block by an empty one. The index rewinds the stale
+    // block when the competing block is connected.
+    CBlockIndex* stale_block_index = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    CCoinsStats stale_stats;
+    BOOST_CHECK(coin_stats_index.LookUpStats(stale_block_index, stale_stats));
+    {
+        BlockValidationState state;
+        BOOST_CHECK(::ChainstateActive().InvalidateBlock(state, Params(), stale_block_index));
+    }
+    CreateAndProcessBlock({}, coinbase_script_pub_key);
+    BOOST_CHECK(coin_stats_index.BlockUntilSyncedToCurrentChain());
+    CheckStatsAgainstCoinsDB(coin_stats_index);
+
+    // The stale block can still be looked up by hash.
+    CCoinsStats stale_stats_after_rewind;
+    BOOST_CHECK(coin_stats_index.LookUpStats(stale_block_index, stale_stats_after_rewind));
+    BOOST_CHECK_EQUAL(stale_stats_after_rewind.hashSerialized, stale_stats.hashSerialized);
+    BOOST_CHECK_EQUAL(stale_stats_after_rewind.nTotalAmount, stale_stats.nTotalAmount);
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    coin_stats_index.Stop();
+
+    // Let scheduler events finish running to avoid accessing any memory related to the index after it is destructed
+    SyncWithValidationInterfaceQueue();
+}
+
+BOOST_FIXTURE_TEST_CASE(coinstatsindex_unsynced_fallback, TestChain100Setup)
+{
+    // An index that has not synced yet cannot serve the current best block,
+    // so the statistics are calculated by scanning the UTXO set instead.
+    g_coin_stats_index = std::make_unique<CoinStatsIndex>(1 << 20, true);
+    ::ChainstateActive().ForceFlushStateToDisk();
+
+    LOCK(cs_main);
+    CCoinsStats stats;
+    stats.index_requested = true;
+    BOOST_CHECK(GetUTXOStats(&::ChainstateActive().CoinsDB(), stats, CoinStatsHashType::MUHASH, [] {}));
+    BOOST_CHECK(!stats.index_used);
+    BOOST_CHECK_EQUAL(stats.nHeight, ::ChainActive().Height());
+    BOOST_CHECK(stats.nTransactionOutputs > 0);
+
+    // Statistics of a specific block are only available from the index.
+    CCoinsStats block_stats;
+    BOOST_CHECK(!GetUTXOStats(&::ChainstateActive().CoinsDB(), block_stats, CoinStatsHashType::MUHASH, [] {}, ::ChainActive().Tip()));
+
+    g_coin_stats_index.reset();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -7,8 +7,10 @@
 #include <uint256.h>
 #include <util/memory.h>
 
+#include <map>
 #include <memory>
 
+#include <boost/mpl/list.hpp>
 #include <boost/test/unit_test.hpp>
 
 // Test if a string consists entirely of null characters
@@ -21,14 +23,27 @@ static bool is_null_key(const std::vector<unsigned char>& key) {
     return isnull;
 }
 
+// Test cases run against each backend. The partitioned backend splits the
+// keys the tests write across several databases.
+struct UseLevelDB {
+    static constexpr const char* NAME{"leveldb"};
+};
+struct UsePartitioned {
+    static constexpr const char* NAME{"partitioned"};
+};
+using Backends = boost::mpl::list<UseLevelDB, UsePartitioned>;
+
+static const DBOptions TEST_OPTIONS{/*partitions=*/{{'j', 0.25}, {'k', 0.25}, {0x80, 0.25}}};
+
 BOOST_FIXTURE_TEST_SUITE(dbwrapper_tests, BasicTestingSetup)
 
-BOOST_AUTO_TEST_CASE(dbwrapper)
+BOOST_AUTO_TEST_CASE_TEMPLATE(dbwrapper, Backend, Backends)
 {
+    gArgs.ForceSetArg("-dbbackend", Backend::NAME);
     // Perform tests both obfuscated and non-obfuscated.
     for (const bool obfuscate : {false, true}) {
         fs::path ph = GetDataDir() / (obfuscate ? "dbwrapper_obfuscate_true" : "dbwrapper_obfuscate_false");
-        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate, TEST_OPTIONS);
         char key = 'k';
         uint256 in = InsecureRand256();
         uint256 res;
@@ -42,12 +57,13 @@ BOOST_AUTO_TEST_CASE(dbwrapper)
     }
 }
 
-BOOST_AUTO_TEST_CASE(dbwrapper_basic_data)
+BOOST_AUTO_TEST_CASE_TEMPLATE(dbwrapper_basic_data, Backend, Backends)
 {
+    gArgs.ForceSetArg("-dbbackend", Backend::NAME);
     // Perform tests both obfuscated and non-obfuscated.
     for (bool obfuscate : {false, true}) {
         fs::path ph = GetDataDir() / (obfuscate ? "dbwrapper_1_obfuscate_true" : "dbwrapper_1_obfuscate_false");
-        CDBWrapper dbw(ph, (1 << 20), false, true, obfuscate);
+        CDBWrapper dbw(ph, (1 << 20), false, true, obfuscate, TEST_OPTIONS);
 
         uint256 res;
         uint32_t res_uint_32;
@@ -123,12 +139,13 @@ BOOST_AUTO_TEST_CASE(dbwrapper_basic_data)
 }
 
 // Test batch operations
-BOOST_AUTO_TEST_CASE(dbwrapper_batch)
+BOOST_AUTO_TEST_CASE_TEMPLATE(dbwrapper_batch, Backend, Backends)
 {
+    gArgs.ForceSetArg("-dbbackend", Backend::NAME);
     // Perform tests both obfuscated and non-obfuscated.
     for (const bool obfuscate : {false, true}) {
         fs::path ph = GetDataDir() / (obfuscate ? "dbwrapper_batch_obfuscate_true" : "dbwrapper_batch_obfuscate_false");
-        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate, TEST_OPTIONS);
 
         char key = 'i';
         uint256 in = InsecureRand256();
@@ -159,12 +176,13 @@ BOOST_AUTO_TEST_CASE(dbwrapper_batch)
     }
 }
 
-BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
+BOOST_AUTO_TEST_CASE_TEMPLATE(dbwrapper_iterator, Backend, Backends)
 {
+    gArgs.ForceSetArg("-dbbackend", Backend::NAME);
     // Perform tests both obfuscated and non-obfuscated.
     for (const bool obfuscate : {false, true}) {
         fs::path ph = GetDataDir() / (obfuscate ? "dbwrapper_iterator_obfuscate_true" : "dbwrapper_iterator_obfuscate_false");
-        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate, TEST_OPTIONS);
 
         // The two keys are intentionally chosen for ordering
         char key = 'j';
@@ -200,14 +218,15 @@ BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 }
 
 // Test that we do not obfuscation if there is existing data.
-BOOST_AUTO_TEST_CASE(existing_data_no_obfuscate)
+BOOST_AUTO_TEST_CASE_TEMPLATE(existing_data_no_obfuscate, Backend, Backends)
 {
+    gArgs.ForceSetArg("-dbbackend", Backend::NAME);
     // We're going to share this fs::path between two wrappers
     fs::path ph = GetDataDir() / "existing_data_no_obfuscate";
     create_directories(ph);
 
     // Set up a non-obfuscated wrapper to write some initial data.
-    std::unique_ptr<CDBWrapper> dbw = MakeUnique<CDBWrapper>(ph, (1 << 10), false, false, false);
+    std::unique_ptr<CDBWrapper> dbw = MakeUnique<CDBWrapper>(ph, (1 << 10), false, false, false, TEST_OPTIONS);
     char key = 'k';
     uint256 in = InsecureRand256();
     uint256 res;
@@ -220,7 +239,7 @@ BOOST_AUTO_TEST_CASE(existing_data_no_obfuscate)
     dbw.reset();
 
     // Now, set up another wrapper that wants to obfuscate the same directory
-    CDBWrapper odbw(ph, (1 << 10), false, false, true);
+    CDBWrapper odbw(ph, (1 << 10), false, false, true, TEST_OPTIONS);
 
     // Check that the key/val we wrote with unobfuscated wrapper exists and
     // is readable.
@@ -241,14 +260,15 @@ BOOST_AUTO_TEST_CASE(existing_data_no_obfuscate)
 }
 
 // Ensure that we start obfuscating during a reindex.
-BOOST_AUTO_TEST_CASE(existing_data_reindex)
+BOOST_AUTO_TEST_CASE_TEMPLATE(existing_data_reindex, Backend, Backends)
 {
+    gArgs.ForceSetArg("-dbbackend", Backend::NAME);
     // We're going to share this fs::path between two wrappers
     fs::path ph = GetDataDir() / "existing_data_reindex";
     create_directories(ph);
 
     // Set up a non-obfuscated wrapper to write some initial data.
-    std::unique_ptr<CDBWrapper> dbw = MakeUnique<CDBWrapper>(ph, (1 << 10), false, false, false);
+    std::unique_ptr<CDBWrapper> dbw = MakeUnique<CDBWrapper>(ph, (1 << 10), false, false, false, TEST_OPTIONS);
     char key = 'k';
     uint256 in = InsecureRand256();
     uint256 res;
@@ -261,7 +281,7 @@ BOOST_AUTO_TEST_CASE(existing_data_reindex)
     dbw.reset();
 
     // Simulate a -reindex by wiping the existing data store
-    CDBWrapper odbw(ph, (1 << 10), false, true, true);
+    CDBWrapper odbw(ph, (1 << 10), false, true, true, TEST_OPTIONS);
 
     // Check that the key/val we wrote with unobfuscated wrapper doesn't exist
     uint256 res2;
@@ -277,10 +297,11 @@ BOOST_AUTO_TEST_CASE(existing_data_reindex)
     BOOST_CHECK_EQUAL(res3.ToString(), in2.ToString());
 }
 
-BOOST_AUTO_TEST_CASE(iterator_ordering)
+BOOST_AUTO_TEST_CASE_TEMPLATE(iterator_ordering, Backend, Backends)
 {
+    gArgs.ForceSetArg("-dbbackend", Backend::NAME);
     fs::path ph = GetDataDir() / "iterator_ordering";
-    CDBWrapper dbw(ph, (1 << 20), true, false, false);
+    CDBWrapper dbw(ph, (1 << 20), true, false, false, TEST_OPTIONS);
     for (int x=0x00; x<256; ++x) {
         uint8_t key = x;
         uint32_t value = x*x;
@@ -355,12 +376,13 @@ struct StringContentsSerializer {
     }
 };
 
-BOOST_AUTO_TEST_CASE(iterator_string_ordering)
+BOOST_AUTO_TEST_CASE_TEMPLATE(iterator_string_ordering, Backend, Backends)
 {
+    gArgs.ForceSetArg("-dbbackend", Backend::NAME);
     char buf[10];
 
     fs::path ph = GetDataDir() / "iterator_string_ordering";
-    CDBWrapper dbw(ph, (1 << 20), true, false, false);
+    CDBWrapper dbw(ph, (1 << 20), true, false, false, TEST_OPTIONS);
     for (int x=0x00; x<10; ++x) {
         for (int y = 0; y < 10; y++) {
             snprintf(buf, sizeof(buf), "%d", x);
@@ -399,6 +421,104 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
     }
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(dbwrapper_read_many, Backend, Backends)
+{
+    gArgs.ForceSetArg("-dbbackend", Backend::NAME);
+    fs::path ph = GetDataDir() / "dbwrapper_read_many";
+    CDBWrapper dbw(ph, (1 << 20), true, false, true, TEST_OPTIONS);
+    for (const uint8_t key : std::vector<uint8_t>{'i', 'j', 'k', 0x80, 0x81}) {
+        BOOST_CHECK(dbw.Write(key, uint32_t{key} * 3));
+    }
+
+    const std::vector<uint8_t> keys{0x81, 'l', 'j', 'i', 0x80, 'k', 0x7f};
+    std::vector<uint32_t> values;
+    std::vector<bool> found;
+    BOOST_CHECK_EQUAL(dbw.ReadMany(keys, values, found), 5U);
+    BOOST_REQUIRE_EQUAL(found.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const bool exists = keys[i] != 'l' && keys[i] != 0x7f;
+        BOOST_CHECK_EQUAL(found[i], exists);
+        if (exists) BOOST_CHECK_EQUAL(values[i], uint32_t{keys[i]} * 3);
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(dbwrapper_tuning, Backend, Backends)
+{
+    gArgs.ForceSetArg("-dbbackend", Backend::NAME);
+    fs::path ph = GetDataDir() / "dbwrapper_tuning";
+    DBOptions options = TEST_OPTIONS;
+    options.max_file_size = 16 << 10;
+    options.max_open_files = 32;
+    options.compaction_thread = true;
+    options.bulk_load = true;
+
+    // Write enough to fill several write buffers and table files, which are
+    // compacted in the background.
+    std::map<uint256, uint256> written;
+    {
+        CDBWrapper dbw(ph, (1 << 20), false, false, true, options);
+        for (int batch_num = 0; batch_num < 20; ++batch_num) {
+            CDBBatch batch(dbw);
+            for (int i = 0; i < 500; ++i) {
+                const uint256 key = InsecureRand256();
+                written[key] = InsecureRand256();
+                batch.Write(key, written[key]);
+            }
+            BOOST_CHECK(dbw.WriteBatch(batch));
+        }
+        dbw.CompactRange(uint256(), uint256S("ff"));
+    }
+
+    CDBWrapper dbw(ph, (1 << 20), false, false, true, options);
+    std::unique_ptr<CDBIterator> it(dbw.NewIterator());
+    it->SeekToFirst();
+    for (const auto& [key, value] : written) {
+        uint256 key_res, value_res;
+        while (it->Valid() && !it->GetKey(key_res)) it->Next(); // skip the obfuscation key
+        BOOST_REQUIRE(it->Valid());
+        BOOST_CHECK(key_res == key);
+        BOOST_CHECK(it->GetValue(value_res));
+        BOOST_CHECK(value_res == value);
+        it->Next();
+    }
+    BOOST_CHECK(!it->Valid());
+}
+
+// A database can only be opened with the backend, and partitions, it was written with.
+BOOST_AUTO_TEST_CASE(dbwrapper_backend_mismatch)
+{
+    fs::path ph = GetDataDir() / "dbwrapper_backend_mismatch";
+    uint256 res;
+
+    gArgs.ForceSetArg("-dbbackend", "leveldb");
+    {
+        CDBWrapper dbw(ph, (1 << 10), false, false, false, TEST_OPTIONS);
+        BOOST_CHECK(dbw.Write('a', InsecureRand256()));
+        BOOST_CHECK(dbw.Write('k', InsecureRand256()));
+    }
+    gArgs.ForceSetArg("-dbbackend", "partitioned");
+    BOOST_CHECK_THROW(CDBWrapper(ph, (1 << 10), false, false, false, TEST_OPTIONS), dbwrapper_error);
+    {
+        // Without partitions the layout of the data is the same.
+        CDBWrapper dbw(ph, (1 << 10), false, false, false);
+        BOOST_CHECK(dbw.Read('k', res));
+    }
+
+    // Wiping removes the data of either backend.
+    {
+        CDBWrapper dbw(ph, (1 << 10), false, true, false, TEST_OPTIONS);
+        BOOST_CHECK(!dbw.Read('k', res));
+        BOOST_CHECK(dbw.Write('k', InsecureRand256()));
+    }
+    BOOST_CHECK_THROW(CDBWrapper(ph, (1 << 10), false, false, false, DBOptions{{{'j', 0.5}}}), dbwrapper_error);
+    gArgs.ForceSetArg("-dbbackend", "leveldb");
+    BOOST_CHECK_THROW(CDBWrapper(ph, (1 << 10), false, false, false, TEST_OPTIONS), dbwrapper_error);
+    {
+        CDBWrapper dbw(ph, (1 << 10), false, true, false, TEST_OPTIONS);
+        BOOST_CHECK(!dbw.Read('k', res));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(unicodepath)
 {
     // Attempt to create a database with a UTF8 character in the path.
@@ -8,6 +8,8 @@
 #include <test/util/setup_common.h>
 #include <util/system.h>
 
+#include <array>
+
 #include <boost/test/unit_test.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(flatfile_tests, BasicTestingSetup)
@@ -123,4 +125,158 @@ BOOST_AUTO_TEST_CASE(flatfile_flush)
     BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(0, 1))), 1U);
 }
 
+BOOST_AUTO_TEST_CASE(flatfile_compress)
+{
+    const auto data_dir = GetDataDir();
+    FlatFileSeq seq(data_dir, "a", 16 * 1024);
+    const FlatFilePos pos(0, 0);
+
+    // Compressible and incompressible chunks, and a partial last chunk
+    std::vector<uint8_t> data(COMPRESSED_FLAT_FILE_CHUNK_SIZE * 2 + 1000, 'x');
+    const std::vector<uint8_t> random{g_insecure_rand_ctx.randbytes(COMPRESSED_FLAT_FILE_CHUNK_SIZE)};
+    std::copy(random.begin(), random.end(), data.begin() + COMPRESSED_FLAT_FILE_CHUNK_SIZE / 2);
+    {
+        CAutoFile file(seq.Open(pos), SER_DISK, CLIENT_VERSION);
+        file.write((const char*)data.data(), data.size());
+    }
+
+    BOOST_CHECK(!seq.Compress(FlatFilePos(1, 0), 1));
+    // An interrupted compression leaves nothing behind.
+    int chunks{0};
+    BOOST_CHECK(!seq.Compress(pos, data.size(), [&] { return ++chunks > 1; }));
+    BOOST_CHECK_EQUAL(chunks, 2);
+    BOOST_CHECK(!fs::exists(seq.CompressedFileName(pos)));
+    BOOST_CHECK(seq.Compress(pos, data.size()));
+    BOOST_CHECK(fs::exists(seq.CompressedFileName(pos)));
+    BOOST_CHECK_LT(fs::file_size(seq.CompressedFileName(pos)), data.size());
+    BOOST_CHECK(!seq.IsCompressed(pos));
+    fs::remove(seq.FileName(pos));
+    BOOST_CHECK(seq.IsCompressed(pos));
+    BOOST_CHECK(seq.Exists(pos));
+    BOOST_CHECK(!seq.Exists(FlatFilePos(1, 0)));
+
+    // Reads within and across chunks use the uncompressed positions.
+    for (const auto& [start, size] : std::vector<std::pair<size_t, size_t>>{
+             {0, 1}, {100, 0}, {COMPRESSED_FLAT_FILE_CHUNK_SIZE - 10, 20}, {1000, COMPRESSED_FLAT_FILE_CHUNK_SIZE * 2}, {data.size() - 1, 1}}) {
+        std::vector<uint8_t> out(size);
+        BOOST_CHECK(seq.ReadCompressed(FlatFilePos(0, start), out));
+        BOOST_CHECK(std::equal(out.begin(), out.end(), data.begin() + start));
+    }
+    // A header and the body it gives the size of, within a chunk and across chunks.
+    for (size_t start : {size_t{10}, size_t{COMPRESSED_FLAT_FILE_CHUNK_SIZE - 2}}) {
+        std::array<uint8_t, 4> header;
+        std::vector<uint8_t> body;
+        BOOST_CHECK(seq.ReadCompressed(FlatFilePos(0, start), header, [&](Span<const uint8_t> header_data) -> std::optional<size_t> {
+            BOOST_CHECK(std::equal(header_data.begin(), header_data.end(), data.begin() + start));
+            return 100;
+        }, body));
+        BOOST_REQUIRE_EQUAL(body.size(), 100U);
+        BOOST_CHECK(std::equal(body.begin(), body.end(), data.begin() + start + header.size()));
+        BOOST_CHECK(!seq.ReadCompressed(FlatFilePos(0, start), header, [](Span<const uint8_t>) { return std::nullopt; }, body));
+        BOOST_CHECK(!seq.ReadCompressed(FlatFilePos(0, start), header, [&](Span<const uint8_t>) { return data.size(); }, body));
+    }
+    std::vector<uint8_t> out(2);
+    BOOST_CHECK(!seq.ReadCompressed(FlatFilePos(0, data.size() - 1), out));
+    BOOST_CHECK(!seq.ReadCompressed(FlatFilePos(1, 0), out));
+
+    // Compressed files are decompressed when opened read-only, and cannot be written to.
+    BOOST_CHECK(seq.Open(pos) == nullptr);
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, 1000), true), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        std::vector<uint8_t> rest(data.size() - 1000);
+        file.read((char*)rest.data(), rest.size());
+        BOOST_CHECK(std::equal(rest.begin(), rest.end(), data.begin() + 1000));
+    }
+
+    // A corrupt compressed file is not read.
+    {
+        CAutoFile file(fsbridge::fopen(seq.CompressedFileName(pos), "rb+"), SER_DISK, CLIENT_VERSION);
+        file.write("xxxx", 4);
+    }
+    BOOST_CHECK(!seq.ReadCompressed(pos, out));
+    BOOST_CHECK(seq.Open(pos, true) == nullptr);
+}
+
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(flatfile_map)
+{
+    const auto data_dir = GetDataDir();
+    FlatFileSeq seq(data_dir, "a", 16 * 1024);
+
+    std::string line1("A purely peer-to-peer version of electronic cash");
+    std::string line2("would allow online payments to be sent directly");
+
+    size_t pos1 = 0;
+    size_t pos2 = pos1 + GetSerializeSize(line1, CLIENT_VERSION);
+    size_t pos3 = pos2 + GetSerializeSize(line2, CLIENT_VERSION);
+
+    // Missing files cannot be mapped.
+    BOOST_CHECK(!seq.Map(FlatFilePos(0, pos1), 1));
+
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, pos1)), SER_DISK, CLIENT_VERSION);
+        file << line1;
+    }
+
+    // Ranges past the end of the file cannot be mapped.
+    BOOST_CHECK(!seq.Map(FlatFilePos(0, pos1), pos2 + 1));
+
+    auto map1 = seq.Map(FlatFilePos(0, pos1), pos2);
+    BOOST_REQUIRE(map1);
+    BOOST_CHECK_EQUAL(map1->size(), pos2);
+    {
+        std::string text;
+        SpanReader{SER_DISK, CLIENT_VERSION, map1->data().subspan(pos1)} >> text;
+        BOOST_CHECK_EQUAL(text, line1);
+    }
+
+    // The cached mapping is shared while it is large enough.
+    BOOST_CHECK_EQUAL(seq.Map(FlatFilePos(0, pos1), 1), map1);
+
+    // Grow the file; a mapping covering the new data replaces the old one, which stays usable.
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, pos2)), SER_DISK, CLIENT_VERSION);
+        file << line2;
+    }
+    auto map2 = seq.Map(FlatFilePos(0, pos2), pos3 - pos2);
+    BOOST_REQUIRE(map2);
+    BOOST_CHECK(map2 != map1);
+    BOOST_CHECK_EQUAL(map2->size(), pos3);
+    {
+        std::string text1, text2;
+        SpanReader{SER_DISK, CLIENT_VERSION, map2->data()} >> text1 >> text2;
+        BOOST_CHECK_EQUAL(text1, line1);
+        BOOST_CHECK_EQUAL(text2, line2);
+        SpanReader{SER_DISK, CLIENT_VERSION, map1->data()} >> text1;
+        BOOST_CHECK_EQUAL(text1, line1);
+    }
+
+    // Unmapping drops the cached mapping, but not the ones still referenced.
+    seq.Unmap(FlatFilePos(0, 0));
+    auto map3 = seq.Map(FlatFilePos(0, pos1), 1);
+    BOOST_REQUIRE(map3);
+    BOOST_CHECK(map3 != map2);
+    BOOST_CHECK(std::equal(map2->data().begin(), map2->data().end(), map3->data().begin(), map3->data().end()));
+
+    // A cached mapping is not handed out for a range the file was truncated below.
+    fs::resize_file(seq.FileName(FlatFilePos(0, 0)), pos2);
+    BOOST_CHECK(!seq.Map(FlatFilePos(0, pos2), pos3 - pos2));
+    auto map4 = seq.Map(FlatFilePos(0, pos1), 1);
+    BOOST_REQUIRE(map4);
+    BOOST_CHECK(map4 != map3);
+    BOOST_CHECK_EQUAL(map4->size(), pos2);
+    seq.Unmap(FlatFilePos(0, 0));
+
+    // Raw data views either keep a mapping alive or own a copy.
+    FlatFileData mapped(map3, map3->data().subspan(pos2));
+    BOOST_CHECK(mapped.IsMapped());
+    BOOST_CHECK_EQUAL(mapped.span().size(), pos3 - pos2);
+    FlatFileData copied(std::vector<uint8_t>(mapped.span().begin(), mapped.span().end()));
+    BOOST_CHECK(!copied.IsMapped());
+    FlatFileData moved(std::move(copied));
+    BOOST_CHECK(std::equal(mapped.span().begin(), mapped.span().end(), moved.span().begin(), moved.span().end()));
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
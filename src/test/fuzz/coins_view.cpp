@@ -110,18 +110,19 @@ FUZZ_TARGET_INIT(coins_view, initialize_coins_view)
                 random_mutable_transaction = *opt_mutable_transaction;
             },
             [&] {
-                CCoinsMap coins_map;
+                CCoinsMapMemoryResource resource;
+                CCoinsMap coins_map{0, SaltedOutpointHasher{}, CCoinsMap::key_equal{}, &resource};
                 while (fuzzed_data_provider.ConsumeBool()) {
                     CCoinsCacheEntry coins_cache_entry;
                     coins_cache_entry.flags = fuzzed_data_provider.ConsumeIntegral<unsigned char>();
                     if (fuzzed_data_provider.ConsumeBool()) {
-                        coins_cache_entry.coin = random_coin;
+                        coins_cache_entry.coin.Set(random_coin);
                     } else {
                         const std::optional<Coin> opt_coin = ConsumeDeserializable<Coin>(fuzzed_data_provider);
                         if (!opt_coin) {
                             return;
                         }
-                        coins_cache_entry.coin = *opt_coin;
+                        coins_cache_entry.coin.Set(*opt_coin);
                     }
                     coins_map.emplace(random_out_point, std::move(coins_cache_entry));
                 }
@@ -148,6 +149,12 @@ FUZZ_TARGET_INIT(coins_view, initialize_coins_view)
         if (exists_using_get_coin) {
             assert(coin_using_get_coin == coin_using_access_coin);
         }
+        std::vector<Coin> coins_using_get_coins(1);
+        const bool exists_using_get_coins = coins_view_cache.GetCoins(Span<const COutPoint>{&random_out_point, 1}, coins_using_get_coins) == 1;
+        assert(exists_using_get_coins == exists_using_get_coin);
+        if (exists_using_get_coins) {
+            assert(coins_using_get_coins[0] == coin_using_get_coin);
+        }
         assert((exists_using_access_coin && exists_using_have_coin_in_cache && exists_using_have_coin && exists_using_get_coin) ||
                (!exists_using_access_coin && !exists_using_have_coin_in_cache && !exists_using_have_coin && !exists_using_get_coin));
         const bool exists_using_have_coin_in_backend = backend_coins_view.HaveCoin(random_out_point);
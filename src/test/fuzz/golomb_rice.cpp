@@ -15,6 +15,7 @@
 #include <cassert>
 #include <cstdint>
 #include <iosfwd>
+#include <optional>
 #include <unordered_set>
 #include <vector>
 
@@ -92,6 +93,16 @@ FUZZ_TARGET(golomb_rice)
 
     assert(encoded_deltas == decoded_deltas);
 
+    {
+        VectorReader stream{SER_NETWORK, 0, golomb_rice_data, 0};
+        const uint32_t n = static_cast<uint32_t>(ReadCompactSize(stream));
+        GolombRiceReader reader(Span<const uint8_t>{golomb_rice_data}.subspan(golomb_rice_data.size() - stream.size()));
+        for (uint32_t i = 0; i < n; ++i) {
+            assert(reader.Decode(BASIC_FILTER_P) == encoded_deltas[i]);
+        }
+        assert(reader.RemainingBytes() == 0);
+    }
+
     {
         const std::vector<uint8_t> random_bytes = ConsumeRandomLengthByteVector(fuzzed_data_provider, 1024);
         VectorReader stream{SER_NETWORK, 0, random_bytes, 0};
@@ -102,10 +113,21 @@ FUZZ_TARGET(golomb_rice)
             return;
         }
         BitStreamReader<VectorReader> bitreader(stream);
+        GolombRiceReader reader(Span<const uint8_t>{random_bytes}.subspan(random_bytes.size() - stream.size()));
+        bool reader_failed{false};
         for (uint32_t i = 0; i < std::min<uint32_t>(n, 1024); ++i) {
+            std::optional<uint64_t> decoded;
+            try {
+                decoded = GolombRiceDecode(bitreader, BASIC_FILTER_P);
+            } catch (const std::ios_base::failure&) {
+            }
+            if (reader_failed) continue;
             try {
-                (void)GolombRiceDecode(bitreader, BASIC_FILTER_P);
+                const uint64_t read = reader.Decode(BASIC_FILTER_P);
+                assert(decoded && *decoded == read);
             } catch (const std::ios_base::failure&) {
+                assert(!decoded);
+                reader_failed = true;
             }
         }
     }
@@ -0,0 +1,28 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/fuzz/FuzzedDataProvider.h>
+#include <test/fuzz/fuzz.h>
+#include <test/fuzz/util.h>
+#include <util/lzcompress.h>
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+FUZZ_TARGET(lzcompress)
+{
+    FuzzedDataProvider fuzzed_data_provider(buffer.data(), buffer.size());
+    const size_t out_size = fuzzed_data_provider.ConsumeIntegralInRange<size_t>(0, 1 << 16);
+
+    // Arbitrary input must not be decoded out of bounds.
+    std::vector<uint8_t> out(out_size);
+    (void)LZDecompress(ConsumeRandomLengthByteVector(fuzzed_data_provider), out);
+
+    const std::vector<uint8_t> data = fuzzed_data_provider.ConsumeRemainingBytes<uint8_t>();
+    const std::vector<uint8_t> compressed = LZCompress(data);
+    std::vector<uint8_t> decompressed(data.size());
+    assert(LZDecompress(compressed, decompressed));
+    assert(decompressed == data);
+}
@@ -187,4 +187,35 @@ BOOST_AUTO_TEST_CASE(findearliestatleast_edge_test)
     BOOST_CHECK(ret2->nTimeMax >= 200 && ret2->nHeight == 4);
 }
 
+BOOST_AUTO_TEST_CASE(blockindexarena_test)
+{
+    BlockIndexArena arena;
+    std::vector<CBlockIndex*> entries;
+    for (int i = 0; i < 10000; i++) {
+        CBlockIndex* pindex = arena.Allocate();
+        BOOST_CHECK(pindex->pprev == nullptr && pindex->nHeight == 0);
+        pindex->nHeight = i;
+        pindex->pprev = (i == 0) ? nullptr : entries.back();
+        pindex->BuildSkip();
+        entries.push_back(pindex);
+    }
+    BOOST_CHECK_EQUAL(arena.size(), entries.size());
+
+    // Entries keep their address, and most follow the entry allocated before them.
+    size_t adjacent = 0;
+    for (int i = 0; i < 10000; i++) {
+        BOOST_CHECK_EQUAL(entries[i]->nHeight, i);
+        BOOST_CHECK(entries.back()->GetAncestor(i) == entries[i]);
+        if (i > 0 && entries[i] == entries[i - 1] + 1) ++adjacent;
+    }
+    BOOST_CHECK_GE(adjacent, 9990U);
+
+    BlockIndexArena other;
+    other.swap(arena);
+    BOOST_CHECK_EQUAL(arena.size(), 0U);
+    BOOST_CHECK_EQUAL(other.size(), entries.size());
+    other.clear();
+    BOOST_CHECK_EQUAL(other.size(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
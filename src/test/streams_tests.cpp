@@ -112,6 +112,34 @@ BOOST_AUTO_TEST_CASE(streams_vector_reader)
     BOOST_CHECK_THROW(new_reader >> d, std::ios_base::failure);
 }
 
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    std::vector<unsigned char> vch = {1, 255, 3, 4, 5, 6};
+
+    SpanReader reader(SER_NETWORK, INIT_PROTO_VERSION, vch);
+    BOOST_CHECK_EQUAL(reader.size(), 6U);
+    BOOST_CHECK(!reader.empty());
+
+    unsigned char a;
+    reader >> a;
+    BOOST_CHECK_EQUAL(a, 1);
+    BOOST_CHECK_EQUAL(reader.size(), 5U);
+
+    uint32_t b;
+    reader >> b;
+    BOOST_CHECK_EQUAL(b, 0x050403FF);
+    BOOST_CHECK_EQUAL(reader.size(), 1U);
+
+    // Reading past the end of the span fails and leaves the remaining data untouched.
+    uint16_t c;
+    BOOST_CHECK_THROW(reader >> c, std::ios_base::failure);
+    BOOST_CHECK_EQUAL(reader.size(), 1U);
+
+    reader >> a;
+    BOOST_CHECK_EQUAL(a, 6);
+    BOOST_CHECK(reader.empty());
+}
+
 BOOST_AUTO_TEST_CASE(bitstream_reader_writer)
 {
     CDataStream data(SER_NETWORK, INIT_PROTO_VERSION);
@@ -7,6 +7,7 @@
 #include <script/standard.h>
 #include <test/util/setup_common.h>
 #include <util/time.h>
+#include <validation.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -74,4 +75,33 @@ BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
     SyncWithValidationInterfaceQueue();
 }
 
+BOOST_FIXTURE_TEST_CASE(txindex_sync_threads, TestChain100Setup)
+{
+    // The index is the same however many threads read and prepare the blocks ahead of writing them.
+    for (const char* threads : {"1", "4"}) {
+        gArgs.ForceSetArg("-indexsyncthreads", threads);
+        TxIndex txindex(1 << 20, true);
+        txindex.Start();
+
+        constexpr int64_t timeout_ms = 10 * 1000;
+        int64_t time_start = GetTimeMillis();
+        while (!txindex.BlockUntilSyncedToCurrentChain()) {
+            BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+            UninterruptibleSleep(std::chrono::milliseconds{100});
+        }
+
+        CTransactionRef tx_disk;
+        uint256 block_hash;
+        for (size_t i = 0; i < m_coinbase_txns.size(); ++i) {
+            const CTransactionRef& txn = m_coinbase_txns[i];
+            BOOST_REQUIRE(txindex.FindTx(txn->GetHash(), block_hash, tx_disk));
+            BOOST_CHECK_EQUAL(tx_disk->GetHash(), txn->GetHash());
+            BOOST_CHECK_EQUAL(block_hash, WITH_LOCK(cs_main, return ::ChainActive()[i + 1]->GetBlockHash()));
+        }
+
+        txindex.Stop();
+        SyncWithValidationInterfaceQueue();
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,73 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <index/txospenderindex.h>
+#include <script/standard.h>
+#include <test/util/setup_common.h>
+#include <test/util/transaction_utils.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(txospenderindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(txospenderindex_initial_sync, TestChain100Setup)
+{
+    TxoSpenderIndex txospender_index(1 << 20, true);
+
+    // Spend the first coinbase output before the index is started.
+    const CMutableTransaction spend = BuildP2PKSpendingTransaction(coinbaseKey, COutPoint{m_coinbase_txns[0]->GetHash(), 0},
+                                                                   GetScriptForDestination(WitnessV0KeyHash(coinbaseKey.GetPubKey())), 11 * CENT);
+    const CScript p2pkh = GetScriptForDestination(PKHash(coinbaseKey.GetPubKey()));
+    CreateAndProcessBlock({spend}, p2pkh);
+
+    // Spends should not be found in the index before it is started.
+    TxoSpender spender;
+    BOOST_CHECK(!txospender_index.FindSpender(spend.vin[0].prevout, spender));
+
+    // BlockUntilSyncedToCurrentChain should return false before txospenderindex is started.
+    BOOST_CHECK(!txospender_index.BlockUntilSyncedToCurrentChain());
+
+    txospender_index.Start();
+
+    // Allow the index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!txospender_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        UninterruptibleSleep(std::chrono::milliseconds{100});
+    }
+
+    // Check that the spend made before the index was started is found.
+    BOOST_REQUIRE(txospender_index.FindSpender(spend.vin[0].prevout, spender));
+    BOOST_CHECK_EQUAL(spender.input.hash, CTransaction(spend).GetHash());
+    BOOST_CHECK_EQUAL(spender.input.n, 0U);
+    BOOST_CHECK_EQUAL(spender.height, 101);
+    BOOST_CHECK_EQUAL(spender.block_hash, WITH_LOCK(cs_main, return ::ChainActive()[101]->GetBlockHash()));
+
+    // Unspent outputs are not found.
+    BOOST_CHECK(!txospender_index.FindSpender(COutPoint{m_coinbase_txns[1]->GetHash(), 0}, spender));
+    BOOST_CHECK(!txospender_index.FindSpender(COutPoint{CTransaction(spend).GetHash(), 0}, spender));
+
+    // Replace the spending block by an empty one. The index rewinds the stale
+    // block when the competing block is connected.
+    CBlockIndex* stale_block_index = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    {
+        BlockValidationState state;
+        BOOST_CHECK(::ChainstateActive().InvalidateBlock(state, Params(), stale_block_index));
+    }
+    CreateAndProcessBlock({}, p2pkh);
+    BOOST_CHECK(txospender_index.BlockUntilSyncedToCurrentChain());
+    BOOST_CHECK(!txospender_index.FindSpender(spend.vin[0].prevout, spender));
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    txospender_index.Stop();
+
+    // Let scheduler events finish running to avoid accessing any memory related to the index after it is destructed
+    SyncWithValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -146,12 +146,21 @@ ChainTestingSetup::ChainTestingSetup(const std::string& chainName, const std::ve
     constexpr int script_check_threads = 2;
     StartScriptCheckWorkerThreads(script_check_threads);
     g_parallel_script_checks = true;
+
+    // Start coins prefetch threads so that block inputs are loaded in parallel.
+    constexpr int coins_prefetch_threads = 2;
+    StartCoinsPrefetchWorkerThreads(coins_prefetch_threads);
+
+    // Load blocks in the background before they are connected.
+    StartBlockReadAheadThread(DEFAULT_BLOCK_READ_AHEAD);
 }
 
 ChainTestingSetup::~ChainTestingSetup()
 {
     if (m_node.scheduler) m_node.scheduler->stop();
     StopScriptCheckWorkerThreads();
+    StopCoinsPrefetchWorkerThreads();
+    StopBlockReadAheadThread();
     GetMainSignals().FlushBackgroundCallbacks();
     GetMainSignals().UnregisterBackgroundSignalScheduler();
     m_node.connman.reset();
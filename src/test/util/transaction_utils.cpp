@@ -3,9 +3,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <coins.h>
+#include <key.h>
+#include <script/interpreter.h>
 #include <script/signingprovider.h>
 #include <test/util/transaction_utils.h>
 
+#include <cassert>
+
 CMutableTransaction BuildCreditingTransaction(const CScript& scriptPubKey, int nValue)
 {
     CMutableTransaction txCredit;
@@ -40,6 +44,26 @@ CMutableTransaction BuildSpendingTransaction(const CScript& scriptSig, const CSc
     return txSpend;
 }
 
+CMutableTransaction BuildP2PKSpendingTransaction(const CKey& key, const COutPoint& prevout, const CScript& scriptPubKey, CAmount nValue)
+{
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = prevout;
+    spend.vout.resize(1);
+    spend.vout[0].nValue = nValue;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+
+    const CScript prev_script_pub_key = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+    std::vector<unsigned char> vchSig;
+    const uint256 hash = SignatureHash(prev_script_pub_key, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    bool signed_ok = key.Sign(hash, vchSig);
+    assert(signed_ok);
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+    return spend;
+}
+
 std::vector<CMutableTransaction> SetupDummyInputs(FillableSigningProvider& keystoreRet, CCoinsViewCache& coinsRet, const std::array<CAmount,4>& nValues)
 {
     std::vector<CMutableTransaction> dummyTransactions;
@@ -9,8 +9,9 @@
 
 #include <array>
 
-class FillableSigningProvider;
 class CCoinsViewCache;
+class CKey;
+class FillableSigningProvider;
 
 // create crediting transaction
 // [1 coinbase input => 1 output with given scriptPubkey and value]
@@ -21,6 +22,10 @@ CMutableTransaction BuildCreditingTransaction(const CScript& scriptPubKey, int n
 //  1 output with empty scriptPubKey, full value of referenced transaction]
 CMutableTransaction BuildSpendingTransaction(const CScript& scriptSig, const CScriptWitness& scriptWitness, const CTransaction& txCredit);
 
+// create transaction spending a pay-to-pubkey output of key
+// [1 input with given outpoint, signed with SIGHASH_ALL => 1 output with given scriptPubKey and value]
+CMutableTransaction BuildP2PKSpendingTransaction(const CKey& key, const COutPoint& prevout, const CScript& scriptPubKey, CAmount nValue);
+
 // Helper: create two dummy transactions, each with two outputs.
 // The first has nValues[0] and nValues[1] outputs paid to a TxoutType::PUBKEY,
 // the second nValues[2] and nValues[3] outputs paid to a TxoutType::PUBKEYHASH.
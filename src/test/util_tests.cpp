@@ -14,6 +14,7 @@
 #include <test/util/str.h>
 #include <uint256.h>
 #include <util/getuniquepath.h>
+#include <util/lzcompress.h>
 #include <util/message.h> // For MessageSign(), MessageVerify(), MESSAGE_MAGIC
 #include <util/moneystr.h>
 #include <util/spanparsing.h>
@@ -2224,4 +2225,67 @@ BOOST_AUTO_TEST_CASE(remove_prefix)
     BOOST_CHECK_EQUAL(RemovePrefix("", ""), "");
 }
 
+BOOST_AUTO_TEST_CASE(lzcompress_roundtrip)
+{
+    auto roundtrip = [](const std::vector<uint8_t>& data) {
+        const std::vector<uint8_t> compressed{LZCompress(data)};
+        std::vector<uint8_t> decompressed(data.size());
+        BOOST_CHECK(LZDecompress(compressed, decompressed));
+        BOOST_CHECK(decompressed == data);
+        return compressed;
+    };
+
+    BOOST_CHECK_EQUAL(roundtrip({}).size(), 1U);
+    roundtrip({'a', 'b', 'c'});
+
+    // Runs and repeated strings, including references overlapping the bytes they produce
+    std::vector<uint8_t> repetitive(100000, 'x');
+    for (size_t i = 0; i < repetitive.size(); i += 1000) {
+        std::copy_n("Chancellor on brink of second bailout for banks", 47, repetitive.begin() + i);
+    }
+    BOOST_CHECK_LT(roundtrip(repetitive).size(), repetitive.size() / 50);
+
+    // Incompressible data grows by little
+    const std::vector<uint8_t> random{g_insecure_rand_ctx.randbytes(100000)};
+    BOOST_CHECK_LT(roundtrip(random).size(), random.size() + random.size() / 200);
+
+    // Mixed data
+    std::vector<uint8_t> mixed;
+    for (int i = 0; i < 100; ++i) {
+        if (i % 2) {
+            mixed.insert(mixed.end(), random.begin() + i * 500, random.begin() + i * 500 + 300);
+        } else {
+            mixed.insert(mixed.end(), repetitive.begin() + i, repetitive.begin() + i + 2000);
+        }
+    }
+    roundtrip(mixed);
+}
+
+BOOST_AUTO_TEST_CASE(lzcompress_malformed)
+{
+    std::vector<uint8_t> data(1000, 'x');
+    std::copy_n("Chancellor on brink of second bailout for banks", 47, data.begin() + 500);
+    const std::vector<uint8_t> compressed{LZCompress(data)};
+
+    // The output must have the exact uncompressed size.
+    std::vector<uint8_t> out(data.size() - 1);
+    BOOST_CHECK(!LZDecompress(compressed, out));
+    out.resize(data.size() + 1);
+    BOOST_CHECK(!LZDecompress(compressed, out));
+
+    // Truncated data
+    out.resize(data.size());
+    for (size_t size = 0; size < compressed.size(); ++size) {
+        BOOST_CHECK(!LZDecompress(Span<const uint8_t>{compressed}.first(size), out));
+    }
+
+    // A back reference before the start of the output
+    const std::vector<uint8_t> bad_offset{0x10, 'a', 0x02, 0x00, 0x00};
+    out.resize(5);
+    BOOST_CHECK(!LZDecompress(bad_offset, out));
+    const std::vector<uint8_t> good_offset{0x10, 'a', 0x01, 0x00, 0x00};
+    BOOST_CHECK(LZDecompress(good_offset, out));
+    BOOST_CHECK(out == std::vector<uint8_t>(5, 'a'));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -321,6 +321,43 @@ BOOST_AUTO_TEST_CASE(mempool_locks_reorg)
     }
 }
 
+BOOST_AUTO_TEST_CASE(reconnect_blocks_from_disk)
+{
+    bool ignored;
+    auto ProcessBlock = [&](std::shared_ptr<const CBlock> block) -> bool {
+        return Assert(m_node.chainman)->ProcessNewBlock(Params(), block, /* fForceProcessing */ true, /* fNewBlock */ &ignored);
+    };
+
+    BOOST_REQUIRE(ProcessBlock(std::make_shared<CBlock>(Params().GenesisBlock())));
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    uint256 prev_hash{Params().GenesisBlock().GetHash()};
+    for (int i = 0; i < 3 * DEFAULT_BLOCK_READ_AHEAD; ++i) {
+        blocks.push_back(GoodBlock(prev_hash));
+        prev_hash = blocks.back()->GetHash();
+        BOOST_REQUIRE(ProcessBlock(blocks.back()));
+    }
+    BOOST_CHECK_EQUAL(::ChainActive().Tip()->GetBlockHash(), blocks.back()->GetHash());
+
+    // Disconnect all blocks, then connect them again. Blocks are read from
+    // disk ahead of being connected, which must not change the outcome.
+    CBlockIndex* first = WITH_LOCK(cs_main, return g_chainman.m_blockman.LookupBlockIndex(blocks.front()->GetHash()));
+    BlockValidationState state;
+    BOOST_REQUIRE(::ChainstateActive().InvalidateBlock(state, Params(), first));
+    BOOST_CHECK_EQUAL(::ChainActive().Tip()->GetBlockHash(), Params().GenesisBlock().GetHash());
+    WITH_LOCK(cs_main, ::ChainstateActive().ResetBlockFailureFlags(first));
+    SyncWithValidationInterfaceQueue();
+
+    TestSubscriber sub(Params().GenesisBlock().GetHash());
+    RegisterValidationInterface(&sub);
+    BOOST_REQUIRE(::ChainstateActive().ActivateBestChain(state, Params()));
+    SyncWithValidationInterfaceQueue();
+    UnregisterValidationInterface(&sub);
+
+    BOOST_CHECK(state.IsValid());
+    BOOST_CHECK_EQUAL(::ChainActive().Tip()->GetBlockHash(), blocks.back()->GetHash());
+    BOOST_CHECK_EQUAL(sub.m_expected_tip, blocks.back()->GetHash());
+}
+
 BOOST_AUTO_TEST_CASE(witness_commitment_index)
 {
     CScript pubKey;
@@ -243,10 +243,12 @@ BOOST_FIXTURE_TEST_CASE(chainstatemanager_activate_snapshot, TestChain100Determi
             // A UTXO is missing but count is correct
             metadata.m_coins_count -= 1;
 
-            COutPoint outpoint;
+            uint256 txid;
             Coin coin;
 
-            auto_infile >> outpoint;
+            auto_infile >> txid;
+            BOOST_CHECK_EQUAL(ReadCompactSize(auto_infile), 1U);
+            ReadCompactSize(auto_infile);
             auto_infile >> coin;
     }));
     BOOST_REQUIRE(!CreateAndActivateUTXOSnapshot(
@@ -84,9 +84,10 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
 
     // We should be able to add COINS_UNTIL_CRITICAL coins to the cache before going CRITICAL.
     // This is contingent not only on the dynamic memory usage of the Coins
-    // that we're adding (COIN_SIZE bytes per), but also on how much memory the
-    // cacheCoins (unordered_map) preallocates.
-    constexpr int COINS_UNTIL_CRITICAL{3};
+    // that we're adding (COIN_SIZE bytes per, plus the expanded Coin once it
+    // is accessed), but also on how much memory the cacheCoins
+    // (unordered_map) uses for its nodes and buckets.
+    constexpr int COINS_UNTIL_CRITICAL{2};
 
     for (int i{0}; i < COINS_UNTIL_CRITICAL; ++i) {
         COutPoint res = add_coin(view);
@@ -98,7 +99,7 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
     }
 
     // Adding some additional coins will push us over the edge to CRITICAL.
-    for (int i{0}; i < 4; ++i) {
+    for (int i{0}; i < 3; ++i) {
         add_coin(view);
         print_view_mem_usage(view);
         if (chainstate.GetCoinsCacheSizeState(&tx_pool, MAX_COINS_CACHE_BYTES, /*max_mempool_size_bytes*/ 0) ==
@@ -148,20 +149,21 @@ BOOST_AUTO_TEST_CASE(getcoinscachesizestate)
             CoinsCacheSizeState::OK);
     }
 
-    // Flushing the view doesn't take us back to OK because cacheCoins has
-    // preallocated memory that doesn't get reclaimed even after flush.
-
     BOOST_CHECK_EQUAL(
         chainstate.GetCoinsCacheSizeState(&tx_pool, MAX_COINS_CACHE_BYTES, 0),
         CoinsCacheSizeState::CRITICAL);
 
+    // Flushing the view releases the pooled memory of cacheCoins, which takes
+    // us back to OK.
     view.SetBestBlock(InsecureRand256());
     BOOST_CHECK(view.Flush());
+    // The coins count until a background write has reached the database.
+    BOOST_CHECK(chainstate.CoinsDB().WaitForPendingWrite());
     print_view_mem_usage(view);
 
     BOOST_CHECK_EQUAL(
         chainstate.GetCoinsCacheSizeState(&tx_pool, MAX_COINS_CACHE_BYTES, 0),
-        CoinsCacheSizeState::CRITICAL);
+        CoinsCacheSizeState::OK);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
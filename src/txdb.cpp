@@ -5,6 +5,8 @@
 
 #include <txdb.h>
 
+#include <flatfile.h>
+#include <hash.h>
 #include <node/ui_interface.h>
 #include <pow.h>
 #include <random.h>
@@ -12,11 +14,17 @@
 #include <uint256.h>
 #include <util/memory.h>
 #include <util/system.h>
+#include <util/threadnames.h>
 #include <util/translation.h>
 #include <util/vector.h>
+#include <warnings.h>
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
 static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
@@ -27,6 +35,15 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_BLOCK_INDEX_IMAGE = 'i';
+//! While a bulk loaded coins database is not fully compacted, the first txid
+//! byte that the compaction resumes at.
+static const char DB_BULK_LOAD = 'L';
+
+//! With the partitioned -dbbackend the coins get a database, and nearly all of
+//! the cache, of their own. Batches spanning the coins and the best block
+//! markers need not be atomic, as DB_HEAD_BLOCKS covers partial flushes.
+static const DBPartition COINS_DB_PARTITION{DB_COIN, 0.9};
 
 namespace {
 
@@ -40,13 +57,84 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe) :
-    m_db(MakeUnique<CDBWrapper>(ldb_path, nCacheSize, fMemory, fWipe, true)),
+bool IsBulkLoad(const fs::path& path, bool fMemory, bool fWipe)
+{
+    return gArgs.GetBoolArg("-dbbulkload", DEFAULT_DB_BULK_LOAD) && !fMemory && (fWipe || !fs::exists(path));
+}
+
+static DBOptions WithCoinsPartition(DBOptions db_options)
+{
+    db_options.partitions.push_back(COINS_DB_PARTITION);
+    return db_options;
+}
+
+CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe, DBOptions db_options, bool background_flush) :
     m_ldb_path(ldb_path),
-    m_is_memory(fMemory) { }
+    m_is_memory(fMemory),
+    m_db_options(WithCoinsPartition(std::move(db_options))),
+    m_background_flush(background_flush)
+{
+    m_db = MakeUnique<CDBWrapper>(ldb_path, nCacheSize, fMemory, fWipe, true, m_db_options);
+    if (m_db_options.bulk_load) {
+        // Remember the bulk load, so that the database is compacted after it
+        // even when it finishes in a later session.
+        m_db->Write(DB_BULK_LOAD, 0);
+    } else if (m_db->Exists(DB_BULK_LOAD)) {
+        // The bulk load of an earlier session is not finished or not compacted yet.
+        m_db_options.bulk_load = true;
+        m_db.reset();
+        m_db = MakeUnique<CDBWrapper>(ldb_path, nCacheSize, fMemory, /*fWipe*/ false, true, m_db_options);
+    }
+}
+
+CCoinsViewDB::~CCoinsViewDB()
+{
+    StopCompaction();
+    WaitForPendingWrite();
+}
+
+void CCoinsViewDB::StopCompaction()
+{
+    m_compaction_interrupt = true;
+    if (m_compaction_thread.joinable()) m_compaction_thread.join();
+    m_compaction_interrupt = false;
+}
+
+void CCoinsViewDB::ResumeCompaction()
+{
+    int start;
+    if (m_db_options.bulk_load || !m_db->Read(DB_BULK_LOAD, start)) return;
+    LogPrintf("Compacting %s after the initial block download\n", m_ldb_path.string());
+    m_compaction_thread = std::thread([this, start] {
+        util::ThreadRename("coinscompact");
+        // Compact in steps by the first byte of the txid, so that shutdown
+        // does not wait for a compaction of the whole database, and record
+        // each step for the compaction to resume at after a restart.
+        for (int i = std::max(start, 0); i < 256; ++i) {
+            if (m_compaction_interrupt) return;
+            const std::pair<char, uint8_t> begin{DB_COIN, uint8_t(i)};
+            const std::pair<char, uint8_t> end = i < 255 ? std::make_pair(DB_COIN, uint8_t(i + 1)) : std::make_pair(char(DB_COIN + 1), uint8_t{0});
+            m_db->CompactRange(begin, end);
+            if (i < 255) m_db->Write(DB_BULK_LOAD, i + 1);
+        }
+        m_db->Erase(DB_BULK_LOAD);
+        LogPrintf("Finished compacting %s\n", m_ldb_path.string());
+    });
+}
+
+void CCoinsViewDB::FinishBulkLoad()
+{
+    if (!m_db_options.bulk_load) return;
+    m_db_options.bulk_load = false;
+    ResumeCompaction();
+}
 
 void CCoinsViewDB::ResizeCache(size_t new_cache_size)
 {
+    // The background threads must not be using m_db while it is replaced.
+    StopCompaction();
+    WaitForPendingWrite();
+
     // We can't do this operation with an in-memory DB since we'll lose all the coins upon
     // reset.
     if (!m_is_memory) {
@@ -54,19 +142,102 @@ void CCoinsViewDB::ResizeCache(size_t new_cache_size)
         // filesystem lock.
         m_db.reset();
         m_db = MakeUnique<CDBWrapper>(
-            m_ldb_path, new_cache_size, m_is_memory, /*fWipe*/ false, /*obfuscate*/ true);
+            m_ldb_path, new_cache_size, m_is_memory, /*fWipe*/ false, /*obfuscate*/ true, m_db_options);
+    }
+    ResumeCompaction();
+}
+
+std::shared_ptr<const CCoinsViewDB::PendingWrite> CCoinsViewDB::GetPendingWrite() const
+{
+    LOCK(m_pending_mutex);
+    return m_pending;
+}
+
+bool CCoinsViewDB::WaitForPendingWrite() const
+{
+    LOCK(m_writer_mutex);
+    if (m_writer_thread.joinable()) m_writer_thread.join();
+    return !m_write_failed;
+}
+
+size_t CCoinsViewDB::PendingWriteUsage() const
+{
+    const auto pending = GetPendingWrite();
+    return pending ? pending->usage : 0;
+}
+
+void CCoinsViewDB::AfterPendingWrite(std::function<void()> func)
+{
+    {
+        LOCK(m_pending_mutex);
+        if (m_pending) {
+            if (!m_write_failed) m_after_write.push_back(std::move(func));
+            return;
+        }
     }
+    func();
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    if (auto pending = GetPendingWrite()) {
+        CCoinsMap::const_iterator it = pending->coins.find(outpoint);
+        if (it != pending->coins.end()) {
+            if (it->second.coin.IsSpent()) return false;
+            coin = it->second.coin.Expand();
+            return true;
+        }
+    }
     return m_db->Read(CoinEntry(&outpoint), coin);
 }
 
+size_t CCoinsViewDB::GetCoins(Span<const COutPoint> outpoints, Span<Coin> coins) const
+{
+    assert(outpoints.size() == coins.size());
+    size_t found = 0;
+    std::vector<size_t> order;
+    order.reserve(outpoints.size());
+    const auto pending = GetPendingWrite();
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        coins[i].Clear();
+        if (pending) {
+            CCoinsMap::const_iterator it = pending->coins.find(outpoints[i]);
+            if (it != pending->coins.end()) {
+                if (!it->second.coin.IsSpent()) {
+                    coins[i] = it->second.coin.Expand();
+                    ++found;
+                }
+                continue;
+            }
+        }
+        order.push_back(i);
+    }
+    if (order.empty()) return found;
+
+    // Keys are laid out by txid, so looking them up in sorted order keeps
+    // consecutive lookups within the same table blocks.
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return outpoints[a] < outpoints[b]; });
+    std::vector<CoinEntry> keys;
+    keys.reserve(order.size());
+    for (const size_t i : order) keys.emplace_back(&outpoints[i]);
+    std::vector<Coin> values;
+    std::vector<bool> exists;
+    found += m_db->ReadMany(keys, values, exists);
+    for (size_t j = 0; j < order.size(); ++j) {
+        if (exists[j]) coins[order[j]] = std::move(values[j]);
+    }
+    return found;
+}
+
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    if (auto pending = GetPendingWrite()) {
+        CCoinsMap::const_iterator it = pending->coins.find(outpoint);
+        if (it != pending->coins.end()) return !it->second.coin.IsSpent();
+    }
     return m_db->Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
+    if (auto pending = GetPendingWrite()) return pending->best_block;
     uint256 hashBestChain;
     if (!m_db->Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
@@ -74,6 +245,8 @@ uint256 CCoinsViewDB::GetBestBlock() const {
 }
 
 std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
+    // A pending write is, as far as readers are concerned, already complete.
+    if (GetPendingWrite()) return std::vector<uint256>();
     std::vector<uint256> vhashHeadBlocks;
     if (!m_db->Read(DB_HEAD_BLOCKS, vhashHeadBlocks)) {
         return std::vector<uint256>();
@@ -82,13 +255,12 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
-    CDBBatch batch(*m_db);
-    size_t count = 0;
-    size_t changed = 0;
-    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
-    int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
+    // Only one write may be in flight, so that the database only ever moves
+    // between two consecutive best blocks.
+    if (!WaitForPendingWrite()) return false;
+
     uint256 old_tip = GetBestBlock();
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
@@ -99,6 +271,63 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
         }
     }
 
+    if (!m_background_flush) {
+        return WriteCoins(mapCoins, hashBlock, old_tip, /* erase */ true);
+    }
+
+    // Move the dirty entries out of the caller's map, so that it can be reused
+    // immediately, and let a separate thread write them. Until that is done,
+    // reads are answered from the moved entries first.
+    auto pending = std::make_shared<PendingWrite>();
+    pending->best_block = hashBlock;
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = mapCoins.erase(it)) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            pending->usage += it->second.coin.DynamicMemoryUsage();
+            pending->coins.emplace(it->first, std::move(it->second));
+        }
+    }
+    pending->usage += memusage::DynamicUsage(pending->coins);
+    WITH_LOCK(m_pending_mutex, m_pending = pending);
+
+    LOCK(m_writer_mutex);
+    m_writer_thread = std::thread([this, pending, old_tip] {
+        util::ThreadRename("coinsflush");
+        bool ret = false;
+        try {
+            // The entries are only read here; GetCoin may be looking them up concurrently.
+            ret = WriteCoins(pending->coins, pending->best_block, old_tip, /* erase */ false);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        if (!ret) {
+            // Keep the entries visible to readers until the node has shut down.
+            WITH_LOCK(m_pending_mutex, m_write_failed = true; m_after_write.clear());
+            const std::string message{"Failed to write to coin database"};
+            SetMiscWarning(Untranslated(message));
+            LogPrintf("*** %s\n", message);
+            AbortError(_("A fatal internal error occurred, see debug.log for details"));
+            StartShutdown();
+            return;
+        }
+        std::vector<std::function<void()>> after_write;
+        {
+            LOCK(m_pending_mutex);
+            m_pending.reset();
+            after_write.swap(m_after_write);
+        }
+        for (const auto& func : after_write) func();
+    });
+    return true;
+}
+
+bool CCoinsViewDB::WriteCoins(CCoinsMap& mapCoins, const uint256& hashBlock, const uint256& old_tip, bool erase)
+{
+    CDBBatch batch(*m_db);
+    size_t count = 0;
+    size_t changed = 0;
+    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
+
     // In the first batch, mark the database as being in the middle of a
     // transition from old_tip to hashBlock.
     // A vector is used for future extensibility, as we may want to support
@@ -116,8 +345,11 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (erase) {
+            it = mapCoins.erase(it);
+        } else {
+            ++it;
+        }
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             m_db->WriteBatch(batch);
@@ -147,7 +379,16 @@ size_t CCoinsViewDB::EstimateSize() const
     return m_db->EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+static DBOptions BlockTreeDBOptions(const fs::path& path, bool fMemory, bool fWipe)
+{
+    DBOptions db_options;
+    db_options.bulk_load = IsBulkLoad(path, fMemory, fWipe);
+    return db_options;
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false,
+               BlockTreeDBOptions(GetDataDir() / "blocks" / "index", fMemory, fWipe)) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -171,22 +412,38 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
+    // The cursor iterates the database directly, so it must be up to date.
+    WaitForPendingWrite();
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(*m_db).NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     i->pcursor->Seek(DB_COIN);
     // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
-    } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
-    }
+    i->ReadKey();
     return i;
 }
 
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewDB::Cursors(size_t count) const
+{
+    // All outputs of a transaction share the first byte of their key after
+    // DB_COIN, so splitting on it never splits a transaction across shards.
+    count = std::max<size_t>(1, std::min<size_t>(count, 256));
+    WaitForPendingWrite();
+    const uint256 hash_block = GetBestBlock();
+    std::vector<std::unique_ptr<CDBIterator>> iterators = const_cast<CDBWrapper&>(*m_db).NewIterators(count);
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    for (size_t n = 0; n < count; ++n) {
+        std::unique_ptr<CCoinsViewDBCursor> cursor{new CCoinsViewDBCursor(iterators[n].release(), hash_block, (n + 1) * 256 / count)};
+        uint256 shard_start;
+        *shard_start.begin() = n * 256 / count;
+        cursor->pcursor->Seek(std::make_pair(DB_COIN, shard_start));
+        cursor->ReadKey();
+        cursors.push_back(std::move(cursor));
+    }
+    return cursors;
+}
+
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
@@ -215,8 +472,13 @@ bool CCoinsViewDBCursor::Valid() const
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
+    ReadKey();
+}
+
+void CCoinsViewDBCursor::ReadKey()
+{
     CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
+    if (!pcursor->Valid() || !pcursor->GetKey(entry) || (entry.key == DB_COIN && *keyTmp.second.hash.begin() >= m_shard_end)) {
         keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
     } else {
         keyTmp.first = entry.key;
@@ -247,8 +509,239 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+/* The block index image holds the same fields as the DB_BLOCK_INDEX records, in
+ * fixed-size records that link each block to its parent by position instead of
+ * by hash, so that it can be mapped and loaded without lookups or hashing.
+ *
+ * The file is [uint32 version, uint256 image id, uint256 block files state,
+ * uint64 count], count records and the hash of everything before it. The
+ * database holds the image id under DB_BLOCK_INDEX_IMAGE while the image
+ * matches the block index records in it. The block files state, a hash of
+ * DB_LAST_BLOCK and the info of the last block file, changes whenever a block
+ * is stored, also by versions that do not know about the image.
+ */
+namespace {
+
+constexpr uint32_t BLOCK_INDEX_IMAGE_VERSION = 2;
+//! Parent position of blocks without a parent
+constexpr uint32_t BLOCK_INDEX_IMAGE_NO_PREV = std::numeric_limits<uint32_t>::max();
+
+fs::path BlockIndexImagePath()
+{
+    return GetBlocksDir() / "blockindex.dat";
+}
+
+struct BlockIndexImageRecord {
+    uint256 hash;
+    uint32_t prev{BLOCK_INDEX_IMAGE_NO_PREV};
+    int32_t height{0};
+    int32_t file{0};
+    uint32_t data_pos{0};
+    uint32_t undo_pos{0};
+    int32_t version{0};
+    uint256 merkle_root;
+    uint32_t time{0};
+    uint32_t bits{0};
+    uint32_t nonce{0};
+    uint32_t status{0};
+    uint32_t tx_count{0};
+
+    SERIALIZE_METHODS(BlockIndexImageRecord, obj)
+    {
+        READWRITE(obj.hash, obj.prev, obj.height, obj.file, obj.data_pos, obj.undo_pos, obj.version,
+                  obj.merkle_root, obj.time, obj.bits, obj.nonce, obj.status, obj.tx_count);
+    }
+};
+
+} // namespace
+
+bool CBlockTreeDB::ReadBlockFilesState(uint256& state)
+{
+    int last_file;
+    CBlockFileInfo info;
+    if (!ReadLastBlockFile(last_file) || !ReadBlockFileInfo(last_file, info)) return false;
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    hasher << last_file << info;
+    state = hasher.GetHash();
+    return true;
+}
+
+bool CBlockTreeDB::WriteBlockIndexImage(const std::vector<const CBlockIndex*>& blockinfo)
+{
+    const fs::path path = BlockIndexImagePath();
+    const fs::path path_tmp = GetBlocksDir() / "blockindex.dat.new";
+    const uint256 image_id = GetRandHash();
+    uint256 files_state;
+    if (!ReadBlockFilesState(files_state)) {
+        return error("%s: Failed to read the block files state", __func__);
+    }
+
+    CAutoFile file(fsbridge::fopen(path_tmp, "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        return error("%s: Failed to open file %s", __func__, path_tmp.string());
+    }
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    std::unordered_map<const CBlockIndex*, uint32_t> positions;
+    positions.reserve(blockinfo.size());
+    try {
+        const uint64_t count = blockinfo.size();
+        file << BLOCK_INDEX_IMAGE_VERSION << image_id << files_state << count;
+        hasher << BLOCK_INDEX_IMAGE_VERSION << image_id << files_state << count;
+        for (const CBlockIndex* pindex : blockinfo) {
+            BlockIndexImageRecord record;
+            record.hash = pindex->GetBlockHash();
+            if (pindex->pprev) {
+                const auto it = positions.find(pindex->pprev);
+                if (it == positions.end()) {
+                    file.fclose();
+                    fs::remove(path_tmp);
+                    return error("%s: Block %s comes before its parent", __func__, record.hash.ToString());
+                }
+                record.prev = it->second;
+            }
+            record.height = pindex->nHeight;
+            record.file = pindex->nFile;
+            record.data_pos = pindex->nDataPos;
+            record.undo_pos = pindex->nUndoPos;
+            record.version = pindex->nVersion;
+            record.merkle_root = pindex->hashMerkleRoot;
+            record.time = pindex->nTime;
+            record.bits = pindex->nBits;
+            record.nonce = pindex->nNonce;
+            record.status = pindex->nStatus;
+            record.tx_count = pindex->nTx;
+            positions.emplace(pindex, positions.size());
+            file << record;
+            hasher << record;
+        }
+        file << hasher.GetHash();
+    } catch (const std::exception& e) {
+        file.fclose();
+        fs::remove(path_tmp);
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    if (!FileCommit(file.Get())) {
+        file.fclose();
+        fs::remove(path_tmp);
+        return error("%s: Failed to flush file %s", __func__, path_tmp.string());
+    }
+    file.fclose();
+    if (!RenameOver(path_tmp, path)) {
+        fs::remove(path_tmp);
+        return error("%s: Rename-into-place failed", __func__);
+    }
+
+    // Only now that the image is complete on disk does the database point to it.
+    return Write(DB_BLOCK_INDEX_IMAGE, image_id, true);
+}
+
+bool CBlockTreeDB::LoadBlockIndexImage(const uint256& image_id, const std::function<CBlockIndex*(const uint256&)>& insertBlockIndex)
+{
+    const fs::path path = BlockIndexImagePath();
+    FlatFileData data;
+    if (auto mapping = MapFlatFile(path)) {
+        const Span<const uint8_t> span = mapping->data();
+        data = FlatFileData(std::move(mapping), span);
+    } else {
+        CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            return error("%s: Failed to open file %s", __func__, path.string());
+        }
+        try {
+            std::vector<uint8_t> bytes(fs::file_size(path));
+            file.read((char*)bytes.data(), bytes.size());
+            data = FlatFileData(std::move(bytes));
+        } catch (const std::exception& e) {
+            return error("%s: Failed to read file %s - %s", __func__, path.string(), e.what());
+        }
+    }
+
+    try {
+        const Span<const uint8_t> image = data.span();
+        if (image.size() < sizeof(uint256)) {
+            return error("%s: %s is truncated", __func__, path.string());
+        }
+        const Span<const uint8_t> body = image.first(image.size() - sizeof(uint256));
+        uint256 checksum;
+        SpanReader(SER_DISK, CLIENT_VERSION, image.subspan(body.size())) >> checksum;
+        if (Hash(body) != checksum) {
+            return error("%s: Checksum mismatch in %s", __func__, path.string());
+        }
+
+        SpanReader stream(SER_DISK, CLIENT_VERSION, body);
+        uint32_t version;
+        uint256 id;
+        uint256 files_state;
+        uint64_t count;
+        stream >> version;
+        if (version != BLOCK_INDEX_IMAGE_VERSION) {
+            return error("%s: Unknown version %u of %s", __func__, version, path.string());
+        }
+        stream >> id >> files_state >> count;
+        // A version that does not know about the image leaves its id in the
+        // database, but still changes the block files state as it stores blocks.
+        uint256 db_files_state;
+        if (id != image_id || !ReadBlockFilesState(db_files_state) || files_state != db_files_state) {
+            return error("%s: %s does not match the block index database", __func__, path.string());
+        }
+        const size_t record_size = GetSerializeSize(BlockIndexImageRecord(), CLIENT_VERSION);
+        if (stream.size() % record_size != 0 || stream.size() / record_size != count) {
+            return error("%s: Unexpected size of %s", __func__, path.string());
+        }
+
+        std::vector<CBlockIndex*> blocks;
+        blocks.reserve(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            BlockIndexImageRecord record;
+            stream >> record;
+            CBlockIndex* pindexNew = insertBlockIndex(record.hash);
+            if (record.prev != BLOCK_INDEX_IMAGE_NO_PREV) {
+                if (record.prev >= i) {
+                    return error("%s: Block %s comes before its parent", __func__, record.hash.ToString());
+                }
+                pindexNew->pprev = blocks[record.prev];
+            }
+            pindexNew->nHeight        = record.height;
+            pindexNew->nFile          = record.file;
+            pindexNew->nDataPos       = record.data_pos;
+            pindexNew->nUndoPos       = record.undo_pos;
+            pindexNew->nVersion       = record.version;
+            pindexNew->hashMerkleRoot = record.merkle_root;
+            pindexNew->nTime          = record.time;
+            pindexNew->nBits          = record.bits;
+            pindexNew->nNonce         = record.nonce;
+            pindexNew->nStatus        = record.status;
+            pindexNew->nTx            = record.tx_count;
+            blocks.push_back(pindexNew);
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize error in %s - %s", __func__, path.string(), e.what());
+    }
+    return true;
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
+    uint256 image_id;
+    if (Read(DB_BLOCK_INDEX_IMAGE, image_id)) {
+        // The image no longer matches the database once the block index is
+        // written again, so it is used at most once and its id is erased
+        // before that. After an unclean shutdown the database is loaded.
+        const bool use_image = gArgs.GetBoolArg("-blockindeximage", DEFAULT_BLOCK_INDEX_IMAGE);
+        const bool loaded = use_image && LoadBlockIndexImage(image_id, insertBlockIndex);
+        if (!Erase(DB_BLOCK_INDEX_IMAGE, true)) {
+            return error("%s: failed to erase the block index image id", __func__);
+        }
+        fs::remove(BlockIndexImagePath());
+        if (loaded) {
+            LogPrintf("Loaded the block index from its image\n");
+            return true;
+        }
+        if (use_image) {
+            LogPrintf("Loading the block index from the database instead of its image\n");
+        }
+    }
+
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
@@ -10,9 +10,13 @@
 #include <dbwrapper.h>
 #include <chain.h>
 #include <primitives/block.h>
+#include <sync.h>
 
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -24,6 +28,14 @@ class uint256;
 static const int64_t nDefaultDbCache = 450;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -dbbackgroundflush default
+static const bool DEFAULT_DB_BACKGROUND_FLUSH = true;
+//! -dbbulkload default
+static const bool DEFAULT_DB_BULK_LOAD = false;
+//! -blockindeximage default
+static const bool DEFAULT_BLOCK_INDEX_IMAGE = false;
+//! Target size of the chainstate table files (bytes), for fewer and larger compactions
+static const size_t COINS_DB_MAX_FILE_SIZE = 32 << 20;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
@@ -36,6 +48,10 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxTxIndexCache = 1024;
 //! Max memory allocated to all block filter index caches combined in MiB.
 static const int64_t max_filter_index_cache = 1024;
+//! Max memory allocated to address index DB specific cache in MiB.
+static const int64_t max_address_index_cache = 1024;
+//! Max memory allocated to spent output index DB specific cache in MiB.
+static const int64_t max_txospender_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
@@ -49,18 +65,68 @@ protected:
     std::unique_ptr<CDBWrapper> m_db;
     fs::path m_ldb_path;
     bool m_is_memory;
+    DBOptions m_db_options;
+
+    /** Dirty coins handed to the background writer, kept readable until they are on disk. */
+    struct PendingWrite {
+        CCoinsMapMemoryResource resource{};
+        CCoinsMap coins{0, SaltedOutpointHasher{}, CCoinsMap::key_equal{}, &resource};
+        uint256 best_block;
+        //! Memory used by the coins, counted like CCoinsViewCache::DynamicMemoryUsage().
+        size_t usage{0};
+    };
+
+    //! Whether BatchWrite hands the coins to a background thread.
+    const bool m_background_flush;
+
+    mutable Mutex m_pending_mutex;
+    //! Set while a background write is in flight, or after it failed.
+    std::shared_ptr<const PendingWrite> m_pending GUARDED_BY(m_pending_mutex);
+    //! Run once the write in flight has reached the database.
+    std::vector<std::function<void()>> m_after_write GUARDED_BY(m_pending_mutex);
+
+    //! Serializes starting and joining m_writer_thread.
+    mutable Mutex m_writer_mutex;
+    mutable std::thread m_writer_thread GUARDED_BY(m_writer_mutex);
+    std::atomic<bool> m_write_failed{false};
+
+    //! Compacts the database once a bulk load is finished (see DB_BULK_LOAD).
+    std::thread m_compaction_thread;
+    std::atomic<bool> m_compaction_interrupt{false};
+
+    std::shared_ptr<const PendingWrite> GetPendingWrite() const;
+
+    void StopCompaction();
+    //! Start or resume the compaction after a finished bulk load, unless it is done.
+    void ResumeCompaction();
+
+    /**
+     * Write the dirty entries of mapCoins to disk, moving the database from
+     * old_tip to hashBlock. Entries are erased from mapCoins as they are
+     * written if erase is true.
+     */
+    bool WriteCoins(CCoinsMap& mapCoins, const uint256& hashBlock, const uint256& old_tip, bool erase);
+
 public:
     /**
      * @param[in] ldb_path    Location in the filesystem where leveldb data will be stored.
+     * @param[in] db_options  Tuning of the database. The coins are added as a partition.
+     * @param[in] background_flush  Write the coins passed to BatchWrite in a
+     *                              background thread (see -dbbackgroundflush).
      */
-    explicit CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe);
+    explicit CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe, DBOptions db_options = {}, bool background_flush = false);
+    ~CCoinsViewDB() override;
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    //! Looks the outpoints up in key order against one state of the database.
+    size_t GetCoins(Span<const COutPoint> outpoints, Span<Coin> coins) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    //! Splits the coins into shards by the first byte of their txid.
+    std::vector<std::unique_ptr<CCoinsViewCursor>> Cursors(size_t count) const override;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
@@ -68,8 +134,35 @@ public:
 
     //! Dynamically alter the underlying leveldb cache size.
     void ResizeCache(size_t new_cache_size) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /**
+     * Block until a write started in the background by BatchWrite (see
+     * -dbbackgroundflush) has reached the database. Returns false if that
+     * write failed, in which case the database must not be used any further.
+     */
+    bool WaitForPendingWrite() const;
+
+    //! Memory used by the coins of a background write that is still in flight.
+    size_t PendingWriteUsage() const;
+
+    /**
+     * Run func once the coins passed to the last BatchWrite are on disk: right
+     * away if they are, otherwise from the background writer. func is dropped
+     * if the write fails.
+     */
+    void AfterPendingWrite(std::function<void()> func);
+
+    /**
+     * Called when initial block download is over. If the database was opened
+     * for a bulk load, in this session or an earlier one, compact it once, in
+     * the background.
+     */
+    void FinishBulkLoad() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 };
 
+/** Whether the database at path is built from scratch, so that -dbbulkload applies to it. */
+bool IsBulkLoad(const fs::path& path, bool fMemory, bool fWipe);
+
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
 class CCoinsViewDBCursor: public CCoinsViewCursor
 {
@@ -84,10 +177,15 @@ public:
     void Next() override;
 
 private:
-    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn, unsigned int shard_end = 256):
+        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn), m_shard_end(shard_end) {}
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, COutPoint> keyTmp;
+    //! The cursor stops at the first txid whose first byte is at least this.
+    unsigned int m_shard_end;
+
+    //! Cache the key at the current position of pcursor.
+    void ReadKey();
 
     friend class CCoinsViewDB;
 };
@@ -105,7 +203,18 @@ public:
     void ReadReindexing(bool &fReindexing);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    /**
+     * Write an image of the block index to the blocks directory, for the next
+     * LoadBlockIndexGuts to map instead of walking the database. Blocks must
+     * come after their parents.
+     */
+    bool WriteBlockIndexImage(const std::vector<const CBlockIndex*>& blockinfo);
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+
+private:
+    /** Hash of the last block file number and its info, which change whenever a block is stored. */
+    bool ReadBlockFilesState(uint256& state);
+    bool LoadBlockIndexImage(const uint256& image_id, const std::function<CBlockIndex*(const uint256&)>& insertBlockIndex);
 };
 
 #endif // BITCOIN_TXDB_H
@@ -933,6 +933,35 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     return base->GetCoin(outpoint, coin);
 }
 
+size_t CCoinsViewMemPool::GetCoins(Span<const COutPoint> outpoints, Span<Coin> coins) const
+{
+    assert(outpoints.size() == coins.size());
+    size_t found = 0;
+    std::vector<size_t> missing;
+    std::vector<COutPoint> missing_outpoints;
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        // As in GetCoin, mempool entries take precedence over the base.
+        CTransactionRef ptx = mempool.get(outpoints[i].hash);
+        if (!ptx) {
+            missing.push_back(i);
+            missing_outpoints.push_back(outpoints[i]);
+        } else if (outpoints[i].n < ptx->vout.size()) {
+            coins[i] = Coin(ptx->vout[outpoints[i].n], MEMPOOL_HEIGHT, false);
+            ++found;
+        } else {
+            coins[i].Clear();
+        }
+    }
+    if (missing.empty()) return found;
+
+    std::vector<Coin> missing_coins(missing.size());
+    found += base->GetCoins(missing_outpoints, missing_coins);
+    for (size_t j = 0; j < missing.size(); ++j) {
+        coins[missing[j]] = std::move(missing_coins[j]);
+    }
+    return found;
+}
+
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 15 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
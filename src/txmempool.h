@@ -868,6 +868,7 @@ protected:
 public:
     CCoinsViewMemPool(CCoinsView* baseIn, const CTxMemPool& mempoolIn);
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    size_t GetCoins(Span<const COutPoint> outpoints, Span<Coin> coins) const override;
 };
 
 /**
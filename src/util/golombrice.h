@@ -5,9 +5,13 @@
 #ifndef BITCOIN_UTIL_GOLOMBRICE_H
 #define BITCOIN_UTIL_GOLOMBRICE_H
 
+#include <crypto/common.h>
+#include <span.h>
 #include <streams.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <ios>
 
 template <typename OStream>
 void GolombRiceEncode(BitStreamWriter<OStream>& bitwriter, uint8_t P, uint64_t x)
@@ -40,4 +44,100 @@ uint64_t GolombRiceDecode(BitStreamReader<IStream>& bitreader, uint8_t P)
     return (q << P) + r;
 }
 
+/**
+ * Decodes Golomb-Rice coded values from a buffer in memory. Gives the same results as
+ * GolombRiceDecode over a BitStreamReader, but loads the data 64 bits at a time and counts
+ * the unary-encoded quotient of a value with a single count-leading-zeros instead of
+ * reading it bit by bit.
+ */
+class GolombRiceReader
+{
+private:
+    /// Data not yet loaded into m_buffer.
+    Span<const unsigned char> m_data;
+
+    /// Bits loaded from m_data and not yet consumed, most significant bit first. The bits below
+    /// the m_bits high order ones are always zero.
+    uint64_t m_buffer{0};
+
+    /// Number of valid bits in m_buffer.
+    int m_bits{0};
+
+    void Refill()
+    {
+        if (m_data.size() >= 8) {
+            m_buffer = ReadBE64(m_data.data());
+            m_bits = 64;
+            m_data = m_data.subspan(8);
+            return;
+        }
+        if (m_data.empty()) {
+            throw std::ios_base::failure("GolombRiceReader::Refill(): end of data");
+        }
+        m_buffer = 0;
+        m_bits = 0;
+        for (const unsigned char byte : m_data) {
+            m_buffer |= uint64_t{byte} << (56 - m_bits);
+            m_bits += 8;
+        }
+        m_data = m_data.last(0);
+    }
+
+    void Consume(int nbits)
+    {
+        m_buffer = nbits < 64 ? m_buffer << nbits : 0;
+        m_bits -= nbits;
+    }
+
+public:
+    explicit GolombRiceReader(Span<const unsigned char> data) : m_data(data) {}
+
+    /** Read the specified number of bits. The data is returned in the nbits least significant
+     * bits of a 64-bit uint.
+     */
+    uint64_t Read(int nbits)
+    {
+        if (nbits < 0 || nbits > 64) {
+            throw std::out_of_range("nbits must be between 0 and 64");
+        }
+
+        uint64_t data = 0;
+        while (nbits > 0) {
+            if (m_bits == 0) Refill();
+
+            const int bits = std::min(m_bits, nbits);
+            data = (bits < 64 ? data << bits : 0) | (m_buffer >> (64 - bits));
+            Consume(bits);
+            nbits -= bits;
+        }
+        return data;
+    }
+
+    uint64_t Decode(uint8_t P)
+    {
+        // Count the unary-encoded quotient: q 1's followed by one 0. As the bits below the valid
+        // ones are zero, the leading 1's of m_buffer never run past the valid bits.
+        uint64_t q = 0;
+        while (true) {
+            if (m_bits == 0) Refill();
+
+            const int ones = 64 - CountBits(~m_buffer);
+            if (ones < m_bits) {
+                q += ones;
+                Consume(ones + 1);
+                break;
+            }
+            q += m_bits;
+            Consume(m_bits);
+        }
+
+        const uint64_t r = Read(P);
+
+        return (q << P) + r;
+    }
+
+    /** Number of whole bytes of the data that were not read from yet. */
+    size_t RemainingBytes() const { return m_data.size() + m_bits / 8; }
+};
+
 #endif // BITCOIN_UTIL_GOLOMBRICE_H
@@ -0,0 +1,135 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <util/lzcompress.h>
+
+#include <crypto/common.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+//! Shortest back reference
+constexpr size_t MIN_MATCH{4};
+//! Largest distance of a back reference
+constexpr size_t MAX_OFFSET{65535};
+//! The last bytes of the input are always literals, which lets decoders copy
+//! literals without bounds checks in the LZ4 block format
+constexpr size_t LAST_LITERALS{5};
+//! No back reference starts in the last bytes of the input
+constexpr size_t MATCH_FIND_LIMIT{12};
+//! Number of bits of the hash of 4-byte sequences looked up in the match table
+constexpr int HASH_LOG{16};
+//! A run length of 15 in a token is followed by more length bytes
+constexpr size_t RUN_MASK{15};
+
+uint32_t HashSequence(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - HASH_LOG);
+}
+
+void WriteLength(std::vector<uint8_t>& out, size_t length)
+{
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(length);
+}
+
+//! Write literals, followed by a back reference unless match_length is 0.
+void WriteSequence(std::vector<uint8_t>& out, Span<const uint8_t> literals, size_t offset, size_t match_length)
+{
+    const size_t match_run{match_length ? match_length - MIN_MATCH : 0};
+    out.push_back((std::min(literals.size(), RUN_MASK) << 4) | std::min(match_run, RUN_MASK));
+    if (literals.size() >= RUN_MASK) WriteLength(out, literals.size() - RUN_MASK);
+    out.insert(out.end(), literals.begin(), literals.end());
+    if (!match_length) return;
+    out.push_back(offset & 0xff);
+    out.push_back(offset >> 8);
+    if (match_run >= RUN_MASK) WriteLength(out, match_run - RUN_MASK);
+}
+
+} // namespace
+
+std::vector<uint8_t> LZCompress(Span<const uint8_t> data)
+{
+    std::vector<uint8_t> out;
+    out.reserve(data.size() + data.size() / 255 + 16);
+    size_t anchor{0};
+    if (data.size() > MATCH_FIND_LIMIT) {
+        const size_t match_end_limit{data.size() - LAST_LITERALS};
+        const size_t match_start_limit{data.size() - MATCH_FIND_LIMIT};
+        std::vector<uint32_t> table(size_t{1} << HASH_LOG);
+        size_t pos{0};
+        while (pos < match_start_limit) {
+            const uint32_t sequence{ReadLE32(data.data() + pos)};
+            uint32_t& entry{table[HashSequence(sequence)]};
+            const size_t ref{entry};
+            entry = pos;
+            if (ref < pos && pos - ref <= MAX_OFFSET && ReadLE32(data.data() + ref) == sequence) {
+                size_t length{MIN_MATCH};
+                while (pos + length < match_end_limit && data[ref + length] == data[pos + length]) {
+                    ++length;
+                }
+                WriteSequence(out, data.subspan(anchor, pos - anchor), pos - ref, length);
+                pos += length;
+                anchor = pos;
+            } else {
+                // Skip ahead faster the longer no match is found, so that
+                // incompressible data such as hashes and signatures is cheap.
+                pos += 1 + ((pos - anchor) >> 6);
+            }
+        }
+    }
+    WriteSequence(out, data.subspan(anchor), 0, 0);
+    return out;
+}
+
+bool LZDecompress(Span<const uint8_t> data, Span<uint8_t> out)
+{
+    size_t in_pos{0};
+    size_t out_pos{0};
+    auto read_length = [&](size_t& length) {
+        uint8_t byte;
+        do {
+            if (in_pos >= data.size()) return false;
+            byte = data[in_pos++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (in_pos < data.size()) {
+        const uint8_t token{data[in_pos++]};
+        size_t literals{size_t{token} >> 4};
+        if (literals == RUN_MASK && !read_length(literals)) return false;
+        if (literals > data.size() - in_pos || literals > out.size() - out_pos) return false;
+        std::copy_n(data.begin() + in_pos, literals, out.begin() + out_pos);
+        in_pos += literals;
+        out_pos += literals;
+        // The last sequence has no back reference.
+        if (in_pos == data.size()) break;
+
+        if (data.size() - in_pos < 2) return false;
+        const size_t offset{data[in_pos] | (size_t{data[in_pos + 1]} << 8)};
+        in_pos += 2;
+        if (offset == 0 || offset > out_pos) return false;
+        size_t length{token & RUN_MASK};
+        if (length == RUN_MASK && !read_length(length)) return false;
+        length += MIN_MATCH;
+        if (length > out.size() - out_pos) return false;
+        if (offset >= length) {
+            std::memcpy(out.data() + out_pos, out.data() + out_pos - offset, length);
+        } else {
+            // The reference overlaps the bytes it produces.
+            for (size_t i = 0; i < length; ++i) {
+                out[out_pos + i] = out[out_pos - offset + i];
+            }
+        }
+        out_pos += length;
+    }
+    return out_pos == out.size();
+}
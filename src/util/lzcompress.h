@@ -0,0 +1,28 @@
+// Copyright (c) 2021 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_LZCOMPRESS_H
+#define BITCOIN_UTIL_LZCOMPRESS_H
+
+#include <span.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Compress data with a byte-oriented LZ77 encoding in the LZ4 block format:
+ * a sequence of literal runs and back references of at least 4 bytes within
+ * the preceding 64 KiB. It trades compression ratio for very fast decoding.
+ */
+std::vector<uint8_t> LZCompress(Span<const uint8_t> data);
+
+/**
+ * Decompress data compressed with LZCompress() into out, which must have the
+ * exact size of the uncompressed data.
+ *
+ * @return false if data is malformed or does not decompress to out.size() bytes.
+ */
+bool LZDecompress(Span<const uint8_t> data, Span<uint8_t> out);
+
+#endif // BITCOIN_UTIL_LZCOMPRESS_H
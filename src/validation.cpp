@@ -42,15 +42,23 @@
 #include <uint256.h>
 #include <undo.h>
 #include <util/check.h> // For NDEBUG compile time check
+#include <util/hasher.h>
 #include <util/moneystr.h>
 #include <util/rbf.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <util/threadnames.h>
 #include <util/translation.h>
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
 #include <string>
+#include <thread>
+#include <unordered_set>
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -73,6 +81,8 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static constexpr std::chrono::hours DATABASE_WRITE_INTERVAL{1};
 /** Time to wait between flushing chainstate to disk. */
 static constexpr std::chrono::hours DATABASE_FLUSH_INTERVAL{24};
+/** Share of the coins cache budget (in percent) that stays cached when the cache is trimmed. */
+static constexpr size_t COINS_CACHE_KEEP_PERCENT{50};
 /** Maximum age of our tip for us to be considered current for fee estimation */
 static constexpr std::chrono::hours MAX_FEE_ESTIMATION_TIP_AGE{3};
 const std::vector<std::string> CHECKLEVEL_DOC {
@@ -202,7 +212,8 @@ std::unique_ptr<CBlockTreeDB> pblocktree;
 bool CheckInputScripts(const CTransaction& tx, TxValidationState& state,
                        const CCoinsViewCache& inputs, unsigned int flags, bool cacheSigStore,
                        bool cacheFullScriptStore, PrecomputedTransactionData& txdata,
-                       std::vector<CScriptCheck>* pvChecks = nullptr)
+                       std::vector<CScriptCheck>* pvChecks = nullptr,
+                       BatchSchnorrVerifier* batch = nullptr)
                        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 static FILE* OpenUndoFile(const FlatFilePos &pos, bool fReadOnly = false);
 static FlatFileSeq BlockFileSeq();
@@ -1173,21 +1184,78 @@ static bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos, const CMessa
     return true;
 }
 
+/**
+ * Map the block file that holds the block stored at pos, reading the block size from the meta
+ * header in front of it. Returns nullptr if the file cannot be mapped or the meta header does not
+ * describe a block that fits in the file, in which case the caller should read through a FILE*.
+ */
+static std::shared_ptr<const MappedFlatFile> MapBlockFile(const FlatFilePos& pos, CMessageHeader::MessageStartChars& blk_start, unsigned int& blk_size)
+{
+    if (pos.IsNull() || pos.nPos < 8) return nullptr;
+    const FlatFilePos hpos(pos.nFile, pos.nPos - 8);
+    std::shared_ptr<const MappedFlatFile> mapping = BlockFileSeq().Map(hpos, 8);
+    if (!mapping) return nullptr;
+
+    SpanReader{SER_DISK, CLIENT_VERSION, mapping->data().subspan(hpos.nPos, 8)} >> blk_start >> blk_size;
+    if (blk_size > MAX_SIZE) return nullptr;
+    if (mapping->size() < size_t{pos.nPos} + blk_size) {
+        mapping = BlockFileSeq().Map(pos, blk_size);
+    }
+    return mapping;
+}
+
+/**
+ * Read the block stored at pos from its compressed block file, reading the block size from the
+ * meta header in front of it.
+ */
+static bool ReadCompressedBlock(const FlatFilePos& pos, CMessageHeader::MessageStartChars& blk_start, std::vector<uint8_t>& block_data)
+{
+    if (pos.nPos < 8) return false;
+    std::array<uint8_t, 8> header;
+    return BlockFileSeq().ReadCompressed(FlatFilePos(pos.nFile, pos.nPos - 8), header, [&](Span<const uint8_t> header_data) -> std::optional<size_t> {
+        unsigned int blk_size;
+        SpanReader{SER_DISK, CLIENT_VERSION, header_data} >> blk_start >> blk_size;
+        if (blk_size > MAX_SIZE) return std::nullopt;
+        return blk_size;
+    }, block_data);
+}
+
 bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    CMessageHeader::MessageStartChars blk_start;
+    unsigned int blk_size;
+    if (std::shared_ptr<const MappedFlatFile> mapping = MapBlockFile(pos, blk_start, blk_size)) {
+        // Deserialize straight from the mapped block file
+        try {
+            SpanReader{SER_DISK, CLIENT_VERSION, mapping->data().subspan(pos.nPos, blk_size)} >> block;
+        } catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else if (BlockFileSeq().IsCompressed(pos)) {
+        std::vector<uint8_t> block_data;
+        if (!ReadCompressedBlock(pos, blk_start, block_data)) {
+            return error("%s: failed to read compressed block at %s", __func__, pos.ToString());
+        }
+        try {
+            SpanReader{SER_DISK, CLIENT_VERSION, block_data} >> block;
+        } catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
 
-    // Read block
-    try {
-        filein >> block;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     // Check the header
@@ -1218,8 +1286,35 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
-bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start)
+bool ReadRawBlockFromDisk(FlatFileData& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start)
 {
+    CMessageHeader::MessageStartChars blk_start;
+    unsigned int blk_size;
+    if (std::shared_ptr<const MappedFlatFile> mapping = MapBlockFile(pos, blk_start, blk_size)) {
+        if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+            return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
+                    HexStr(blk_start),
+                    HexStr(message_start));
+        }
+        const Span<const uint8_t> data = mapping->data().subspan(pos.nPos, blk_size);
+        block = FlatFileData(std::move(mapping), data);
+        return true;
+    }
+
+    if (BlockFileSeq().IsCompressed(pos)) {
+        std::vector<uint8_t> block_data;
+        if (!ReadCompressedBlock(pos, blk_start, block_data)) {
+            return error("%s: failed to read compressed block at %s", __func__, pos.ToString());
+        }
+        if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+            return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
+                    HexStr(blk_start),
+                    HexStr(message_start));
+        }
+        block = FlatFileData(std::move(block_data));
+        return true;
+    }
+
     FlatFilePos hpos = pos;
     hpos.nPos -= 8; // Seek back 8 bytes for meta header
     CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
@@ -1228,9 +1323,6 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, c
     }
 
     try {
-        CMessageHeader::MessageStartChars blk_start;
-        unsigned int blk_size;
-
         filein >> blk_start >> blk_size;
 
         if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
@@ -1244,8 +1336,9 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, c
                     blk_size, MAX_SIZE);
         }
 
-        block.resize(blk_size); // Zeroing of memory is intentional here
-        filein.read((char*)block.data(), blk_size);
+        std::vector<uint8_t> block_data(blk_size); // Zeroing of memory is intentional here
+        filein.read((char*)block_data.data(), blk_size);
+        block = FlatFileData(std::move(block_data));
     } catch(const std::exception& e) {
         return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
     }
@@ -1253,7 +1346,7 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, c
     return true;
 }
 
-bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
+bool ReadRawBlockFromDisk(FlatFileData& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
 {
     FlatFilePos block_pos;
     {
@@ -1261,7 +1354,30 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex
         block_pos = pindex->GetBlockPos();
     }
 
-    return ReadRawBlockFromDisk(block, block_pos, message_start);
+    if (!ReadRawBlockFromDisk(block, block_pos, message_start)) {
+        return false;
+    }
+
+    // The bytes are handed out without being deserialized, so check that they
+    // start with the header of the requested block, as ReadBlockFromDisk() does.
+    static constexpr size_t BLOCK_HEADER_SIZE{80};
+    const Span<const uint8_t> data = block.span();
+    if (data.size() < BLOCK_HEADER_SIZE || Hash(data.first(BLOCK_HEADER_SIZE)) != pindex->GetBlockHash()) {
+        return error("%s: block header doesn't match index for %s at %s", __func__, pindex->ToString(), block_pos.ToString());
+    }
+    return true;
+}
+
+bool IsBIP30Repeat(const CBlockIndex& block_index)
+{
+    return (block_index.nHeight==91842 && block_index.GetBlockHash() == uint256S("0x00000000000a4d0a398161ffc163c503763b1f4360639393e0e4c8e300e0caec")) ||
+           (block_index.nHeight==91880 && block_index.GetBlockHash() == uint256S("0x00000000000743f190a18c5577a3c2d2a1f610ae9601ac046a38084ccb7cd721"));
+}
+
+bool IsBIP30Unspendable(const CBlockIndex& block_index)
+{
+    return (block_index.nHeight==91722 && block_index.GetBlockHash() == uint256S("0x00000000000271a2dc26e7667f8419f2e15416dc6955e5a6c6cdf3f2574dd08e")) ||
+           (block_index.nHeight==91812 && block_index.GetBlockHash() == uint256S("0x00000000000af0aed4792b1acee3d966af36cf5def14935db8de83d6f9306f2f"));
 }
 
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
@@ -1277,12 +1393,25 @@ CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
     return nSubsidy;
 }
 
+static DBOptions CoinsDBOptions(const fs::path& path, bool in_memory, bool should_wipe)
+{
+    DBOptions db_options;
+    db_options.max_file_size = COINS_DB_MAX_FILE_SIZE;
+    // Keep the chainstate compactions from queueing behind those of the
+    // block index and the indexes.
+    db_options.compaction_thread = true;
+    db_options.bulk_load = IsBulkLoad(path, in_memory, should_wipe);
+    return db_options;
+}
+
 CoinsViews::CoinsViews(
     std::string ldb_name,
     size_t cache_size_bytes,
     bool in_memory,
     bool should_wipe) : m_dbview(
-                            GetDataDir() / ldb_name, cache_size_bytes, in_memory, should_wipe),
+                            GetDataDir() / ldb_name, cache_size_bytes, in_memory, should_wipe,
+                            CoinsDBOptions(GetDataDir() / ldb_name, in_memory, should_wipe),
+                            gArgs.GetBoolArg("-dbbackgroundflush", DEFAULT_DB_BACKGROUND_FLUSH)),
                         m_catcherview(&m_dbview) {}
 
 void CoinsViews::InitCache()
@@ -1385,7 +1514,7 @@ void CChainState::CheckForkWarningConditions()
 // Called both upon regular invalid block discovery *and* InvalidateBlock
 void CChainState::InvalidChainFound(CBlockIndex* pindexNew)
 {
-    assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
+    assert(std::addressof(::ChainstateActive()) == std::addressof(*this) || m_validation_target);
     if (!pindexBestInvalid || pindexNew->nChainWork > pindexBestInvalid->nChainWork)
         pindexBestInvalid = pindexNew;
     if (pindexBestHeader != nullptr && pindexBestHeader->GetAncestor(pindexNew->nHeight) == pindexNew) {
@@ -1400,7 +1529,11 @@ void CChainState::InvalidChainFound(CBlockIndex* pindexNew)
     LogPrintf("%s:  current best=%s  height=%d  log2_work=%f  date=%s\n", __func__,
       tip->GetBlockHash().ToString(), m_chain.Height(), log(tip->nChainWork.getdouble())/log(2.0),
       FormatISO8601DateTime(tip->GetBlockTime()));
-    CheckForkWarningConditions();
+    if (m_validation_target) {
+        g_chainman.MaybeInvalidateSnapshot(pindexNew);
+    } else {
+        CheckForkWarningConditions();
+    }
 }
 
 // Same as InvalidChainFound, above, except not called directly from InvalidateBlock,
@@ -1439,6 +1572,20 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
 bool CScriptCheck::operator()() {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
     const CScriptWitness *witness = &ptxTo->vin[nIn].scriptWitness;
+    if (m_batch) {
+        // A deferred invalid signature lets the script go on and fail later
+        // for another reason, so check again without batching to report the
+        // same error as individual verification would.
+        const bool ok{VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, cacheStore, *txdata, m_batch), &error) ||
+                      VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, cacheStore, *txdata), &error)};
+        // If this is the last check of the batch, verify the batch here, on
+        // the script checking thread.
+        if (!m_batch->FinishCheck() && ok) {
+            error = SCRIPT_ERR_SCHNORR_SIG;
+            return false;
+        }
+        return ok;
+    }
     return VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, cacheStore, *txdata), &error);
 }
 
@@ -1480,6 +1627,9 @@ void InitScriptExecutionCache() {
  * script checks which are not necessary (eg due to script execution cache hits) are, obviously,
  * not pushed onto pvChecks/run.
  *
+ * If batch is not nullptr, Schnorr signatures are added to it instead of being verified, and the
+ * script checks are registered with it. The caller must finish the batch before relying on the result.
+ *
  * Setting cacheSigStore/cacheFullScriptStore to false will remove elements from the corresponding cache
  * which are matched. This is useful for checking blocks where we will likely never need the cache
  * entry again.
@@ -1492,7 +1642,7 @@ void InitScriptExecutionCache() {
 bool CheckInputScripts(const CTransaction& tx, TxValidationState& state,
                        const CCoinsViewCache& inputs, unsigned int flags, bool cacheSigStore,
                        bool cacheFullScriptStore, PrecomputedTransactionData& txdata,
-                       std::vector<CScriptCheck>* pvChecks)
+                       std::vector<CScriptCheck>* pvChecks, BatchSchnorrVerifier* batch)
 {
     if (tx.IsCoinBase()) return true;
 
@@ -1536,7 +1686,8 @@ bool CheckInputScripts(const CTransaction& tx, TxValidationState& state,
         // spent being checked as a part of CScriptCheck.
 
         // Verify signature
-        CScriptCheck check(txdata.m_spent_outputs[i], tx, i, flags, cacheSigStore, &txdata);
+        CScriptCheck check(txdata.m_spent_outputs[i], tx, i, flags, cacheSigStore, &txdata, batch);
+        if (batch) batch->AddCheck();
         if (pvChecks) {
             pvChecks->push_back(CScriptCheck());
             check.swap(pvChecks->back());
@@ -1568,7 +1719,7 @@ bool CheckInputScripts(const CTransaction& tx, TxValidationState& state,
         }
     }
 
-    if (cacheFullScriptStore && !pvChecks) {
+    if (cacheFullScriptStore && !pvChecks && !batch) {
         // We executed all of the provided scripts, and were told to
         // cache the result. Do so now.
         g_scriptExecutionCache.insert(hashCacheEntry);
@@ -1799,6 +1950,9 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, BlockValidationSt
 
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
 
+//! Number of script checks of a block whose Schnorr signatures are batch-verified together
+static constexpr unsigned int SCHNORR_BATCH_CHECKS{128};
+
 void StartScriptCheckWorkerThreads(int threads_num)
 {
     scriptcheckqueue.StartWorkerThreads(threads_num);
@@ -1809,6 +1963,242 @@ void StopScriptCheckWorkerThreads()
     scriptcheckqueue.StopWorkerThreads();
 }
 
+namespace {
+/**
+ * Closure representing the lookup of a batch of coins against the coins
+ * database, run on a prefetch worker thread. The results are stored in slots
+ * owned by the caller of PrefetchBlockInputs, which moves them into the cache
+ * after all lookups have completed.
+ */
+class CCoinsPrefetchCheck
+{
+private:
+    const CCoinsView* m_view{nullptr};
+    Span<const COutPoint> m_outpoints;
+    Span<Coin> m_results;
+
+public:
+    CCoinsPrefetchCheck() = default;
+    CCoinsPrefetchCheck(const CCoinsView& view, Span<const COutPoint> outpoints, Span<Coin> results)
+        : m_view(&view), m_outpoints(outpoints), m_results(results) {}
+
+    bool operator()()
+    {
+        m_view->GetCoins(m_outpoints, m_results);
+        return true;
+    }
+
+    void swap(CCoinsPrefetchCheck& check)
+    {
+        std::swap(m_view, check.m_view);
+        std::swap(m_outpoints, check.m_outpoints);
+        std::swap(m_results, check.m_results);
+    }
+};
+
+//! Number of outpoints looked up together by one CCoinsPrefetchCheck.
+static constexpr size_t COINS_PREFETCH_BATCH_SIZE{32};
+} // namespace
+
+static CCheckQueue<CCoinsPrefetchCheck> coinsprefetchqueue(16);
+static bool g_parallel_coins_prefetch{false};
+
+void StartCoinsPrefetchWorkerThreads(int threads_num)
+{
+    coinsprefetchqueue.StartWorkerThreads(threads_num, "coinsfetch");
+    g_parallel_coins_prefetch = threads_num > 0;
+}
+
+void StopCoinsPrefetchWorkerThreads()
+{
+    coinsprefetchqueue.StopWorkerThreads();
+    g_parallel_coins_prefetch = false;
+}
+
+namespace {
+/**
+ * Loads the blocks that are about to be connected in a background thread:
+ * reading them from disk, deserializing them and running CheckBlock (which
+ * verifies the merkle root) overlaps with connecting the preceding blocks.
+ * Blocks are requested and taken by the thread connecting blocks, in the
+ * order they will be connected.
+ */
+class BlockReadAhead
+{
+private:
+    struct Entry {
+        uint256 hash;
+        FlatFilePos pos;
+        //! The loaded block, or nullptr if it could not be read
+        std::shared_ptr<const CBlock> block;
+        bool loading{false};
+        bool done{false};
+    };
+
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    //! The blocks to load, in the order they will be connected
+    std::deque<Entry> m_entries GUARDED_BY(m_mutex);
+    const CChainParams* m_chainparams GUARDED_BY(m_mutex){nullptr};
+    size_t m_depth GUARDED_BY(m_mutex){0};
+    bool m_request_stop GUARDED_BY(m_mutex){false};
+    std::thread m_thread;
+
+    void Loop()
+    {
+        WAIT_LOCK(m_mutex, lock);
+        while (!m_request_stop) {
+            auto it = std::find_if(m_entries.begin(), m_entries.end(), [](const Entry& entry) { return !entry.loading && !entry.done; });
+            if (it == m_entries.end()) {
+                m_cv.wait(lock);
+                continue;
+            }
+            it->loading = true;
+            const uint256 hash{it->hash};
+            const FlatFilePos pos{it->pos};
+            const Consensus::Params& params{m_chainparams->GetConsensus()};
+            std::shared_ptr<CBlock> block;
+            {
+                REVERSE_LOCK(lock);
+                block = std::make_shared<CBlock>();
+                if (!ReadBlockFromDisk(*block, pos, params) || block->GetHash() != hash) {
+                    block.reset();
+                } else {
+                    // Any failure is detected and reported again by ConnectBlock.
+                    BlockValidationState state;
+                    CheckBlock(*block, state, params);
+                }
+            }
+            // The entry may have been taken or dropped in the meantime.
+            for (Entry& entry : m_entries) {
+                if (entry.hash == hash && !entry.done) {
+                    entry.block = block;
+                    entry.loading = false;
+                    entry.done = true;
+                }
+            }
+            m_cv.notify_all();
+        }
+    }
+
+public:
+    void Start(int depth)
+    {
+        assert(!m_thread.joinable());
+        if (depth <= 0) return;
+        WITH_LOCK(m_mutex, m_depth = depth);
+        m_thread = std::thread([this]() {
+            util::ThreadRename("blockload");
+            Loop();
+        });
+    }
+
+    void Stop()
+    {
+        WITH_LOCK(m_mutex, m_request_stop = true);
+        m_cv.notify_all();
+        if (m_thread.joinable()) m_thread.join();
+        LOCK(m_mutex);
+        m_entries.clear();
+        m_depth = 0;
+        m_request_stop = false;
+    }
+
+    /**
+     * Set the blocks to load next, in the order they will be connected. Blocks
+     * that were already requested are kept, all others are dropped.
+     */
+    void Request(const CChainParams& chainparams, const std::vector<std::pair<uint256, FlatFilePos>>& blocks)
+    {
+        LOCK(m_mutex);
+        std::deque<Entry> entries;
+        for (size_t i = 0; i < blocks.size() && i < m_depth; ++i) {
+            auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& entry) { return entry.hash == blocks[i].first; });
+            if (it != m_entries.end()) {
+                entries.push_back(std::move(*it));
+            } else {
+                entries.push_back(Entry{blocks[i].first, blocks[i].second});
+            }
+        }
+        m_entries = std::move(entries);
+        m_chainparams = &chainparams;
+        m_cv.notify_all();
+    }
+
+    /**
+     * Take a block out of the read-ahead, waiting for it if it is being loaded.
+     * Returns nullptr if the block was not loaded (yet), in which case the
+     * caller has to read it itself.
+     */
+    std::shared_ptr<const CBlock> Take(const uint256& hash)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& entry) { return entry.hash == hash; });
+        if (it == m_entries.end()) return nullptr;
+        // Only the loader thread changes entries while we wait, and only in place.
+        m_cv.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return !it->loading || m_request_stop; });
+        std::shared_ptr<const CBlock> block{it->block};
+        // Blocks before this one won't be connected anymore.
+        m_entries.erase(m_entries.begin(), it + 1);
+        return block;
+    }
+};
+
+BlockReadAhead g_block_read_ahead;
+} // namespace
+
+void StartBlockReadAheadThread(int depth)
+{
+    g_block_read_ahead.Start(depth);
+}
+
+void StopBlockReadAheadThread()
+{
+    g_block_read_ahead.Stop();
+}
+
+size_t PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache, const CCoinsView& base)
+{
+    if (!g_parallel_coins_prefetch) return 0;
+
+    // Outputs created within the block itself are never in the database, so
+    // skip them instead of issuing lookups that are known to miss.
+    std::unordered_set<uint256, SaltedTxidHasher> block_txids;
+    block_txids.reserve(block.vtx.size());
+    for (const auto& tx : block.vtx) {
+        block_txids.insert(tx->GetHash());
+    }
+
+    std::vector<COutPoint> missing;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase()) continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (block_txids.count(txin.prevout.hash) || cache.HaveCoinInCache(txin.prevout)) continue;
+            missing.push_back(txin.prevout);
+        }
+    }
+    if (missing.empty()) return 0;
+
+    std::vector<Coin> results(missing.size());
+    std::vector<CCoinsPrefetchCheck> checks;
+    checks.reserve((missing.size() + COINS_PREFETCH_BATCH_SIZE - 1) / COINS_PREFETCH_BATCH_SIZE);
+    for (size_t i = 0; i < missing.size(); i += COINS_PREFETCH_BATCH_SIZE) {
+        const size_t count = std::min(COINS_PREFETCH_BATCH_SIZE, missing.size() - i);
+        checks.emplace_back(base, Span<const COutPoint>{missing}.subspan(i, count), Span<Coin>{results}.subspan(i, count));
+    }
+    {
+        CCheckQueueControl<CCoinsPrefetchCheck> control(&coinsprefetchqueue);
+        control.Add(checks);
+        control.Wait();
+    }
+
+    size_t loaded = 0;
+    for (size_t i = 0; i < missing.size(); ++i) {
+        if (cache.PrefetchCoin(missing[i], std::move(results[i]))) ++loaded;
+    }
+    return loaded;
+}
+
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
 
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
@@ -2018,8 +2408,7 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     // Now that the whole chain is irreversibly beyond that time it is applied to all blocks except the
     // two in the chain that violate it. This prevents exploiting the issue against nodes during their
     // initial block download.
-    bool fEnforceBIP30 = !((pindex->nHeight==91842 && pindex->GetBlockHash() == uint256S("0x00000000000a4d0a398161ffc163c503763b1f4360639393e0e4c8e300e0caec")) ||
-                           (pindex->nHeight==91880 && pindex->GetBlockHash() == uint256S("0x00000000000743f190a18c5577a3c2d2a1f610ae9601ac046a38084ccb7cd721")));
+    bool fEnforceBIP30 = !IsBIP30Repeat(*pindex);
 
     // Once BIP34 activated it was not possible to create new duplicate coinbases and thus other than starting
     // with the 2 existing duplicate coinbase pairs, not possible to create overwriting txs.  But by the
@@ -2114,7 +2503,15 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
     // until after `control` has run the script checks (potentially
     // in multiple threads). Preallocate the vector size so a new allocation
     // doesn't invalidate pointers into the vector, and keep txsdata in scope
-    // for as long as `control`.
+    // for as long as `control`. The same holds for `schnorr_batches`, which
+    // collect the Schnorr signatures of runs of SCHNORR_BATCH_CHECKS script
+    // checks so they can be verified together by the script checking thread
+    // that runs the last check of the run. Batching is only used when
+    // actually connecting the block, as deferred signatures can't be stored
+    // in the signature cache.
+    std::deque<BatchSchnorrVerifier> schnorr_batches;
+    const bool use_schnorr_batches{fScriptChecks && !fJustCheck};
+    if (use_schnorr_batches) schnorr_batches.emplace_back();
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && g_parallel_script_checks ? &scriptcheckqueue : nullptr);
     std::vector<PrecomputedTransactionData> txsdata(block.vtx.size());
 
@@ -2174,7 +2571,8 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
             TxValidationState tx_state;
-            if (fScriptChecks && !CheckInputScripts(tx, tx_state, view, flags, fCacheResults, fCacheResults, txsdata[i], g_parallel_script_checks ? &vChecks : nullptr)) {
+            BatchSchnorrVerifier* const batch = use_schnorr_batches ? &schnorr_batches.back() : nullptr;
+            if (fScriptChecks && !CheckInputScripts(tx, tx_state, view, flags, fCacheResults, fCacheResults, txsdata[i], g_parallel_script_checks ? &vChecks : nullptr, batch)) {
                 // Any transaction validation failure in ConnectBlock is a block consensus failure
                 state.Invalid(BlockValidationResult::BLOCK_CONSENSUS,
                               tx_state.GetRejectReason(), tx_state.GetDebugMessage());
@@ -2182,6 +2580,13 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
                     tx.GetHash().ToString(), state.ToString());
             }
             control.Add(vChecks);
+            if (batch && batch->CheckCount() >= SCHNORR_BATCH_CHECKS) {
+                if (!batch->FinishCheck()) {
+                    LogPrintf("ERROR: %s: Schnorr signature batch verification failed\n", __func__);
+                    return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(SCRIPT_ERR_SCHNORR_SIG)));
+                }
+                schnorr_batches.emplace_back();
+            }
         }
 
         CTxUndo undoDummy;
@@ -2199,6 +2604,10 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-cb-amount");
     }
 
+    if (use_schnorr_batches && !schnorr_batches.back().FinishCheck()) {
+        LogPrintf("ERROR: %s: Schnorr signature batch verification failed\n", __func__);
+        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(SCRIPT_ERR_SCHNORR_SIG)));
+    }
     if (!control.Wait()) {
         LogPrintf("ERROR: %s: CheckQueue failed\n", __func__);
         return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "block-validation-failed");
@@ -2244,7 +2653,8 @@ CoinsCacheSizeState CChainState::GetCoinsCacheSizeState(
     size_t max_mempool_size_bytes)
 {
     const int64_t nMempoolUsage = tx_pool ? tx_pool->DynamicMemoryUsage() : 0;
-    int64_t cacheSize = CoinsTip().DynamicMemoryUsage();
+    // Coins handed to a background write are still held in memory.
+    int64_t cacheSize = CoinsTip().DynamicMemoryUsage() + CoinsDB().PendingWriteUsage();
     int64_t nTotalSpace =
         max_coins_cache_size_bytes + std::max<int64_t>(max_mempool_size_bytes - nMempoolUsage, 0);
 
@@ -2384,15 +2794,38 @@ bool CChainState::FlushStateToDisk(
                 return AbortNode(state, "Disk space is too low!", _("Disk space is too low!"));
             }
             // Flush the chainstate (which may refer to block index entries).
-            if (!CoinsTip().Flush())
+            // Unless the caller asked for the cache to be emptied, only write
+            // the modified entries, and if the cache is too big, evict the
+            // oldest coins so that the recently created ones stay cached.
+            if (mode == FlushStateMode::ALWAYS) {
+                if (!CoinsTip().Flush())
+                    return AbortNode(state, "Failed to write to coin database");
+            } else {
+                if (!CoinsTip().Sync())
+                    return AbortNode(state, "Failed to write to coin database");
+                if (fCacheLarge || fCacheCritical) {
+                    const size_t evicted = CoinsTip().Evict(m_coinstip_cache_size_bytes * COINS_CACHE_KEEP_PERCENT / 100);
+                    LogPrint(BCLog::COINDB, "Evicted %u coins from the cache, %u left (%.2f MiB)\n",
+                        evicted, CoinsTip().GetCacheSize(), CoinsTip().DynamicMemoryUsage() * (1.0 / (1 << 20)));
+                }
+            }
+            // The coin database may complete the write in the background
+            // (-dbbackgroundflush). Wait for it when the caller relies on the
+            // chainstate being on disk, or when pruned block files might
+            // otherwise be needed to replay up to the flushed tip.
+            if ((mode == FlushStateMode::ALWAYS || fFlushForPrune) && !CoinsDB().WaitForPendingWrite()) {
                 return AbortNode(state, "Failed to write to coin database");
+            }
             nLastFlush = nNow;
             full_flush_completed = true;
         }
     }
-    if (full_flush_completed) {
-        // Update best block in wallet (so we can detect restored wallets).
-        GetMainSignals().ChainStateFlushed(m_chain.GetLocator());
+    if (full_flush_completed && !m_validation_target) {
+        // Update best block in wallet (so we can detect restored wallets), once
+        // the chainstate it refers to has reached the disk.
+        CoinsDB().AfterPendingWrite([locator = m_chain.GetLocator()] {
+            GetMainSignals().ChainStateFlushed(locator);
+        });
     }
     } catch (const std::runtime_error& e) {
         return AbortNode(state, std::string("System error while flushing: ") + e.what());
@@ -2439,6 +2872,17 @@ static void AppendWarning(bilingual_str& res, const bilingual_str& warn)
 static void UpdateTip(CTxMemPool& mempool, const CBlockIndex* pindexNew, const CChainParams& chainParams, CChainState& active_chainstate)
     EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
 {
+    if (active_chainstate.m_validation_target) {
+        // The chainstate validating a snapshot in the background is not the
+        // one the best block, the mempool and the warnings refer to.
+        LogPrintf("%s: [background validation] new best=%s height=%d log2_work=%f tx=%lu date='%s' cache=%.1fMiB(%utxo)\n", __func__,
+          pindexNew->GetBlockHash().ToString(), pindexNew->nHeight,
+          log(pindexNew->nChainWork.getdouble())/log(2.0), (unsigned long)pindexNew->nChainTx,
+          FormatISO8601DateTime(pindexNew->GetBlockTime()),
+          active_chainstate.CoinsTip().DynamicMemoryUsage() * (1.0 / (1<<20)), active_chainstate.CoinsTip().GetCacheSize());
+        return;
+    }
+
     // New best block
     mempool.AddTransactionsUpdated(1);
 
@@ -2529,11 +2973,12 @@ bool CChainState::DisconnectTip(BlockValidationState& state, const CChainParams&
     UpdateTip(m_mempool, pindexDelete->pprev, chainparams, *this);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
-    GetMainSignals().BlockDisconnected(pblock, pindexDelete);
+    if (!m_validation_target) GetMainSignals().BlockDisconnected(pblock, pindexDelete);
     return true;
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2595,10 +3040,14 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
     int64_t nTime1 = GetTimeMicros();
     std::shared_ptr<const CBlock> pthisBlock;
     if (!pblock) {
-        std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
-        if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
-            return AbortNode(state, "Failed to read block");
-        pthisBlock = pblockNew;
+        // Use the block if it was already loaded in the background.
+        pthisBlock = g_block_read_ahead.Take(pindexNew->GetBlockHash());
+        if (!pthisBlock) {
+            std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
+            if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
+                return AbortNode(state, "Failed to read block");
+            pthisBlock = pblockNew;
+        }
     } else {
         pthisBlock = pblock;
     }
@@ -2607,6 +3056,10 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    // Warm the coins cache with this block's inputs using parallel database reads.
+    size_t prefetched = PrefetchBlockInputs(blockConnecting, CoinsTip(), CoinsErrorCatcher());
+    int64_t nTimePrefetched = GetTimeMicros(); nTimePrefetch += nTimePrefetched - nTime2;
+    LogPrint(BCLog::BENCH, "  - Prefetch %u inputs: %.2fms [%.2fs]\n", prefetched, (nTimePrefetched - nTime2) * MILLI, nTimePrefetch * MICRO);
     {
         CCoinsViewCache view(&CoinsTip());
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
@@ -2616,9 +3069,9 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
                 InvalidBlockFound(pindexNew, state);
             return error("%s: ConnectBlock %s failed, %s", __func__, pindexNew->GetBlockHash().ToString(), state.ToString());
         }
-        nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
+        nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTimePrefetched;
         assert(nBlocksTotal > 0);
-        LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
+        LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTimePrefetched) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = view.Flush();
         assert(flushed);
     }
@@ -2630,8 +3083,10 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "  - Writing chainstate: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime5 - nTime4) * MILLI, nTimeChainState * MICRO, nTimeChainState * MILLI / nBlocksTotal);
     // Remove conflicting transactions from the mempool.;
-    m_mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
-    disconnectpool.removeForBlock(blockConnecting.vtx);
+    if (!m_validation_target) {
+        m_mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
+        disconnectpool.removeForBlock(blockConnecting.vtx);
+    }
     // Update m_chain & related variables.
     m_chain.SetTip(pindexNew);
     UpdateTip(m_mempool, pindexNew, chainparams, *this);
@@ -2725,7 +3180,7 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, const CChai
 {
     AssertLockHeld(cs_main);
     AssertLockHeld(m_mempool.cs);
-    assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
+    assert(std::addressof(::ChainstateActive()) == std::addressof(*this) || m_validation_target);
 
     const CBlockIndex* pindexOldTip = m_chain.Tip();
     const CBlockIndex* pindexFork = m_chain.FindFork(pindexMostWork);
@@ -2733,11 +3188,13 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, const CChai
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
     DisconnectedBlockTransactions disconnectpool;
+    // A chainstate validating a snapshot in the background leaves the mempool alone.
+    const bool update_mempool = !m_validation_target;
     while (m_chain.Tip() && m_chain.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+        if (!DisconnectTip(state, chainparams, update_mempool ? &disconnectpool : nullptr)) {
             // This is likely a fatal error, but keep the mempool consistent,
             // just in case. Only remove from the mempool in this case.
-            UpdateMempoolForReorg(*this, m_mempool, disconnectpool, false);
+            if (update_mempool) UpdateMempoolForReorg(*this, m_mempool, disconnectpool, false);
 
             // If we're unable to disconnect a block during normal operation,
             // then that is a failure of our local system -- we should abort
@@ -2765,6 +3222,15 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, const CChai
         }
         nHeight = nTargetHeight;
 
+        // Start loading the blocks to connect in the background.
+        std::vector<std::pair<uint256, FlatFilePos>> read_ahead;
+        for (const CBlockIndex* pindex : reverse_iterate(vpindexToConnect)) {
+            if (pindex == pindexMostWork && pblock) break;
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA)) break;
+            read_ahead.emplace_back(pindex->GetBlockHash(), pindex->GetBlockPos());
+        }
+        g_block_read_ahead.Request(chainparams, read_ahead);
+
         // Connect new blocks.
         for (CBlockIndex* pindexConnect : reverse_iterate(vpindexToConnect)) {
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
@@ -2781,7 +3247,7 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, const CChai
                     // A system error occurred (disk space, database error, ...).
                     // Make the mempool consistent with the current tip, just in case
                     // any observers try to use it before shutdown.
-                    UpdateMempoolForReorg(*this, m_mempool, disconnectpool, false);
+                    if (update_mempool) UpdateMempoolForReorg(*this, m_mempool, disconnectpool, false);
                     return false;
                 }
             } else {
@@ -2795,6 +3261,8 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, const CChai
         }
     }
 
+    if (!update_mempool) return true;
+
     if (fBlocksDisconnected) {
         // If any blocks were disconnected, disconnectpool may be non empty.  Add
         // any disconnected transactions back to the mempool.
@@ -2905,17 +3373,19 @@ bool CChainState::ActivateBestChain(BlockValidationState &state, const CChainPar
 
                 for (const PerBlockConnectTrace& trace : connectTrace.GetBlocksConnected()) {
                     assert(trace.pblock && trace.pindex);
-                    GetMainSignals().BlockConnected(trace.pblock, trace.pindex);
+                    if (!m_validation_target) GetMainSignals().BlockConnected(trace.pblock, trace.pindex);
                 }
             } while (!m_chain.Tip() || (starting_tip && CBlockIndexWorkComparator()(m_chain.Tip(), starting_tip)));
             if (!blocks_connected) return true;
 
             const CBlockIndex* pindexFork = m_chain.FindFork(starting_tip);
             bool fInitialDownload = IsInitialBlockDownload();
+            if (!fInitialDownload) CoinsDB().FinishBulkLoad();
 
             // Notify external listeners about the new tip.
             // Enqueue while holding cs_main to ensure that UpdatedBlockTip is called in the order in which blocks are connected
-            if (pindexFork != pindexNewTip) {
+            // Listeners only follow the active chainstate.
+            if (pindexFork != pindexNewTip && !m_validation_target) {
                 // Notify ValidationInterface subscribers
                 GetMainSignals().UpdatedBlockTip(pindexNewTip, pindexFork, fInitialDownload);
 
@@ -2925,7 +3395,7 @@ bool CChainState::ActivateBestChain(BlockValidationState &state, const CChainPar
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
 
-        if (nStopAtHeight && pindexNewTip && pindexNewTip->nHeight >= nStopAtHeight) StartShutdown();
+        if (nStopAtHeight && pindexNewTip && pindexNewTip->nHeight >= nStopAtHeight && !WITH_LOCK(::cs_main, return m_validation_target)) StartShutdown();
 
         // We check shutdown only after giving ActivateBestChainStep a chance to run once so that we
         // never shutdown before connecting the genesis block during LoadChainTip(). Previously this
@@ -3154,7 +3624,8 @@ CBlockIndex* BlockManager::AddToBlockIndex(const CBlockHeader& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = m_block_index_arena.Allocate();
+    *pindexNew = CBlockIndex(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3179,6 +3650,19 @@ CBlockIndex* BlockManager::AddToBlockIndex(const CBlockHeader& block)
     return pindexNew;
 }
 
+void CChainState::TryAddBlockIndexCandidate(CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (m_chain.Tip() != nullptr && setBlockIndexCandidates.value_comp()(pindex, m_chain.Tip())) {
+        return;
+    }
+    // Background validation of a snapshot ends at its base block.
+    if (m_validation_target && m_validation_target->GetAncestor(pindex->nHeight) != pindex) {
+        return;
+    }
+    setBlockIndexCandidates.insert(pindex);
+}
+
 /** Mark a block as having its data received and checked (up to BLOCK_VALID_TRANSACTIONS). */
 void CChainState::ReceivedBlockTransactions(const CBlock& block, CBlockIndex* pindexNew, const FlatFilePos& pos, const Consensus::Params& consensusParams)
 {
@@ -3208,9 +3692,10 @@ void CChainState::ReceivedBlockTransactions(const CBlock& block, CBlockIndex* pi
                 LOCK(cs_nBlockSequenceId);
                 pindex->nSequenceId = nBlockSequenceId++;
             }
-            if (m_chain.Tip() == nullptr || !setBlockIndexCandidates.value_comp()(pindex, m_chain.Tip())) {
-                setBlockIndexCandidates.insert(pindex);
-            }
+            TryAddBlockIndexCandidate(pindex);
+            // The chainstate validating a snapshot in the background may need the block, too.
+            CChainState* background = g_chainman.BackgroundValidationChainstate();
+            if (background && background != this) background->TryAddBlockIndexCandidate(pindex);
             std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = m_blockman.m_blocks_unlinked.equal_range(pindex);
             while (range.first != range.second) {
                 std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first;
@@ -3776,6 +4261,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, Block
         if (state.IsInvalid() && state.GetResult() != BlockValidationResult::BLOCK_MUTATED) {
             pindex->nStatus |= BLOCK_FAILED_VALID;
             setDirtyBlockIndex.insert(pindex);
+            g_chainman.MaybeInvalidateSnapshot(pindex);
         }
         return error("%s: %s", __func__, state.ToString());
     }
@@ -3839,6 +4325,19 @@ bool ChainstateManager::ProcessNewBlock(const CChainParams& chainparams, const s
     if (!ActiveChainstate().ActivateBestChain(state, chainparams, pblock))
         return error("%s: ActivateBestChain failed (%s)", __func__, state.ToString());
 
+    // Then let the chainstate validating a snapshot in the background catch up.
+    CChainState* background = WITH_LOCK(::cs_main, return BackgroundValidationChainstate());
+    if (background) {
+        const CBlockIndex* old_tip = WITH_LOCK(::cs_main, return background->m_chain.Tip());
+        if (!background->ActivateBestChain(state, chainparams, pblock))
+            return error("%s: ActivateBestChain failed in the background (%s)", __func__, state.ToString());
+        LOCK(::cs_main);
+        if (background->m_chain.Tip() != old_tip && !MaybeCompleteSnapshotValidation()) {
+            return false;
+        }
+        MaybeRebalanceCaches();
+    }
+
     return true;
 }
 
@@ -3930,7 +4429,9 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         FlatFilePos pos(*it, 0);
+        BlockFileSeq().Unmap(pos);
         fs::remove(BlockFileSeq().FileName(pos));
+        fs::remove(BlockFileSeq().CompressedFileName(pos));
         fs::remove(UndoFileSeq().FileName(pos));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
     }
@@ -4054,6 +4555,126 @@ fs::path GetBlockPosFilename(const FlatFilePos &pos)
     return BlockFileSeq().FileName(pos);
 }
 
+namespace {
+/**
+ * Compresses finalized block files one at a time in a background thread, to
+ * reduce the disk space used by archival nodes. A block file is finalized once
+ * blocks are written to a later one. Undo files are left alone, as undo data
+ * may still be appended to older ones.
+ */
+class BlockFileCompressor
+{
+private:
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_request_stop GUARDED_BY(m_mutex){false};
+    std::thread m_thread;
+    //! The first block file that may not be compressed yet
+    int m_next_file{0};
+
+    //! Find a finalized block file that is not compressed yet, or return -1.
+    int FindFileToCompress(unsigned int& size)
+    {
+        LOCK(cs_LastBlockFile);
+        for (; m_next_file < nLastBlockFile; ++m_next_file) {
+            // Pruned block files are empty.
+            size = vinfoBlockFile[m_next_file].nSize;
+            if (size > 0 && !BlockFileSeq().IsCompressed(FlatFilePos(m_next_file, 0))) {
+                return m_next_file;
+            }
+        }
+        return -1;
+    }
+
+    void CompressFile(int n_file, unsigned int size)
+    {
+        const FlatFilePos pos(n_file, 0);
+        const int64_t start{GetTimeMillis()};
+        // Compressing a file takes a while; stop between chunks when shutting down.
+        const auto interrupt = [this] { return WITH_LOCK(m_mutex, return m_request_stop); };
+        if (!BlockFileSeq().Compress(pos, size, interrupt)) {
+            if (!interrupt()) LogPrintf("Failed to compress block file %05u\n", n_file);
+            return;
+        }
+        const fs::path compressed_path{BlockFileSeq().CompressedFileName(pos)};
+        {
+            LOCK2(cs_main, cs_LastBlockFile);
+            if (vinfoBlockFile[n_file].nSize != size) {
+                // The file was pruned in the meantime.
+                fs::remove(compressed_path);
+                return;
+            }
+            // Readers switch to the compressed file once the original is gone.
+            BlockFileSeq().Unmap(pos);
+            try {
+                fs::remove(BlockFileSeq().FileName(pos));
+            } catch (const fs::filesystem_error& e) {
+                // E.g. on Windows, while the file is open.
+                LogPrintf("Unable to remove block file %05u after compressing it: %s\n", n_file, fsbridge::get_filesystem_error_message(e));
+                fs::remove(compressed_path);
+                return;
+            }
+        }
+        LogPrintf("Compressed block file %05u from %u to %u bytes in %dms\n",
+            n_file, size, fs::file_size(compressed_path), GetTimeMillis() - start);
+    }
+
+    void Loop()
+    {
+        WAIT_LOCK(m_mutex, lock);
+        while (!m_request_stop) {
+            int n_file{-1};
+            unsigned int size{0};
+            {
+                REVERSE_LOCK(lock);
+                // Block files are read in bulk while reindexing and importing.
+                if (!fReindex && !fImporting) n_file = FindFileToCompress(size);
+                if (n_file >= 0) {
+                    CompressFile(n_file, size);
+                    ++m_next_file;
+                }
+            }
+            if (n_file < 0) {
+                // Wait for the next block file to be finalized.
+                m_cv.wait_for(lock, std::chrono::minutes{1}, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_request_stop; });
+            }
+        }
+    }
+
+public:
+    void Start()
+    {
+        assert(!m_thread.joinable());
+        m_thread = std::thread([this]() {
+            util::ThreadRename("blockcompress");
+            Loop();
+        });
+    }
+
+    void Stop()
+    {
+        WITH_LOCK(m_mutex, m_request_stop = true);
+        m_cv.notify_all();
+        if (m_thread.joinable()) m_thread.join();
+        LOCK(m_mutex);
+        m_request_stop = false;
+        m_next_file = 0;
+    }
+};
+
+BlockFileCompressor g_block_file_compressor;
+} // namespace
+
+void StartBlockFileCompressionThread()
+{
+    g_block_file_compressor.Start();
+}
+
+void StopBlockFileCompressionThread()
+{
+    g_block_file_compressor.Stop();
+}
+
 CBlockIndex * BlockManager::InsertBlockIndex(const uint256& hash)
 {
     AssertLockHeld(cs_main);
@@ -4067,7 +4688,7 @@ CBlockIndex * BlockManager::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    CBlockIndex* pindexNew = m_block_index_arena.Allocate();
     mi = m_block_index.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -4077,10 +4698,12 @@ CBlockIndex * BlockManager::InsertBlockIndex(const uint256& hash)
 bool BlockManager::LoadBlockIndex(
     const Consensus::Params& consensus_params,
     CBlockTreeDB& blocktree,
-    std::set<CBlockIndex*, CBlockIndexWorkComparator>& block_index_candidates)
+    std::set<CBlockIndex*, CBlockIndexWorkComparator>& block_index_candidates,
+    const uint256& snapshot_blockhash)
 {
     if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
         return false;
+    m_block_index_loaded = true;
 
     // Calculate nChainWork
     std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
@@ -4091,6 +4714,47 @@ bool BlockManager::LoadBlockIndex(
         vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
     }
     sort(vSortedByHeight.begin(), vSortedByHeight.end());
+
+    // Move the entries to a new arena in height order, so that walks along a
+    // chain touch neighbouring memory. The old entries are discarded, so their
+    // pskip, which is only built below, holds their new address meanwhile.
+    BlockIndexArena arena;
+    for (std::pair<int, CBlockIndex*>& item : vSortedByHeight)
+    {
+        CBlockIndex* pindexOld = item.second;
+        CBlockIndex* pindexNew = arena.Allocate();
+        *pindexNew = *pindexOld;
+        if (pindexOld->pprev) {
+            if (!pindexOld->pprev->pskip) {
+                return error("%s: block %s is not higher than its parent", __func__, pindexOld->GetBlockHash().ToString());
+            }
+            pindexNew->pprev = pindexOld->pprev->pskip;
+        }
+        pindexOld->pskip = pindexNew;
+        item.second = pindexNew;
+    }
+    for (BlockMap::value_type& entry : m_block_index) {
+        entry.second = entry.second->pskip;
+    }
+    m_block_index_arena.swap(arena);
+
+    // Fake the transaction counts of the blocks below the base of a resumed
+    // snapshot that were not downloaded yet, as PopulateAndValidateSnapshot()
+    // did when the snapshot was activated.
+    if (!snapshot_blockhash.IsNull()) {
+        CBlockIndex* base = LookupBlockIndex(snapshot_blockhash);
+        if (!base) {
+            return error("%s: snapshot base block %s is not known", __func__, snapshot_blockhash.ToString());
+        }
+        for (CBlockIndex* pindex = base; pindex; pindex = pindex->pprev) {
+            if (pindex->nTx) continue;
+            pindex->nTx = 1;
+            if (pindex->pprev && IsWitnessEnabled(pindex->pprev, consensus_params)) {
+                pindex->nStatus |= BLOCK_OPT_WITNESS;
+            }
+        }
+    }
+
     for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight)
     {
         if (ShutdownRequested()) return false;
@@ -4133,11 +4797,27 @@ void BlockManager::Unload() {
     m_failed_blocks.clear();
     m_blocks_unlinked.clear();
 
+    m_block_index.clear();
+    m_block_index_arena.clear();
+    m_block_index_loaded = false;
+}
+
+bool BlockManager::WriteBlockIndexImage(CBlockTreeDB& blocktree) const
+{
+    AssertLockHeld(cs_main);
+    if (!m_block_index_loaded) return false;
+
+    const int64_t start_time = GetTimeMillis();
+    std::vector<const CBlockIndex*> blocks;
+    blocks.reserve(m_block_index.size());
     for (const BlockMap::value_type& entry : m_block_index) {
-        delete entry.second;
+        blocks.push_back(entry.second);
     }
-
-    m_block_index.clear();
+    // Parents are lower than their children.
+    std::sort(blocks.begin(), blocks.end(), [](const CBlockIndex* a, const CBlockIndex* b) { return a->nHeight < b->nHeight; });
+    if (!blocktree.WriteBlockIndexImage(blocks)) return false;
+    LogPrintf("Wrote block index image of %u blocks in %dms\n", blocks.size(), GetTimeMillis() - start_time);
+    return true;
 }
 
 bool CChainState::LoadBlockIndexDB(const CChainParams& chainparams)
@@ -4145,7 +4825,7 @@ bool CChainState::LoadBlockIndexDB(const CChainParams& chainparams)
     assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
     if (!m_blockman.LoadBlockIndex(
             chainparams.GetConsensus(), *pblocktree,
-            setBlockIndexCandidates)) {
+            setBlockIndexCandidates, m_from_snapshot_blockhash)) {
         return false;
     }
 
@@ -4178,7 +4858,8 @@ bool CChainState::LoadBlockIndexDB(const CChainParams& chainparams)
     for (std::set<int>::iterator it = setBlkDataFiles.begin(); it != setBlkDataFiles.end(); it++)
     {
         FlatFilePos pos(*it, 0);
-        if (CAutoFile(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION).IsNull()) {
+        if (!BlockFileSeq().Exists(pos)) {
+            LogPrintf("Unable to open file %s\n", BlockFileSeq().FileName(pos).string());
             return false;
         }
     }
@@ -4222,6 +4903,9 @@ bool CChainState::LoadChainTip(const CChainParams& chainparams)
         return false;
     }
     m_chain.SetTip(pindex);
+    // The block index only populates the candidates of the active chainstate;
+    // those of a background chainstate are set up by InitBackgroundValidation().
+    setBlockIndexCandidates.insert(pindex);
     PruneBlockIndexCandidates();
 
     tip = m_chain.Tip();
@@ -4278,6 +4962,11 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CChainState& active_ch
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
+        if (pindex->GetBlockHash() == active_chainstate.m_from_snapshot_blockhash) {
+            // A snapshot chainstate has no undo data for its base and below.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (snapshot base)\n", pindex->nHeight);
+            break;
+        }
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -4645,13 +5334,35 @@ bool CChainState::LoadGenesisBlock(const CChainParams& chainparams)
     return true;
 }
 
-void CChainState::LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFilePos* dbp)
-{
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, FlatFilePos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+namespace {
+/** A block read before its parent, kept until the parent has been accepted. */
+struct UnknownParentBlock {
+    //! Position of the block in the block files, or null for blocks from external files
+    FlatFilePos pos;
+    //! The block itself, or nullptr if it has to be read from disk again
+    std::shared_ptr<CBlock> block;
+    //! Serialized size of the block
+    unsigned int size;
+};
 
-    int nLoaded = 0;
+/** Keep at most this many bytes of blocks with unknown parent in memory, read the others from disk again */
+constexpr size_t MAX_UNKNOWN_PARENT_MEMORY{32 << 20};
+/** Maximum size of the blocks scanned but not yet accepted, per file being reindexed */
+constexpr size_t MAX_REINDEX_QUEUE_SIZE{16 << 20};
+
+/** Blocks with unknown parent by parent hash, only used by the thread importing blocks */
+std::multimap<uint256, UnknownParentBlock> g_blocks_unknown_parent;
+size_t g_blocks_unknown_parent_memory{0};
+
+using ExternalBlockFn = std::function<bool(std::shared_ptr<CBlock> pblock, const uint256& hash, unsigned int size)>;
+
+/**
+ * Scan a block file for serialized blocks and pass each one to fn, along with
+ * its hash and size. If dbp is set it is updated to the position of each block
+ * before fn is called. Stops when fn returns false.
+ */
+void ScanExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFilePos* dbp, const ExternalBlockFn& fn)
+{
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
@@ -4686,89 +5397,245 @@ void CChainState::LoadExternalBlockFile(const CChainParams& chainparams, FILE* f
                     dbp->nPos = nBlockPos;
                 blkdat.SetLimit(nBlockPos + nSize);
                 std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
+                blkdat >> *pblock;
                 nRewind = blkdat.GetPos();
 
-                uint256 hash = block.GetHash();
-                {
-                    LOCK(cs_main);
-                    // detect out of order blocks, and store them for later
-                    assert(std::addressof(g_chainman.m_blockman) == std::addressof(m_blockman));
-                    if (hash != chainparams.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(block.hashPrevBlock)) {
-                        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                                block.hashPrevBlock.ToString());
-                        if (dbp)
-                            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                        continue;
-                    }
+                const uint256 hash = pblock->GetHash();
+                if (!fn(std::move(pblock), hash, nSize)) break;
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+}
+} // namespace
 
-                    // process in case the block isn't known yet
-                    assert(std::addressof(g_chainman.m_blockman) == std::addressof(m_blockman));
-                    CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
-                    if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                      BlockValidationState state;
-                      assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
-                      if (AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
-                          nLoaded++;
-                      }
-                      if (state.IsError()) {
-                          break;
-                      }
-                    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
-                      LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
-                    }
+bool CChainState::AcceptExternalBlock(const CChainParams& chainparams, std::shared_ptr<CBlock> pblock, const uint256& hash, unsigned int size, const FlatFilePos* dbp, int& nLoaded)
+{
+    {
+        LOCK(cs_main);
+        // detect out of order blocks, and store them for later
+        assert(std::addressof(g_chainman.m_blockman) == std::addressof(m_blockman));
+        if (hash != chainparams.GetConsensus().hashGenesisBlock && !m_blockman.LookupBlockIndex(pblock->hashPrevBlock)) {
+            LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                    pblock->hashPrevBlock.ToString());
+            const uint256 hashPrevBlock{pblock->hashPrevBlock};
+            UnknownParentBlock entry{dbp ? *dbp : FlatFilePos{}, nullptr, size};
+            // Keep the block itself as long as that takes little memory, so it
+            // doesn't have to be read and checked again once its parent shows up.
+            if (g_blocks_unknown_parent_memory + size <= MAX_UNKNOWN_PARENT_MEMORY) {
+                g_blocks_unknown_parent_memory += size;
+                entry.block = std::move(pblock);
+            }
+            if (entry.block || !entry.pos.IsNull()) {
+                g_blocks_unknown_parent.emplace(hashPrevBlock, std::move(entry));
+            }
+            return true;
+        }
+
+        // process in case the block isn't known yet
+        assert(std::addressof(g_chainman.m_blockman) == std::addressof(m_blockman));
+        CBlockIndex* pindex = m_blockman.LookupBlockIndex(hash);
+        if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
+            BlockValidationState state;
+            assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
+            if (AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
+                nLoaded++;
+            }
+            if (state.IsError()) {
+                return false;
+            }
+        } else if (hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
+            LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
+        }
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        BlockValidationState state;
+        assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
+        if (!ActivateBestChain(state, chainparams, nullptr)) {
+            return false;
+        }
+    }
+
+    assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
+    NotifyHeaderTip(*this);
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        auto range = g_blocks_unknown_parent.equal_range(head);
+        while (range.first != range.second) {
+            auto it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::move(it->second.block);
+            if (pblockrecursive) {
+                g_blocks_unknown_parent_memory -= it->second.size;
+            } else {
+                pblockrecursive = std::make_shared<CBlock>();
+                if (!ReadBlockFromDisk(*pblockrecursive, it->second.pos, chainparams.GetConsensus())) {
+                    pblockrecursive.reset();
+                }
+            }
+            if (pblockrecursive)
+            {
+                LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                BlockValidationState dummy;
+                assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
+                if (AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, it->second.pos.IsNull() ? nullptr : &it->second.pos, nullptr))
+                {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
                 }
+            }
+            range.first++;
+            g_blocks_unknown_parent.erase(it);
+            assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
+            NotifyHeaderTip(*this);
+        }
+    }
+    return true;
+}
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    BlockValidationState state;
-                    assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
-                    if (!ActivateBestChain(state, chainparams, nullptr)) {
-                        break;
-                    }
+void CChainState::LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFilePos* dbp)
+{
+    int64_t nStart = GetTimeMillis();
+
+    int nLoaded = 0;
+    ScanExternalBlockFile(chainparams, fileIn, dbp, [&](std::shared_ptr<CBlock> pblock, const uint256& hash, unsigned int size) {
+        return AcceptExternalBlock(chainparams, std::move(pblock), hash, size, dbp, nLoaded);
+    });
+    LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+}
+
+bool CChainState::ReindexBlockFiles(const CChainParams& chainparams, int threads)
+{
+    int n_files = 0;
+    while (BlockFileSeq().Exists(FlatFilePos(n_files, 0))) {
+        ++n_files;
+    }
+    threads = std::max(1, std::min(threads, n_files));
+
+    struct ScannedBlock {
+        std::shared_ptr<CBlock> block;
+        uint256 hash;
+        unsigned int size{0};
+        FlatFilePos pos;
+    };
+    struct FileScan {
+        std::deque<ScannedBlock> blocks;
+        size_t queued_size{0};
+        bool done{false};
+        bool opened{false};
+    };
+
+    Mutex mutex;
+    std::condition_variable cv;
+    // All guarded by mutex
+    std::vector<FileScan> files(n_files);
+    int next_file{0};
+    int accepting_file{0};
+    bool stop{false};
+
+    // Each scan thread claims the next file, deserializes and checks its
+    // blocks, and queues them for the importing thread. To bound memory usage
+    // the queue per file is limited, and threads don't run too far ahead.
+    auto scan_files = [&]() {
+        WAIT_LOCK(mutex, lock);
+        while (true) {
+            cv.wait(lock, [&]() { return stop || next_file >= n_files || next_file < accepting_file + 2 * threads; });
+            if (stop || next_file >= n_files) break;
+            const int n_file = next_file++;
+            bool opened;
+            {
+                REVERSE_LOCK(lock);
+                FlatFilePos pos(n_file, 0);
+                FILE* file = OpenBlockFile(pos, true);
+                opened = file != nullptr; // This error is logged in OpenBlockFile
+                if (opened) {
+                    ScanExternalBlockFile(chainparams, file, &pos, [&](std::shared_ptr<CBlock> pblock, const uint256& hash, unsigned int size) {
+                        // Any failure is detected and reported again by AcceptBlock.
+                        BlockValidationState state;
+                        CheckBlock(*pblock, state, chainparams.GetConsensus());
+
+                        WAIT_LOCK(mutex, queue_lock);
+                        FileScan& scan = files[n_file];
+                        cv.wait(queue_lock, [&]() { return stop || scan.queued_size < MAX_REINDEX_QUEUE_SIZE; });
+                        if (stop) return false;
+                        scan.queued_size += size;
+                        scan.blocks.push_back(ScannedBlock{std::move(pblock), hash, size, pos});
+                        cv.notify_all();
+                        return true;
+                    });
                 }
+            }
+            files[n_file].opened = opened;
+            files[n_file].done = true;
+            cv.notify_all();
+        }
+    };
 
-                assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
-                NotifyHeaderTip(*this);
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, FlatFilePos>::iterator, std::multimap<uint256, FlatFilePos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, FlatFilePos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
-                        {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            BlockValidationState dummy;
-                            assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
-                            if (AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        assert(std::addressof(::ChainstateActive()) == std::addressof(*this));
-                        NotifyHeaderTip(*this);
-                    }
+    std::vector<std::thread> workers;
+    for (int n = 0; n < threads; ++n) {
+        workers.emplace_back([&scan_files, n]() {
+            util::ThreadRename(strprintf("reindex.%i", n));
+            scan_files();
+        });
+    }
+
+    bool failed{false};
+    for (int n_file = 0; n_file < n_files && !ShutdownRequested(); ++n_file) {
+        LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)n_file);
+        int64_t nStart = GetTimeMillis();
+        int nLoaded = 0;
+        bool opened = true;
+        while (true) {
+            ScannedBlock scanned;
+            {
+                WAIT_LOCK(mutex, lock);
+                FileScan& scan = files[n_file];
+                cv.wait(lock, [&]() { return !scan.blocks.empty() || scan.done; });
+                if (scan.blocks.empty()) {
+                    opened = scan.opened;
+                    break;
+                }
+                scanned = std::move(scan.blocks.front());
+                scan.blocks.pop_front();
+                scan.queued_size -= scanned.size;
+            }
+            cv.notify_all();
+            if (ShutdownRequested()) break;
+            try {
+                if (!AcceptExternalBlock(chainparams, std::move(scanned.block), scanned.hash, scanned.size, &scanned.pos, nLoaded)) {
+                    // A block could not be stored; stop scanning the other files.
+                    WITH_LOCK(mutex, stop = true);
+                    cv.notify_all();
+                    failed = true;
+                    break;
                 }
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
-    } catch (const std::runtime_error& e) {
-        AbortNode(std::string("System error: ") + e.what());
+        if (!opened || failed) break;
+        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+        WITH_LOCK(mutex, accepting_file = n_file + 1);
+        cv.notify_all();
     }
-    LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+
+    WITH_LOCK(mutex, stop = true);
+    cv.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return !failed && !ShutdownRequested();
 }
 
 void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
@@ -4779,6 +5646,14 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
 
     LOCK(cs_main);
 
+    // Until a snapshot is validated in the background, the blocks below its
+    // base are assumed valid without being downloaded, and the chainstate
+    // validating it only considers ancestors of the base: neither fits the
+    // invariants checked here.
+    if (m_validation_target) return;
+    const CChainState* background = g_chainman.BackgroundValidationChainstate();
+    if (background && background->m_chain.Tip() != background->m_validation_target) return;
+
     // During a reindex, we read the genesis block and call CheckBlockIndex before ActivateBestChain,
     // so we have the genesis block in m_blockman.m_block_index but no active chain. (A few of the
     // tests when iterating the block tree require that m_chain has been initialized.)
@@ -5235,6 +6110,117 @@ const AssumeutxoData* ExpectedAssumeutxo(
     return nullptr;
 }
 
+//! Prefix of the directory holding the coins database of a snapshot chainstate,
+//! followed by the hash of the snapshot base (see CChainState::InitCoinsDB()).
+static const std::string SNAPSHOT_CHAINSTATE_PREFIX{"chainstate_"};
+//! Written into that directory once the snapshot is activated.
+static const char* const SNAPSHOT_BASE_FILENAME{"base_blockhash"};
+//! Written into that directory once the snapshot is validated in the background.
+static const char* const SNAPSHOT_VALIDATED_FILENAME{"validated"};
+
+static fs::path SnapshotChainstateDir(const uint256& base_blockhash)
+{
+    return GetDataDir() / (SNAPSHOT_CHAINSTATE_PREFIX + base_blockhash.ToString());
+}
+
+static bool WriteSnapshotFile(const fs::path& path, const uint256& base_blockhash)
+{
+    CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        return error("%s: failed to open %s", __func__, path.string());
+    }
+    try {
+        file << base_blockhash;
+    } catch (const std::exception& e) {
+        return error("%s: failed to write %s: %s", __func__, path.string(), e.what());
+    }
+    if (!FileCommit(file.Get())) {
+        return error("%s: failed to commit %s", __func__, path.string());
+    }
+    return true;
+}
+
+static bool ReadSnapshotFile(const fs::path& path, uint256& base_blockhash)
+{
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) return false;
+    try {
+        file >> base_blockhash;
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+//! Remove the activation record of a snapshot found invalid, so that its
+//! chainstate is removed at the next start.
+static void DropSnapshotOnRestart(const uint256& base_blockhash)
+{
+    try {
+        fs::remove(SnapshotChainstateDir(base_blockhash) / SNAPSHOT_BASE_FILENAME);
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("[snapshot] failed to remove the activation record: %s\n", e.what());
+    }
+}
+
+bool ChainstateManager::DetectSnapshotChainstate(CTxMemPool& mempool, bool drop)
+{
+    AssertLockHeld(::cs_main);
+    assert(!m_snapshot_chainstate);
+
+    std::vector<uint256> snapshots;
+    std::vector<fs::path> leftovers;
+    for (fs::directory_iterator it(GetDataDir()); it != fs::directory_iterator(); ++it) {
+        const std::string name = it->path().filename().string();
+        if (!fs::is_directory(it->path()) || name.size() != SNAPSHOT_CHAINSTATE_PREFIX.size() + 64 ||
+                name.compare(0, SNAPSHOT_CHAINSTATE_PREFIX.size(), SNAPSHOT_CHAINSTATE_PREFIX) != 0) {
+            continue;
+        }
+        const std::string hex = name.substr(SNAPSHOT_CHAINSTATE_PREFIX.size());
+        if (!IsHex(hex)) continue;
+        uint256 base_blockhash;
+        if (ReadSnapshotFile(it->path() / SNAPSHOT_BASE_FILENAME, base_blockhash) && base_blockhash.ToString() == hex) {
+            snapshots.push_back(base_blockhash);
+        } else {
+            leftovers.push_back(it->path());
+        }
+    }
+    for (const fs::path& path : leftovers) {
+        LogPrintf("[snapshot] removing %s, which holds no activated snapshot\n", path.filename().string());
+        fs::remove_all(path);
+    }
+    if (snapshots.empty()) return true;
+    if (snapshots.size() > 1) {
+        return error("%s: found %u snapshot chainstates", __func__, snapshots.size());
+    }
+
+    const uint256& base_blockhash = snapshots.front();
+    const fs::path snapshot_dir = SnapshotChainstateDir(base_blockhash);
+    if (fs::exists(snapshot_dir / SNAPSHOT_VALIDATED_FILENAME)) {
+        // The IBD chainstate is not needed anymore. Move the snapshot chainstate
+        // into its place before removing the markers, so that an interruption
+        // at any point is picked up again at the next start.
+        LogPrintf("[snapshot] replacing the IBD chainstate with the validated snapshot chainstate %s\n",
+            base_blockhash.ToString());
+        const fs::path chainstate_dir = GetDataDir() / "chainstate";
+        fs::remove_all(chainstate_dir);
+        fs::rename(snapshot_dir, chainstate_dir);
+        fs::remove(chainstate_dir / SNAPSHOT_VALIDATED_FILENAME);
+        fs::remove(chainstate_dir / SNAPSHOT_BASE_FILENAME);
+        return true;
+    }
+    if (drop) {
+        LogPrintf("[snapshot] removing the snapshot chainstate %s, which can't be rebuilt from the blocks on disk\n",
+            base_blockhash.ToString());
+        fs::remove_all(snapshot_dir);
+        return true;
+    }
+
+    LogPrintf("[snapshot] resuming the snapshot chainstate based on block %s\n", base_blockhash.ToString());
+    InitializeChainstate(mempool, base_blockhash);
+    return true;
+}
+
 bool ChainstateManager::ActivateSnapshot(
         CAutoFile& coins_file,
         const SnapshotMetadata& metadata,
@@ -5284,17 +6270,30 @@ bool ChainstateManager::ActivateSnapshot(
 
     {
         LOCK(::cs_main);
+        // Wipe any database left over from an activation that did not complete.
         snapshot_chainstate->InitCoinsDB(
             static_cast<size_t>(current_coinsdb_cache_size * SNAPSHOT_CACHE_PERC),
-            in_memory, false, "chainstate");
+            in_memory, true, "chainstate");
         snapshot_chainstate->InitCoinsCache(
             static_cast<size_t>(current_coinstip_cache_size * SNAPSHOT_CACHE_PERC));
     }
 
-    const bool snapshot_ok = this->PopulateAndValidateSnapshot(
+    bool snapshot_ok = this->PopulateAndValidateSnapshot(
         *snapshot_chainstate, coins_file, metadata);
 
+    // Record the activation, so that the snapshot chainstate is resumed after
+    // a restart.
+    const fs::path snapshot_dir = SnapshotChainstateDir(base_blockhash);
+    if (snapshot_ok && !in_memory) {
+        snapshot_ok = WriteSnapshotFile(snapshot_dir / SNAPSHOT_BASE_FILENAME, base_blockhash);
+    }
+
     if (!snapshot_ok) {
+        if (!in_memory) {
+            // Close the coins database before removing it.
+            snapshot_chainstate.reset();
+            fs::remove_all(snapshot_dir);
+        }
         WITH_LOCK(::cs_main, this->MaybeRebalanceCaches());
         return false;
     }
@@ -5306,13 +6305,41 @@ bool ChainstateManager::ActivateSnapshot(
         const bool chaintip_loaded = m_snapshot_chainstate->LoadChainTip(::Params());
         assert(chaintip_loaded);
 
+        const CBlockIndex* old_tip = m_active_chainstate->m_chain.Tip();
         m_active_chainstate = m_snapshot_chainstate.get();
 
+        // The mempool was accepted against the tip of the IBD chainstate. Evict
+        // its transactions the way a reorg would, so that listeners (e.g. the
+        // wallet) learn about it.
+        {
+            LOCK(m_active_chainstate->m_mempool.cs);
+            CTxMemPool& mempool = m_active_chainstate->m_mempool;
+            while (!mempool.mapTx.empty()) {
+                const CTransactionRef tx = mempool.mapTx.begin()->GetSharedTx();
+                mempool.removeRecursive(*tx, MemPoolRemovalReason::REORG);
+            }
+        }
+
+        InitBackgroundValidation();
+
         LogPrintf("[snapshot] successfully activated snapshot %s\n", base_blockhash.ToString());
         LogPrintf("[snapshot] (%.2f MB)\n",
             m_snapshot_chainstate->CoinsTip().DynamicMemoryUsage() / (1000 * 1000));
 
         this->MaybeRebalanceCaches();
+
+        // The active chain jumped to the snapshot base without connecting the
+        // blocks in between; tell listeners about the new tip.
+        const CBlockIndex* base = m_snapshot_chainstate->m_chain.Tip();
+        const bool initial_download = m_snapshot_chainstate->IsInitialBlockDownload();
+        GetMainSignals().UpdatedBlockTip(base, old_tip ? LastCommonAncestor(old_tip, base) : nullptr, initial_download);
+        if (base->nStatus & BLOCK_HAVE_DATA) {
+            auto block = std::make_shared<CBlock>();
+            if (ReadBlockFromDisk(*block, base, ::Params().GetConsensus())) {
+                GetMainSignals().BlockConnected(block, base);
+            }
+        }
+        uiInterface.NotifyBlockTip(GetSynchronizationState(initial_download), base);
     }
     return true;
 }
@@ -5328,8 +6355,6 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
 
     uint256 base_blockhash = metadata.m_base_blockhash;
 
-    COutPoint outpoint;
-    Coin coin;
     const uint64_t coins_count = metadata.m_coins_count;
     uint64_t coins_left = metadata.m_coins_count;
 
@@ -5337,21 +6362,51 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
     int64_t flush_now{0};
     int64_t coins_processed{0};
 
+    // The hash of the coins is computed while they are loaded, in the order
+    // of the snapshot. Only a snapshot in the order of the UTXO set database
+    // can match the assumeutxo hash, so any other order is rejected early.
+    SnapshotHasher hasher{base_blockhash};
+    uint256 txid;
+    uint256 prev_txid;
+
     while (coins_left > 0) {
+        SnapshotHasher::Outputs outputs;
         try {
-            coins_file >> outpoint;
+            coins_file >> txid;
+            const uint64_t num_outputs{ReadCompactSize(coins_file)};
+            if (coins_processed > 0 && !(prev_txid < txid)) {
+                LogPrintf("[snapshot] bad snapshot - transaction %s is out of order\n", txid.ToString());
+                return false;
+            }
+            if (num_outputs == 0 || num_outputs > coins_left) {
+                LogPrintf("[snapshot] bad snapshot - bad number of coins (%d) of transaction %s\n",
+                    num_outputs, txid.ToString());
+                return false;
+            }
+            for (uint64_t i = 0; i < num_outputs; ++i) {
+                const uint32_t n = ReadCompactSize(coins_file);
+                if (!outputs.empty() && n <= outputs.rbegin()->first) {
+                    LogPrintf("[snapshot] bad snapshot - coin %s:%d is out of order\n", txid.ToString(), n);
+                    return false;
+                }
+                coins_file >> outputs[n];
+            }
         } catch (const std::ios_base::failure&) {
             LogPrintf("[snapshot] bad snapshot - no coins left after deserializing %d coins\n",
                 coins_count - coins_left);
             return false;
         }
-        coins_file >> coin;
-        coins_cache.EmplaceCoinInternalDANGER(std::move(outpoint), std::move(coin));
+        for (const auto& output : outputs) {
+            coins_cache.EmplaceCoinInternalDANGER(COutPoint{txid, output.first}, Coin{output.second});
+        }
+        prev_txid = txid;
 
-        --coins_left;
-        ++coins_processed;
+        const int64_t coins_before{coins_processed};
+        coins_left -= outputs.size();
+        coins_processed += outputs.size();
+        hasher.Add(txid, std::move(outputs));
 
-        if (coins_processed % 1000000 == 0) {
+        if (coins_processed / 1000000 != coins_before / 1000000) {
             LogPrintf("[snapshot] %d coins loaded (%.2f%%, %.2f MB)\n",
                 coins_processed,
                 static_cast<float>(coins_processed) * 100 / static_cast<float>(coins_count),
@@ -5362,7 +6417,7 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
         //
         // If our average Coin size is roughly 41 bytes, checking every 120,000 coins
         // means <5MB of memory imprecision.
-        if (coins_processed % 120000 == 0) {
+        if (coins_processed / 120000 != coins_before / 120000) {
             if (ShutdownRequested()) {
                 return false;
             }
@@ -5396,7 +6451,7 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
 
     bool out_of_coins{false};
     try {
-        coins_file >> outpoint;
+        coins_file >> txid;
     } catch (const std::ios_base::failure&) {
         // We expect an exception since we should be out of coins.
         out_of_coins = true;
@@ -5418,17 +6473,7 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
 
     assert(coins_cache.GetBestBlock() == base_blockhash);
 
-    CCoinsStats stats;
-    auto breakpoint_fnc = [] { /* TODO insert breakpoint here? */ };
-
-    // As above, okay to immediately release cs_main here since no other context knows
-    // about the snapshot_chainstate.
-    CCoinsViewDB* snapshot_coinsdb = WITH_LOCK(::cs_main, return &snapshot_chainstate.CoinsDB());
-
-    if (!GetUTXOStats(snapshot_coinsdb, stats, CoinStatsHashType::HASH_SERIALIZED, breakpoint_fnc)) {
-        LogPrintf("[snapshot] failed to generate coins stats\n");
-        return false;
-    }
+    const CCoinsStats stats{hasher.Finalize()};
 
     // Ensure that the base blockhash appears in the known chain of valid headers. We're willing to
     // wait a bit here because the snapshot may have been loaded on startup, before we've
@@ -5541,6 +6586,106 @@ bool ChainstateManager::IsBackgroundIBD(CChainState* chainstate) const
     return (m_snapshot_chainstate && chainstate == m_ibd_chainstate.get());
 }
 
+CChainState* ChainstateManager::BackgroundValidationChainstate() const
+{
+    AssertLockHeld(::cs_main);
+    if (m_snapshot_chainstate && m_ibd_chainstate && !m_snapshot_validated) {
+        return m_ibd_chainstate.get();
+    }
+    return nullptr;
+}
+
+bool ChainstateManager::MaybeCompleteSnapshotValidation()
+{
+    AssertLockHeld(::cs_main);
+    CChainState* background = BackgroundValidationChainstate();
+    if (!background || !background->m_validation_target ||
+            background->m_chain.Tip() != background->m_validation_target) {
+        return true;
+    }
+    const CBlockIndex* base = background->m_validation_target;
+    LogPrintf("[snapshot] background chainstate reached snapshot base %s, hashing its UTXO set\n",
+        base->GetBlockHash().ToString());
+
+    // Hash the UTXO set from disk, the same way PopulateAndValidateSnapshot() did for the snapshot.
+    background->ForceFlushStateToDisk();
+    CCoinsStats stats;
+    if (!GetUTXOStats(&background->CoinsDB(), stats, CoinStatsHashType::HASH_SERIALIZED, [] {})) {
+        return AbortNode("Failed to hash the UTXO set of the background chainstate");
+    }
+    const AssumeutxoData* au_data = ExpectedAssumeutxo(base->nHeight, ::Params());
+    if (!au_data || stats.hashSerialized != au_data->hash_serialized) {
+        LogPrintf("[snapshot] bad snapshot: the validated UTXO set at height %d has hash %s\n",
+            base->nHeight, stats.hashSerialized.ToString());
+        DropSnapshotOnRestart(base->GetBlockHash());
+        return AbortNode("Background validation does not match the UTXO snapshot",
+            _("The UTXO snapshot does not match the validated chain. Restart to continue syncing without it."));
+    }
+
+    m_snapshot_validated = true;
+    LogPrintf("[snapshot] snapshot beginning at %s has been fully validated\n", base->GetBlockHash().ToString());
+    // The snapshot chainstate replaces the IBD chainstate at the next start.
+    const fs::path snapshot_dir = SnapshotChainstateDir(base->GetBlockHash());
+    if (fs::exists(snapshot_dir) && !WriteSnapshotFile(snapshot_dir / SNAPSHOT_VALIDATED_FILENAME, base->GetBlockHash())) {
+        LogPrintf("[snapshot] failed to record the validation, it is repeated at the next start\n");
+    }
+    MaybeRebalanceCaches();
+    return true;
+}
+
+void ChainstateManager::MaybeInvalidateSnapshot(const CBlockIndex* invalid_block)
+{
+    AssertLockHeld(::cs_main);
+    CChainState* background = BackgroundValidationChainstate();
+    if (!background || !background->m_validation_target ||
+            background->m_validation_target->GetAncestor(invalid_block->nHeight) != invalid_block) {
+        return;
+    }
+    LogPrintf("[snapshot] bad snapshot: block %s below its base is invalid\n", invalid_block->GetBlockHash().ToString());
+    DropSnapshotOnRestart(m_snapshot_chainstate->m_from_snapshot_blockhash);
+    AbortNode("The UTXO snapshot builds on an invalid block",
+        _("The UTXO snapshot builds on an invalid chain. Restart to continue syncing without it."));
+}
+
+void ChainstateManager::InitBackgroundValidation()
+{
+    AssertLockHeld(::cs_main);
+    CChainState* background = BackgroundValidationChainstate();
+    if (!background) return;
+
+    const CBlockIndex* base = m_blockman.LookupBlockIndex(m_snapshot_chainstate->m_from_snapshot_blockhash);
+    assert(base);
+    background->m_validation_target = base;
+
+    // Only the ancestors of the base whose data we have are candidates; the
+    // transaction counts of the others are faked.
+    auto& candidates = background->setBlockIndexCandidates;
+    candidates.clear();
+    if (background->m_chain.Tip()) {
+        candidates.insert(background->m_chain.Tip());
+    }
+    for (const BlockMap::value_type& entry : m_blockman.m_block_index) {
+        CBlockIndex* pindex = entry.second;
+        if (pindex->IsValid(BLOCK_VALID_TRANSACTIONS) && (pindex->nStatus & BLOCK_HAVE_DATA) && pindex->HaveTxsDownloaded()) {
+            background->TryAddBlockIndexCandidate(pindex);
+        }
+    }
+}
+
+void ChainstateManager::ResetAssumedValidBlockIndex()
+{
+    AssertLockHeld(::cs_main);
+    if (!m_snapshot_chainstate || m_snapshot_validated) return;
+    CBlockIndex* base = m_blockman.LookupBlockIndex(m_snapshot_chainstate->m_from_snapshot_blockhash);
+    for (CBlockIndex* pindex = base; pindex; pindex = pindex->pprev) {
+        if (pindex->nStatus & BLOCK_HAVE_DATA) continue;
+        pindex->nTx = 0;
+        pindex->nChainTx = 0;
+        pindex->nStatus &= ~BLOCK_OPT_WITNESS;
+        setDirtyBlockIndex.insert(pindex);
+    }
+}
+
 void ChainstateManager::Unload()
 {
     for (CChainState* chainstate : this->GetAll()) {
@@ -5576,7 +6721,13 @@ void ChainstateManager::MaybeRebalanceCaches()
         // If both chainstates exist, determine who needs more cache based on IBD status.
         //
         // Note: shrink caches first so that we don't inadvertently overwhelm available memory.
-        if (m_snapshot_chainstate->IsInitialBlockDownload()) {
+        if (m_snapshot_validated) {
+            // The IBD chainstate is not used anymore once it validated the snapshot.
+            m_ibd_chainstate->ResizeCoinsCaches(
+                m_total_coinstip_cache * 0.01, m_total_coinsdb_cache * 0.01);
+            m_snapshot_chainstate->ResizeCoinsCaches(
+                m_total_coinstip_cache * 0.99, m_total_coinsdb_cache * 0.99);
+        } else if (m_snapshot_chainstate->IsInitialBlockDownload()) {
             m_ibd_chainstate->ResizeCoinsCaches(
                 m_total_coinstip_cache * 0.05, m_total_coinsdb_cache * 0.05);
             m_snapshot_chainstate->ResizeCoinsCaches(
@@ -15,6 +15,7 @@
 #include <coins.h>
 #include <consensus/validation.h>
 #include <crypto/common.h> // for ReadLE64
+#include <flatfile.h>
 #include <fs.h>
 #include <node/utxo_snapshot.h>
 #include <optional.h>
@@ -38,6 +39,7 @@
 #include <utility>
 #include <vector>
 
+class BatchSchnorrVerifier;
 class CChainState;
 class BlockValidationState;
 class CBlockIndex;
@@ -75,9 +77,26 @@ static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 15;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of dedicated coins prefetch threads allowed */
+static const int MAX_COINS_PREFETCH_THREADS = 16;
+/** -coinsprefetchthreads default (number of threads reading block inputs from the chainstate ahead of ConnectBlock) */
+static const int DEFAULT_COINS_PREFETCH_THREADS = 4;
+/** Maximum number of blocks read ahead of connecting them */
+static const int MAX_BLOCK_READ_AHEAD = 32;
+/** -blockreadahead default (number of blocks read from disk and checked in the background before they are connected) */
+static const int DEFAULT_BLOCK_READ_AHEAD = 4;
+/** Maximum number of threads scanning block files during -reindex */
+static const int MAX_REINDEX_THREADS = 16;
+/** -reindexthreads default (number of threads scanning block files during -reindex, 0 = auto) */
+static const int DEFAULT_REINDEX_THREADS = 0;
+/** -compressblocks default (compress finalized block files in the background) */
+static const bool DEFAULT_COMPRESS_BLOCKS = false;
 static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = false;
+static const bool DEFAULT_COINSTATSINDEX = false;
+static const bool DEFAULT_ADDRESSINDEX = false;
+static const bool DEFAULT_TXOSPENDERINDEX = false;
 static const char* const DEFAULT_BLOCKFILTERINDEX = "0";
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -156,6 +175,37 @@ void UnloadBlockIndex(CTxMemPool* mempool, ChainstateManager& chainman);
 void StartScriptCheckWorkerThreads(int threads_num);
 /** Stop all of the script checking worker threads */
 void StopScriptCheckWorkerThreads();
+/** Run instances of coins prefetch worker threads */
+void StartCoinsPrefetchWorkerThreads(int threads_num);
+/** Stop all of the coins prefetch worker threads */
+void StopCoinsPrefetchWorkerThreads();
+/**
+ * Run a thread that reads the next blocks to be connected from disk and runs
+ * the context-free CheckBlock on them while the preceding blocks are being
+ * connected. depth is the number of blocks to stay ahead; 0 disables it.
+ */
+void StartBlockReadAheadThread(int depth);
+/** Stop the block read-ahead thread */
+void StopBlockReadAheadThread();
+/**
+ * Run a thread that compresses finalized block files to reduce their disk
+ * space. Blocks keep their positions and are decompressed when read.
+ */
+void StartBlockFileCompressionThread();
+/** Stop the block file compression thread */
+void StopBlockFileCompressionThread();
+/**
+ * Load the coins spent by a block into a cache before it is connected, so that
+ * ConnectBlock does not stall on one database read per cache miss. Outpoints
+ * not yet held by the cache are looked up from its backing view in parallel
+ * on the coins prefetch worker threads. Does nothing if no threads are running.
+ *
+ * @param[in]     block  The block whose inputs should be loaded
+ * @param[in,out] cache  The coins cache to warm
+ * @param[in]     base   The view backing cache; must be safe for concurrent reads
+ * @returns              The number of coins inserted into cache
+ */
+size_t PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache, const CCoinsView& base);
 /**
  * Return transaction from the block at block_index.
  * If block_index is not provided, fall back to mempool.
@@ -171,6 +221,12 @@ void StopScriptCheckWorkerThreads();
 CTransactionRef GetTransaction(const CBlockIndex* const block_index, const CTxMemPool* const mempool, const uint256& hash, const Consensus::Params& consensusParams, uint256& hashBlock);
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams);
 
+/** Identifies blocks that overwrote an existing coinbase output in the UTXO set (see BIP30) */
+bool IsBIP30Repeat(const CBlockIndex& block_index);
+
+/** Identifies blocks whose coinbase output was overwritten in the UTXO set (see BIP30) */
+bool IsBIP30Unspendable(const CBlockIndex& block_index);
+
 /** Guess verification progress (as a fraction between 0.0=genesis and 1.0=current tip). */
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex* pindex);
 
@@ -278,11 +334,12 @@ private:
     bool cacheStore;
     ScriptError error;
     PrecomputedTransactionData *txdata;
+    BatchSchnorrVerifier *m_batch;
 
 public:
-    CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
-    CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
-        m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
+    CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR), m_batch(nullptr) {}
+    CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn, BatchSchnorrVerifier* batchIn = nullptr) :
+        m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn), m_batch(batchIn) { }
 
     bool operator()();
 
@@ -294,6 +351,7 @@ public:
         std::swap(cacheStore, check.cacheStore);
         std::swap(error, check.error);
         std::swap(txdata, check.txdata);
+        std::swap(m_batch, check.m_batch);
     }
 
     ScriptError GetScriptError() const { return error; }
@@ -306,8 +364,9 @@ void InitScriptExecutionCache();
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
-bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start);
-bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+/** Read a serialized block. When the block file can be memory-mapped, block points straight into the mapping. */
+bool ReadRawBlockFromDisk(FlatFileData& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start);
+bool ReadRawBlockFromDisk(FlatFileData& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 
@@ -397,6 +456,12 @@ private:
      */
     void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight, int chain_tip_height, int prune_height, bool is_ibd);
 
+    //! Whether all of the block tree database was loaded into m_block_index
+    bool m_block_index_loaded GUARDED_BY(cs_main){false};
+
+    //! Storage of the entries of m_block_index
+    BlockIndexArena m_block_index_arena GUARDED_BY(cs_main);
+
 public:
     BlockMap m_block_index GUARDED_BY(cs_main);
 
@@ -433,16 +498,27 @@ public:
      *
      * @param[out] block_index_candidates  Fill this set with any valid blocks for
      *                                     which we've downloaded all transactions.
+     * @param[in]  snapshot_blockhash      The base of the snapshot chainstate being
+     *                                     resumed, if any. Its ancestors are assumed
+     *                                     to have their transactions.
      */
     bool LoadBlockIndex(
         const Consensus::Params& consensus_params,
         CBlockTreeDB& blocktree,
-        std::set<CBlockIndex*, CBlockIndexWorkComparator>& block_index_candidates)
+        std::set<CBlockIndex*, CBlockIndexWorkComparator>& block_index_candidates,
+        const uint256& snapshot_blockhash = uint256())
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     /** Clear all data members. */
     void Unload() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /**
+     * Write an image of the block index for the next start to load instead of
+     * the block tree database. Does nothing unless the block index was loaded
+     * completely, so that a failed startup does not leave a partial image.
+     */
+    bool WriteBlockIndexImage(CBlockTreeDB& blocktree) const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     CBlockIndex* AddToBlockIndex(const CBlockHeader& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
     CBlockIndex* InsertBlockIndex(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -620,6 +696,18 @@ public:
      */
     std::set<CBlockIndex*, CBlockIndexWorkComparator> setBlockIndexCandidates;
 
+    /**
+     * The base block of the snapshot this chainstate validates in the
+     * background, or nullptr. Such a chainstate only connects ancestors of the
+     * base block, and leaves the mempool and the validation interface
+     * notifications to the active chainstate.
+     */
+    const CBlockIndex* m_validation_target GUARDED_BY(::cs_main){nullptr};
+
+    //! Add a block whose transactions and those of all its ancestors were
+    //! received to setBlockIndexCandidates, if this chainstate may connect it.
+    void TryAddBlockIndexCandidate(CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
     //! @returns A reference to the in-memory cache of the UTXO set.
     CCoinsViewCache& CoinsTip() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     {
@@ -657,6 +745,16 @@ public:
     /** Import blocks from an external file */
     void LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFilePos* dbp = nullptr);
 
+    /**
+     * Rebuild the block index from the blk*.dat files for -reindex. Each of
+     * the given number of threads scans one file at a time, deserializing and
+     * checking its blocks, while the calling thread accepts them in file order.
+     *
+     * @returns false if a block could not be stored or a shutdown was
+     *          requested before all files were loaded.
+     */
+    bool ReindexBlockFiles(const CChainParams& chainparams, int threads);
+
     /**
      * Update the on-disk chain state.
      * The caches and indexes are flushed depending on the mode we're called with
@@ -778,6 +876,11 @@ private:
 
     bool LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    //! Accept a block read from a block file, followed by any earlier read
+    //! children that were waiting for it. Returns false if loading the file
+    //! should stop.
+    bool AcceptExternalBlock(const CChainParams& chainparams, std::shared_ptr<CBlock> pblock, const uint256& hash, unsigned int size, const FlatFilePos* dbp, int& nLoaded) LOCKS_EXCLUDED(cs_main);
+
     friend ChainstateManager;
 };
 
@@ -866,6 +969,7 @@ private:
         CAutoFile& coins_file,
         const SnapshotMetadata& metadata);
 
+
     // For access to m_active_chainstate.
     friend CChainState& ChainstateActive();
     friend CChain& ChainActive();
@@ -909,6 +1013,10 @@ public:
     //!   faking nTx* block index data along the way.
     //! - Move the new chainstate to `m_snapshot_chainstate` and make it our
     //!   ChainstateActive().
+    //!
+    //! Unless `in_memory`, the base of the snapshot is recorded in the directory
+    //! of its coins database, so that DetectSnapshotChainstate() resumes it
+    //! after a restart.
     [[nodiscard]] bool ActivateSnapshot(
         CAutoFile& coins_file, const SnapshotMetadata& metadata, bool in_memory);
 
@@ -934,6 +1042,48 @@ public:
     //!          snapshot in the background.
     bool IsBackgroundIBD(CChainState* chainstate) const;
 
+    //! Once the background chainstate has connected the base block of the
+    //! snapshot, compare its UTXO set with the assumeutxo chain parameters and
+    //! mark the snapshot validated if they match. Shuts down the node if they
+    //! don't, since the snapshot chainstate then builds on an invalid UTXO set.
+    //!
+    //! @returns false if the snapshot turned out invalid.
+    bool MaybeCompleteSnapshotValidation() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    //! The chainstate validating the snapshot in the background, or nullptr if
+    //! no snapshot is in use or its background validation has completed.
+    CChainState* BackgroundValidationChainstate() const EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    //! Called when a block is found invalid. If it is an ancestor of the base of
+    //! a snapshot that is not validated yet, the snapshot builds on an invalid
+    //! chain: it is dropped at the next start, and the node shuts down.
+    void MaybeInvalidateSnapshot(const CBlockIndex* invalid_block) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    //! Reset the transaction counts faked for the blocks below the snapshot
+    //! base that were not downloaded yet, so that the block index written at
+    //! shutdown does not claim them if the snapshot is dropped. LoadBlockIndex()
+    //! fakes them again when the snapshot chainstate is resumed.
+    void ResetAssumedValidBlockIndex() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    //! Look for the coins database of a snapshot chainstate left by a previous
+    //! run. If its activation completed, initialize a snapshot chainstate that
+    //! resumes it. Directories of activations that did not complete, or of
+    //! snapshots found invalid, are removed. A snapshot chainstate that was
+    //! validated in the background replaces the IBD chainstate on disk.
+    //!
+    //! Must be called after the IBD chainstate is initialized and before the
+    //! block index and the coins databases are loaded.
+    //!
+    //! @param[in] drop  Remove the snapshot chainstate instead of resuming it,
+    //!                  e.g. because the chainstate is reindexed.
+    //! @returns false if the data directory holds more than one snapshot chainstate.
+    [[nodiscard]] bool DetectSnapshotChainstate(CTxMemPool& mempool, bool drop) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    //! Make the IBD chainstate validate the snapshot chainstate in the
+    //! background, which only involves the ancestors of the snapshot base.
+    //! Called once the tips of both chainstates are loaded.
+    void InitBackgroundValidation() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
     //! Return the most-work chainstate that has been fully validated.
     //!
     //! During background validation of a snapshot, this is the IBD chain. After
@@ -621,7 +621,10 @@ public:
     void WriteDescriptor();
 
     const WalletDescriptor GetWalletDescriptor() const EXCLUSIVE_LOCKS_REQUIRED(cs_desc_man);
-    const std::vector<CScript> GetScriptPubKeys() const;
+    /** Get the scripts of the descriptor, from range index minimum_index on. */
+    const std::vector<CScript> GetScriptPubKeys(int32_t minimum_index = 0) const;
+    /** Get the range index after the last one whose scripts are known. */
+    int32_t GetEndRange() const;
 
     bool GetDescriptorString(std::string& out, bool priv) const;
 };
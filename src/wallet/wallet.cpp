@@ -39,6 +39,7 @@
 #include <univalue.h>
 
 #include <algorithm>
+#include <limits>
 #include <assert.h>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -1732,9 +1733,86 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
     return startTime;
 }
 
+namespace {
+/** Number of blocks whose filters a fast rescan matches in one batch. */
+constexpr int FAST_RESCAN_BATCH_SIZE{1000};
+
+/**
+ * Screens the blocks of a rescan against the block filter index with the scripts
+ * of a descriptor wallet, so that only the blocks that may contain wallet
+ * transactions have to be read. The filter of a block covers the scripts of its
+ * outputs and of the outputs its inputs spend, so it matches both payments to and
+ * spends from the wallet.
+ */
+class FastWalletRescanFilter
+{
+public:
+    explicit FastWalletRescanFilter(const CWallet& wallet) : m_wallet(wallet)
+    {
+        // Legacy wallets can have scripts outside of any descriptor range (e.g.
+        // imported watch-only ones), so only descriptor wallets are supported.
+        assert(!m_wallet.IsLegacy());
+        UpdateIfNeeded();
+    }
+
+    /**
+     * Add the scripts of descriptors that were added or whose range grew, e.g.
+     * by topping up after a wallet transaction was found. Blocks that were
+     * screened with the old scripts are screened again.
+     */
+    void UpdateIfNeeded()
+    {
+        for (ScriptPubKeyMan* spk_man : m_wallet.GetAllScriptPubKeyMans()) {
+            const auto desc_spk_man = dynamic_cast<DescriptorScriptPubKeyMan*>(spk_man);
+            assert(desc_spk_man);
+            const int32_t range_end = desc_spk_man->GetEndRange();
+            auto it = m_last_range_ends.find(desc_spk_man->GetID());
+            if (it != m_last_range_ends.end() && it->second >= range_end) continue;
+
+            for (const CScript& script_pub_key : desc_spk_man->GetScriptPubKeys(it != m_last_range_ends.end() ? it->second : 0)) {
+                m_filter_set.emplace(script_pub_key.begin(), script_pub_key.end());
+            }
+            m_last_range_ends[desc_spk_man->GetID()] = range_end;
+            m_blocks.clear();
+        }
+    }
+
+    /**
+     * Return whether the block may contain wallet transactions, or nullopt if
+     * its filter is not available. Blocks are matched a batch at a time, and
+     * must be asked for in chain order for the batches to be reused.
+     */
+    Optional<bool> MatchesBlock(const uint256& block_hash, int block_height, Optional<int> max_height)
+    {
+        if (m_pos >= m_blocks.size() || m_blocks[m_pos].first != block_hash) {
+            m_pos = 0;
+            const int batch_end{std::min(block_height + FAST_RESCAN_BATCH_SIZE - 1, max_height.value_or(std::numeric_limits<int>::max()))};
+            // Fall back to matching the block on its own, in case the filter
+            // index has not caught up with the whole batch.
+            if (!m_wallet.chain().matchBlockFilters(BlockFilterType::BASIC, block_hash, batch_end, m_filter_set, m_blocks) &&
+                !m_wallet.chain().matchBlockFilters(BlockFilterType::BASIC, block_hash, block_height, m_filter_set, m_blocks)) {
+                m_blocks.clear();
+                return nullopt;
+            }
+        }
+        return m_blocks[m_pos++].second;
+    }
+
+private:
+    const CWallet& m_wallet;
+    //! Range end of each descriptor when its scripts were last added to m_filter_set
+    std::map<uint256, int32_t> m_last_range_ends;
+    GCSFilter::ElementSet m_filter_set;
+    //! Hashes of the blocks of the current batch, with whether their filter matched
+    std::vector<std::pair<uint256, bool>> m_blocks;
+    size_t m_pos{0};
+};
+} // namespace
+
 /**
  * Scan the block chain (starting in start_block) for transactions
- * from or to us. If fUpdate is true, found transactions that already
+ * from or to us. With -blockfilterindex, descriptor wallets only read the
+ * blocks whose filter matches one of their scripts. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
  *
  * @param[in] start_block Scan starting block. If block is not on the active
@@ -1763,7 +1841,11 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
     uint256 block_hash = start_block;
     ScanResult result;
 
-    WalletLogPrintf("Rescan started from block %s...\n", start_block.ToString());
+    std::unique_ptr<FastWalletRescanFilter> fast_rescan_filter;
+    if (!IsLegacy() && chain().hasBlockFilterIndex(BlockFilterType::BASIC)) fast_rescan_filter = MakeUnique<FastWalletRescanFilter>(*this);
+
+    WalletLogPrintf("Rescan started from block %s... (%s)\n", start_block.ToString(),
+                    fast_rescan_filter ? "fast variant using block filters" : "slow variant inspecting all blocks");
 
     fAbortRescan = false;
     ShowProgress(strprintf("%s " + _("Rescanning...").translated, GetDisplayName()), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
@@ -1788,9 +1870,14 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", block_height, progress_current);
         }
 
-        // Read block data
+        // Read block data, unless its filter rules out wallet transactions
+        bool fetch_block = true;
+        if (fast_rescan_filter) {
+            fast_rescan_filter->UpdateIfNeeded();
+            fetch_block = fast_rescan_filter->MatchesBlock(block_hash, block_height, max_height).value_or(true);
+        }
         CBlock block;
-        chain().findBlock(block_hash, FoundBlock().data(block));
+        if (fetch_block) chain().findBlock(block_hash, FoundBlock().data(block));
 
         // Find next block separately from reading data above, because reading
         // is slow and there might be a reorg while it is read.
@@ -1799,7 +1886,8 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
         uint256 next_block_hash;
         chain().findBlock(block_hash, FoundBlock().inActiveChain(block_still_active).nextBlock(FoundBlock().inActiveChain(next_block).hash(next_block_hash)));
 
-        if (!block.IsNull()) {
+        // A block that was not fetched has no wallet transactions and counts as scanned.
+        if (!fetch_block || !block.IsNull()) {
             LOCK(cs_wallet);
             if (!block_still_active) {
                 // Abort scan if current block is no longer active, to prevent
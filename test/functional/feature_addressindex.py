@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test addressindex.
+
+Test that getaddressoutputs and the /rest/addressoutputs endpoint list the
+outputs paying to an address and their spends, that the results can be paged,
+and that the index follows reorgs and catches up with an existing chain.
+"""
+from decimal import Decimal
+import http.client
+import json
+import urllib.parse
+
+from test_framework.address import ADDRESS_BCRT1_UNSPENDABLE
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+)
+from test_framework.wallet import MiniWallet
+
+
+class AddressIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [
+            ["-addressindex", "-rest"],
+            [],
+        ]
+
+    def sync_index(self, node):
+        height = node.getblockcount()
+        expected = {'addressindex': {'synced': True, 'best_block_height': height}}
+        self.wait_until(lambda: node.getindexinfo('addressindex') == expected)
+
+    def rest_addressoutputs(self, skip, count, address):
+        url = urllib.parse.urlparse(self.nodes[0].url)
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.request('GET', '/rest/addressoutputs/{}/{}/{}.json'.format(skip, count, address))
+        resp = conn.getresponse()
+        assert_equal(resp.status, 200)
+        return json.loads(resp.read().decode('utf-8'), parse_float=Decimal)
+
+    def run_test(self):
+        node = self.nodes[0]
+        wallet = MiniWallet(node)
+        address = wallet._address
+
+        self.log.info("Mine blocks and spend a few of their outputs")
+        wallet.generate(3)
+        node.generatetoaddress(100, ADDRESS_BCRT1_UNSPENDABLE)
+        spends = [wallet.send_self_transfer(from_node=node) for _ in range(3)]
+        node.generatetoaddress(1, ADDRESS_BCRT1_UNSPENDABLE)
+        self.sync_index(node)
+
+        self.log.info("Test that the index lists all outputs and their spends")
+        res = node.getaddressoutputs(address, True, 0, 1000, False, 0, True)
+        assert_equal(res['height'], 104)
+        assert_equal(res['txouts'], 6)
+        assert_equal(len(res['outputs']), 6)
+        spent = [o for o in res['outputs'] if 'spent' in o]
+        assert_equal(sorted(o['spent']['txid'] for o in spent), sorted(s['txid'] for s in spends))
+        for o in spent:
+            assert_equal(o['spent']['vin'], 0)
+            assert_equal(o['spent']['height'], 104)
+        assert_equal([o['height'] for o in res['outputs']], sorted(o['height'] for o in res['outputs']))
+
+        self.log.info("Test that the balance matches the UTXO set")
+        scan = node.scantxoutset('start', ['addr({})'.format(address)])
+        assert_equal(res['balance'], scan['total_amount'])
+        assert_equal(res['total_received'], sum(o['amount'] for o in res['outputs']))
+
+        self.log.info("Test that descriptors and addresses give the same result")
+        assert_equal(node.getaddressoutputs('addr({})'.format(address), True, 0, 1000, False, 0, True), res)
+
+        self.log.info("Test include_spent and pagination")
+        unspent = node.getaddressoutputs(address, False, 0, 1000, False, 0, True)
+        assert_equal(unspent['txouts'], 3)
+        assert all('spent' not in o for o in unspent['outputs'])
+        page = node.getaddressoutputs(address, True, 1, 2)
+        assert 'txouts' not in page
+        assert_equal(page['outputs'], res['outputs'][1:3])
+        assert_equal(node.getaddressoutputs(address, True, 1, 2, False, 0, True)['txouts'], 6)
+        assert_equal(node.getaddressoutputs(address, True, 10, 5)['outputs'], [])
+
+        self.log.info("Test paging from a height")
+        last = page['outputs'][-1]
+        at_height = sum(1 for o in page['outputs'] if o['height'] == last['height'])
+        next_page = node.getaddressoutputs(address, True, at_height, 1000, False, last['height'])
+        assert_equal(next_page['outputs'], res['outputs'][3:])
+        from_height = node.getaddressoutputs(address, True, 0, 1000, False, 104, True)
+        assert_equal(from_height['outputs'], [o for o in res['outputs'] if o['height'] >= 104])
+        assert_equal(from_height['txouts'], len(from_height['outputs']))
+
+        self.log.info("Test verbose")
+        verbose = node.getaddressoutputs(address, True, 0, 1, True)
+        decoded = node.decoderawtransaction(verbose['outputs'][0]['hex'])
+        assert_equal(decoded['txid'], res['outputs'][0]['txid'])
+
+        self.log.info("Test the REST endpoint")
+        assert_equal(self.rest_addressoutputs(1, 2, address), page)
+
+        self.log.info("Test that invalid arguments are rejected")
+        assert_raises_rpc_error(-5, "", node.getaddressoutputs, "invalid")
+        assert_raises_rpc_error(-8, "skip, count and start_height must not be negative", node.getaddressoutputs, address, True, -1)
+        assert_raises_rpc_error(-8, "skip, count and start_height must not be negative", node.getaddressoutputs, address, True, 0, 1, False, -1)
+        assert_raises_rpc_error(-1, "Address index not enabled", self.nodes[1].getaddressoutputs, address)
+
+        self.log.info("Test that the index follows a reorg")
+        tip = node.getbestblockhash()
+        node.invalidateblock(tip)
+        # Leave the spends, which went back to the mempool, out of the new blocks
+        node.generateblock(ADDRESS_BCRT1_UNSPENDABLE, [])
+        node.generateblock(ADDRESS_BCRT1_UNSPENDABLE, [])
+        self.sync_index(node)
+        res_reorg = node.getaddressoutputs(address, True, 0, 1000, False, 0, True)
+        assert_equal(res_reorg['txouts'], 3)
+        assert all('spent' not in o for o in res_reorg['outputs'])
+        assert_equal(res_reorg['balance'], res_reorg['total_received'])
+
+        self.log.info("Test that the index catches up with an existing chain")
+        node.generatetoaddress(1, ADDRESS_BCRT1_UNSPENDABLE)
+        self.sync_index(node)
+        expected = node.getaddressoutputs(address)
+        self.sync_blocks()
+        self.restart_node(1, extra_args=["-addressindex", "-indexsyncthreads=2"])
+        self.sync_index(self.nodes[1])
+        assert_equal(self.nodes[1].getaddressoutputs(address), expected)
+
+
+if __name__ == '__main__':
+    AddressIndexTest().main()
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test loadtxoutset.
+
+Test that a node loading a UTXO snapshot serves the chain from the snapshot
+base right away, while the blocks leading up to it are downloaded and
+validated in the background, and that the snapshot chainstate is resumed at a
+restart and replaces the validated chainstate once its validation completed.
+
+The chain up to the snapshot height matches the regtest assumeutxo parameters.
+"""
+import os
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+)
+from test_framework.wallet import MiniWallet
+
+# Fixed block times make the chain, and so the UTXO set hash, which commits
+# to the best block, match the assumeutxo parameters.
+MOCKTIME = 1600000000
+SNAPSHOT_BASE_HEIGHT = 299
+FINAL_HEIGHT = 310
+VALIDATED = "[snapshot] snapshot beginning at {} has been fully validated"
+
+
+class AssumeutxoTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-mocktime={}".format(MOCKTIME)]] * 2
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def submit_headers(self, start, end):
+        for height in range(start, end + 1):
+            header = self.nodes[0].getblockheader(self.nodes[0].getblockhash(height), False)
+            self.nodes[1].submitheader(header)
+
+    def write_snapshot(self, name, contents):
+        with open(os.path.join(self.nodes[1].datadir, self.chain, name), 'wb') as f:
+            f.write(contents)
+
+    def run_test(self):
+        n0, n1 = self.nodes
+        wallet = MiniWallet(n0)
+
+        self.log.info("Mine the chain leading up to the snapshot, with a few spends")
+        wallet.generate(199)
+        for utxo in [wallet.get_utxo(txid=wallet._utxos[0]['txid']) for _ in range(3)]:
+            wallet.send_self_transfer(from_node=n0, utxo_to_spend=utxo)
+        wallet.generate(SNAPSHOT_BASE_HEIGHT - 199)
+        assert_equal(n0.getblockcount(), SNAPSHOT_BASE_HEIGHT)
+        base_hash = n0.getbestblockhash()
+        utxo_info = n0.gettxoutsetinfo()
+        dump = n0.dumptxoutset('utxos.dat')
+        assert_equal(dump['base_height'], SNAPSHOT_BASE_HEIGHT)
+        assert_equal(dump['txoutset_hash'], utxo_info['hash_serialized_2'])
+
+        wallet.generate(FINAL_HEIGHT - SNAPSHOT_BASE_HEIGHT)
+        bad_dump = n0.dumptxoutset('utxos_bad_height.dat')
+        assert_equal(bad_dump['base_height'], FINAL_HEIGHT)
+
+        self.log.info("Test that invalid snapshots are rejected")
+        assert_raises_rpc_error(-8, "Couldn't open file", n1.loadtxoutset, 'missing.dat')
+        with open(dump['path'], 'rb') as f:
+            snapshot = f.read()
+        self.write_snapshot('bad_magic.dat', b'\x00' + snapshot[1:])
+        assert_raises_rpc_error(-22, "Invalid UTXO snapshot magic bytes", n1.loadtxoutset, 'bad_magic.dat')
+        self.write_snapshot('bad_version.dat', snapshot[:5] + b'\x01\x00' + snapshot[7:])
+        assert_raises_rpc_error(-22, "Unsupported UTXO snapshot version 1", n1.loadtxoutset, 'bad_version.dat')
+        assert_raises_rpc_error(-5, "is not known", n1.loadtxoutset, bad_dump['path'])
+        self.submit_headers(1, FINAL_HEIGHT)
+        assert_raises_rpc_error(-32603, "Unable to load UTXO snapshot", n1.loadtxoutset, bad_dump['path'])
+        assert_equal(n1.getblockcount(), 0)
+        assert not os.path.exists(os.path.join(n1.datadir, self.chain, 'chainstate_' + n0.getbestblockhash()))
+
+        self.log.info("Test that the snapshot chainstate serves the tip right away")
+        res = n1.loadtxoutset(dump['path'])
+        assert_equal(res['coins_loaded'], dump['coins_written'])
+        assert_equal(res['tip_hash'], base_hash)
+        assert_equal(res['base_height'], SNAPSHOT_BASE_HEIGHT)
+        assert_equal(n1.getbestblockhash(), base_hash)
+        assert_equal(n1.gettxoutsetinfo()['hash_serialized_2'], utxo_info['hash_serialized_2'])
+        assert_raises_rpc_error(-1, "not behind the base block", n1.loadtxoutset, dump['path'])
+
+        self.log.info("Test that the snapshot chainstate is resumed after a restart")
+        snapshot_dir = os.path.join(n1.datadir, self.chain, 'chainstate_' + base_hash)
+        leftover_dir = os.path.join(n1.datadir, self.chain, 'chainstate_' + '00' * 32)
+        backup_dir = os.path.join(n1.datadir, self.chain, 'chainstate_backup')
+        assert os.path.exists(snapshot_dir)
+        os.mkdir(leftover_dir)
+        os.mkdir(backup_dir)
+        with n1.assert_debug_log([
+            "resuming the snapshot chainstate based on block {}".format(base_hash),
+            "removing {}, which holds no activated snapshot".format(os.path.basename(leftover_dir)),
+        ]):
+            self.restart_node(1)
+        assert_equal(n1.getbestblockhash(), base_hash)
+        assert_equal(n1.gettxoutsetinfo()['hash_serialized_2'], utxo_info['hash_serialized_2'])
+        assert os.path.exists(snapshot_dir)
+        assert os.path.exists(backup_dir)
+        assert not os.path.exists(leftover_dir)
+
+        self.log.info("Test that the snapshot is validated in the background while syncing the tip")
+        with n1.assert_debug_log([VALIDATED.format(base_hash)], timeout=60):
+            self.connect_nodes(0, 1)
+            self.sync_blocks()
+        assert_equal(n1.getbestblockhash(), n0.getbestblockhash())
+        assert_equal(n1.getblock(n1.getblockhash(1))['confirmations'], FINAL_HEIGHT)
+
+        self.log.info("Test that the validated snapshot chainstate replaces the IBD chainstate after a restart")
+        with n1.assert_debug_log(["replacing the IBD chainstate with the validated snapshot chainstate {}".format(base_hash)]):
+            self.restart_node(1)
+        assert not os.path.exists(snapshot_dir)
+        assert_equal(n1.getbestblockhash(), n0.getbestblockhash())
+        assert_equal(n1.gettxoutsetinfo()['hash_serialized_2'], n0.gettxoutsetinfo()['hash_serialized_2'])
+
+
+if __name__ == '__main__':
+    AssumeutxoTest().main()
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test -blockindeximage.
+
+Test that the block index image written at shutdown is loaded at the next
+start, and that the block index database is loaded instead when the image is
+stale, corrupt or not enabled.
+"""
+import os
+import shutil
+
+from test_framework.address import (
+    ADDRESS_BCRT1_P2WSH_OP_TRUE,
+    ADDRESS_BCRT1_UNSPENDABLE,
+)
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+LOADED_IMAGE = "Loaded the block index from its image"
+FALLBACK = "Loading the block index from the database instead of its image"
+
+
+class BlockIndexImageTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [["-blockindeximage"]]
+
+    def image_path(self):
+        return os.path.join(self.nodes[0].datadir, self.chain, 'blocks', 'blockindex.dat')
+
+    def block_index_state(self):
+        node = self.nodes[0]
+        tips = node.getchaintips()
+        headers = [node.getblockheader(tip['hash']) for tip in tips]
+        info = node.getblockchaininfo()
+        # The best header is recomputed at startup, also from the database.
+        del info['headers']
+        return tips, headers, info
+
+    def run_test(self):
+        node = self.nodes[0]
+
+        self.log.info("Mine a chain with an invalid branch")
+        node.generatetoaddress(150, ADDRESS_BCRT1_UNSPENDABLE)
+        fork_hash = node.getblockhash(140)
+        node.invalidateblock(fork_hash)
+        node.generatetoaddress(15, ADDRESS_BCRT1_P2WSH_OP_TRUE)
+        node.reconsiderblock(fork_hash)
+        invalid_hash = node.getblockhash(145)
+        node.invalidateblock(invalid_hash)
+        state = self.block_index_state()
+        assert_equal(sorted(tip['status'] for tip in state[0]), ['active', 'invalid'])
+
+        self.log.info("Test that the image is written at shutdown and loaded at startup")
+        self.stop_node(0)
+        assert os.path.exists(self.image_path())
+        with node.assert_debug_log(expected_msgs=[LOADED_IMAGE]):
+            self.start_node(0)
+        assert_equal(self.block_index_state(), state)
+        # The image is only used once.
+        assert not os.path.exists(self.image_path())
+
+        self.log.info("Test that the node keeps working after loading the image")
+        node.reconsiderblock(invalid_hash)
+        node.generatetoaddress(5, ADDRESS_BCRT1_UNSPENDABLE)
+        state = self.block_index_state()
+        self.restart_node(0)
+        assert_equal(self.block_index_state(), state)
+
+        self.log.info("Test that a stale image is not loaded")
+        self.stop_node(0)
+        stale_path = self.image_path() + '.stale'
+        shutil.copyfile(self.image_path(), stale_path)
+        self.start_node(0)
+        node.generatetoaddress(5, ADDRESS_BCRT1_UNSPENDABLE)
+        state = self.block_index_state()
+        self.stop_node(0)
+        os.replace(stale_path, self.image_path())
+        with node.assert_debug_log(expected_msgs=[FALLBACK], unexpected_msgs=[LOADED_IMAGE]):
+            self.start_node(0)
+        assert_equal(self.block_index_state(), state)
+
+        self.log.info("Test that a corrupt image is not loaded")
+        self.stop_node(0)
+        with open(self.image_path(), 'r+b') as f:
+            f.seek(200)
+            byte = f.read(1)
+            f.seek(200)
+            f.write(bytes([byte[0] ^ 0xff]))
+        with node.assert_debug_log(expected_msgs=[FALLBACK], unexpected_msgs=[LOADED_IMAGE]):
+            self.start_node(0)
+        assert_equal(self.block_index_state(), state)
+
+        self.log.info("Test that the image is neither loaded nor written without -blockindeximage")
+        self.stop_node(0)
+        with node.assert_debug_log(expected_msgs=[], unexpected_msgs=[LOADED_IMAGE, FALLBACK]):
+            self.start_node(0, extra_args=[])
+        assert not os.path.exists(self.image_path())
+        self.stop_node(0)
+        assert not os.path.exists(self.image_path())
+        self.start_node(0)
+        assert_equal(self.block_index_state(), state)
+
+
+if __name__ == '__main__':
+    BlockIndexImageTest().main()
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020-2021 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test coinstatsindex across nodes.
+
+Test that the values returned by gettxoutsetinfo are consistent
+between a node running the coinstatsindex and a node without
+the index.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+)
+
+
+class CoinStatsIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.supports_cli = False
+        self.extra_args = [
+            [],
+            ["-coinstatsindex"],
+        ]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def sync_index(self, node):
+        height = node.getblockcount()
+        expected = {'coinstatsindex': {'synced': True, 'best_block_height': height}}
+        self.wait_until(lambda: node.getindexinfo('coinstatsindex') == expected)
+
+    def run_test(self):
+        self._test_coin_stats_index()
+        self._test_reorg_index()
+        self._test_index_rejects_hash_serialized()
+        self._test_restart()
+
+    def _test_coin_stats_index(self):
+        node = self.nodes[0]
+        index_node = self.nodes[1]
+
+        self.log.info("Mine blocks, with a few spends, and wait for the index to catch up")
+        node.generate(101)
+        node.sendtoaddress(node.getnewaddress(), 21)
+        node.sendtoaddress(node.getnewaddress(), 7)
+        node.generate(1)
+        self.sync_blocks()
+        self.sync_index(index_node)
+
+        self.log.info("Test that gettxoutsetinfo() output is consistent with or without coinstatsindex option")
+        res0 = node.gettxoutsetinfo('muhash')
+        res1 = index_node.gettxoutsetinfo('muhash')
+        # The index doesn't track the number of transactions nor the disk size
+        del res0['transactions'], res0['disk_size']
+        assert_equal(res0, res1)
+        # Without use_index the index node scans its UTXO set as well
+        res2 = index_node.gettxoutsetinfo(hash_type='muhash', use_index=False)
+        del res2['transactions'], res2['disk_size']
+        assert_equal(res0, res2)
+
+        self.log.info("Test that gettxoutsetinfo() can get the statistics at earlier heights")
+        for height in [0, 50, 101]:
+            res3 = index_node.gettxoutsetinfo('muhash', height)
+            assert_equal(res3['height'], height)
+            assert_equal(res3['bestblock'], index_node.getblockhash(height))
+        assert_equal(index_node.gettxoutsetinfo('muhash', 0)['txouts'], 0)
+
+        self.log.info("Test that the block hash can be used instead of the height")
+        res4 = index_node.gettxoutsetinfo('muhash', index_node.getblockhash(50))
+        assert_equal(res4, index_node.gettxoutsetinfo('muhash', 50))
+
+        self.log.info("Test that a height above the tip is rejected")
+        assert_raises_rpc_error(-8, "Target block height 103 after current tip 102", index_node.gettxoutsetinfo, 'muhash', 103)
+
+        self.log.info("Test that querying a height requires coinstatsindex")
+        assert_raises_rpc_error(-8, "Querying specific block heights requires coinstatsindex", node.gettxoutsetinfo, 'muhash', 50)
+
+    def _test_reorg_index(self):
+        node = self.nodes[0]
+        index_node = self.nodes[1]
+
+        self.log.info("Test that the index follows a reorg")
+        tip_hash = index_node.getbestblockhash()
+        tip_height = index_node.getblockcount()
+        res_before = index_node.gettxoutsetinfo('muhash')
+
+        # Keep the competing chain local to the index node
+        self.disconnect_nodes(0, 1)
+        index_node.invalidateblock(tip_hash)
+        index_node.generate(2)
+        self.sync_index(index_node)
+        res_index = index_node.gettxoutsetinfo('muhash')
+        res_scan = index_node.gettxoutsetinfo(hash_type='muhash', use_index=False)
+        del res_scan['transactions'], res_scan['disk_size']
+        assert_equal(res_index, res_scan)
+
+        self.log.info("Test that a stale block can not be queried")
+        assert_raises_rpc_error(-8, "Block is not in chain regtest", index_node.gettxoutsetinfo, 'muhash', tip_hash)
+
+        self.log.info("Test that the index goes back to the original chain")
+        index_node.reconsiderblock(tip_hash)
+        assert_equal(node.gettxoutsetinfo('muhash')['muhash'], res_before['muhash'])
+        node.generate(3)
+        self.connect_nodes(0, 1)
+        self.sync_blocks()
+        self.sync_index(index_node)
+        assert_equal(index_node.getblockcount(), tip_height + 3)
+        res_node = node.gettxoutsetinfo('muhash')
+        del res_node['transactions'], res_node['disk_size']
+        assert_equal(index_node.gettxoutsetinfo('muhash'), res_node)
+
+    def _test_index_rejects_hash_serialized(self):
+        self.log.info("Test that the rpc raises if the legacy hash is passed with the index")
+        index_node = self.nodes[1]
+        assert_raises_rpc_error(-8, "hash_serialized_2 hash type cannot be queried for a specific block", index_node.gettxoutsetinfo, 'hash_serialized_2', 10)
+        # Without a height the legacy hash is still computed from the UTXO set
+        assert 'hash_serialized_2' in index_node.gettxoutsetinfo('hash_serialized_2')
+
+    def _test_restart(self):
+        self.log.info("Test that the index continues from its saved state after a restart")
+        node = self.nodes[0]
+        index_node = self.nodes[1]
+        self.restart_node(1, extra_args=["-coinstatsindex"])
+        self.connect_nodes(0, 1)
+        node.generate(2)
+        self.sync_blocks()
+        self.sync_index(index_node)
+        res_node = node.gettxoutsetinfo('muhash')
+        del res_node['transactions'], res_node['disk_size']
+        assert_equal(index_node.gettxoutsetinfo('muhash'), res_node)
+
+
+if __name__ == '__main__':
+    CoinStatsIndexTest().main()
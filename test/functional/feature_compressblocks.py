@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test -compressblocks.
+
+Test that block files are compressed in the background once no more blocks
+are written to them, and that the blocks and transactions in them can still
+be read, reindexed and pruned.
+"""
+import os
+
+from test_framework.address import ADDRESS_BCRT1_UNSPENDABLE
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+
+class CompressBlocksTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        # Small block files, so that a few hundred blocks fill several of them.
+        self.extra_args = [["-fastprune", "-txindex"]]
+
+    def block_file(self, n, compressed=False):
+        name = 'blk{:05d}.dat'.format(n) + ('.cmp' if compressed else '')
+        return os.path.join(self.nodes[0].datadir, self.chain, 'blocks', name)
+
+    def check_blocks(self, blocks, check_txs=True):
+        node = self.nodes[0]
+        for block_hash, raw_block, coinbase_txid in blocks:
+            assert_equal(node.getblock(block_hash, 0), raw_block)
+            assert_equal(node.getblock(block_hash, 1)['tx'], [coinbase_txid])
+            if check_txs:
+                assert_equal(node.getrawtransaction(coinbase_txid, True)['blockhash'], block_hash)
+
+    def run_test(self):
+        node = self.nodes[0]
+
+        self.log.info("Fill a few block files")
+        node.generatetoaddress(700, ADDRESS_BCRT1_UNSPENDABLE)
+        num_files = len([f for f in os.listdir(os.path.dirname(self.block_file(0))) if f.startswith('blk')])
+        assert num_files >= 3
+        blocks = []
+        for height in range(1, 701, 20):
+            block_hash = node.getblockhash(height)
+            block = node.getblock(block_hash)
+            blocks.append((block_hash, node.getblock(block_hash, 0), block['tx'][0]))
+        sizes = [os.path.getsize(self.block_file(n)) for n in range(num_files)]
+
+        self.log.info("Test that the finalized block files are compressed")
+        expected_msgs = ["Compressed block file {:05d}".format(n) for n in range(num_files - 1)]
+        with node.assert_debug_log(expected_msgs, timeout=60):
+            self.restart_node(0, extra_args=self.extra_args[0] + ["-compressblocks"])
+        for n in range(num_files - 1):
+            assert not os.path.exists(self.block_file(n))
+            assert os.path.getsize(self.block_file(n, compressed=True)) < sizes[n]
+        assert os.path.exists(self.block_file(num_files - 1))
+        assert not os.path.exists(self.block_file(num_files - 1, compressed=True))
+
+        self.log.info("Test that blocks and transactions are read from the compressed files")
+        self.check_blocks(blocks)
+        node.generatetoaddress(10, ADDRESS_BCRT1_UNSPENDABLE)
+        self.restart_node(0)
+        self.check_blocks(blocks)
+
+        self.log.info("Test reindexing from the compressed files")
+        tip = node.getbestblockhash()
+        self.restart_node(0, extra_args=self.extra_args[0] + ["-reindex"])
+        self.wait_until(lambda: node.getbestblockhash() == tip)
+        self.check_blocks(blocks)
+
+        self.log.info("Test that compressed files are pruned")
+        self.restart_node(0, extra_args=["-fastprune", "-prune=1"])
+        node.pruneblockchain(400)
+        assert not os.path.exists(self.block_file(0, compressed=True))
+        self.check_blocks(blocks[-5:], check_txs=False)
+
+
+if __name__ == '__main__':
+    CompressBlocksTest().main()
@@ -77,9 +77,14 @@ class ChainstateWriteCrashTest(BitcoinTestFramework):
         self.import_deterministic_coinbase_privkeys()
         # Leave them unconnected, we'll use submitblock directly in this test
 
-    def restart_node(self, node_index, expected_tip):
+    def restart_node(self, node_index, expected_tip, blocks=()):
         """Start up a given node id, wait for the tip to reach the given block hash, and calculate the utxo hash.
 
+        The coins database is written in the background, so the node may have
+        crashed after earlier submitblock calls returned, before their blocks
+        were recorded in the block index. The given blocks are therefore
+        submitted again after the restart.
+
         Exceptions on startup should indicate node crash (due to -dbcrashratio), in which case we try again. Give up
         after 60 seconds. Returns the utxo hash of the given node."""
 
@@ -88,6 +93,8 @@ class ChainstateWriteCrashTest(BitcoinTestFramework):
             try:
                 # Any of these RPC calls could throw due to node crash
                 self.start_node(node_index)
+                for (_, block) in blocks:
+                    self.nodes[node_index].submitblock(block)
                 self.nodes[node_index].waitforblock(expected_tip)
                 utxo_hash = self.nodes[node_index].gettxoutsetinfo()['hash_serialized_2']
                 return utxo_hash
@@ -145,7 +152,7 @@ class ChainstateWriteCrashTest(BitcoinTestFramework):
         for i in range(3):
             nodei_utxo_hash = None
             self.log.debug("Syncing blocks to node %d", i)
-            for (block_hash, block) in blocks:
+            for (n, (block_hash, block)) in enumerate(blocks):
                 # Get the block from node3, and submit to node_i
                 self.log.debug("submitting block %s", block_hash)
                 if not self.submit_block_catch_error(i, block):
@@ -153,7 +160,7 @@ class ChainstateWriteCrashTest(BitcoinTestFramework):
                     # (change the exit code perhaps, and check that here?)
                     self.wait_for_node_exit(i, timeout=30)
                     self.log.debug("Restarting node %d after block hash %s", i, block_hash)
-                    nodei_utxo_hash = self.restart_node(i, block_hash)
+                    nodei_utxo_hash = self.restart_node(i, block_hash, blocks[:n + 1])
                     assert nodei_utxo_hash is not None
                     self.restart_counts[i] += 1
                 else:
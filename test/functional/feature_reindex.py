@@ -7,8 +7,11 @@
 - Start a single node and generate 3 blocks.
 - Stop the node and restart it with -reindex. Verify that the node has reindexed up to block 3.
 - Stop the node and restart it with -reindex-chainstate. Verify that the node has reindexed up to block 3.
+- Spread the chain over several block files, store blocks on disk before their parents, and verify
+  that -reindex with several scan threads restores the same tip.
 """
 
+from test_framework.blocktools import create_block, create_coinbase
 from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import assert_equal
 
@@ -27,11 +30,42 @@ class ReindexTest(BitcoinTestFramework):
         assert_equal(self.nodes[0].getblockcount(), blockcount)  # start_node is blocking on reindex
         self.log.info("Success")
 
+    def reindex_out_of_order(self):
+        node = self.nodes[0]
+        # Small block files, so the chain spans several of them
+        self.restart_node(0, extra_args=["-fastprune"])
+        node.generatetoaddress(500, node.get_deterministic_priv_key().address)
+
+        # Store the last blocks on disk in reverse order: headers first, then
+        # each block before its parent.
+        tip = int(node.getbestblockhash(), 16)
+        height = node.getblockcount()
+        block_time = node.getblock(node.getbestblockhash())['time'] + 1
+        blocks = []
+        for _ in range(3):
+            height += 1
+            block = create_block(tip, create_coinbase(height), block_time, version=4)
+            block.solve()
+            blocks.append(block)
+            tip = block.sha256
+            block_time += 1
+        for block in blocks:
+            node.submitheader(block.serialize().hex())
+        for block in reversed(blocks):
+            node.submitblock(block.serialize().hex())
+        assert_equal(node.getbestblockhash(), blocks[-1].hash)
+
+        self.restart_node(0, extra_args=["-fastprune", "-reindex", "-reindexthreads=2"])
+        self.wait_until(lambda: node.getbestblockhash() == blocks[-1].hash)
+        assert_equal(node.getblockcount(), height)
+        self.log.info("Success")
+
     def run_test(self):
         self.reindex(False)
         self.reindex(True)
         self.reindex(False)
         self.reindex(True)
+        self.reindex_out_of_order()
 
 if __name__ == '__main__':
     ReindexTest().main()
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test txospenderindex.
+
+Test that gettxspendingprevout finds the transactions spending outputs in the
+mempool and, with -txospenderindex, in the active chain, and that the index
+follows reorgs and catches up with an existing chain.
+"""
+from test_framework.address import ADDRESS_BCRT1_UNSPENDABLE
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+)
+from test_framework.wallet import MiniWallet
+
+
+class TxoSpenderIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [
+            ["-txospenderindex"],
+            [],
+        ]
+
+    def sync_index(self, node):
+        height = node.getblockcount()
+        expected = {'txospenderindex': {'synced': True, 'best_block_height': height}}
+        self.wait_until(lambda: node.getindexinfo('txospenderindex') == expected)
+
+    def run_test(self):
+        node = self.nodes[0]
+        wallet = MiniWallet(node)
+
+        self.log.info("Mine blocks and spend a few of their outputs")
+        wallet.generate(3)
+        node.generatetoaddress(100, ADDRESS_BCRT1_UNSPENDABLE)
+        spends = [wallet.send_self_transfer(from_node=node) for _ in range(3)]
+        prevouts = [{'txid': node.decoderawtransaction(s['hex'])['vin'][0]['txid'], 'vout': 0} for s in spends]
+        self.sync_mempools()
+
+        self.log.info("Test that mempool spends are found without the index")
+        for n in self.nodes:
+            res = n.gettxspendingprevout(prevouts)
+            assert_equal([r['spendingtxid'] for r in res], [s['txid'] for s in spends])
+            assert all('blockhash' not in r for r in res)
+
+        self.log.info("Test that confirmed spends are found in the index")
+        blockhash = node.generatetoaddress(1, ADDRESS_BCRT1_UNSPENDABLE)[0]
+        self.sync_index(node)
+        res = node.gettxspendingprevout(prevouts)
+        for r, prevout, s in zip(res, prevouts, spends):
+            assert_equal(r['txid'], prevout['txid'])
+            assert_equal(r['vout'], prevout['vout'])
+            assert_equal(r['spendingtxid'], s['txid'])
+            assert_equal(r['vin'], 0)
+            assert_equal(r['height'], 104)
+            assert_equal(r['blockhash'], blockhash)
+
+        self.log.info("Test that unspent outputs and nodes without the index return no spender")
+        unspent = {'txid': spends[0]['txid'], 'vout': 0}
+        assert_equal(node.gettxspendingprevout([unspent]), [unspent])
+        self.sync_blocks()
+        assert_equal(self.nodes[1].gettxspendingprevout(prevouts[:1]), prevouts[:1])
+
+        self.log.info("Test that invalid arguments are rejected")
+        assert_raises_rpc_error(-8, "outputs are missing", node.gettxspendingprevout, [])
+        assert_raises_rpc_error(-8, "vout cannot be negative", node.gettxspendingprevout, [{'txid': prevouts[0]['txid'], 'vout': -1}])
+        assert_raises_rpc_error(-3, "Expected type string for txid", node.gettxspendingprevout, [{'txid': 1, 'vout': 0}])
+
+        self.log.info("Test that the index follows a reorg")
+        node.invalidateblock(blockhash)
+        # Leave the spends, which went back to the mempool, out of the new blocks
+        node.generateblock(ADDRESS_BCRT1_UNSPENDABLE, [])
+        node.generateblock(ADDRESS_BCRT1_UNSPENDABLE, [])
+        self.sync_index(node)
+        res = node.gettxspendingprevout(prevouts)
+        assert_equal([r['spendingtxid'] for r in res], [s['txid'] for s in spends])
+        assert all('blockhash' not in r for r in res)
+
+        self.log.info("Test that the index catches up with an existing chain")
+        node.generatetoaddress(1, ADDRESS_BCRT1_UNSPENDABLE)
+        self.sync_index(node)
+        expected = node.gettxspendingprevout(prevouts)
+        assert_equal(expected[0]['height'], 106)
+        self.sync_blocks()
+        self.restart_node(1, extra_args=["-txospenderindex", "-indexsyncthreads=2"])
+        self.sync_index(self.nodes[1])
+        assert_equal(self.nodes[1].gettxspendingprevout(prevouts), expected)
+
+
+if __name__ == '__main__':
+    TxoSpenderIndexTest().main()
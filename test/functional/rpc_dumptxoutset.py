@@ -32,6 +32,7 @@ class DumptxoutsetTest(BitcoinTestFramework):
         assert_equal(out['coins_written'], 100)
         assert_equal(out['base_height'], 100)
         assert_equal(out['path'], str(expected_path))
+        assert_equal(out['txoutset_hash'], node.gettxoutsetinfo()['hash_serialized_2'])
         # Blockhash should be deterministic based on mocked time.
         assert_equal(
             out['base_hash'],
@@ -41,7 +42,7 @@ class DumptxoutsetTest(BitcoinTestFramework):
             digest = hashlib.sha256(f.read()).hexdigest()
             # UTXO snapshot hash should be deterministic based on mocked time.
             assert_equal(
-                digest, 'be032e5f248264ba08e11099ac09dbd001f6f87ffc68bf0f87043d8146d50664')
+                digest, 'c5a72fc91f9dc6b2762bf5a8f8687683afb030b0b584cc7eb86427ff231b7782')
 
         # Specifying a path to an existing file will fail.
         assert_raises_rpc_error(
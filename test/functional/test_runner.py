@@ -129,6 +129,9 @@ BASE_SCRIPTS = [
     'feature_bip68_sequence.py',
     'p2p_feefilter.py',
     'feature_reindex.py',
+    'feature_blockindeximage.py',
+    'feature_assumeutxo.py',
+    'feature_compressblocks.py',
     'feature_abortnode.py',
     # vv Tests less than 30s vv
     'wallet_keypool_topup.py --legacy-wallet',
@@ -175,6 +178,9 @@ BASE_SCRIPTS = [
     'p2p_disconnect_ban.py',
     'rpc_decodescript.py',
     'rpc_blockchain.py',
+    'feature_coinstatsindex.py',
+    'feature_addressindex.py',
+    'feature_txospenderindex.py',
     'rpc_deprecated.py',
     'wallet_disable.py --legacy-wallet',
     'wallet_disable.py --descriptors',
@@ -241,6 +247,7 @@ BASE_SCRIPTS = [
     'wallet_listsinceblock.py --legacy-wallet',
     'wallet_listsinceblock.py --descriptors',
     'wallet_listdescriptors.py --descriptors',
+    'wallet_fast_rescan.py --descriptors',
     'p2p_leak.py',
     'wallet_encryption.py --legacy-wallet',
     'wallet_encryption.py --descriptors',
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+# Copyright (c) 2021 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that fast rescans using block filters for descriptor wallets detect
+   top-ups correctly and find the same transactions as the slow variant."""
+from test_framework.address import ADDRESS_BCRT1_UNSPENDABLE
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+
+KEYPOOL_SIZE = 10   # smaller than default size to speed-up test
+NUM_DESCRIPTORS = 6 # number of descriptors (3 output types * internal/external)
+NUM_BLOCKS = 6      # number of blocks to mine
+
+
+class WalletFastRescanTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.extra_args = [[f'-keypool={KEYPOOL_SIZE}', '-blockfilterindex=1'],
+                           [f'-keypool={KEYPOOL_SIZE}']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+        self.skip_if_no_sqlite()
+
+    def get_wallet_txids(self, node, wallet_name):
+        w = node.get_wallet_rpc(wallet_name)
+        txs = w.listtransactions('*', 1000000)
+        return [tx['txid'] for tx in txs]
+
+    def run_test(self):
+        node = self.nodes[0]
+        funder = node.get_wallet_rpc(self.default_wallet_name)
+
+        self.log.info("Create descriptor wallet with backup")
+        node.createwallet(wallet_name='topup_test', descriptors=True)
+        w = node.get_wallet_rpc('topup_test')
+        descriptors = w.listdescriptors()
+        assert_equal(len(descriptors), NUM_DESCRIPTORS)
+        for desc in descriptors:
+            assert_equal(desc['range'], [0, KEYPOOL_SIZE - 1])
+
+        self.log.info(f"Create txs sending to end range address of each descriptor, triggering top-ups")
+        for i in range(NUM_BLOCKS):
+            self.log.info(f"Block {i+1}/{NUM_BLOCKS}")
+            for desc in w.listdescriptors():
+                self.log.info(f"-> range [{desc['range'][0]},{desc['range'][1]}], last address {desc['desc'][:20]}...")
+                addr = node.deriveaddresses(desc['desc'], desc['range'])[-1]
+                funder.sendtoaddress(addr, 0.1)
+            node.generatetoaddress(1, ADDRESS_BCRT1_UNSPENDABLE)
+            # Blocks without wallet transactions, which a fast rescan skips
+            node.generatetoaddress(5, ADDRESS_BCRT1_UNSPENDABLE)
+        self.sync_blocks()
+
+        self.log.info("Import wallet backup with block filter index")
+        with node.assert_debug_log(['fast variant using block filters']):
+            node.createwallet(wallet_name='rescan_fast', disable_private_keys=True, blank=True, descriptors=True)
+            w_fast = node.get_wallet_rpc('rescan_fast')
+            w_fast.importdescriptors([{'desc': d['desc'], 'timestamp': 0, 'range': [0, KEYPOOL_SIZE - 1]} for d in descriptors])
+        txids_fast = self.get_wallet_txids(node, 'rescan_fast')
+
+        self.log.info("Import wallet backup without block filter index")
+        with self.nodes[1].assert_debug_log(['slow variant inspecting all blocks']):
+            self.nodes[1].createwallet(wallet_name='rescan_slow', disable_private_keys=True, blank=True, descriptors=True)
+            w_slow = self.nodes[1].get_wallet_rpc('rescan_slow')
+            w_slow.importdescriptors([{'desc': d['desc'], 'timestamp': 0, 'range': [0, KEYPOOL_SIZE - 1]} for d in descriptors])
+        txids_slow = self.get_wallet_txids(self.nodes[1], 'rescan_slow')
+
+        assert_equal(len(txids_slow), NUM_DESCRIPTORS * NUM_BLOCKS)
+        assert_equal(sorted(txids_fast), sorted(txids_slow))
+
+        self.log.info("Test that rescanblockchain with a block filter index finds the same transactions")
+        with node.assert_debug_log(['fast variant using block filters']):
+            w_fast.rescanblockchain()
+        assert_equal(sorted(self.get_wallet_txids(node, 'rescan_fast')), sorted(txids_slow))
+
+
+if __name__ == '__main__':
+    WalletFastRescanTest().main()